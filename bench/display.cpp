@@ -0,0 +1,63 @@
+// sherpa_41's Display module benchmarks, licensed under MIT. (c) hafiz, 2018
+
+#include "display.h"
+
+#include "util.h"
+
+static void DisplayListExample(benchmark::State& state) {
+  const auto& name = examples()[state.range(0)];
+  const auto laidOut = layoutPage(readExample(name + ".html"), readExample(name + ".css"));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Display::DisplayList::from(laidOut.root));
+  }
+}
+BENCHMARK(DisplayListExample)->Apply(exampleArgs);
+
+static void DisplayListWide(benchmark::State& state) {
+  const auto page = widePage(state.range(0));
+  const auto laidOut = layoutPage(Generator::document(page), Generator::stylesheet(page));
+  uint64_t commands(0);
+  for (auto _ : state) {
+    auto list = Display::DisplayList::from(laidOut.root);
+    commands = list.size();
+    benchmark::DoNotOptimize(list);
+  }
+  state.counters["commands"] = static_cast<double>(commands);
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(DisplayListWide)->RangeMultiplier(4)->Range(16, 4096)->Complexity();
+
+static void DisplayListViewport(benchmark::State& state) {
+  const auto page = widePage(state.range(0));
+  const auto laidOut = layoutPage(Generator::document(page), Generator::stylesheet(page));
+  const Layout::Rectangle viewport(0, 0, benchWidth, benchHeight);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Display::DisplayList::from(laidOut.root, viewport));
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(DisplayListViewport)->RangeMultiplier(4)->Range(16, 4096)->Complexity();
+
+static void CullNested(benchmark::State& state) {
+  // boxes nested without padding cover one another exactly, so each is hidden
+  // by the next, and only the innermost is kept
+  std::string html;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    html += "<div>";
+  }
+  html += "x";
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    html += "</div>";
+  }
+  const auto laidOut =
+      layoutPage("<html>" + html + "</html>",
+                 "* { display: block; } div { height: 10px; background: #102030; }");
+  const auto list = Display::DisplayList::from(laidOut.root);
+  for (auto _ : state) {
+    auto culled = list;
+    benchmark::DoNotOptimize(culled.cullOccluded());
+  }
+  state.counters["commands"] = static_cast<double>(list.size());
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(CullNested)->RangeMultiplier(4)->Range(16, 1024)->Complexity();
@@ -0,0 +1,52 @@
+// sherpa_41's Layout module benchmarks, licensed under MIT. (c) hafiz, 2018
+
+#include "layout.h"
+
+#include "util.h"
+
+/**
+ * Benchmarks laying out a page, excluding parsing and styling
+ * @param state benchmark state
+ * @param html HTML source
+ * @param css CSS source
+ */
+static void layout(benchmark::State& state,
+                   const std::string& html,
+                   const std::string& css) {
+  auto dom = HTMLParser(html).evaluate();
+  auto stylesheet = CSSParser(css).evaluate();
+  auto styledDom = Style::StyledNode::from(*dom, stylesheet);
+  const Layout::BoxDimensions window(Layout::Rectangle(0, 0, benchWidth, benchHeight));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Layout::Box::from(styledDom, window));
+  }
+}
+
+static void LayoutExample(benchmark::State& state) {
+  const auto& name = examples()[state.range(0)];
+  layout(state, readExample(name + ".html"), readExample(name + ".css"));
+}
+BENCHMARK(LayoutExample)->Apply(exampleArgs);
+
+static void LayoutDeep(benchmark::State& state) {
+  const auto page = deepPage(state.range(0));
+  layout(state, Generator::document(page), Generator::stylesheet(page));
+  state.SetComplexityN(state.range(0));
+}
+// every box holds a copy of its styled subtree, and boxes are copied again as
+// they are built, so depth is kept small: time doubles with each level
+BENCHMARK(LayoutDeep)->DenseRange(2, 12, 2)->Complexity();
+
+static void LayoutWide(benchmark::State& state) {
+  const auto page = widePage(state.range(0));
+  layout(state, Generator::document(page), Generator::stylesheet(page));
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(LayoutWide)->RangeMultiplier(4)->Range(16, 4096)->Complexity();
+
+static void LayoutRandom(benchmark::State& state) {
+  const auto page = randomPage(state.range(0));
+  layout(state, Generator::document(page), Generator::stylesheet(page));
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(LayoutRandom)->RangeMultiplier(4)->Range(16, 1024)->Complexity();
@@ -0,0 +1,24 @@
+// sherpa_41's CSS Parser benchmarks, licensed under MIT. (c) hafiz, 2018
+
+#include "parser/css.h"
+
+#include "util.h"
+
+static void CSSParserExample(benchmark::State& state) {
+  const auto css = readExample(examples()[state.range(0)] + ".css");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(CSSParser(css).evaluate());
+  }
+  state.SetBytesProcessed(state.iterations() * css.size());
+}
+BENCHMARK(CSSParserExample)->Apply(exampleArgs);
+
+static void CSSParserRules(benchmark::State& state) {
+  const auto css = Generator::stylesheet(rulesPage(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(CSSParser(css).evaluate());
+  }
+  state.SetBytesProcessed(state.iterations() * css.size());
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(CSSParserRules)->RangeMultiplier(4)->Range(16, 1024)->Complexity();
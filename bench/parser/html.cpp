@@ -0,0 +1,44 @@
+// sherpa_41's HTML Parser benchmarks, licensed under MIT. (c) hafiz, 2018
+
+#include "parser/html.h"
+
+#include "util.h"
+
+static void HTMLParserExample(benchmark::State& state) {
+  const auto html = readExample(examples()[state.range(0)] + ".html");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(HTMLParser(html).evaluate());
+  }
+  state.SetBytesProcessed(state.iterations() * html.size());
+}
+BENCHMARK(HTMLParserExample)->Apply(exampleArgs);
+
+static void HTMLParserDeep(benchmark::State& state) {
+  const auto html = Generator::document(deepPage(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(HTMLParser(html).evaluate());
+  }
+  state.SetBytesProcessed(state.iterations() * html.size());
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(HTMLParserDeep)->RangeMultiplier(4)->Range(16, 1024)->Complexity();
+
+static void HTMLParserWide(benchmark::State& state) {
+  const auto html = Generator::document(widePage(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(HTMLParser(html).evaluate());
+  }
+  state.SetBytesProcessed(state.iterations() * html.size());
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(HTMLParserWide)->RangeMultiplier(4)->Range(16, 4096)->Complexity();
+
+static void HTMLParserRandom(benchmark::State& state) {
+  const auto html = Generator::document(randomPage(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(HTMLParser(html).evaluate());
+  }
+  state.SetBytesProcessed(state.iterations() * html.size());
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(HTMLParserRandom)->RangeMultiplier(4)->Range(16, 4096)->Complexity();
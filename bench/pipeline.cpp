@@ -0,0 +1,79 @@
+// sherpa_41's end-to-end benchmarks, licensed under MIT. (c) hafiz, 2018
+
+#include <memory_resource>
+
+#include "arena.h"
+#include "renderer/canvas.h"
+#include "renderer/encoder.h"
+#include "util.h"
+
+/**
+ * Benchmarks every stage of a render, from sources to an encoded PNG image
+ * @param state benchmark state
+ * @param html HTML source
+ * @param css CSS source
+ * @param arena resource to render from, released after each render, or
+ *        nullptr for the heap
+ */
+static void render(benchmark::State& state,
+                   const std::string& html,
+                   const std::string& css,
+                   std::pmr::unsynchronized_pool_resource* arena = nullptr) {
+  const auto width = static_cast<uint64_t>(benchWidth);
+  const auto height = static_cast<uint64_t>(benchHeight);
+  for (auto _ : state) {
+    {
+      const Arena::Scope scope(arena);
+      const auto laidOut = layoutPage(html, css);
+      const Canvas canvas(Layout::Rectangle(0, 0, benchWidth, benchHeight), laidOut.root);
+      std::stringstream out;
+      auto encoder = Encoder::from("out.png", out, width, height);
+      canvas.encode(*encoder);
+      encoder->finish();
+      benchmark::DoNotOptimize(out);
+    }
+    if (arena != nullptr) {
+      arena->release();
+    }
+  }
+}
+
+static void PipelineExample(benchmark::State& state) {
+  const auto& name = examples()[state.range(0)];
+  render(state, readExample(name + ".html"), readExample(name + ".css"));
+}
+BENCHMARK(PipelineExample)->Apply(exampleArgs)->Unit(benchmark::kMillisecond);
+
+static void PipelineWide(benchmark::State& state) {
+  const auto page = widePage(state.range(0));
+  render(state, Generator::document(page), Generator::stylesheet(page));
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(PipelineWide)
+    ->RangeMultiplier(4)
+    ->Range(16, 1024)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+
+static void PipelineRandom(benchmark::State& state) {
+  const auto page = randomPage(state.range(0));
+  render(state, Generator::document(page), Generator::stylesheet(page));
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(PipelineRandom)
+    ->RangeMultiplier(4)
+    ->Range(16, 1024)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+
+static void PipelineRandomArena(benchmark::State& state) {
+  const auto page = randomPage(state.range(0));
+  std::pmr::unsynchronized_pool_resource arena;
+  render(state, Generator::document(page), Generator::stylesheet(page), &arena);
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(PipelineRandomArena)
+    ->RangeMultiplier(4)
+    ->Range(16, 1024)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
@@ -0,0 +1,54 @@
+// sherpa_41's Canvas benchmarks, licensed under MIT. (c) hafiz, 2018
+
+#include "renderer/canvas.h"
+
+#include "util.h"
+
+static void CanvasExample(benchmark::State& state) {
+  const auto& name = examples()[state.range(0)];
+  const auto laidOut = layoutPage(readExample(name + ".html"), readExample(name + ".css"));
+  const Layout::Rectangle frame(0, 0, benchWidth, benchHeight);
+  for (auto _ : state) {
+    Canvas canvas(frame, laidOut.root);
+    benchmark::DoNotOptimize(canvas.view().data);
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(benchWidth * benchHeight));
+}
+BENCHMARK(CanvasExample)->Apply(exampleArgs);
+
+static void CanvasScroll(benchmark::State& state) {
+  const auto page = widePage(state.range(0));
+  const auto laidOut = layoutPage(Generator::document(page), Generator::stylesheet(page));
+  Canvas canvas(static_cast<uint64_t>(benchWidth), static_cast<uint64_t>(benchHeight));
+  for (auto _ : state) {
+    canvas.scrollTo(laidOut.root, 0, 0);
+    benchmark::DoNotOptimize(canvas.view().data);
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(benchWidth * benchHeight));
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(CanvasScroll)->RangeMultiplier(4)->Range(16, 4096)->Complexity();
+
+static void CanvasGetPixels(benchmark::State& state) {
+  const auto size = static_cast<uint64_t>(state.range(0));
+  Canvas canvas(size, size);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(canvas.getPixels());
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(size * size * 4));
+}
+BENCHMARK(CanvasGetPixels)->RangeMultiplier(4)->Range(256, 4096);
+
+static void CanvasExportPixels(benchmark::State& state) {
+  const auto size = static_cast<uint64_t>(state.range(0));
+  Canvas canvas(size, size);
+  std::vector<uint8_t> pixels(size * size * 4);
+  for (auto _ : state) {
+    canvas.exportPixels(pixels.data(), Canvas::ChannelOrder::BGRA, true);
+    benchmark::DoNotOptimize(pixels.data());
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(pixels.size()));
+}
+BENCHMARK(CanvasExportPixels)->RangeMultiplier(4)->Range(256, 4096);
@@ -0,0 +1,33 @@
+// sherpa_41's Encoder benchmarks, licensed under MIT. (c) hafiz, 2018
+
+#include "renderer/encoder.h"
+
+#include "renderer/canvas.h"
+#include "util.h"
+
+/**
+ * Benchmarks encoding the first example page into an in-memory image file
+ * @param state benchmark state
+ * @param file name of the image file, whose extension picks the encoder
+ */
+static void encode(benchmark::State& state, const std::string& file) {
+  const auto& name = examples()[2];
+  const auto laidOut = layoutPage(readExample(name + ".html"), readExample(name + ".css"));
+  const Canvas canvas(Layout::Rectangle(0, 0, benchWidth, benchHeight), laidOut.root);
+  const auto width = static_cast<uint64_t>(benchWidth);
+  const auto height = static_cast<uint64_t>(benchHeight);
+
+  uint64_t bytes(0);
+  for (auto _ : state) {
+    std::stringstream out;
+    auto encoder = Encoder::from(file, out, width, height);
+    canvas.encode(*encoder);
+    encoder->finish();
+    bytes = out.tellp();
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(width * height * 4));
+  state.counters["size"] = static_cast<double>(bytes);
+}
+BENCHMARK_CAPTURE(encode, png, std::string("out.png"));
+BENCHMARK_CAPTURE(encode, ppm, std::string("out.ppm"));
+BENCHMARK_CAPTURE(encode, pam, std::string("out.pam"));
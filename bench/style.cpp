@@ -0,0 +1,81 @@
+// sherpa_41's Style module benchmarks, licensed under MIT. (c) hafiz, 2018
+
+#include "style.h"
+
+#include "util.h"
+
+static void StyledNodeExample(benchmark::State& state) {
+  const auto& name = examples()[state.range(0)];
+  auto dom = HTMLParser(readExample(name + ".html")).evaluate();
+  auto stylesheet = CSSParser(readExample(name + ".css")).evaluate();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Style::StyledNode::from(*dom, stylesheet));
+  }
+}
+BENCHMARK(StyledNodeExample)->Apply(exampleArgs);
+
+static void StyledNodeDeep(benchmark::State& state) {
+  const auto page = deepPage(state.range(0));
+  auto dom = HTMLParser(Generator::document(page)).evaluate();
+  auto stylesheet = CSSParser(Generator::stylesheet(page)).evaluate();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Style::StyledNode::from(*dom, stylesheet));
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(StyledNodeDeep)->RangeMultiplier(2)->Range(8, 128)->Complexity();
+
+static void StyledNodeWide(benchmark::State& state) {
+  const auto page = widePage(state.range(0));
+  auto dom = HTMLParser(Generator::document(page)).evaluate();
+  auto stylesheet = CSSParser(Generator::stylesheet(page)).evaluate();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Style::StyledNode::from(*dom, stylesheet));
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(StyledNodeWide)->RangeMultiplier(4)->Range(16, 4096)->Complexity();
+
+static void StyledNodeRules(benchmark::State& state) {
+  const auto page = rulesPage(state.range(0));
+  auto dom = HTMLParser(Generator::document(page)).evaluate();
+  auto stylesheet = CSSParser(Generator::stylesheet(page)).evaluate();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Style::StyledNode::from(*dom, stylesheet));
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(StyledNodeRules)->RangeMultiplier(4)->Range(16, 1024)->Complexity();
+
+static void StyledNodeRandom(benchmark::State& state) {
+  const auto page = randomPage(state.range(0));
+  auto dom = HTMLParser(Generator::document(page)).evaluate();
+  auto stylesheet = CSSParser(Generator::stylesheet(page)).evaluate();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Style::StyledNode::from(*dom, stylesheet));
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(StyledNodeRandom)->RangeMultiplier(4)->Range(16, 4096)->Complexity();
+
+static void StyledNodeCombinators(benchmark::State& state) {
+  const auto page = combinatorPage(state.range(0));
+  auto dom = HTMLParser(Generator::document(page)).evaluate();
+  auto stylesheet = CSSParser(Generator::stylesheet(page)).evaluate();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Style::StyledNode::from(*dom, stylesheet));
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(StyledNodeCombinators)->RangeMultiplier(2)->Range(8, 128)->Complexity();
+
+static void StyledNodeStructural(benchmark::State& state) {
+  const auto page = structuralPage(state.range(0));
+  auto dom = HTMLParser(Generator::document(page)).evaluate();
+  auto stylesheet = CSSParser(Generator::stylesheet(page)).evaluate();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Style::StyledNode::from(*dom, stylesheet));
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(StyledNodeStructural)->RangeMultiplier(4)->Range(16, 4096)->Complexity();
@@ -0,0 +1,162 @@
+// sherpa_41's benchmark utilities, licensed under MIT. (c) hafiz, 2018
+
+#ifndef BENCH_UTIL_HPP
+#define BENCH_UTIL_HPP
+
+#include <benchmark/benchmark.h>
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "generator.h"
+#include "layout.h"
+#include "parser/css.h"
+#include "parser/html.h"
+
+/**
+ * Width of the browser window benchmarks lay pages out in
+ */
+static constexpr double benchWidth = 1200;
+
+/**
+ * Height of the browser window benchmarks lay pages out in
+ */
+static constexpr double benchHeight = 800;
+
+/**
+ * Returns the example pages, each a pair of `examples/<name>.html` and
+ * `examples/<name>.css`
+ * @return page names
+ */
+inline auto examples() -> const std::vector<std::string>& {
+  static const std::vector<std::string> names{"robinson-test", "test", "sherpa-webpage",
+                                              "rainbow-boxes"};
+  return names;
+}
+
+/**
+ * Reads a file of the examples directory
+ * @param file file name
+ * @return file contents
+ */
+inline auto readExample(const std::string& file) -> std::string {
+  std::ifstream in(std::string(SHERPA_EXAMPLES) + "/" + file);
+  if (!in) {
+    throw std::runtime_error("Cannot read example " + file);
+  }
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  return buffer.str();
+}
+
+/**
+ * Runs a benchmark once per example page, passing the page's index as its
+ * argument
+ * @param bench benchmark to configure
+ */
+inline void exampleArgs(benchmark::internal::Benchmark* bench) {
+  bench->DenseRange(0, static_cast<int>(examples().size()) - 1);
+}
+
+/**
+ * Returns the options of a page of nested elements, one per level
+ * @param depth number of nested elements
+ * @return generator options
+ */
+inline auto deepPage(uint64_t depth) -> Generator::Options {
+  Generator::Options options;
+  options.nodes = depth;
+  options.depth = depth;
+  options.fanOut = 1;
+  return options;
+}
+
+/**
+ * Returns the options of a page of nested elements, one per level, styled by
+ * rules that are mostly descendant and child selectors
+ * @param depth number of nested elements
+ * @return generator options
+ */
+inline auto combinatorPage(uint64_t depth) -> Generator::Options {
+  auto options = deepPage(depth);
+  options.selectors.combinator = 8;
+  return options;
+}
+
+/**
+ * Returns the options of a page of sibling elements
+ * @param width number of siblings
+ * @return generator options
+ */
+inline auto widePage(uint64_t width) -> Generator::Options {
+  Generator::Options options;
+  options.nodes = width + 1;
+  options.depth = 2;
+  options.fanOut = width;
+  return options;
+}
+
+/**
+ * Returns the options of a page of sibling elements, styled by rules that are
+ * mostly structural pseudo-classes and attribute selectors
+ * @param width number of siblings
+ * @return generator options
+ */
+inline auto structuralPage(uint64_t width) -> Generator::Options {
+  auto options = widePage(width);
+  options.selectors.structural = 8;
+  return options;
+}
+
+/**
+ * Returns the options of a page of random elements, of the generator's
+ * default depth and fan-out
+ * @param nodes number of elements
+ * @return generator options
+ */
+inline auto randomPage(uint64_t nodes) -> Generator::Options {
+  Generator::Options options;
+  options.nodes = nodes;
+  return options;
+}
+
+/**
+ * Returns the options of a page of the generator's default shape, with a
+ * style sheet of some number of rules
+ * @param rules number of rules
+ * @return generator options
+ */
+inline auto rulesPage(uint64_t rules) -> Generator::Options {
+  Generator::Options options;
+  options.rules = rules;
+  return options;
+}
+
+/**
+ * A page laid out in the benchmark window, with the DOM tree and style sheet
+ * its boxes refer to
+ */
+struct LaidOutPage {
+  DOM::NodePtr dom;
+  CSS::StyleSheet stylesheet;
+  Layout::BoxPtr root;
+};
+
+/**
+ * Lays out a page in the benchmark window
+ * @param html HTML source
+ * @param css CSS source
+ * @return laid out page
+ */
+inline auto layoutPage(const std::string& html, const std::string& css) -> LaidOutPage {
+  LaidOutPage laidOut{HTMLParser(html).evaluate(), CSSParser(css).evaluate(), nullptr};
+  auto styledDom = Style::StyledNode::from(*laidOut.dom, laidOut.stylesheet);
+  laidOut.root = Layout::Box::from(
+      styledDom, Layout::BoxDimensions(Layout::Rectangle(0, 0, benchWidth, benchHeight)));
+  return laidOut;
+}
+
+#endif
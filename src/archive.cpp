@@ -0,0 +1,868 @@
+// sherpa_41's Archive module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef ARCHIVE_CPP
+#define ARCHIVE_CPP
+
+#include "archive.h"
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Magic bytes that start every image
+ */
+static constexpr char magic[4] = {'S', '4', '1', 'A'};
+
+/**
+ * Size of the image header
+ */
+static constexpr uint64_t headerSize = 16;
+
+/**
+ * Size of a box record: six u32 fields, then sixteen f64 dimensions
+ */
+static constexpr uint64_t boxSize = 6 * 4 + 16 * 8;
+
+/**
+ * Creates a writer of an empty image
+ */
+Archive::Writer::Writer() : image(headerSize, '\0'), root(0), kind(Kind::Document) {}
+
+/**
+ * Writes a text node
+ * @param node Text node
+ */
+void Archive::Writer::visit(const DOM::TextNode& node) {
+  root = writeNode(node, true);
+  kind = Kind::Document;
+}
+
+/**
+ * Writes a comment node
+ * @param node Comment node
+ */
+void Archive::Writer::visit(const DOM::CommentNode& node) {
+  root = writeNode(node, true);
+  kind = Kind::Document;
+}
+
+/**
+ * Writes an element and its children
+ * @param node Element node
+ */
+void Archive::Writer::visit(const DOM::ElementNode& node) {
+  root = writeNode(node, true);
+  kind = Kind::Document;
+}
+
+/**
+ * Writes a style sheet
+ * @param ss style sheet
+ */
+void Archive::Writer::visit(const CSS::StyleSheet& ss) {
+  std::vector<uint32_t> rules;
+  rules.reserve(ss.size());
+  for (const auto& rule : ss) {
+    std::vector<uint32_t> selectors, declarations;
+    for (const auto& selector : rule.selectors) {
+      selectors.push_back(writeSelector(selector));
+    }
+    for (const auto& declaration : rule.declarations) {
+      declarations.push_back(writeDeclaration(declaration.name, declaration.value));
+    }
+
+    const uint32_t record[2] = {writeArray(selectors), writeArray(declarations)};
+    rules.push_back(append(record, sizeof(record)));
+  }
+
+  root = writeArray(rules);
+  kind = Kind::StyleSheet;
+}
+
+/**
+ * Writes a layout box tree. Children are written before their parents.
+ * @param box root box
+ */
+void Archive::Writer::visit(const Layout::Box& box) {
+  std::vector<uint32_t> children;
+  children.reserve(box.borrowChildren().size());
+  for (const auto& child : box.borrowChildren()) {
+    visit(*child);
+    children.push_back(root);
+  }
+
+  uint32_t fields[6] = {0, 0, 0, 0, writeArray(children), 0};
+  if (auto styled = dynamic_cast<const Layout::StyledBox*>(&box)) {
+    const auto& content = styled->borrowContent();
+    std::vector<uint32_t> properties;
+    for (const auto& property : content.getProperties()) {
+      properties.push_back(writeDeclaration(property.first, property.second));
+    }
+    fields[0] = 1;
+    fields[1] = styled->getDisplay();
+    fields[2] = writeNode(content.borrowNode(), false);
+    fields[3] = writeArray(properties);
+  }
+
+  const auto dims = box.getDimensions();
+  const double numbers[16] = {
+      dims.origin.x,      dims.origin.y,       dims.width,          dims.height,
+      dims.margin.top,    dims.margin.left,    dims.margin.bottom,  dims.margin.right,
+      dims.padding.top,   dims.padding.left,   dims.padding.bottom, dims.padding.right,
+      dims.border.top,    dims.border.left,    dims.border.bottom,  dims.border.right};
+
+  char record[boxSize];
+  std::memcpy(record, fields, sizeof(fields));
+  std::memcpy(record + sizeof(fields), numbers, sizeof(numbers));
+  root = append(record, sizeof(record), 8);
+  kind = Kind::Layout;
+}
+
+/**
+ * Returns the image, rooted at the last tree written
+ * @return image bytes
+ */
+auto Archive::Writer::result() -> std::string {
+  if (image.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::length_error("Archive is larger than 4 GiB");
+  }
+
+  const auto type = static_cast<uint16_t>(kind);
+  const auto size = static_cast<uint32_t>(image.size());
+  std::memcpy(&image[0], magic, 4);
+  std::memcpy(&image[4], &version, 2);
+  std::memcpy(&image[6], &type, 2);
+  std::memcpy(&image[8], &root, 4);
+  std::memcpy(&image[12], &size, 4);
+  return image;
+}
+
+/**
+ * Writes an image of a DOM tree
+ * @param root root node
+ * @return image bytes
+ */
+auto Archive::Writer::from(const DOM::Node& root) -> std::string {
+  Writer writer;
+  root.acceptVisitor(writer);
+  return writer.result();
+}
+
+/**
+ * Writes an image of a style sheet
+ * @param ss style sheet
+ * @return image bytes
+ */
+auto Archive::Writer::from(const CSS::StyleSheet& ss) -> std::string {
+  Writer writer;
+  writer.visit(ss);
+  return writer.result();
+}
+
+/**
+ * Writes an image of a layout box tree
+ * @param root root box
+ * @return image bytes
+ */
+auto Archive::Writer::from(const Layout::Box& root) -> std::string {
+  Writer writer;
+  writer.visit(root);
+  return writer.result();
+}
+
+/**
+ * Writes a node, with or without its children. Children are written before
+ * their parents.
+ * @param node DOM node
+ * @param children whether to write its children
+ * @return offset of the node
+ */
+auto Archive::Writer::writeNode(const DOM::Node& node, bool children) -> uint32_t {
+  uint32_t record[4] = {0, 0, 0, 0};
+  if (auto text = dynamic_cast<const DOM::TextNode*>(&node)) {
+    record[0] = static_cast<uint32_t>(NodeType::Text);
+    record[1] = writeString(text->getText());
+  } else if (auto comment = dynamic_cast<const DOM::CommentNode*>(&node)) {
+    record[0] = static_cast<uint32_t>(NodeType::Comment);
+    record[1] = writeString(comment->getComment());
+  } else if (auto element = dynamic_cast<const DOM::ElementNode*>(&node)) {
+    const auto& attributes = element->borrowAttributes();
+    std::vector<uint32_t> attrs, kids;
+    for (const auto& name : attributes.getOrder()) {
+      attrs.push_back(writeString(name));
+      attrs.push_back(writeString(attributes.at(name)));
+    }
+    if (children) {
+      for (const auto& child : element->borrowChildren()) {
+        kids.push_back(writeNode(*child, true));
+      }
+    }
+
+    record[0] = static_cast<uint32_t>(NodeType::Element);
+    record[1] = writeString(element->tagName());
+    record[2] = writeArray(attrs);
+    record[3] = writeArray(kids);
+  }
+  return append(record, sizeof(record));
+}
+
+/**
+ * Writes a declaration
+ * @param name property name
+ * @param value property value
+ * @return offset of the declaration
+ */
+auto Archive::Writer::writeDeclaration(const std::string& name, const CSS::Value& value)
+    -> uint32_t {
+  uint32_t fields[2] = {0, 0};
+  double number(0);
+  switch (value.getType()) {
+    case CSS::Value::Keyword:  // by name, as keywords are numbered per process
+      fields[1] = writeString(std::string(value.getIdentifier()));
+      break;
+    case CSS::Value::Length:
+      fields[0] = 1;
+      fields[1] = value.getUnit();
+      number = value.unitValue();
+      break;
+    case CSS::Value::Color: {
+      const auto rgb = value.channels();
+      fields[0] = 2;
+      fields[1] = rgb[0] | rgb[1] << 8 | rgb[2] << 16;
+      number = value.getAlpha();
+      break;
+    }
+    default:
+      throw std::invalid_argument("Cannot archive value " + value.print());
+  }
+
+  char record[16];
+  std::memcpy(record, fields, sizeof(fields));
+  std::memcpy(record + sizeof(fields), &number, sizeof(number));
+  const uint32_t declaration[2] = {writeString(name), append(record, sizeof(record), 8)};
+  return append(declaration, sizeof(declaration));
+}
+
+/**
+ * Writes a selector, after its ancestor selectors
+ * @param selector selector to write
+ * @return offset of the selector
+ */
+auto Archive::Writer::writeSelector(const CSS::Selector& selector) -> uint32_t {
+  std::vector<uint32_t> klass, ancestors;
+  for (const auto& name : selector.klass) {
+    klass.push_back(writeString(name));
+  }
+  for (const auto& ancestor : selector.ancestors) {
+    ancestors.push_back(writeSelector(ancestor));
+  }
+  std::vector<uint32_t> attributes, pseudoClasses;
+  for (const auto& attribute : selector.attributes) {
+    const uint32_t fields[3] = {writeString(attribute.name), attribute.match,
+                                writeString(attribute.value)};
+    attributes.push_back(append(fields, sizeof(fields)));
+  }
+  for (const auto& pseudoClass : selector.pseudoClasses) {
+    const int32_t fields[2] = {static_cast<int32_t>(pseudoClass.a),
+                               static_cast<int32_t>(pseudoClass.b)};
+    pseudoClasses.push_back(append(fields, sizeof(fields)));
+  }
+  const uint32_t record[7] = {writeString(selector.tag), writeString(selector.id),
+                              writeArray(klass),         selector.combinator,
+                              writeArray(ancestors),     writeArray(attributes),
+                              writeArray(pseudoClasses)};
+  return append(record, sizeof(record));
+}
+
+/**
+ * Writes a string, or finds it if it was already written. Tag, attribute, and
+ * property names repeat throughout a page, so each is stored once.
+ * @param str string to write
+ * @return offset of the string
+ */
+auto Archive::Writer::writeString(const std::string& str) -> uint32_t {
+  if (str.empty()) {
+    return 0;
+  }
+  auto found = strings.find(str);
+  if (found != strings.end()) {
+    return found->second;
+  }
+
+  const auto length = static_cast<uint32_t>(str.size());
+  const auto offset = append(&length, sizeof(length));
+  image += str;
+  strings.emplace(str, offset);
+  return offset;
+}
+
+/**
+ * Writes an array of offsets
+ * @param offsets offsets to write
+ * @return offset of the array
+ */
+auto Archive::Writer::writeArray(const std::vector<uint32_t>& offsets) -> uint32_t {
+  if (offsets.empty()) {
+    return 0;
+  }
+  std::vector<uint32_t> record;
+  record.reserve(offsets.size() + 1);
+  record.push_back(static_cast<uint32_t>(offsets.size()));
+  record.insert(record.end(), offsets.begin(), offsets.end());
+  return append(record.data(), record.size() * sizeof(uint32_t));
+}
+
+/**
+ * Appends a record to the image, padding it to its alignment
+ * @param data record bytes
+ * @param size number of bytes
+ * @param align alignment of the record
+ * @return offset of the record
+ */
+auto Archive::Writer::append(const void* data, uint64_t size, uint64_t align) -> uint32_t {
+  image.resize((image.size() + align - 1) / align * align, '\0');
+  if (image.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::length_error("Archive is larger than 4 GiB");
+  }
+  const auto offset = static_cast<uint32_t>(image.size());
+  image.append(static_cast<const char*>(data), size);
+  return offset;
+}
+
+/**
+ * Creates a view of bytes
+ * @param data first byte
+ * @param size number of bytes
+ */
+Archive::Bytes::Bytes(const char* data, uint64_t size) : data(data), size(size) {}
+
+/**
+ * Returns the number of bytes
+ * @return number of bytes
+ */
+auto Archive::Bytes::getSize() const -> uint64_t {
+  return size;
+}
+
+/**
+ * Reads a u16
+ * @param offset offset of the u16
+ * @return read value
+ */
+auto Archive::Bytes::u16(uint64_t offset) const -> uint16_t {
+  check(offset, sizeof(uint16_t));
+  uint16_t value;
+  std::memcpy(&value, data + offset, sizeof(value));
+  return value;
+}
+
+/**
+ * Reads a u32
+ * @param offset offset of the u32
+ * @return read value
+ */
+auto Archive::Bytes::u32(uint64_t offset) const -> uint32_t {
+  check(offset, sizeof(uint32_t));
+  uint32_t value;
+  std::memcpy(&value, data + offset, sizeof(value));
+  return value;
+}
+
+/**
+ * Reads an f64
+ * @param offset offset of the f64
+ * @return read value
+ */
+auto Archive::Bytes::f64(uint64_t offset) const -> double {
+  check(offset, sizeof(double));
+  double value;
+  std::memcpy(&value, data + offset, sizeof(value));
+  return value;
+}
+
+/**
+ * Reads a string record in place
+ * @param offset offset of the string, or 0 for an empty string
+ * @return viewed string
+ */
+auto Archive::Bytes::string(uint32_t offset) const -> std::string_view {
+  if (offset == 0) {
+    return std::string_view();
+  }
+  const auto length = u32(offset);
+  check(offset + 4ULL, length);
+  return std::string_view(data + offset + 4, length);
+}
+
+/**
+ * Reads the length of an array record
+ * @param offset offset of the array, or 0 for an empty array
+ * @return number of elements
+ */
+auto Archive::Bytes::count(uint32_t offset) const -> uint32_t {
+  return offset == 0 ? 0 : u32(offset);
+}
+
+/**
+ * Reads an element of an array record
+ * @param offset offset of the array
+ * @param index index of the element
+ * @return element offset
+ */
+auto Archive::Bytes::element(uint32_t offset, uint32_t index) const -> uint32_t {
+  if (index >= count(offset)) {
+    throw std::invalid_argument("Archive array index out of bounds");
+  }
+  return u32(offset + 4ULL + 4ULL * index);
+}
+
+/**
+ * Reads a value record
+ * @param offset offset of the value
+ * @return copy of the value, viewing the identifier of a keyword in the bytes
+ */
+auto Archive::Bytes::value(uint32_t offset) const -> CSS::Value {
+  const auto type = u32(offset);
+  const auto field = u32(offset + 4ULL);
+  const auto number = f64(offset + 8ULL);
+  switch (type) {
+    case 0:
+      return CSS::Value::keyword(string(field));
+    case 1:
+      if (field > CSS::percent) {
+        break;
+      }
+      return CSS::Value::length(number, static_cast<CSS::Unit>(field));
+    case 2:
+      return CSS::Value::color(field & 0xff, field >> 8 & 0xff, field >> 16 & 0xff, number);
+    default:
+      break;
+  }
+  throw std::invalid_argument("Archive value is malformed");
+}
+
+/**
+ * Reads a selector record, with its ancestors. Ancestors must have been
+ * written before the selector, so that a malformed image cannot loop.
+ * @param offset offset of the selector
+ * @return copy of the selector
+ */
+auto Archive::Bytes::selector(uint32_t offset) const -> CSS::Selector {
+  const auto classes = u32(offset + 8ULL);
+  std::vector<std::string> klass;
+  for (uint32_t c = 0; c < count(classes); ++c) {
+    klass.emplace_back(string(element(classes, c)));
+  }
+  CSS::Selector selector(std::string(string(u32(offset))),
+                         std::string(string(u32(offset + 4ULL))), std::move(klass));
+
+  const auto combinator = u32(offset + 12ULL);
+  const auto ancestors = u32(offset + 16ULL);
+  if (combinator > CSS::Child) {
+    throw std::invalid_argument("Archive selector is malformed");
+  }
+  selector.combinator = static_cast<CSS::Combinator>(combinator);
+  for (uint32_t a = 0; a < count(ancestors); ++a) {
+    const auto ancestor = element(ancestors, a);
+    if (ancestor >= offset) {
+      throw std::invalid_argument("Archive selector is malformed");
+    }
+    selector.ancestors.push_back(this->selector(ancestor));
+  }
+
+  const auto attributes = u32(offset + 20ULL);
+  for (uint32_t a = 0; a < count(attributes); ++a) {
+    const auto attribute = element(attributes, a);
+    const auto match = u32(attribute + 4ULL);
+    if (match > CSS::Equals) {
+      throw std::invalid_argument("Archive selector is malformed");
+    }
+    selector.attributes.push_back({std::string(string(u32(attribute))),
+                                   static_cast<CSS::AttributeMatch>(match),
+                                   std::string(string(u32(attribute + 8ULL)))});
+  }
+  const auto pseudoClasses = u32(offset + 24ULL);
+  for (uint32_t p = 0; p < count(pseudoClasses); ++p) {
+    const auto pseudoClass = element(pseudoClasses, p);
+    selector.pseudoClasses.push_back({static_cast<int32_t>(u32(pseudoClass)),
+                                      static_cast<int32_t>(u32(pseudoClass + 4ULL))});
+  }
+  return selector;
+}
+
+/**
+ * Ensures that a range of bytes is within the image
+ * @param offset start of the range
+ * @param size length of the range
+ */
+void Archive::Bytes::check(uint64_t offset, uint64_t size) const {
+  if (offset > this->size || size > this->size - offset) {
+    throw std::invalid_argument("Archive record out of bounds");
+  }
+}
+
+/**
+ * Creates a view of a node record
+ * @param bytes bytes of the image
+ * @param offset offset of the node
+ */
+Archive::NodeView::NodeView(Bytes bytes, uint32_t offset) : bytes(bytes), offset(offset) {}
+
+/**
+ * Returns the type of the node
+ * @return node type
+ */
+auto Archive::NodeView::type() const -> NodeType {
+  const auto type = bytes.u32(offset);
+  if (type > static_cast<uint32_t>(NodeType::Element)) {
+    throw std::invalid_argument("Archive node is malformed");
+  }
+  return static_cast<NodeType>(type);
+}
+
+/**
+ * Returns the tag name of an element, or the content of a text or comment
+ * @return tag name or content
+ */
+auto Archive::NodeView::name() const -> std::string_view {
+  return bytes.string(bytes.u32(offset + 4ULL));
+}
+
+/**
+ * Returns the number of attributes of the node
+ * @return number of attributes
+ */
+auto Archive::NodeView::attributeCount() const -> uint32_t {
+  return bytes.count(bytes.u32(offset + 8ULL)) / 2;
+}
+
+/**
+ * Returns an attribute of the node, in the order it was parsed
+ * @param index index of the attribute
+ * @return attribute name and value
+ */
+auto Archive::NodeView::attribute(uint32_t index) const
+    -> std::pair<std::string_view, std::string_view> {
+  const auto attributes = bytes.u32(offset + 8ULL);
+  return {bytes.string(bytes.element(attributes, 2 * index)),
+          bytes.string(bytes.element(attributes, 2 * index + 1))};
+}
+
+/**
+ * Returns the number of children of the node
+ * @return number of children
+ */
+auto Archive::NodeView::childCount() const -> uint32_t {
+  return bytes.count(bytes.u32(offset + 12ULL));
+}
+
+/**
+ * Returns a child of the node. Children always precede their parents, which
+ * keeps a malformed image from looping.
+ * @param index index of the child
+ * @return child view
+ */
+auto Archive::NodeView::child(uint32_t index) const -> NodeView {
+  const auto child = bytes.element(bytes.u32(offset + 12ULL), index);
+  if (child >= offset) {
+    throw std::invalid_argument("Archive node is malformed");
+  }
+  return NodeView(bytes, child);
+}
+
+/**
+ * Copies the node and its descendants into a DOM tree
+ * @return root of the DOM tree
+ */
+auto Archive::NodeView::toNode() const -> DOM::NodePtr {
+  switch (type()) {
+    case NodeType::Text:
+      return DOM::NodePtr(new DOM::TextNode(std::string(name())));
+    case NodeType::Comment:
+      return DOM::NodePtr(new DOM::CommentNode(std::string(name())));
+    default:
+      break;
+  }
+
+  DOM::AttributeMap attributes;
+  for (uint32_t i = 0; i < attributeCount(); ++i) {
+    const auto attr = attribute(i);
+    attributes.insert(std::string(attr.first), std::string(attr.second));
+  }
+  DOM::NodeVector children;
+  for (uint32_t i = 0; i < childCount(); ++i) {
+    children.push_back(child(i).toNode());
+  }
+  return DOM::NodePtr(new DOM::ElementNode(std::string(name()), attributes, children));
+}
+
+/**
+ * Creates a view of a box record
+ * @param bytes bytes of the image
+ * @param offset offset of the box
+ */
+Archive::BoxView::BoxView(Bytes bytes, uint32_t offset) : bytes(bytes), offset(offset) {}
+
+/**
+ * Returns whether the box is anonymous, rather than styled
+ * @return whether the box is anonymous
+ */
+auto Archive::BoxView::isAnonymous() const -> bool {
+  return bytes.u32(offset) == 0;
+}
+
+/**
+ * Returns the display type of a styled box
+ * @return display type
+ */
+auto Archive::BoxView::display() const -> Layout::DisplayType {
+  const auto display = bytes.u32(offset + 4ULL);
+  if (display > Layout::None) {
+    throw std::invalid_argument("Archive box is malformed");
+  }
+  return static_cast<Layout::DisplayType>(display);
+}
+
+/**
+ * Returns the laid out dimensions of the box
+ * @return box dimensions
+ */
+auto Archive::BoxView::dimensions() const -> Layout::BoxDimensions {
+  double d[16];
+  for (uint64_t i = 0; i < 16; ++i) {
+    d[i] = bytes.f64(offset + 24 + 8 * i);
+  }
+  return Layout::BoxDimensions(Layout::Rectangle(d[0], d[1], d[2], d[3]),
+                               Layout::Edges(d[4], d[5], d[6], d[7]),
+                               Layout::Edges(d[8], d[9], d[10], d[11]),
+                               Layout::Edges(d[12], d[13], d[14], d[15]));
+}
+
+/**
+ * Returns the DOM node a styled box was made for, without its children
+ * @return node view
+ */
+auto Archive::BoxView::node() const -> NodeView {
+  const auto node = bytes.u32(offset + 8ULL);
+  if (isAnonymous() || node >= offset) {
+    throw std::invalid_argument("Archive box has no node");
+  }
+  return NodeView(bytes, node);
+}
+
+/**
+ * Returns the number of children of the box
+ * @return number of children
+ */
+auto Archive::BoxView::childCount() const -> uint32_t {
+  return bytes.count(bytes.u32(offset + 16ULL));
+}
+
+/**
+ * Returns a child of the box. Children always precede their parents.
+ * @param index index of the child
+ * @return child view
+ */
+auto Archive::BoxView::child(uint32_t index) const -> BoxView {
+  const auto child = bytes.element(bytes.u32(offset + 16ULL), index);
+  if (child >= offset) {
+    throw std::invalid_argument("Archive box is malformed");
+  }
+  return BoxView(bytes, child);
+}
+
+/**
+ * Copies the box and its descendants into a layout box tree
+ * @return root of the box tree
+ */
+auto Archive::BoxView::toBox() const -> Layout::BoxPtr {
+  Layout::BoxVector children;
+  for (uint32_t i = 0; i < childCount(); ++i) {
+    children.push_back(child(i).toBox());
+  }
+  if (isAnonymous()) {
+    return Layout::BoxPtr(new Layout::AnonymousBox(children));
+  }
+
+  Style::PropertyMap props;
+  const auto properties = bytes.u32(offset + 12ULL);
+  for (uint32_t i = 0; i < bytes.count(properties); ++i) {
+    const auto declaration = bytes.element(properties, i);
+    props[std::string(bytes.string(bytes.u32(declaration)))] =
+        bytes.value(bytes.u32(declaration + 4ULL));
+  }
+  const Style::StyledNode content(node().toNode(), std::move(props));
+  return Layout::BoxPtr(new Layout::StyledBox(dimensions(), content, display(), children));
+}
+
+/**
+ * Creates an image from its bytes
+ * @param bytes image bytes
+ */
+Archive::Image::Image(std::string bytes) : storage(), bytes(nullptr, 0) {
+  auto owned = std::make_shared<const std::string>(std::move(bytes));
+  this->bytes = Bytes(owned->data(), owned->size());
+  storage = std::move(owned);
+  validate();
+}
+
+/**
+ * Creates an image over bytes kept alive by their storage
+ * @param storage owner of the bytes
+ * @param data first byte
+ * @param size number of bytes
+ */
+Archive::Image::Image(std::shared_ptr<const void> storage, const char* data, uint64_t size)
+    : storage(std::move(storage)), bytes(data, size) {
+  validate();
+}
+
+/**
+ * Maps an image file into memory. Where mapping is unavailable, the file is
+ * read instead. The prefix is compared before the image is validated.
+ * @param path image file
+ * @param prefix bytes the file must start with, followed by the image
+ * @return mapped image
+ */
+auto Archive::Image::map(const std::string& path, std::string_view prefix) -> Image {
+#ifndef _WIN32
+  const int fd = open(path.c_str(), O_RDONLY);
+  struct stat info {};
+  if (fd < 0 || fstat(fd, &info) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    throw std::runtime_error("Cannot read " + path);
+  }
+
+  const auto size = static_cast<uint64_t>(info.st_size);
+  void* data = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (data == MAP_FAILED) {
+    throw std::invalid_argument(path + " is not an archive");
+  }
+
+  std::shared_ptr<const void> storage(
+      data, [size](const void* mapped) { munmap(const_cast<void*>(mapped), size); });
+  const auto* bytes = static_cast<const char*>(data);
+  if (std::string_view(bytes, size).substr(0, prefix.size()) != prefix) {
+    throw std::invalid_argument(path + " does not start with the expected prefix");
+  }
+  return Image(std::move(storage), bytes + prefix.size(), size - prefix.size());
+#else
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Cannot read " + path);
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  auto bytes = buffer.str();
+  if (std::string_view(bytes).substr(0, prefix.size()) != prefix) {
+    throw std::invalid_argument(path + " does not start with the expected prefix");
+  }
+  return Image(bytes.substr(prefix.size()));
+#endif
+}
+
+/**
+ * Returns what the image holds
+ * @return image kind
+ */
+auto Archive::Image::kind() const -> Kind {
+  return static_cast<Kind>(bytes.u16(6));
+}
+
+/**
+ * Returns the root DOM node of a document image
+ * @return node view
+ */
+auto Archive::Image::document() const -> NodeView {
+  return NodeView(bytes, rootOf(Kind::Document));
+}
+
+/**
+ * Copies the style sheet of a style sheet image
+ * @return style sheet
+ */
+auto Archive::Image::stylesheet() const -> CSS::StyleSheet {
+  const auto rules = rootOf(Kind::StyleSheet);
+  const auto identifiers = std::make_shared<CSS::Identifiers>();
+  CSS::StyleSheet ss;
+  ss.identifiers = identifiers;
+  ss.reserve(bytes.count(rules));
+  for (uint32_t r = 0; r < bytes.count(rules); ++r) {
+    const auto rule = bytes.element(rules, r);
+    const auto selectors = bytes.u32(rule);
+    const auto declarations = bytes.u32(rule + 4ULL);
+
+    CSS::PrioritySelectorSet sels;
+    for (uint32_t s = 0; s < bytes.count(selectors); ++s) {
+      sels.insert(bytes.selector(bytes.element(selectors, s)));
+    }
+
+    CSS::DeclarationSet decls;
+    for (uint32_t d = 0; d < bytes.count(declarations); ++d) {
+      const auto declaration = bytes.element(declarations, d);
+      auto value = bytes.value(bytes.u32(declaration + 4ULL));
+      // the sheet outlives the image, so keeps identifiers of its own
+      if (value.getKeyword() == CSS::Keyword::Count) {
+        value = CSS::Value::keyword(identifiers->intern(value.getIdentifier()));
+      }
+      decls.emplace_back(std::string(bytes.string(bytes.u32(declaration))), value);
+    }
+    ss.emplace_back(std::move(sels), std::move(decls));
+  }
+  return ss;
+}
+
+/**
+ * Returns the root box of a layout image
+ * @return box view
+ */
+auto Archive::Image::layout() const -> BoxView {
+  return BoxView(bytes, rootOf(Kind::Layout));
+}
+
+/**
+ * Ensures that the image has a valid header, of the current version
+ */
+void Archive::Image::validate() const {
+  uint32_t expected;
+  std::memcpy(&expected, magic, sizeof(expected));
+  if (bytes.getSize() < headerSize || bytes.u32(0) != expected) {
+    throw std::invalid_argument("Data is not an archive");
+  }
+  if (bytes.u16(4) != version) {
+    throw std::invalid_argument("Archive version " + std::to_string(bytes.u16(4)) +
+                                " is not supported");
+  }
+  const auto kind = bytes.u16(6);
+  if (kind < static_cast<uint16_t>(Kind::Document) ||
+      kind > static_cast<uint16_t>(Kind::Layout) || bytes.u32(12) != bytes.getSize()) {
+    throw std::invalid_argument("Archive is malformed");
+  }
+}
+
+/**
+ * Returns the root offset, ensuring that the image is of a kind
+ * @param expected expected kind
+ * @return root offset
+ */
+auto Archive::Image::rootOf(Kind expected) const -> uint32_t {
+  if (kind() != expected) {
+    throw std::invalid_argument("Archive does not hold the expected kind of tree");
+  }
+  return bytes.u32(8);
+}
+
+#endif
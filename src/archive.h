@@ -0,0 +1,488 @@
+// sherpa_41's Archive module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef ARCHIVE_HPP
+#define ARCHIVE_HPP
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "css.h"
+#include "dom.h"
+#include "layout.h"
+#include "visitor/visitor.h"
+
+/**
+ * The Archive module persists pipeline stages - DOM trees, style sheets, and
+ * layout box trees - in a compact binary image. Images are designed to be
+ * memory mapped and read in place: records refer to one another by offsets
+ * from the start of the image, so reading needs neither parsing nor pointer
+ * fixups.
+ *
+ * An image starts with a 16 byte header: the magic "S41A", a u16 version, a
+ * u16 kind, the u32 offset of the root record, and the u32 size of the image.
+ * All fields are in host byte order. Offset 0 stands for an empty string or
+ * array. Records are:
+ *  - string: u32 length, then its bytes
+ *  - array: u32 count, then count u32 offsets
+ *  - node: u32 type, u32 tag (or text) string, u32 attributes array of
+ *    alternating name and value strings, u32 children array of nodes
+ *  - style sheet: array of rules
+ *  - rule: u32 selectors array, u32 declarations array
+ *  - selector: u32 tag string, u32 id string, u32 classes array of strings,
+ *    u32 combinator, u32 ancestors array of selectors, nearest first, each
+ *    written before the selector, u32 attributes array of attribute
+ *    selectors, u32 pseudo-classes array of nth-child records
+ *  - attribute selector: u32 name string, u32 match, u32 value string
+ *  - nth-child: i32 a, i32 b
+ *  - declaration: u32 name string, u32 value
+ *  - value (8 byte aligned): u32 type, u32 text string, unit, or packed RGB
+ *    color, f64 number or alpha
+ *  - box (8 byte aligned): u32 type, u32 display, u32 node, u32 properties
+ *    array of declarations, u32 children array of boxes, u32 padding, then the
+ *    f64 x, y, width, height, and margin, padding, and border edges
+ */
+namespace Archive {
+/**
+ * What an image holds
+ */
+enum class Kind : uint16_t { Document = 1, StyleSheet = 2, Layout = 3 };
+
+/**
+ * Type of a DOM node record
+ */
+enum class NodeType : uint32_t { Text, Comment, Element };
+
+/**
+ * Current format version. Images of other versions are rejected.
+ */
+static constexpr uint16_t version = 3;
+
+/**
+ * Writes DOM trees, style sheets, and layout box trees into an image. The
+ * root of the image is the last tree written.
+ */
+class Writer : public Visitor {
+ public:
+  /**
+   * Creates a writer of an empty image
+   */
+  Writer();
+
+  ~Writer() override = default;
+
+  /**
+   * Writes a text node
+   * @param node Text node
+   */
+  void visit(const DOM::TextNode& node) override;
+
+  /**
+   * Writes a comment node
+   * @param node Comment node
+   */
+  void visit(const DOM::CommentNode& node) override;
+
+  /**
+   * Writes an element and its children
+   * @param node Element node
+   */
+  void visit(const DOM::ElementNode& node) override;
+
+  /**
+   * Writes a style sheet
+   * @param ss style sheet
+   */
+  void visit(const CSS::StyleSheet& ss) override;
+
+  /**
+   * Writes a layout box tree
+   * @param box root box
+   */
+  void visit(const Layout::Box& box);
+
+  /**
+   * Returns the image, rooted at the last tree written
+   * @return image bytes
+   * @throws std::length_error if the image outgrew its 32-bit offsets
+   */
+  auto result() -> std::string;
+
+  /**
+   * Writes an image of a DOM tree
+   * @param root root node
+   * @return image bytes
+   */
+  static auto from(const DOM::Node& root) -> std::string;
+
+  /**
+   * Writes an image of a style sheet
+   * @param ss style sheet
+   * @return image bytes
+   */
+  static auto from(const CSS::StyleSheet& ss) -> std::string;
+
+  /**
+   * Writes an image of a layout box tree
+   * @param root root box
+   * @return image bytes
+   */
+  static auto from(const Layout::Box& root) -> std::string;
+
+ private:
+  /**
+   * Writes a node, with or without its children
+   * @param node DOM node
+   * @param children whether to write its children
+   * @return offset of the node
+   */
+  auto writeNode(const DOM::Node& node, bool children) -> uint32_t;
+
+  /**
+   * Writes a declaration
+   * @param name property name
+   * @param value property value
+   * @return offset of the declaration
+   */
+  auto writeDeclaration(const std::string& name, const CSS::Value& value) -> uint32_t;
+
+  /**
+   * Writes a selector, after its ancestor selectors
+   * @param selector selector to write
+   * @return offset of the selector
+   */
+  auto writeSelector(const CSS::Selector& selector) -> uint32_t;
+
+  /**
+   * Writes a string, or finds it if it was already written
+   * @param str string to write
+   * @return offset of the string
+   */
+  auto writeString(const std::string& str) -> uint32_t;
+
+  /**
+   * Writes an array of offsets
+   * @param offsets offsets to write
+   * @return offset of the array
+   */
+  auto writeArray(const std::vector<uint32_t>& offsets) -> uint32_t;
+
+  /**
+   * Appends a record to the image
+   * @param data record bytes
+   * @param size number of bytes
+   * @param align alignment of the record
+   * @return offset of the record
+   */
+  auto append(const void* data, uint64_t size, uint64_t align = 4) -> uint32_t;
+
+  std::string image;
+  std::unordered_map<std::string, uint32_t> strings;
+  uint32_t root;
+  Kind kind;
+};
+
+/**
+ * Bounds-checked, read-only access to the bytes of an image
+ */
+class Bytes {
+ public:
+  /**
+   * Creates a view of bytes
+   * @param data first byte
+   * @param size number of bytes
+   */
+  Bytes(const char* data, uint64_t size);
+
+  /**
+   * Returns the number of bytes
+   * @return number of bytes
+   */
+  [[nodiscard]] auto getSize() const -> uint64_t;
+
+  /**
+   * Reads a u16
+   * @param offset offset of the u16
+   * @return read value
+   * @throws std::invalid_argument if the offset is out of bounds
+   */
+  [[nodiscard]] auto u16(uint64_t offset) const -> uint16_t;
+
+  /**
+   * Reads a u32
+   * @param offset offset of the u32
+   * @return read value
+   * @throws std::invalid_argument if the offset is out of bounds
+   */
+  [[nodiscard]] auto u32(uint64_t offset) const -> uint32_t;
+
+  /**
+   * Reads an f64
+   * @param offset offset of the f64
+   * @return read value
+   * @throws std::invalid_argument if the offset is out of bounds
+   */
+  [[nodiscard]] auto f64(uint64_t offset) const -> double;
+
+  /**
+   * Reads a string record in place
+   * @param offset offset of the string, or 0 for an empty string
+   * @return viewed string
+   * @throws std::invalid_argument if the string is out of bounds
+   */
+  [[nodiscard]] auto string(uint32_t offset) const -> std::string_view;
+
+  /**
+   * Reads the length of an array record
+   * @param offset offset of the array, or 0 for an empty array
+   * @return number of elements
+   */
+  [[nodiscard]] auto count(uint32_t offset) const -> uint32_t;
+
+  /**
+   * Reads an element of an array record
+   * @param offset offset of the array
+   * @param index index of the element
+   * @return element offset
+   * @throws std::invalid_argument if the element is out of bounds
+   */
+  [[nodiscard]] auto element(uint32_t offset, uint32_t index) const -> uint32_t;
+
+  /**
+   * Reads a value record
+   * @param offset offset of the value
+   * @return copy of the value, viewing the identifier of a keyword in the
+   *         bytes
+   */
+  [[nodiscard]] auto value(uint32_t offset) const -> CSS::Value;
+
+  /**
+   * Reads a selector record, with its ancestors
+   * @param offset offset of the selector
+   * @return copy of the selector
+   * @throws std::invalid_argument if the selector is malformed
+   */
+  [[nodiscard]] auto selector(uint32_t offset) const -> CSS::Selector;
+
+ private:
+  /**
+   * Ensures that a range of bytes is within the image
+   * @param offset start of the range
+   * @param size length of the range
+   * @throws std::invalid_argument if the range is out of bounds
+   */
+  void check(uint64_t offset, uint64_t size) const;
+
+  const char* data;
+  uint64_t size;
+};
+
+/**
+ * A DOM node read in place from an image. Valid as long as its image.
+ */
+class NodeView {
+ public:
+  /**
+   * Creates a view of a node record
+   * @param bytes bytes of the image
+   * @param offset offset of the node
+   */
+  NodeView(Bytes bytes, uint32_t offset);
+
+  /**
+   * Returns the type of the node
+   * @return node type
+   */
+  [[nodiscard]] auto type() const -> NodeType;
+
+  /**
+   * Returns the tag name of an element, or the content of a text or comment
+   * @return tag name or content
+   */
+  [[nodiscard]] auto name() const -> std::string_view;
+
+  /**
+   * Returns the number of attributes of the node
+   * @return number of attributes
+   */
+  [[nodiscard]] auto attributeCount() const -> uint32_t;
+
+  /**
+   * Returns an attribute of the node, in the order it was parsed
+   * @param index index of the attribute
+   * @return attribute name and value
+   */
+  [[nodiscard]] auto attribute(uint32_t index) const
+      -> std::pair<std::string_view, std::string_view>;
+
+  /**
+   * Returns the number of children of the node
+   * @return number of children
+   */
+  [[nodiscard]] auto childCount() const -> uint32_t;
+
+  /**
+   * Returns a child of the node
+   * @param index index of the child
+   * @return child view
+   */
+  [[nodiscard]] auto child(uint32_t index) const -> NodeView;
+
+  /**
+   * Copies the node and its descendants into a DOM tree
+   * @return root of the DOM tree
+   */
+  [[nodiscard]] auto toNode() const -> DOM::NodePtr;
+
+ private:
+  Bytes bytes;
+  uint32_t offset;
+};
+
+/**
+ * A layout box read in place from an image. Valid as long as its image.
+ */
+class BoxView {
+ public:
+  /**
+   * Creates a view of a box record
+   * @param bytes bytes of the image
+   * @param offset offset of the box
+   */
+  BoxView(Bytes bytes, uint32_t offset);
+
+  /**
+   * Returns whether the box is anonymous, rather than styled
+   * @return whether the box is anonymous
+   */
+  [[nodiscard]] auto isAnonymous() const -> bool;
+
+  /**
+   * Returns the display type of a styled box
+   * @return display type
+   */
+  [[nodiscard]] auto display() const -> Layout::DisplayType;
+
+  /**
+   * Returns the laid out dimensions of the box
+   * @return box dimensions
+   */
+  [[nodiscard]] auto dimensions() const -> Layout::BoxDimensions;
+
+  /**
+   * Returns the DOM node a styled box was made for, without its children
+   * @return node view
+   */
+  [[nodiscard]] auto node() const -> NodeView;
+
+  /**
+   * Returns the number of children of the box
+   * @return number of children
+   */
+  [[nodiscard]] auto childCount() const -> uint32_t;
+
+  /**
+   * Returns a child of the box
+   * @param index index of the child
+   * @return child view
+   */
+  [[nodiscard]] auto child(uint32_t index) const -> BoxView;
+
+  /**
+   * Copies the box and its descendants into a layout box tree, ready to be
+   * painted. Styled boxes keep their node and styles, but not the styled
+   * children of their node. Keyword values view their identifiers in the
+   * image, so the tree must not outlive it.
+   * @return root of the box tree
+   */
+  [[nodiscard]] auto toBox() const -> Layout::BoxPtr;
+
+ private:
+  Bytes bytes;
+  uint32_t offset;
+};
+
+/**
+ * A validated image, either owned or memory mapped from a file
+ */
+class Image {
+ public:
+  Image() = delete;
+
+  /**
+   * Creates an image from its bytes
+   * @param bytes image bytes
+   * @throws std::invalid_argument if the bytes are not a valid image
+   */
+  explicit Image(std::string bytes);
+
+  /**
+   * Maps an image file into memory. Where mapping is unavailable, the file is
+   * read instead.
+   * @param path image file
+   * @param prefix bytes the file must start with, followed by the image
+   * @return mapped image
+   * @throws std::runtime_error if the file cannot be read
+   * @throws std::invalid_argument if the file does not start with the prefix,
+   *         or the rest of it is not a valid image
+   */
+  static auto map(const std::string& path, std::string_view prefix = {}) -> Image;
+
+  /**
+   * Returns what the image holds
+   * @return image kind
+   */
+  [[nodiscard]] auto kind() const -> Kind;
+
+  /**
+   * Returns the root DOM node of a document image
+   * @return node view
+   * @throws std::invalid_argument if the image is not of a document
+   */
+  [[nodiscard]] auto document() const -> NodeView;
+
+  /**
+   * Copies the style sheet of a style sheet image
+   * @return style sheet
+   * @throws std::invalid_argument if the image is not of a style sheet
+   */
+  [[nodiscard]] auto stylesheet() const -> CSS::StyleSheet;
+
+  /**
+   * Returns the root box of a layout image
+   * @return box view
+   * @throws std::invalid_argument if the image is not of a layout
+   */
+  [[nodiscard]] auto layout() const -> BoxView;
+
+ private:
+  /**
+   * Creates an image over bytes kept alive by their storage
+   * @param storage owner of the bytes
+   * @param data first byte
+   * @param size number of bytes
+   */
+  Image(std::shared_ptr<const void> storage, const char* data, uint64_t size);
+
+  /**
+   * Ensures that the image has a valid header, of the current version
+   * @throws std::invalid_argument if the header is invalid
+   */
+  void validate() const;
+
+  /**
+   * Returns the root offset, ensuring that the image is of a kind
+   * @param expected expected kind
+   * @return root offset
+   */
+  [[nodiscard]] auto rootOf(Kind expected) const -> uint32_t;
+
+  std::shared_ptr<const void> storage;
+  Bytes bytes;
+};
+}  // namespace Archive
+
+#endif
@@ -0,0 +1,36 @@
+// sherpa_41's Arena module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef ARENA_CPP
+#define ARENA_CPP
+
+#include "arena.h"
+
+/**
+ * Resource of each thread, or nullptr for the heap
+ */
+static thread_local std::pmr::memory_resource* current;
+
+/**
+ * Returns the resource the calling thread creates containers with
+ * @return resource of the innermost open scope, or the heap's
+ */
+auto Arena::resource() -> std::pmr::memory_resource* {
+  return current != nullptr ? current : std::pmr::new_delete_resource();
+}
+
+/**
+ * Opens a scope, allocating from a resource until it is closed
+ * @param resource resource to allocate from, or nullptr for the heap
+ */
+Arena::Scope::Scope(std::pmr::memory_resource* resource) : previous(current) {
+  current = resource;
+}
+
+/**
+ * Closes the scope, allocating from the resource of the enclosing scope
+ */
+Arena::Scope::~Scope() {
+  current = previous;
+}
+
+#endif
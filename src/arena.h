@@ -0,0 +1,105 @@
+// sherpa_41's Arena module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <functional>
+#include <map>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+/**
+ * The Arena module lets a stage of the pipeline allocate its containers from
+ * a polymorphic memory resource rather than the heap. The containers of the
+ * DOM, style, layout, and display trees - NodeVector, AttributeMap,
+ * DeclarationSet, PropertyMap, the box vectors, and display lists - take an
+ * Allocator, which allocates from the resource of the innermost Scope open
+ * on the thread that created the container, or from the heap if there is
+ * none. A stage run on a monotonic buffer frees nothing per container, and
+ * its memory is released wholesale once its output is destroyed; a pool per
+ * worker thread spares parallel renders from contending on malloc.
+ *
+ * Only those containers are affected: nodes, strings, statics, and caches
+ * allocate from the heap as usual. A container keeps the resource it was
+ * created with, through moves, so it must be destroyed before the resource
+ * is released; a copy allocates from the resource of the scope it is made
+ * in.
+ */
+namespace Arena {
+/**
+ * Returns the resource the calling thread creates containers with
+ * @return resource of the innermost open scope, or the heap's
+ */
+auto resource() -> std::pmr::memory_resource*;
+
+/**
+ * Allocates from a resource on the calling thread for the scope's lifetime
+ */
+class Scope {
+ public:
+  Scope() = delete;
+  Scope(const Scope&) = delete;
+  auto operator=(const Scope&) -> Scope& = delete;
+
+  /**
+   * Opens a scope, allocating from a resource until it is closed
+   * @param resource resource to allocate from, or nullptr for the heap
+   */
+  explicit Scope(std::pmr::memory_resource* resource);
+
+  /**
+   * Closes the scope, allocating from the resource of the enclosing scope
+   */
+  ~Scope();
+
+ private:
+  std::pmr::memory_resource* previous;
+};
+
+/**
+ * A polymorphic allocator that defaults to the resource of the innermost
+ * open scope, including when a container is copied
+ * @tparam T allocated type
+ */
+template <typename T>
+class Allocator : public std::pmr::polymorphic_allocator<T> {
+ public:
+  /**
+   * Creates an allocator of the calling thread's resource
+   */
+  Allocator() noexcept : std::pmr::polymorphic_allocator<T>(Arena::resource()) {}
+
+  /**
+   * Creates an allocator of a resource
+   * @param resource resource to allocate from
+   */
+  Allocator(std::pmr::memory_resource* resource) noexcept
+      : std::pmr::polymorphic_allocator<T>(resource) {}
+
+  /**
+   * Creates an allocator of another's resource
+   * @tparam U type allocated by the other
+   * @param rhs allocator to share the resource of
+   */
+  template <typename U>
+  Allocator(const Allocator<U>& rhs) noexcept
+      : std::pmr::polymorphic_allocator<T>(rhs.resource()) {}
+
+  /**
+   * Returns the allocator of a copied container
+   * @return allocator of the calling thread's resource
+   */
+  [[nodiscard]] auto select_on_container_copy_construction() const -> Allocator {
+    return Allocator();
+  }
+};
+
+template <typename T>
+using Vector = std::vector<T, Allocator<T>>;
+
+template <typename Key, typename T, typename Compare = std::less<Key>>
+using Map = std::map<Key, T, Compare, Allocator<std::pair<const Key, T>>>;
+}  // namespace Arena
+
+#endif
@@ -0,0 +1,178 @@
+// sherpa_41's Batch module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef BATCH_CPP
+#define BATCH_CPP
+
+#include "batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "arena.h"
+#include "layout.h"
+#include "renderer/canvas.h"
+#include "renderer/encoder.h"
+#include "style.h"
+#include "trace.h"
+
+/**
+ * Returns the rate at which documents were rendered
+ * @return jobs per second
+ */
+auto Batch::Summary::throughput() const -> double {
+  return seconds > 0 ? static_cast<double>(succeeded) / seconds : 0;
+}
+
+/**
+ * Creates a runner
+ * @param workers number of worker threads, or 0 for one per hardware thread
+ * @param cacheDirectory directory to keep parsed sources in, or empty
+ */
+Batch::Runner::Runner(uint64_t workers, std::string cacheDirectory)
+    : workers(workers > 0 ? workers : std::max(1U, std::thread::hardware_concurrency())),
+      parses(cacheSize, std::move(cacheDirectory)) {}
+
+/**
+ * Renders every job on the worker pool. Workers take the next unclaimed job
+ * until none are left, so long jobs do not hold up the others.
+ * @param jobs jobs to render
+ * @param log stream to log to
+ * @return totals of the run
+ */
+auto Batch::Runner::run(const JobVector& jobs, std::ostream& log) -> Summary {
+  using Clock = std::chrono::steady_clock;
+  const auto start = Clock::now();
+
+  Summary summary{0, 0, loadStyleSheets(jobs), 0, 0};
+  std::atomic<uint64_t> nextJob(0), succeeded(0), failed(0), pixels(0);
+
+  auto work = [&]() {
+    std::pmr::unsynchronized_pool_resource arena;
+    std::unique_ptr<Canvas> canvas;
+    for (auto i = nextJob++; i < jobs.size(); i = nextJob++) {
+      const auto& job = jobs[i];
+      const auto jobStart = Clock::now();
+      std::string error;
+      try {
+        render(job, canvas, arena);
+        ++succeeded;
+        pixels += job.width * job.height;
+      } catch (const std::exception& exc) {
+        error = exc.what();
+        ++failed;
+      }
+      const std::chrono::duration<double, std::milli> elapsed = Clock::now() - jobStart;
+
+      std::lock_guard<std::mutex> lock(logMutex);
+      log << (error.empty() ? "[ok]     " : "[failed] ") << job.out << " " << std::fixed
+          << std::setprecision(2) << elapsed.count() << " ms";
+      if (!error.empty()) {
+        log << ": " << error;
+      }
+      log << "\n";
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (uint64_t t = 1; t < std::min<uint64_t>(workers, jobs.size()); ++t) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  summary.succeeded = succeeded;
+  summary.failed = failed;
+  summary.pixels = pixels;
+  summary.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return summary;
+}
+
+/**
+ * Parses each CSS file used by a batch that has not been parsed yet. Files
+ * that cannot be read are remembered as missing, failing their jobs.
+ * @param jobs jobs to load style sheets for
+ * @return number of style sheets parsed
+ */
+auto Batch::Runner::loadStyleSheets(const JobVector& jobs) -> uint64_t {
+  const auto misses = parses.getMisses();
+  for (const auto& job : jobs) {
+    if (stylesheets.count(job.css) > 0) {
+      continue;
+    }
+
+    StyleSheetPtr sheet;
+    try {
+      sheet = parses.stylesheet(readFile(job.css));
+    } catch (const std::runtime_error&) {
+      sheet = nullptr;
+    }
+    stylesheets.emplace(job.css, std::move(sheet));
+  }
+  return parses.getMisses() - misses;
+}
+
+/**
+ * Renders a single job: the document is parsed and laid out, drawn to the
+ * worker's canvas, and streamed to its output file. Parsed sources and the
+ * canvas outlive the job, so only the rest is allocated from the arena.
+ * @param job job to render
+ * @param canvas the worker's canvas, replaced if it is the wrong size
+ * @param arena the worker's memory pool
+ */
+void Batch::Runner::render(const Job& job,
+                           std::unique_ptr<Canvas>& canvas,
+                           std::pmr::memory_resource& arena) {
+  TRACE_SPAN("batch", "Batch::Runner::render");
+  const auto& sheet = stylesheets.at(job.css);
+  if (!sheet) {
+    throw std::runtime_error("Cannot read " + job.css);
+  }
+  if (!Encoder::supports(job.out)) {
+    throw std::runtime_error("Unsupported output format");
+  }
+
+  const auto dom = parses.document(readFile(job.html));
+  const auto view = canvas ? canvas->view() : Canvas::View{nullptr, 0, 0};
+  if (!canvas || view.width != job.width || view.height != job.height) {
+    canvas = std::make_unique<Canvas>(job.width, job.height);
+  }
+
+  const Arena::Scope scope(&arena);
+  auto styledDom = Style::StyledNode::from(dom, *sheet);
+  const Layout::Rectangle frame(0, 0, job.width, job.height);
+  auto layout = Layout::Box::from(styledDom, Layout::BoxDimensions(frame));
+  canvas->scrollTo(layout, 0, 0);
+
+  std::ofstream file(job.out, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Cannot write " + job.out);
+  }
+  auto encoder = Encoder::from(job.out, file, job.width, job.height);
+  canvas->encode(*encoder);
+  encoder->finish();
+}
+
+/**
+ * Reads a whole file
+ * @param path file to read
+ * @return file contents
+ */
+auto Batch::Runner::readFile(const std::string& path) -> std::string {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("Cannot read " + path);
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+#endif
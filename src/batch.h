@@ -0,0 +1,134 @@
+// sherpa_41's Batch module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <iosfwd>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cache.h"
+#include "css.h"
+
+class Canvas;
+
+/**
+ * The Batch module renders many documents in one process, so that setup is
+ * paid once rather than per document. Jobs are read from a manifest (see
+ * ManifestParser) and rendered by a pool of worker threads.
+ *
+ * Work is shared between jobs where possible:
+ *  - each distinct style sheet and HTML document is parsed once, and shared
+ *    by every job that uses it. Sources are matched by content, so copies of
+ *    a file under different paths are parsed once as well.
+ *  - each worker keeps one canvas, reused by every job of the same size
+ *  - each worker styles, lays out, and paints from its own memory pool (see
+ *    the Arena module), so workers do not contend on the heap
+ *
+ * Outputs are written with the built-in encoders, so only PNG, PPM, and PAM
+ * files are supported.
+ */
+namespace Batch {
+/**
+ * A document to render
+ */
+struct Job {
+  std::string html;
+  std::string css;
+  uint64_t width;
+  uint64_t height;
+  std::string out;
+};
+
+using JobVector = std::vector<Job>;
+
+/**
+ * Totals of a batch run
+ */
+struct Summary {
+ public:
+  /**
+   * Returns the rate at which documents were rendered
+   * @return jobs per second
+   */
+  [[nodiscard]] auto throughput() const -> double;
+
+  uint64_t succeeded;
+  uint64_t failed;
+  uint64_t stylesheets;
+  uint64_t pixels;
+  double seconds;
+};
+
+/**
+ * Renders batches of jobs on a pool of worker threads. Parsed style sheets
+ * and documents are kept between runs.
+ */
+class Runner {
+ public:
+  Runner() = delete;
+
+  /**
+   * Creates a runner
+   * @param workers number of worker threads, or 0 for one per hardware thread
+   * @param cacheDirectory directory to keep parsed sources in between runs of
+   *        the process, or empty to keep them in memory only
+   */
+  explicit Runner(uint64_t workers, std::string cacheDirectory = "");
+
+  /**
+   * Renders every job, logging a line with the timing of each job as it
+   * completes. Failed jobs are logged and counted, not thrown.
+   * @param jobs jobs to render
+   * @param log stream to log to
+   * @return totals of the run
+   */
+  auto run(const JobVector& jobs, std::ostream& log) -> Summary;
+
+ private:
+  using StyleSheetPtr = ParseCache::StyleSheetPtr;
+
+  /**
+   * Parses each CSS file used by a batch that has not been parsed yet
+   * @param jobs jobs to load style sheets for
+   * @return number of style sheets parsed
+   */
+  auto loadStyleSheets(const JobVector& jobs) -> uint64_t;
+
+  /**
+   * Renders a single job
+   * @param job job to render
+   * @param canvas the worker's canvas, replaced if it is the wrong size
+   * @param arena the worker's memory pool
+   * @throws std::runtime_error if the job cannot be rendered
+   */
+  void render(const Job& job,
+              std::unique_ptr<Canvas>& canvas,
+              std::pmr::memory_resource& arena);
+
+  /**
+   * Reads a whole file
+   * @param path file to read
+   * @return file contents
+   * @throws std::runtime_error if the file cannot be read
+   */
+  static auto readFile(const std::string& path) -> std::string;
+
+  /**
+   * Largest total size of the sources of cached style sheets, and of cached
+   * documents, in bytes
+   */
+  static constexpr uint64_t cacheSize = 64 << 20;
+
+  uint64_t workers;
+  ParseCache parses;
+  std::unordered_map<std::string, StyleSheetPtr> stylesheets;
+  std::mutex logMutex;
+};
+}  // namespace Batch
+
+#endif
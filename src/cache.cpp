@@ -0,0 +1,204 @@
+// sherpa_41's Cache module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef CACHE_CPP
+#define CACHE_CPP
+
+#include "cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include "archive.h"
+#include "parser/css.h"
+#include "parser/html.h"
+
+/**
+ * Creates an empty cache
+ * @param capacity maximum total size of cached sources, in bytes, for each
+ *        of style sheets and documents
+ * @param directory directory to keep archives of parsed sources in, or empty
+ */
+ParseCache::ParseCache(uint64_t capacity, std::string directory)
+    : directory(std::move(directory)), stylesheets(capacity), documents(capacity) {}
+
+/**
+ * Returns a parsed style sheet, parsing it if it is cached neither in memory
+ * nor on disk
+ * @param css CSS source
+ * @return parsed style sheet
+ */
+auto ParseCache::stylesheet(const std::string& css) -> StyleSheetPtr {
+  const auto key = hash(css);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto cached = stylesheets.find(key);
+    if (cached && cached->source == css) {
+      ++hits;
+      return cached->tree;
+    }
+    ++misses;
+  }
+
+  StyleSheetPtr parsed;
+  if (!directory.empty()) {
+    const auto path = archivePath(key, "css");
+    try {
+      const auto image = Archive::Image::map(path, prefix(css));
+      parsed = std::make_shared<const CSS::StyleSheet>(image.stylesheet());
+    } catch (const std::exception&) {
+      parsed = std::make_shared<const CSS::StyleSheet>(CSSParser(css).evaluate());
+      store(path, css, Archive::Writer::from(*parsed));
+    }
+  } else {
+    parsed = std::make_shared<const CSS::StyleSheet>(CSSParser(css).evaluate());
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  return stylesheets.insert(key, {css, std::move(parsed)}, css.size()).tree;
+}
+
+/**
+ * Returns a parsed HTML document, parsing it if it is cached neither in
+ * memory nor on disk
+ * @param html HTML source
+ * @return root of the DOM tree
+ */
+auto ParseCache::document(const std::string& html) -> DocumentPtr {
+  const auto key = hash(html);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto cached = documents.find(key);
+    if (cached && cached->source == html) {
+      ++hits;
+      return cached->tree;
+    }
+    ++misses;
+  }
+
+  DocumentPtr parsed;
+  if (!directory.empty()) {
+    const auto path = archivePath(key, "html");
+    try {
+      parsed = Archive::Image::map(path, prefix(html)).document().toNode();
+    } catch (const std::exception&) {
+      parsed = HTMLParser(html).evaluate();
+      store(path, html, Archive::Writer::from(*parsed));
+    }
+  } else {
+    parsed = HTMLParser(html).evaluate();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  return documents.insert(key, {html, std::move(parsed)}, html.size()).tree;
+}
+
+/**
+ * Returns the number of lookups that found their source parsed
+ * @return cache hits
+ */
+auto ParseCache::getHits() -> uint64_t {
+  std::lock_guard<std::mutex> lock(mutex);
+  return hits;
+}
+
+/**
+ * Returns the number of lookups that had to parse their source
+ * @return cache misses
+ */
+auto ParseCache::getMisses() -> uint64_t {
+  std::lock_guard<std::mutex> lock(mutex);
+  return misses;
+}
+
+/**
+ * Returns the path of the archive of a source, named by its hash
+ * @param key hash of the source
+ * @param extension extension of the source
+ * @return archive path, e.g. "cache/0123456789abcdef.css.s41"
+ */
+auto ParseCache::archivePath(uint64_t key, const std::string& extension) const
+    -> std::string {
+  std::stringstream path;
+  path << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << "."
+       << extension << ".s41";
+  return path.str();
+}
+
+/**
+ * Returns the bytes that precede the image in the archive of a source: the
+ * u64 length of the source, then its bytes. A source is thus never mistaken
+ * for the start of a longer one.
+ * @param source parsed source
+ * @return length and bytes of the source
+ */
+auto ParseCache::prefix(const std::string& source) -> std::string {
+  const uint64_t length = source.size();
+  std::string bytes(sizeof(length), '\0');
+  std::memcpy(&bytes[0], &length, sizeof(length));
+  return bytes + source;
+}
+
+/**
+ * Writes an archive to a temporary file, then renames it over the archive
+ * path, so that readers never see a partial archive
+ * @param path archive path
+ * @param source parsed source
+ * @param image archive bytes
+ */
+void ParseCache::store(const std::string& path,
+                       const std::string& source,
+                       const std::string& image) {
+  std::stringstream temporary;
+  temporary << path << "." << std::this_thread::get_id() << ".tmp";
+  {
+    const auto header = prefix(source);
+    std::ofstream file(temporary.str(), std::ios::binary);
+    if (!file.write(header.data(), static_cast<std::streamsize>(header.size())) ||
+        !file.write(image.data(), static_cast<std::streamsize>(image.size()))) {
+      std::remove(temporary.str().c_str());
+      return;
+    }
+  }
+  if (std::rename(temporary.str().c_str(), path.c_str()) != 0) {
+    std::remove(temporary.str().c_str());
+  }
+}
+
+/**
+ * Hashes bytes into a 64-bit content address. Eight-byte words are folded in
+ * with a multiply and rotate, and the result is finished with the SplitMix64
+ * mixer so that every input bit affects every output bit.
+ * @param bytes bytes to hash
+ * @return hash of the bytes
+ */
+auto ParseCache::hash(const std::string& bytes) -> uint64_t {
+  constexpr uint64_t prime = 0x9e3779b97f4a7c15ULL;
+  auto mix = [](uint64_t h, uint64_t word) {
+    h ^= word * 0xbf58476d1ce4e5b9ULL;
+    return ((h << 31) | (h >> 33)) * prime;
+  };
+
+  uint64_t h = bytes.size() * prime;
+  const char* data = bytes.data();
+  uint64_t left = bytes.size();
+  for (; left >= 8; data += 8, left -= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, 8);
+    h = mix(h, word);
+  }
+  if (left > 0) {
+    uint64_t word(0);
+    std::memcpy(&word, data, left);
+    h = mix(h, word);
+  }
+
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+#endif
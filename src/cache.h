@@ -0,0 +1,242 @@
+// sherpa_41's Cache module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "css.h"
+#include "dom.h"
+
+/**
+ * A map of bounded size that evicts its least recently used entries to make
+ * room for new ones. Each entry has a cost, 1 unless given, and the total
+ * cost of the entries is kept within the capacity. Lookups and insertions
+ * are constant time, amortized over evictions.
+ *
+ * @tparam Key type of keys, which must be hashable
+ * @tparam Value type of cached values
+ */
+template <typename Key, typename Value>
+class LRUCache {
+ public:
+  LRUCache() = delete;
+
+  /**
+   * Creates an empty cache
+   * @param capacity maximum total cost of entries, at least 1
+   */
+  explicit LRUCache(uint64_t capacity) : capacity(capacity > 0 ? capacity : 1) {}
+
+  /**
+   * Looks up a value, marking it as the most recently used
+   * @param key key to look up
+   * @return pointer to the cached value, or nullptr if it is not cached. The
+   *         pointer is valid until the entry is evicted.
+   */
+  auto find(const Key& key) -> Value* {
+    auto found = index.find(key);
+    if (found == index.end()) {
+      ++misses;
+      return nullptr;
+    }
+    ++hits;
+    entries.splice(entries.begin(), entries, found->second);
+    return &found->second->value;
+  }
+
+  /**
+   * Caches a value as the most recently used, replacing any value of the
+   * same key and evicting least recently used entries until the cache is
+   * within its capacity. A value costing more than the capacity is cached
+   * alone.
+   * @param key key to cache under
+   * @param value value to cache
+   * @param cost cost of the value
+   * @return reference to the cached value
+   */
+  auto insert(const Key& key, Value value, uint64_t cost = 1) -> Value& {
+    auto found = index.find(key);
+    if (found != index.end()) {
+      total -= found->second->cost;
+      entries.erase(found->second);
+      index.erase(found);
+    }
+    while (!entries.empty() && total + cost > capacity) {
+      total -= entries.back().cost;
+      index.erase(entries.back().key);
+      entries.pop_back();
+    }
+
+    entries.push_front(Entry{key, std::move(value), cost});
+    index.emplace(key, entries.begin());
+    total += cost;
+    return entries.front().value;
+  }
+
+  /**
+   * Returns the number of cached entries
+   * @return number of entries
+   */
+  [[nodiscard]] auto size() const -> uint64_t { return entries.size(); }
+
+  /**
+   * Returns the total cost of the cached entries
+   * @return total cost
+   */
+  [[nodiscard]] auto cost() const -> uint64_t { return total; }
+
+  /**
+   * Returns the maximum total cost of the cached entries
+   * @return capacity
+   */
+  [[nodiscard]] auto getCapacity() const -> uint64_t { return capacity; }
+
+  /**
+   * Returns the number of lookups that found their value
+   * @return cache hits
+   */
+  [[nodiscard]] auto getHits() const -> uint64_t { return hits; }
+
+  /**
+   * Returns the number of lookups that did not find their value
+   * @return cache misses
+   */
+  [[nodiscard]] auto getMisses() const -> uint64_t { return misses; }
+
+ private:
+  struct Entry {
+    Key key;
+    Value value;
+    uint64_t cost;
+  };
+  using EntryList = std::list<Entry>;
+
+  uint64_t capacity;
+  uint64_t total = 0;
+  EntryList entries;
+  std::unordered_map<Key, typename EntryList::iterator> index;
+  uint64_t hits = 0, misses = 0;
+};
+
+/**
+ * A content-addressed cache of parsed documents. Sources are keyed by a hash
+ * of their content, so a style sheet or HTML document is parsed once however
+ * many paths or requests it arrives through. Parsed trees are immutable and
+ * shared, and the cache is bounded by the total size of their sources.
+ *
+ * The hash only narrows the search: each entry keeps its source, and a lookup
+ * returns the entry only if the sources are equal, so colliding sources are
+ * parsed rather than served each other's trees.
+ *
+ * Given a directory, the cache also keeps parsed sources on disk as archives
+ * (see Archive), so that parsing is skipped across restarts. Each archive
+ * file starts with the length and bytes of its source, which are checked in
+ * the same way before the archive is read. The directory is not bounded, and
+ * files that cannot be read or written are ignored.
+ *
+ * The cache may be shared between threads. Sources are parsed outside the
+ * lock, so two threads missing on the same source may both parse it.
+ */
+class ParseCache {
+ public:
+  using StyleSheetPtr = std::shared_ptr<const CSS::StyleSheet>;
+  using DocumentPtr = std::shared_ptr<const DOM::Node>;
+
+  ParseCache() = delete;
+  ParseCache(const ParseCache&) = delete;
+
+  /**
+   * Creates an empty cache
+   * @param capacity maximum total size of cached sources, in bytes, for each
+   *        of style sheets and documents
+   * @param directory directory to keep archives of parsed sources in, or
+   *        empty to keep them in memory only
+   */
+  explicit ParseCache(uint64_t capacity, std::string directory = "");
+
+  /**
+   * Returns a parsed style sheet, parsing it if it is not cached
+   * @param css CSS source
+   * @return parsed style sheet
+   */
+  auto stylesheet(const std::string& css) -> StyleSheetPtr;
+
+  /**
+   * Returns a parsed HTML document, parsing it if it is not cached
+   * @param html HTML source
+   * @return root of the DOM tree
+   */
+  auto document(const std::string& html) -> DocumentPtr;
+
+  /**
+   * Returns the number of lookups that found their source parsed
+   * @return cache hits
+   */
+  auto getHits() -> uint64_t;
+
+  /**
+   * Returns the number of lookups that had to parse their source
+   * @return cache misses
+   */
+  auto getMisses() -> uint64_t;
+
+  /**
+   * Hashes bytes into a 64-bit content address. The hash reads eight bytes
+   * at a time and is not cryptographic, so distinct sources may collide.
+   * @param bytes bytes to hash
+   * @return hash of the bytes
+   */
+  static auto hash(const std::string& bytes) -> uint64_t;
+
+ private:
+  /**
+   * A parsed tree, and the source it was parsed from
+   * @tparam Tree type of pointer to the tree
+   */
+  template <typename Tree>
+  struct Parsed {
+    std::string source;
+    Tree tree;
+  };
+
+  /**
+   * Returns the path of the archive of a source
+   * @param key hash of the source
+   * @param extension extension of the source
+   * @return archive path
+   */
+  [[nodiscard]] auto archivePath(uint64_t key, const std::string& extension) const
+      -> std::string;
+
+  /**
+   * Returns the bytes that precede the image in the archive of a source
+   * @param source parsed source
+   * @return length and bytes of the source
+   */
+  static auto prefix(const std::string& source) -> std::string;
+
+  /**
+   * Writes an archive, replacing any archive of the same path in one step
+   * @param path archive path
+   * @param source parsed source
+   * @param image archive bytes
+   */
+  static void store(const std::string& path,
+                    const std::string& source,
+                    const std::string& image);
+
+  std::string directory;
+  std::mutex mutex;
+  LRUCache<uint64_t, Parsed<StyleSheetPtr>> stylesheets;
+  LRUCache<uint64_t, Parsed<DocumentPtr>> documents;
+  uint64_t hits = 0, misses = 0;
+};
+
+#endif
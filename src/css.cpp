@@ -5,6 +5,9 @@
 
 #include "css.h"
 
+#include <algorithm>
+#include <functional>
+
 #include "visitor/visitor.h"
 
 /**
@@ -22,116 +25,279 @@ auto CSS::normalizeFp(double value) -> std::string {
 }
 
 /**
- * Clones a ValuePtr from a concrete value.
+ * Identifiers of the enumerated keywords, by number
  */
-auto CSS::make_value(const CSS::Value& val) -> CSS::ValuePtr {
-  return val.clone();
-}
+static constexpr std::array<std::string_view, static_cast<uint32_t>(CSS::Keyword::Count)>
+    keywordNames = {{"", "auto", "block", "inline", "none", "inherit", "initial"}};
 
 /**
- * Returns whether this CSS value matches a string.
+ * Hashes an identifier into a slot of the keyword table. The constants were
+ * picked so that no two enumerated keywords share a slot.
+ * @param identifier non-empty identifier
+ * @return slot
  */
-auto CSS::Value::is(const std::string& value) const -> bool {
-  return print() == value;
+static constexpr auto keywordSlot(std::string_view identifier) -> uint32_t {
+  const auto first = static_cast<uint8_t>(identifier.front());
+  const auto last = static_cast<uint8_t>(identifier.back());
+  return (static_cast<uint32_t>(identifier.size()) * 5 + first + last) & 15;
 }
 
 /**
- * Returns the unit value, or 0 if not a UnitValue
- * @return unit value, or 0 if not UnitValue
+ * Builds the perfect hash table of the enumerated keywords
+ * @return keyword of each slot, or Keyword::Empty if the slot is free
  */
-auto CSS::Value::unitValue() const -> double {
-  if (auto unit = dynamic_cast<const UnitValue*>(this)) {
-    return unit->value;
+static constexpr auto keywordTable() -> std::array<CSS::Keyword, 16> {
+  std::array<CSS::Keyword, 16> table{};
+  for (uint32_t k = 1; k < keywordNames.size(); ++k) {
+    table[keywordSlot(keywordNames[k])] = static_cast<CSS::Keyword>(k);
   }
-  return 0;
+  return table;
 }
 
-/**
- * Creates a text value
- * @param value text value
- */
-CSS::TextValue::TextValue(std::string value) : value(std::move(value)) {}
+static constexpr auto keywords = keywordTable();
 
 /**
- * Clones a TextValue
- * @return cloned value
+ * Returns whether every enumerated keyword has a slot of its own
+ * @return whether the hash is perfect
  */
-auto CSS::TextValue::clone() const -> CSS::ValuePtr {
-  return CSS::ValuePtr(new CSS::TextValue(*this));
+static constexpr auto isPerfect() -> bool {
+  for (uint32_t k = 1; k < keywordNames.size(); ++k) {
+    if (keywords[keywordSlot(keywordNames[k])] != static_cast<CSS::Keyword>(k)) {
+      return false;
+    }
+  }
+  return true;
 }
 
+static_assert(isPerfect(), "enumerated keywords must not collide in the keyword table");
+
 /**
- * Prints a text declaration value
- * @return printed value
+ * Creates a keyword value. An identifier that is not enumerated is viewed,
+ * and must outlive the value.
+ * @param identifier keyword
+ * @return keyword value
  */
-auto CSS::TextValue::print() const -> std::string {
+auto CSS::Value::keyword(std::string_view identifier) -> CSS::Value {
+  if (identifier.empty()) {
+    return Value();
+  }
+  const auto known = keywords[keywordSlot(identifier)];
+  if (keywordNames[static_cast<uint32_t>(known)] == identifier) {
+    return keyword(known);
+  }
+
+  Value value;
+  value.name = identifier.data();
+  value.bits = static_cast<uint32_t>(identifier.size());
   return value;
 }
 
 /**
- * String forms of units
- * @return units as strings
+ * Creates a keyword value of a known keyword
+ * @param keyword keyword
+ * @return keyword value
  */
-auto CSS::UnitRaw() -> std::vector<std::string> {
-  return {"px", "em", "rem", "vw", "vh", "%"};
+auto CSS::Value::keyword(CSS::Keyword keyword) -> CSS::Value {
+  Value value;
+  value.bits = static_cast<uint32_t>(keyword);
+  return value;
 }
 
 /**
- * Creates a unit value
+ * Creates a length value
  * @param value magnitude
  * @param unit unit used
+ * @return length value
  */
-CSS::UnitValue::UnitValue(double value, CSS::Unit unit) : value(value), unit(unit) {}
+auto CSS::Value::length(double value, CSS::Unit unit) -> CSS::Value {
+  Value length;
+  length.number = value;
+  length.unit = unit;
+  length.type = Length;
+  return length;
+}
 
 /**
- * Clones a UnitValue
- * @return cloned value
+ * Creates a color value
+ * @param r red channel
+ * @param g green channel
+ * @param b blue channel
+ * @param a alpha channel
+ * @return color value
  */
-auto CSS::UnitValue::clone() const -> CSS::ValuePtr {
-  return CSS::ValuePtr(new CSS::UnitValue(*this));
+auto CSS::Value::color(uint8_t r, uint8_t g, uint8_t b, double a) -> CSS::Value {
+  Value color;
+  color.number = a;
+  color.bits = r | g << 8 | b << 16;
+  color.type = Color;
+  return color;
 }
 
 /**
- * Prints a unit declaration value
- * @return printed value
+ * Returns the kind of the value
+ * @return type
  */
-auto CSS::UnitValue::print() const -> std::string {
-  return normalizeFp(value) + CSS::UnitRaw()[unit];
+auto CSS::Value::getType() const -> CSS::Value::Type {
+  return type;
 }
 
 /**
- * Creates a color value
- * @param r red channel
- * @param g green channel
- * @param b blue channel
- * @param a alpha channel
+ * Returns whether *this is a keyword
+ * @param identifier keyword to compare
+ * @return whether *this is `identifier`
  */
-CSS::ColorValue::ColorValue(uint8_t r, uint8_t g, uint8_t b, double a)
-    : r(r), g(g), b(b), a(a) {}
+auto CSS::Value::is(std::string_view identifier) const -> bool {
+  return type == Keyword && getIdentifier() == identifier;
+}
 
 /**
- * Clones a ColorValue
- * @return cloned value
+ * Returns the number of a keyword, which is Keyword::Count for one that is
+ * not enumerated, or Keyword::Empty if not a keyword
+ * @return keyword
  */
-auto CSS::ColorValue::clone() const -> CSS::ValuePtr {
-  return CSS::ValuePtr(new CSS::ColorValue(*this));
+auto CSS::Value::getKeyword() const -> CSS::Keyword {
+  if (type != Keyword) {
+    return CSS::Keyword::Empty;
+  }
+  return name != nullptr ? CSS::Keyword::Count : static_cast<CSS::Keyword>(bits);
 }
 
 /**
- * Prints a color declaration value
- * @return printed value
+ * Returns the identifier of a keyword, or "" if not a keyword
+ * @return identifier
+ */
+auto CSS::Value::getIdentifier() const -> std::string_view {
+  if (type != Keyword) {
+    return "";
+  }
+  return name != nullptr ? std::string_view(name, bits) : keywordNames[bits];
+}
+
+/**
+ * Returns the magnitude of a length, or 0 if not a length
+ * @return magnitude
  */
-auto CSS::ColorValue::print() const -> std::string {
-  return "rgba(" + std::to_string(r) + ", " + std::to_string(g) + ", " + std::to_string(b) +
-         ", " + normalizeFp(a) + ")";
+auto CSS::Value::unitValue() const -> double {
+  return type == Length ? number : 0;
 }
 
 /**
- * Returns an array of RGB color channels
+ * Returns the unit of a length, or px if not a length
+ * @return unit
+ */
+auto CSS::Value::getUnit() const -> CSS::Unit {
+  return unit;
+}
+
+/**
+ * Returns an array of RGB color channels, or black if not a color
  * @return color channels
  */
-auto CSS::ColorValue::channels() const -> std::array<uint8_t, 3> {
-  return {{r, g, b}};
+auto CSS::Value::channels() const -> std::array<uint8_t, 3> {
+  if (type != Color) {
+    return {{0, 0, 0}};
+  }
+  return {{static_cast<uint8_t>(bits & 0xff), static_cast<uint8_t>(bits >> 8 & 0xff),
+           static_cast<uint8_t>(bits >> 16 & 0xff)}};
+}
+
+/**
+ * Returns the alpha channel of a color, or 0 if not a color
+ * @return alpha channel
+ */
+auto CSS::Value::getAlpha() const -> double {
+  return type == Color ? number : 0;
+}
+
+/**
+ * Prints a declaration value
+ * @return printed value
+ */
+auto CSS::Value::print() const -> std::string {
+  switch (type) {
+    case Length:
+      return normalizeFp(number) + CSS::UnitRaw()[unit];
+    case Color: {
+      const auto rgb = channels();
+      return "rgba(" + std::to_string(rgb[0]) + ", " + std::to_string(rgb[1]) + ", " +
+             std::to_string(rgb[2]) + ", " + normalizeFp(number) + ")";
+    }
+    default:
+      return std::string(getIdentifier());
+  }
+}
+
+/**
+ * Compares two values. The fields a kind of value does not use are zero.
+ * @param rhs value to compare
+ * @return whether both are the same keyword, length, or color
+ */
+auto CSS::Value::operator==(const CSS::Value& rhs) const -> bool {
+  if (type != rhs.type || unit != rhs.unit || bits != rhs.bits) {
+    return false;
+  }
+  if (type != Keyword) {
+    return number == rhs.number;
+  }
+  // identifiers interned by one sheet are equal if they are the same
+  if (name == rhs.name) {
+    return true;
+  }
+  return name != nullptr && rhs.name != nullptr &&
+         std::string_view(name, bits) == std::string_view(rhs.name, bits);
+}
+
+/**
+ * Compares two values
+ * @param rhs value to compare
+ * @return whether the values differ
+ */
+auto CSS::Value::operator!=(const CSS::Value& rhs) const -> bool {
+  return !(*this == rhs);
+}
+
+/**
+ * String forms of units
+ * @return units as strings
+ */
+auto CSS::UnitRaw() -> std::vector<std::string> {
+  return {"px", "em", "rem", "vw", "vh", "%"};
+}
+
+/**
+ * Prints the attribute selector in the form `[name]` or `[name="value"]`
+ * @return pretty-printed attribute selector
+ */
+auto CSS::AttributeSelector::print() const -> std::string {
+  return "[" + name + (match == Equals ? "=\"" + value + "\"" : "") + "]";
+}
+
+/**
+ * Determines whether a position among siblings is an+b for some n >= 0
+ * @param index 1-based position of an element among its parent's elements
+ * @return whether the pseudo-class matches the position
+ */
+auto CSS::NthChild::matches(uint64_t index) const -> bool {
+  const auto offset = static_cast<int64_t>(index) - b;  // a*n
+  if (a == 0) {
+    return offset == 0;
+  }
+  return offset % a == 0 && offset / a >= 0;
+}
+
+/**
+ * Prints the pseudo-class in the form `:first-child` or `:nth-child(2n+1)`
+ * @return pretty-printed pseudo-class
+ */
+auto CSS::NthChild::print() const -> std::string {
+  if (a == 0) {
+    return b == 1 ? ":first-child" : ":nth-child(" + std::to_string(b) + ")";
+  }
+  std::string res = a == 1 ? "n" : a == -1 ? "-n" : std::to_string(a) + "n";
+  if (b != 0) {
+    res += (b > 0 ? "+" : "") + std::to_string(b);
+  }
+  return ":nth-child(" + res + ")";
 }
 
 /**
@@ -145,24 +311,51 @@ CSS::Selector::Selector(std::string tag, std::string id, std::vector<std::string
 
 /**
  * Determines the specificity of the selector, prioritized by
- * (id, class, tag). High specificity is more important.
+ * (id, class, tag) and summed over its compounds, where attribute selectors
+ * and pseudo-classes count as classes. High specificity is more important.
  * @return specificity vector
  */
 auto CSS::Selector::specificity() const -> CSS::Specificity {
-  return {id.empty() ? 0UL : 1, klass.size(), tag.empty() ? 0UL : 1};
+  Specificity res{id.empty() ? 0UL : 1,
+                  klass.size() + attributes.size() + pseudoClasses.size(),
+                  tag.empty() ? 0UL : 1};
+  for (const auto& ancestor : ancestors) {
+    const auto compound = ancestor.specificity();
+    std::transform(res.begin(), res.end(), compound.begin(), res.begin(), std::plus<>());
+  }
+  return res;
 }
 
 /**
- * Prints a selector in the form `tag#id.class1.class2`
+ * Prints a selector in the form `tag#id.class1 > tag#id.class2`
  * @return pretty-printed selector
  */
 auto CSS::Selector::print() const -> std::string {
+  std::string res;
+  for (auto ancestor = ancestors.rbegin(); ancestor != ancestors.rend(); ++ancestor) {
+    res += ancestor->printCompound() + (ancestor->combinator == Child ? " > " : " ");
+  }
+  return res + printCompound();
+}
+
+/**
+ * Prints the compound selector alone, in the form
+ * `tag#id.class1.class2[attr]:first-child`
+ * @return pretty-printed compound
+ */
+auto CSS::Selector::printCompound() const -> std::string {
   std::string res(tag);
   if (!id.empty()) {
     res += "#" + id;
   }
   res += std::accumulate(klass.begin(), klass.end(), std::string(),
                          [](auto acc, auto cl) { return acc + "." + cl; });
+  for (const auto& attribute : attributes) {
+    res += attribute.print();
+  }
+  for (const auto& pseudoClass : pseudoClasses) {
+    res += pseudoClass.print();
+  }
   return res.empty() ? "*" : res;
 }
 
@@ -171,22 +364,102 @@ auto CSS::Selector::print() const -> std::string {
  * @param name declaration name
  * @param value declaration value
  */
-CSS::Declaration::Declaration(std::string name, CSS::ValuePtr&& value)
-    : name(std::move(name)), value(std::move(value)) {}
+CSS::Declaration::Declaration(std::string name, CSS::Value value)
+    : name(std::move(name)), value(value) {}
+
+/**
+ * Declares a value for each side of a box, in the order top, right, bottom,
+ * left, as `margin` and the like do: one value is for every side, two for
+ * the vertical and horizontal sides, and three for the top, horizontal,
+ * and bottom sides.
+ * @param prefix property name before the side
+ * @param suffix property name after the side
+ * @param values one to four values
+ * @param declarations declarations to add to
+ */
+static void expandSides(const std::string& prefix,
+                        const std::string& suffix,
+                        const std::vector<CSS::Value>& values,
+                        CSS::DeclarationSet& declarations) {
+  const auto n = values.size();
+  const std::array<CSS::Value, 4> sides = {values[0], values[n > 1 ? 1 : 0],
+                                           values[n > 2 ? 2 : 0],
+                                           values[n > 3 ? 3 : n > 1 ? 1 : 0]};
+  const std::array<const char*, 4> names = {"-top", "-right", "-bottom", "-left"};
+  for (uint64_t side = 0; side < sides.size(); ++side) {
+    declarations.emplace_back(prefix + names[side] + suffix, sides[side]);
+  }
+}
 
 /**
- * Copy ctor
- * @param rhs declaration to copy
+ * Creates the declarations of a property and its values. A shorthand, such
+ * as `margin: 1px 2px`, is expanded into its longhands, which are reset to
+ * `initial` if it does not set them; `border` is dropped if it sets one of
+ * them twice, and `background` only sets its color, so is dropped without
+ * one. Any other property keeps its first value.
+ * @param name property name
+ * @param values property values, in order
+ * @return declarations, or none if the values do not fit the property
  */
-CSS::Declaration::Declaration(const CSS::Declaration& rhs)
-    : name(rhs.name), value(rhs.value->clone()) {}
+auto CSS::Declaration::expand(const std::string& name, const std::vector<Value>& values)
+    -> CSS::DeclarationSet {
+  DeclarationSet declarations;
+  if (values.empty()) {
+    return declarations;
+  }
+  const auto keyword = values[0].getKeyword();
+  const bool global = keyword == Keyword::Inherit || keyword == Keyword::Initial;
+  if (global && values.size() > 1) {
+    return declarations;  // `inherit` and `initial` stand alone
+  }
+
+  if (name == "margin" || name == "padding") {
+    if (values.size() <= 4) {
+      expandSides(name, "", values, declarations);
+    }
+  } else if (name == "border-width" || name == "border-style" || name == "border-color") {
+    if (values.size() <= 4) {
+      expandSides("border", name.substr(6), values, declarations);
+    }
+  } else if (name == "border") {
+    // at most one each of a width, a style, and a color, in any order
+    std::optional<Value> width, style, color;
+    for (uint64_t i = global ? values.size() : 0; i < values.size(); ++i) {
+      const auto& value = values[i];
+      const auto identifier = value.getType() == Value::Keyword ? value.getIdentifier() : "";
+      auto& slot = value.getType() == Value::Length || identifier == "thin" ||
+                           identifier == "medium" || identifier == "thick"
+                       ? width
+                       : value.getType() == Value::Color ? color : style;
+      if (slot) {
+        return declarations;
+      }
+      slot = value;
+    }
+    const Value unset = global ? values[0] : Value::keyword(Keyword::Initial);
+    expandSides("border", "-width", {width.value_or(unset)}, declarations);
+    expandSides("border", "-style", {style.value_or(unset)}, declarations);
+    expandSides("border", "-color", {color.value_or(unset)}, declarations);
+  } else if (name == "background") {
+    // only the color is supported, wherever it is among the other values
+    const auto color = std::find_if(values.begin(), values.end(), [](const Value& value) {
+      return value.getType() == Value::Color;
+    });
+    if (global || color != values.end()) {
+      declarations.emplace_back("background-color", global ? values[0] : *color);
+    }
+  } else {
+    declarations.emplace_back(name, values[0]);
+  }
+  return declarations;
+}
 
 /**
  * Prints a declaration in the form `name: value;`
  * @return pretty-printed declaration
  */
 auto CSS::Declaration::print() const -> std::string {
-  return name + ": " + value->print() + ";";
+  return name + ": " + value.print() + ";";
 }
 
 /**
@@ -197,6 +470,28 @@ auto CSS::Declaration::print() const -> std::string {
 CSS::Rule::Rule(PrioritySelectorSet selectors, DeclarationSet declarations)
     : selectors(std::move(selectors)), declarations(std::move(declarations)) {}
 
+/**
+ * Stores an identifier, unless it is already stored
+ * @param identifier identifier to store
+ * @return view of the stored identifier
+ */
+auto CSS::Identifiers::intern(std::string_view identifier) -> std::string_view {
+  auto found = index.find(identifier);
+  if (found == index.end()) {
+    names.emplace_back(identifier);
+    found = index.insert(names.back()).first;
+  }
+  return *found;
+}
+
+/**
+ * Returns the number of stored identifiers
+ * @return number of identifiers
+ */
+auto CSS::Identifiers::size() const -> uint64_t {
+  return names.size();
+}
+
 /**
  * Accepts a visitor to the style sheet
  * @param visitor accepted visitor
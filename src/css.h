@@ -4,11 +4,19 @@
 #define CSS_HPP
 
 #include <array>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <numeric>
+#include <optional>
 #include <set>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
 #include <vector>
 
+#include "arena.h"
 #include "parser/parser.h"
 
 class Visitor;
@@ -23,23 +31,27 @@ class Visitor;
  *      - classes
  *      - tags
  *      - wildcards (\*)
+ *      - attributes (`[data-x]`, `[type=text]`)
+ *      - `:first-child` and `:nth-child(an+b)`
+ *      - descendant (`.card .title`) and child (`ul > li`) combinators
  *  __declarations__:
- *      - text values
+ *      - keyword values
  *      - color values (RGB/A, #HEX)
  *      - unit values (px, em, rem, etc... but only px is normalized)
+ *      - the shorthands `margin`, `padding`, `border`, `border-width`,
+ *        `border-style`, `border-color`, and `background`, expanded into
+ *        their longhands as they are parsed
  */
 namespace CSS {
 
 // forward declaration
-struct Value;
 struct Selector;
 struct Declaration;
 struct specificityOrder;
 
-using ValuePtr = std::unique_ptr<Value>;
 using Specificity = std::vector<uint64_t>;
 using PrioritySelectorSet = std::multiset<Selector, specificityOrder>;
-using DeclarationSet = std::vector<Declaration>;
+using DeclarationSet = Arena::Vector<Declaration>;
 
 /**
  * Normalizes a printed floating point value
@@ -49,159 +61,217 @@ using DeclarationSet = std::vector<Declaration>;
  */
 auto normalizeFp(double value) -> std::string;
 
+enum Unit : uint8_t { px, em, rem, vw, vh, percent };
+auto UnitRaw() -> std::vector<std::string>;
+
 /**
- * Creates a ValuePtr from a concrete value
- * @param val value to create a pointer of
- * @return ValuePtr
+ * Keywords the pipeline acts on, numbered at compile time and recognized by a
+ * perfect hash as they are parsed, so that layout switches on them rather
+ * than compare strings. Any other identifier is numbered Count.
  */
-auto make_value(const Value& val) -> ValuePtr;
+enum class Keyword : uint32_t { Empty, Auto, Block, Inline, None, Inherit, Initial, Count };
 
 /**
- * Abstract base struct representing a CSS declaration value
+ * A CSS declaration value: a keyword, such as `auto` or `red`, a length, or
+ * an RGBA color. Values are 16-byte PODs, copied as such, and two values are
+ * equal if they are the same keyword, length, or color.
+ *
+ * Keywords of the Keyword enumeration are stored as their number. Any other
+ * identifier is viewed rather than copied, so its characters must outlive
+ * the value: the parser interns them in the Identifiers of the style sheet
+ * being parsed, which values of the sheet must not outlive. Reading a value
+ * takes no lock, and nothing is kept once the sheet is freed.
  */
-struct Value {
+class Value {
  public:
-  virtual ~Value() = default;
-
   /**
-   * Dynamically clones a Value into a unique_ptr
-   * @return cloned Value as a pointer
+   * Kinds of values
    */
-  [[nodiscard]] virtual auto clone() const -> ValuePtr = 0;
+  enum Type : uint8_t { Keyword, Length, Color };
 
   /**
-   * Prints a declaration value
-   * @return printed value
+   * Creates the empty keyword
    */
-  [[nodiscard]] virtual auto print() const -> std::string = 0;
+  Value() = default;
 
   /**
-   * Returns if *this is of specified value
-   * @param value value to compare
-   * @return whether *this is `value`
+   * Creates a keyword value. An identifier that is not enumerated is viewed,
+   * and must outlive the value.
+   * @param identifier keyword
+   * @return keyword value
    */
-  [[nodiscard]] virtual auto is(const std::string& value) const -> bool;
+  static auto keyword(std::string_view identifier) -> Value;
 
   /**
-   * Returns the unit value, or 0 if not a UnitValue
-   * @return unit value, or 0 if not UnitValue
+   * Creates a keyword value of a known keyword
+   * @param keyword keyword
+   * @return keyword value
    */
-  [[nodiscard]] virtual auto unitValue() const -> double;
-};
+  static auto keyword(CSS::Keyword keyword) -> Value;
 
-/**
- * A text declaration value
- */
-struct TextValue : public Value {
- public:
-  TextValue() = delete;
-  ~TextValue() override = default;
+  /**
+   * Creates a length value
+   * @param value magnitude
+   * @param unit unit used
+   * @return length value
+   */
+  static auto length(double value, Unit unit) -> Value;
 
   /**
-   * Creates a text value
-   * @param value text value
+   * Creates a color value
+   * @param r red channel
+   * @param g green channel
+   * @param b blue channel
+   * @param a alpha channel
+   * @return color value
    */
-  explicit TextValue(std::string value);
+  static auto color(uint8_t r, uint8_t g, uint8_t b, double a) -> Value;
 
-  TextValue(const TextValue& rhs) = default;
+  /**
+   * Returns the kind of the value
+   * @return type
+   */
+  [[nodiscard]] auto getType() const -> Type;
 
   /**
-   * Clones a TextValue
-   * @return cloned value
+   * Returns whether *this is a keyword
+   * @param identifier keyword to compare
+   * @return whether *this is `identifier`
    */
-  [[nodiscard]] auto clone() const -> ValuePtr override;
+  [[nodiscard]] auto is(std::string_view identifier) const -> bool;
 
   /**
-   * Prints a text declaration value
-   * @return printed value
+   * Returns the number of a keyword, which is Keyword::Count for one that is
+   * not enumerated, or Keyword::Empty if not a keyword
+   * @return keyword
    */
-  [[nodiscard]] auto print() const -> std::string override;
+  [[nodiscard]] auto getKeyword() const -> CSS::Keyword;
 
-  std::string value;
-};
+  /**
+   * Returns the identifier of a keyword, or "" if not a keyword
+   * @return identifier
+   */
+  [[nodiscard]] auto getIdentifier() const -> std::string_view;
 
-enum Unit { px, em, rem, vw, vh, percent };
-auto UnitRaw() -> std::vector<std::string>;
-/**
- * A unit declaration value
- */
-struct UnitValue : public Value {
- public:
-  UnitValue() = delete;
-  ~UnitValue() override = default;
+  /**
+   * Returns the magnitude of a length, or 0 if not a length
+   * @return magnitude
+   */
+  [[nodiscard]] auto unitValue() const -> double;
 
   /**
-   * Creates a unit value
-   * @param value magnitude
-   * @param unit unit used
+   * Returns the unit of a length, or px if not a length
+   * @return unit
    */
-  UnitValue(double value, Unit unit);
+  [[nodiscard]] auto getUnit() const -> Unit;
 
-  UnitValue(const UnitValue& rhs) = default;
+  /**
+   * Returns an array of RGB color channels, or black if not a color
+   * @return color channels
+   */
+  [[nodiscard]] auto channels() const -> std::array<uint8_t, 3>;
 
   /**
-   * Clones a UnitValue
-   * @return cloned value
+   * Returns the alpha channel of a color, or 0 if not a color
+   * @return alpha channel
    */
-  [[nodiscard]] auto clone() const -> ValuePtr override;
+  [[nodiscard]] auto getAlpha() const -> double;
 
   /**
-   * Prints a unit declaration value
+   * Prints a declaration value
    * @return printed value
    */
-  [[nodiscard]] auto print() const -> std::string override;
+  [[nodiscard]] auto print() const -> std::string;
 
-  double value;
-  Unit unit;
+  /**
+   * Compares two values
+   * @param rhs value to compare
+   * @return whether both are the same keyword, length, or color
+   */
+  auto operator==(const Value& rhs) const -> bool;
+
+  /**
+   * Compares two values
+   * @param rhs value to compare
+   * @return whether the values differ
+   */
+  auto operator!=(const Value& rhs) const -> bool;
+
+ private:
+  union {
+    const char* name = nullptr;  // characters of a keyword that is not enumerated
+    double number;               // magnitude of a length, or alpha of a color
+  };
+  uint32_t bits = 0;  // keyword number or name length, or color channels as 0xBBGGRR
+  Unit unit = px;
+  Type type = Keyword;
 };
 
+static_assert(sizeof(Value) == 16, "values are 16 bytes");
+static_assert(std::is_trivially_copyable_v<Value>, "values copy as PODs");
+
 /**
- * A color declaration value
+ * How a compound selector relates to the compound on its right
  */
-struct ColorValue : public Value {
- public:
-  ColorValue() = delete;
-  ~ColorValue() override = default;
-
-  /**
-   * Creates a color value
-   * @param r red channel
-   * @param g green channel
-   * @param b blue channel
-   * @param a alpha channel
-   */
-  ColorValue(uint8_t r, uint8_t g, uint8_t b, double a);
+enum Combinator { Descendant, Child };
 
-  ColorValue(const ColorValue& rhs) = default;
+/**
+ * How an attribute selector tests the attribute
+ */
+enum AttributeMatch { Present, Equals };
 
+/**
+ * An attribute selector, such as `[data-x]` or `[type=text]`
+ */
+struct AttributeSelector {
+ public:
   /**
-   * Clones a ColorValue
-   * @return cloned value
+   * Prints the attribute selector in the form `[name]` or `[name="value"]`
+   * @return pretty-printed attribute selector
    */
-  [[nodiscard]] auto clone() const -> ValuePtr override;
+  [[nodiscard]] auto print() const -> std::string;
 
+  std::string name;
+  AttributeMatch match = Present;
+  std::string value;  // compared to the attribute if match is Equals
+};
+
+/**
+ * A structural pseudo-class, `:nth-child(an+b)`, which matches the elements
+ * that are the (an+b)th element of their parent for some n >= 0.
+ * `:first-child` is `:nth-child(1)`, and a pseudo-class that is not supported
+ * is `:nth-child(0)`, which matches nothing.
+ */
+struct NthChild {
+ public:
   /**
-   * Prints a color declaration value
-   * @return printed value
+   * Determines whether a position among siblings is an+b for some n >= 0
+   * @param index 1-based position of an element among its parent's elements
+   * @return whether the pseudo-class matches the position
    */
-  [[nodiscard]] auto print() const -> std::string override;
+  [[nodiscard]] auto matches(uint64_t index) const -> bool;
 
   /**
-   * Returns an array of RGB color channels
-   * @return color channels
+   * Prints the pseudo-class in the form `:first-child` or `:nth-child(2n+1)`
+   * @return pretty-printed pseudo-class
    */
-  [[nodiscard]] auto channels() const -> std::array<uint8_t, 3>;
+  [[nodiscard]] auto print() const -> std::string;
 
-  uint8_t r, g, b;
-  double a;
+  int64_t a = 0;
+  int64_t b = 0;
 };
 
 /**
- * Represents a CSS selector. Can be a
+ * Represents a CSS selector. Its compound selector, matched against an
+ * element, can be a
  * - tag (body, a, p, span)
  * - id (#intro, #user-selection)
  * - class (.full-width, .click-toggle)
- * or any combination of those, but has at most one tag and one id.
+ * - attribute selector ([data-x], [type=text])
+ * - structural pseudo-class (:first-child, :nth-child(2n+1))
+ * or any combination of those, but has at most one tag and one id. The
+ * compounds that must match the element's ancestors, as in `ul > li .title`,
+ * are kept as ancestor selectors, nearest first.
  */
 struct Selector {
  public:
@@ -217,20 +287,32 @@ struct Selector {
 
   /**
    * Determines the specificity of the selector, prioritized by
-   * (id, class, tag). High specificity is more important.
+   * (id, class, tag) and summed over its compounds, where attribute selectors
+   * and pseudo-classes count as classes. High specificity is more important.
    * @return specificity vector
    */
   [[nodiscard]] auto specificity() const -> Specificity;
 
   /**
-   * Prints a selector in the form `tag#id.class1.class2`
+   * Prints a selector in the form `tag#id.class1 > tag#id.class2`
    * @return pretty-printed selector
    */
   [[nodiscard]] auto print() const -> std::string;
 
+  /**
+   * Prints the compound selector alone, in the form
+   * `tag#id.class1.class2[attr]:first-child`
+   * @return pretty-printed compound
+   */
+  [[nodiscard]] auto printCompound() const -> std::string;
+
   std::string tag;
   std::string id;
   std::vector<std::string> klass;
+  std::vector<AttributeSelector> attributes;
+  std::vector<NthChild> pseudoClasses;
+  Combinator combinator = Descendant;  // of an ancestor, to the compound on its right
+  std::vector<Selector> ancestors;     // compounds left of this one, nearest first
 };
 
 /**
@@ -252,13 +334,20 @@ struct Declaration {
    * @param name declaration name
    * @param value declaration value
    */
-  Declaration(std::string name, ValuePtr&& value);
+  Declaration(std::string name, Value value);
 
   /**
-   * Copy ctor
-   * @param rhs declaration to copy
+   * Creates the declarations of a property and its values. A shorthand, such
+   * as `margin: 1px 2px`, is expanded into its longhands, which are reset to
+   * `initial` if it does not set them; `border` is dropped if it sets one of
+   * them twice, and `background` only sets its color, so is dropped without
+   * one. Any other property keeps its first value.
+   * @param name property name
+   * @param values property values, in order
+   * @return declarations, or none if the values do not fit the property
    */
-  Declaration(const Declaration& rhs);
+  static auto expand(const std::string& name, const std::vector<Value>& values)
+      -> DeclarationSet;
 
   /**
    * Prints a declaration in the form `name: value;`
@@ -267,7 +356,7 @@ struct Declaration {
   [[nodiscard]] auto print() const -> std::string;
 
   std::string name;
-  ValuePtr value;
+  Value value;
 };
 
 /**
@@ -291,9 +380,34 @@ struct Rule {
   DeclarationSet declarations;
 };
 
+/**
+ * The identifiers of the keyword values of a style sheet that are not
+ * enumerated, each stored once. Identifiers are never moved nor freed, so
+ * the values viewing them stay valid as long as the table.
+ */
+class Identifiers {
+ public:
+  /**
+   * Stores an identifier, unless it is already stored
+   * @param identifier identifier to store
+   * @return view of the stored identifier
+   */
+  auto intern(std::string_view identifier) -> std::string_view;
+
+  /**
+   * Returns the number of stored identifiers
+   * @return number of identifiers
+   */
+  [[nodiscard]] auto size() const -> uint64_t;
+
+ private:
+  std::deque<std::string> names;
+  std::unordered_set<std::string_view> index;
+};
+
 /**
  * A style sheet, consisting of CSS rules. Adapts a vector of rules to allow
- * for visitors.
+ * for visitors. Copies of a sheet share its identifiers.
  */
 class StyleSheet : public std::vector<Rule> {
  public:
@@ -302,6 +416,8 @@ class StyleSheet : public std::vector<Rule> {
    * @param visitor accepted visitor
    */
   void acceptVisitor(Visitor& visitor) const;
+
+  std::shared_ptr<const Identifiers> identifiers = std::make_shared<Identifiers>();
 };
 }  // namespace CSS
 
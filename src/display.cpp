@@ -5,138 +5,568 @@
 
 #include "display.h"
 
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
 #include "renderer/renderer.h"
+#include "trace.h"
 
 /**
- * Pure virtual dtor
+ * Creates a display list from a layout tree
+ * @param root root layout node
+ * @return list of commands
  */
-Display::Command::~Command() = default;
+auto Display::DisplayList::from(const Layout::BoxPtr& root) -> Display::DisplayList {
+  TRACE_SPAN("display", "DisplayList::from");
+  DisplayList list;
+  renderBox(root, list, std::nullopt);
+  return list;
+}
 
 /**
- * Creates a queue of display commands to execute
+ * Creates a display list of the part of a layout tree visible in a viewport
  * @param root root layout node
- * @return queue of commands
+ * @param viewport visible region of the page
+ * @return list of commands
+ */
+auto Display::DisplayList::from(const Layout::BoxPtr& root,
+                                const Layout::Rectangle& viewport) -> Display::DisplayList {
+  TRACE_SPAN_ARG("display", "DisplayList::from viewport", "y", viewport.origin.y);
+  DisplayList list;
+  renderBox(root, list, viewport);
+  return list;
+}
+
+/**
+ * Reads a display list written by `serialize`
+ * @param in stream to read from
+ * @return deserialized list
+ */
+auto Display::DisplayList::deserialize(std::istream& in) -> Display::DisplayList {
+  char fileMagic[sizeof(magic)];
+  uint32_t fileVersion(0);
+  uint64_t count(0);
+  in.read(fileMagic, sizeof(fileMagic));
+  in.read(reinterpret_cast<char*>(&fileVersion), sizeof(fileVersion));
+  in.read(reinterpret_cast<char*>(&count), sizeof(count));
+  if (!in || !std::equal(std::begin(magic), std::end(magic), fileMagic) ||
+      fileVersion != version) {
+    throw std::runtime_error("Stream does not hold a display list");
+  }
+
+  // a count the stream is too short to hold is rejected before any memory is
+  // reserved for it
+  bool checked = false;
+  const auto start = in.tellg();
+  if (start >= 0 && in.seekg(0, std::ios::end)) {
+    const auto end = in.tellg();
+    in.seekg(start);
+    if (end < start || count > static_cast<uint64_t>(end - start) / recordSize) {
+      throw std::runtime_error("Display list is truncated");
+    }
+    checked = true;
+  }
+  in.clear();
+
+  DisplayList list;
+  if (checked) {
+    list.reserve(count);
+  }
+  for (uint64_t i = 0; i < count; ++i) {
+    Command cmd{};
+    in.read(reinterpret_cast<char*>(&cmd.type), sizeof(cmd.type));
+    in.read(reinterpret_cast<char*>(&cmd.color), sizeof(cmd.color));
+    in.read(reinterpret_cast<char*>(&cmd.rect), sizeof(cmd.rect));
+    if (!in) {
+      throw std::runtime_error("Display list is truncated");
+    }
+    list.push_back(cmd);
+  }
+  return list;
+}
+
+/**
+ * Writes the list as a short header followed by the fields of each command,
+ * in host byte order. Fields are written one by one, so that no padding
+ * between them is written.
+ * @param out stream to write to
  */
-auto Display::Command::createQueue(const Layout::BoxPtr& root) -> Display::CommandQueue {
-  CommandQueue queue;
-  renderBox(root, queue);
-  return queue;
+void Display::DisplayList::serialize(std::ostream& out) const {
+  const uint64_t count = size();
+  out.write(magic, sizeof(magic));
+  out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+  out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+  for (const auto& cmd : *this) {
+    out.write(reinterpret_cast<const char*>(&cmd.type), sizeof(cmd.type));
+    out.write(reinterpret_cast<const char*>(&cmd.color), sizeof(cmd.color));
+    out.write(reinterpret_cast<const char*>(&cmd.rect), sizeof(cmd.rect));
+  }
 }
 
 /**
- * Creates the commands to render a box
+ * Removes commands that are fully hidden by later opaque rectangles, and trims
+ * rectangles that are hidden along an entire edge. Commands are walked from
+ * last to first, and each is tested only against the later opaque rectangles
+ * that a spatial index of the opaque commands finds overlapping it, nearest
+ * first, until it is hidden. A list without overlapping opaque commands, or
+ * whose commands are each hidden by the next, is culled in linear time.
+ * Commands that paint no pixels neither occlude nor are tested.
+ * @return number of pixels of overdraw removed
+ */
+auto Display::DisplayList::cullOccluded() -> uint64_t {
+  TRACE_SPAN_ARG("display", "DisplayList::cullOccluded", "commands", size());
+  const SpatialIndex index(*this, 128, [](const Command& cmd) {
+    return cmd.isOpaque() && pixelArea(cmd.bounds()) > 0;
+  });
+  uint64_t removed(0);
+  std::vector<bool> hidden(size(), false);
+  for (auto i = size(); i-- > 0;) {
+    auto& cmd = (*this)[i];
+    const auto rect = cmd.bounds();
+    auto visible = rect;
+    if (pixelArea(rect) == 0) {
+      hidden[i] = true;
+      continue;
+    }
+
+    // any later opaque command is painted over this one; if it is itself
+    // hidden, it is hidden by commands later still. The nearest ones in each
+    // cell are tried first, and the search stops once nothing is visible.
+    index.visit(rect, i, [this, &visible](uint64_t j) {
+      const auto occluder = (*this)[j].bounds();
+      if (occluder.contains(visible)) {
+        visible.width = visible.height = 0;
+      } else {
+        visible = trim(visible, occluder);
+      }
+      return pixelArea(visible) > 0;
+    });
+
+    removed += pixelArea(rect) - pixelArea(visible);
+    if (pixelArea(visible) == 0) {
+      hidden[i] = true;
+      continue;
+    }
+    cmd.rect = Rect::from(visible);
+  }
+
+  uint64_t kept(0);
+  for (uint64_t i = 0; i < size(); ++i) {
+    if (!hidden[i]) {
+      (*this)[kept++] = (*this)[i];
+    }
+  }
+  resize(kept);
+  return removed;
+}
+
+/**
+ * Finds the regions that render differently between a previous list and *this
+ * list. Commands are matched in order, resynchronizing after small insertions
+ * and removals; since matched commands keep their relative order, any pixel
+ * covered only by matched commands renders the same in both frames. Every
+ * unmatched command damages its bounds.
+ * @param previous previously rendered list
+ * @return damaged rectangles
+ */
+auto Display::DisplayList::diff(const Display::DisplayList& previous) const
+    -> Display::DamageVector {
+  const auto& next = *this;
+  const auto shortest = std::min(size(), previous.size());
+  uint64_t prefix(0), suffix(0);
+  while (prefix < shortest && next[prefix] == previous[prefix]) {
+    ++prefix;
+  }
+  while (suffix < shortest - prefix &&
+         next[size() - suffix - 1] == previous[previous.size() - suffix - 1]) {
+    ++suffix;
+  }
+
+  DamageVector damage;
+  auto addDamage = [&damage](Layout::Rectangle rect) {
+    if (rect.width <= 0 || rect.height <= 0) {
+      return;
+    }
+
+    // absorb all overlapping damage, which may in turn overlap more damage
+    bool grew = true;
+    while (grew) {
+      auto overlap = std::find_if(damage.begin(), damage.end(), [&rect](const auto& other) {
+        return other.intersects(rect);
+      });
+      grew = overlap != damage.end();
+      if (grew) {
+        rect = rect.unite(*overlap);
+        damage.erase(overlap);
+      }
+    }
+    damage.push_back(rect);
+  };
+
+  auto i = prefix, j = prefix;
+  const auto endPrev = previous.size() - suffix, endNext = size() - suffix;
+  while (i < endPrev && j < endNext) {
+    if (next[j] == previous[i]) {
+      ++i, ++j;
+      continue;
+    }
+
+    // find the nearest point where the lists line up again
+    uint64_t inserted(0), removed(0);
+    for (uint64_t k = 1; k <= resyncWindow && inserted + removed == 0; ++k) {
+      if (j + k < endNext && next[j + k] == previous[i]) {
+        inserted = k;
+      } else if (i + k < endPrev && previous[i + k] == next[j]) {
+        removed = k;
+      }
+    }
+
+    if (inserted + removed == 0) {  // command replaced
+      addDamage(previous[i++].bounds());
+      addDamage(next[j++].bounds());
+    }
+    for (; inserted > 0; --inserted) {
+      addDamage(next[j++].bounds());
+    }
+    for (; removed > 0; --removed) {
+      addDamage(previous[i++].bounds());
+    }
+  }
+  for (; i < endPrev; ++i) {
+    addDamage(previous[i].bounds());
+  }
+  for (; j < endNext; ++j) {
+    addDamage(next[j].bounds());
+  }
+  return damage;
+}
+
+/**
+ * Accepts a renderer to the list
+ * @param renderer accepted renderer
+ */
+void Display::DisplayList::acceptRenderer(Renderer& renderer) const {
+  renderer.render(*this);
+}
+
+/**
+ * Creates the commands to render a box and its visible descendants. A box's
+ * extent covers everything its subtree paints, so a subtree whose extent
+ * misses the viewport is skipped whole.
  * @param box box to render
- * @param queue queue to add commands to
+ * @param list list to add commands to
+ * @param viewport visible region, or nullopt if everything is visible
  */
-void Display::Command::renderBox(const Layout::BoxPtr& box, Display::CommandQueue& queue) {
-  renderBackground(box, queue);
-  renderBorders(box, queue);
+void Display::DisplayList::renderBox(const Layout::BoxPtr& box,
+                                     Display::DisplayList& list,
+                                     const std::optional<Layout::Rectangle>& viewport) {
+  if (viewport && !viewport->intersects(box->getExtent())) {
+    return;
+  }
+
+  renderBackground(box, list);
+  renderBorders(box, list);
   // TODO: renderText
 
   // draw children on top of parent
-  const auto children = box->getChildren();
-  for (const auto& child : children) {
-    renderBox(child, queue);
+  for (const auto& child : box->borrowChildren()) {
+    renderBox(child, list, viewport);
   }
 }
 
 /**
  * Creates the commands to render the background of a box
  * @param box box to render background of
- * @param queue queue to add commands to
+ * @param list list to add commands to
  */
-void Display::Command::renderBackground(const Layout::BoxPtr& box,
-                                        Display::CommandQueue& queue) {
-  auto colorPtr = getColor(box, "background-color", "background");
+void Display::DisplayList::renderBackground(const Layout::BoxPtr& box,
+                                            Display::DisplayList& list) {
+  auto color = getColor(box, "background-color");
   // only render box if it actually has a background
-  if (auto color = dynamic_cast<CSS::ColorValue*>(colorPtr.get())) {
+  if (color && color->getType() == CSS::Value::Color) {
     // create rectangle of padding area and background color
-    queue.push(CommandPtr(new RectangleCmd(box->getDimensions().paddingArea(), *color)));
+    list.push_back(Command::rectangle(box->getDimensions().paddingArea(), *color));
   }
 }
 
-void Display::Command::renderBorders(const Layout::BoxPtr& box,
-                                     Display::CommandQueue& queue) {
-  // use background if no explicit border color provided
-  auto colorPtr = getColor(box, "border-color", "background-color", "background");
-  auto color = dynamic_cast<CSS::ColorValue*>(colorPtr.get());
-  if (color == nullptr) {
-    return;  // nothing to render if no border color
-  }
+void Display::DisplayList::renderBorders(const Layout::BoxPtr& box,
+                                         Display::DisplayList& list) {
+  // each side uses the background if no explicit border color is provided
+  auto side = [&box, &list](const std::string& style, const Layout::Rectangle& rectangle) {
+    auto color = getColor(box, style, "background-color");
+    if (color && color->getType() == CSS::Value::Color) {
+      list.push_back(Command::rectangle(rectangle, *color));
+    }
+  };
 
   const auto dims = box->getDimensions();
   const auto borderArea = dims.borderArea();
 
-  // top border
-  queue.push(
-      CommandPtr(new RectangleCmd(Layout::Rectangle(borderArea.origin.x, borderArea.origin.y,
-                                                    borderArea.width, dims.border.top),
-                                  *color)));
-  // right border
-  queue.push(CommandPtr(new RectangleCmd(
-      Layout::Rectangle(borderArea.origin.x + borderArea.width - dims.border.right,
-                        borderArea.origin.y, dims.border.right, borderArea.height),
-      *color)));
-  // bottom border
-  queue.push(CommandPtr(new RectangleCmd(
-      Layout::Rectangle(borderArea.origin.x,
-                        borderArea.origin.y + borderArea.height - dims.border.bottom,
-                        borderArea.width, dims.border.bottom),
-      *color)));
-  // left border
-  queue.push(
-      CommandPtr(new RectangleCmd(Layout::Rectangle(borderArea.origin.x, borderArea.origin.y,
-                                                    dims.border.left, borderArea.height),
-                                  *color)));
-}
-
-/**
- * Gets the color value of a style from a box, or nullptr if no color is
+  side("border-top-color", Layout::Rectangle(borderArea.origin.x, borderArea.origin.y,
+                                             borderArea.width, dims.border.top));
+  side("border-right-color",
+       Layout::Rectangle(borderArea.origin.x + borderArea.width - dims.border.right,
+                         borderArea.origin.y, dims.border.right, borderArea.height));
+  side("border-bottom-color",
+       Layout::Rectangle(borderArea.origin.x,
+                         borderArea.origin.y + borderArea.height - dims.border.bottom,
+                         borderArea.width, dims.border.bottom));
+  side("border-left-color", Layout::Rectangle(borderArea.origin.x, borderArea.origin.y,
+                                              dims.border.left, borderArea.height));
+}
+
+/**
+ * Trims the part of a rectangle hidden by an occluder, if the occluder spans
+ * an entire side of the rectangle
+ * @param rect rectangle to trim
+ * @param occluder opaque rectangle painted over `rect`
+ * @return trimmed rectangle
+ */
+auto Display::DisplayList::trim(const Layout::Rectangle& rect,
+                                const Layout::Rectangle& occluder) -> Layout::Rectangle {
+  const auto rx1 = rect.origin.x + rect.width, ry1 = rect.origin.y + rect.height;
+  const auto ox1 = occluder.origin.x + occluder.width,
+             oy1 = occluder.origin.y + occluder.height;
+
+  auto res = rect;
+  if (occluder.origin.x <= rect.origin.x && ox1 >= rx1) {  // spans full width
+    if (occluder.origin.y <= rect.origin.y && oy1 > rect.origin.y) {  // hides top
+      res.origin.y = oy1;
+      res.height = ry1 - oy1;
+    } else if (occluder.origin.y < ry1 && oy1 >= ry1) {  // hides bottom
+      res.height = occluder.origin.y - rect.origin.y;
+    }
+  } else if (occluder.origin.y <= rect.origin.y && oy1 >= ry1) {  // spans full height
+    if (occluder.origin.x <= rect.origin.x && ox1 > rect.origin.x) {  // hides left
+      res.origin.x = ox1;
+      res.width = rx1 - ox1;
+    } else if (occluder.origin.x < rx1 && ox1 >= rx1) {  // hides right
+      res.width = occluder.origin.x - rect.origin.x;
+    }
+  }
+  return res;
+}
+
+/**
+ * Counts the pixels a rectangle covers when rasterized, using the same
+ * truncation as the Canvas
+ * @param rect rectangle to measure
+ * @return number of pixels covered
+ */
+auto Display::DisplayList::pixelArea(const Layout::Rectangle& rect) -> uint64_t {
+  auto span = [](double start, double length) -> uint64_t {
+    const auto first = std::floor(std::max(0., start));
+    const auto last = std::floor(std::max(0., start + length));
+    return last > first ? static_cast<uint64_t>(last - first) : 0;
+  };
+  return span(rect.origin.x, rect.width) * span(rect.origin.y, rect.height);
+}
+
+/**
+ * Gets the color value of a style from a box, or nothing if no color is
  * specified for that style
  * @tparam Args variadic arguments, should be strings
  * @param box box to get style from
  * @param style style to look up
  * @param backup backup styles to look up
- * @return color value, or nullptr if it does not exist
+ * @return color value, or nothing if it does not exist
  */
 template <typename... Args>
-auto Display::Command::getColor(const Layout::BoxPtr& box,
-                                const std::string& style,
-                                const Args&... backup) -> CSS::ValuePtr {
+auto Display::DisplayList::getColor(const Layout::BoxPtr& box,
+                                    const std::string& style,
+                                    const Args&... backup) -> std::optional<CSS::Value> {
   if (auto sBox = dynamic_cast<Layout::StyledBox*>(box.get())) {
-    auto bg = sBox->getContent().value(style, backup...);
-    return bg ? bg->clone() : nullptr;
+    return sBox->borrowContent().value(style, backup...);
   }
-  return nullptr;
+  return std::nullopt;
 }
 
 /**
- * Command to create a rectangle of a color
+ * Creates a command to render a rectangle of a color
  * @param rectangle rectangle to create
  * @param color color to color rectangle
+ * @return rectangle command
  */
-Display::RectangleCmd::RectangleCmd(const Layout::Rectangle& rectangle,
-                                    const CSS::ColorValue& color)
-    : rectangle(rectangle), color(color) {}
+auto Display::Command::rectangle(const Layout::Rectangle& rectangle,
+                                 const CSS::Value& color) -> Display::Command {
+  const auto rgb = color.channels();
+  const auto alpha = static_cast<uint8_t>(std::lround(color.getAlpha() * 255));
+  return Command{CommandType::Rectangle, Color{rgb[0], rgb[1], rgb[2], alpha},
+                 Rect::from(rectangle)};
+}
 
-void Display::RectangleCmd::acceptRenderer(Renderer& renderer) const {
-  renderer.render(*this);
+/**
+ * Returns the area the command paints over
+ * @return bounding rectangle
+ */
+auto Display::Command::bounds() const -> Layout::Rectangle {
+  return Layout::Rectangle(rect.x, rect.y, rect.width, rect.height);
+}
+
+/**
+ * Returns whether the command fully hides what is below it
+ * @return whether color is opaque
+ */
+auto Display::Command::isOpaque() const -> bool {
+  return color.a == 255;
+}
+
+/**
+ * Determines whether two commands paint identically
+ * @param rhs command to compare
+ * @return whether commands are equal
+ */
+auto Display::Command::operator==(const Display::Command& rhs) const -> bool {
+  return type == rhs.type && color.r == rhs.color.r && color.g == rhs.color.g &&
+         color.b == rhs.color.b && color.a == rhs.color.a && rect.x == rhs.rect.x &&
+         rect.y == rhs.rect.y && rect.width == rhs.rect.width &&
+         rect.height == rhs.rect.height;
+}
+
+/**
+ * Indexes the commands of a display list. The grid spans the finite bounds of
+ * every indexed command that paints any area, and its cells are doubled in
+ * size until there are at most `maxCells` of them.
+ * @param list list to index
+ * @param cellSize width and height of each grid cell, in pixels
+ * @param filter predicate of the commands to index, or empty to index all
+ */
+Display::SpatialIndex::SpatialIndex(const Display::DisplayList& list,
+                                    double cellSize,
+                                    const std::function<bool(const Command&)>& filter)
+    : bounds(),
+      cellSize(cellSize),
+      originX(0),
+      originY(0),
+      columns(0),
+      rows(0),
+      cells() {
+  if (!(cellSize > 0)) {
+    throw std::invalid_argument("Cell size must be positive");
+  }
+
+  // commands left out are given no area, so that no cell lists them
+  bounds.reserve(list.size());
+  auto extent = std::optional<Layout::Rectangle>();
+  for (const auto& cmd : list) {
+    bounds.push_back(!filter || filter(cmd) ? cmd.rect : Rect{0, 0, 0, 0});
+    const auto& rect = bounds.back();
+    if (rect.width > 0 && rect.height > 0 && std::isfinite(rect.x) &&
+        std::isfinite(rect.y) && std::isfinite(rect.x + rect.width) &&
+        std::isfinite(rect.y + rect.height)) {
+      extent = extent ? extent->unite(cmd.bounds()) : cmd.bounds();
+    }
+  }
+  if (!extent) {
+    return;
+  }
+
+  originX = extent->origin.x;
+  originY = extent->origin.y;
+  auto span = [this](double length) { return std::ceil(length / this->cellSize) + 1; };
+  while (span(extent->width) * span(extent->height) > static_cast<double>(maxCells)) {
+    this->cellSize *= 2;
+  }
+  columns = static_cast<uint64_t>(span(extent->width));
+  rows = static_cast<uint64_t>(span(extent->height));
+  cells.resize(columns * rows);
+
+  for (uint64_t i = 0; i < bounds.size(); ++i) {
+    const auto& rect = bounds[i];
+    if (rect.width <= 0 || rect.height <= 0) {
+      continue;
+    }
+    const auto x1 = toCell(rect.x + rect.width, originX, columns);
+    const auto y1 = toCell(rect.y + rect.height, originY, rows);
+    for (auto y = toCell(rect.y, originY, rows); y <= y1; ++y) {
+      for (auto x = toCell(rect.x, originX, columns); x <= x1; ++x) {
+        cells[x + y * columns].push_back(i);
+      }
+    }
+  }
+}
+
+/**
+ * Finds the commands that overlap a region
+ * @param region region to query
+ * @param after index of a command to find only commands painted after, or
+ *        nothing to find every command
+ * @return indices of overlapping commands, in painting order
+ */
+auto Display::SpatialIndex::query(const Layout::Rectangle& region,
+                                  std::optional<uint64_t> after) const
+    -> std::vector<uint64_t> {
+  std::vector<uint64_t> found;
+  query(region, after, found);
+  return found;
+}
+
+/**
+ * Finds the commands that overlap a region into a buffer, visiting the cells
+ * the region overlaps
+ * @param region region to query
+ * @param after index of a command to find only commands painted after, or
+ *        nothing to find every command
+ * @param found buffer to fill with the indices of overlapping commands, in
+ *        painting order; cleared first
+ */
+void Display::SpatialIndex::query(const Layout::Rectangle& region,
+                                  std::optional<uint64_t> after,
+                                  std::vector<uint64_t>& found) const {
+  found.clear();
+  visit(region, after, [&found](uint64_t i) {
+    found.push_back(i);
+    return true;
+  });
+
+  // commands spanning several cells are found once per cell
+  std::sort(found.begin(), found.end());
+  found.erase(std::unique(found.begin(), found.end()), found.end());
+}
+
+/**
+ * Finds the last-painted command covering a point
+ * @param x x coordinate
+ * @param y y coordinate
+ * @return index of topmost command, if any covers the point
+ */
+auto Display::SpatialIndex::topmost(double x, double y) const -> std::optional<uint64_t> {
+  if (cells.empty()) {
+    return std::nullopt;
+  }
+
+  const auto& cell = cells[toCell(x, originX, columns) + toCell(y, originY, rows) * columns];
+  auto hit = std::find_if(cell.rbegin(), cell.rend(), [this, x, y](auto i) {
+    const auto& rect = bounds[i];
+    return x >= rect.x && x < rect.x + rect.width && y >= rect.y && y < rect.y + rect.height;
+  });
+  return hit != cell.rend() ? std::optional<uint64_t>(*hit) : std::nullopt;
 }
 
 /**
- * Returns encompassing rectangle
- * @return rectangle
+ * Converts a coordinate to a cell column or row, bounded by the grid
+ * @param pos coordinate to convert
+ * @param start grid start along the same axis
+ * @param count number of cells along the axis
+ * @return cell column or row
  */
-auto Display::RectangleCmd::getRectangle() const -> Layout::Rectangle {
-  return rectangle;
+auto Display::SpatialIndex::toCell(double pos, double start, uint64_t count) const
+    -> uint64_t {
+  const auto cell = std::floor((pos - start) / cellSize);
+  return static_cast<uint64_t>(std::min(static_cast<double>(count - 1), std::max(0., cell)));
 }
 
 /**
- * Returns color
- * @return color
+ * Narrows a layout rectangle to single precision
+ * @param rectangle rectangle to narrow
+ * @return narrowed rectangle
  */
-auto Display::RectangleCmd::getColor() const -> CSS::ColorValue {
-  return color;
+auto Display::Rect::from(const Layout::Rectangle& rectangle) -> Display::Rect {
+  return Rect{static_cast<float>(rectangle.origin.x), static_cast<float>(rectangle.origin.y),
+              static_cast<float>(rectangle.width), static_cast<float>(rectangle.height)};
 }
 
 #endif
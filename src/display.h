@@ -3,9 +3,14 @@
 #ifndef DISPLAY_HPP
 #define DISPLAY_HPP
 
-#include <memory>
-#include <queue>
+#include <algorithm>
+#include <functional>
+#include <iosfwd>
+#include <optional>
+#include <type_traits>
+#include <vector>
 
+#include "arena.h"
 #include "css.h"
 #include "layout.h"
 
@@ -14,112 +19,344 @@ class Renderer;
 /**
  * The Display module issues commands for rendering various boxes with styled
  * elements in the browser. This separates the concern of _what_ to render with
- * _how_ to render it, with each command having the ability to accept any kind
- * of renderer.
+ * _how_ to render it, with any kind of renderer able to consume the commands.
+ *
+ * Commands are plain, tagged records stored contiguously in a DisplayList.
+ * A list is retained rather than consumed by rendering, so it can be kept
+ * between frames, diffed against a newer list to find the regions that need
+ * repainting, and serialized byte-for-byte.
+ *
+ * A SpatialIndex over a list answers region and point queries, such as hit
+ * testing or finding the commands to replay for a repaint, without scanning
+ * the whole list.
  *
  * The following rendering commands are supported:
- *  - RectangleCmd: a rectangle of a solid color
+ *  - Rectangle: a rectangle of a solid color
  */
 namespace Display {
 // forward declaration
-class Command;
+class DisplayList;
+
+using DamageVector = std::vector<Layout::Rectangle>;
+
+/**
+ * Display command types
+ */
+enum class CommandType : uint8_t { Rectangle };
+
+/**
+ * An 8-bit per channel RGBA color, packed in channel order
+ */
+struct Color {
+  uint8_t r, g, b, a;
+};
 
-using CommandPtr = std::unique_ptr<Command>;
-using CommandQueue = std::queue<CommandPtr>;
+/**
+ * A single-precision rectangle
+ */
+struct Rect {
+ public:
+  /**
+   * Narrows a layout rectangle to single precision
+   * @param rectangle rectangle to narrow
+   * @return narrowed rectangle
+   */
+  static auto from(const Layout::Rectangle& rectangle) -> Rect;
+
+  float x, y, width, height;
+};
 
 /**
- * An abstract class describing a display command
+ * A display command, tagged by its type. Commands are trivially copyable so
+ * that lists of them can be copied as raw memory.
  */
-class Command {
+struct Command {
  public:
   /**
-   * Pure virtual dtor
+   * Creates a command to render a rectangle of a color
+   * @param rectangle rectangle to create
+   * @param color color to color rectangle
+   * @return rectangle command
    */
-  virtual ~Command() = 0;
+  static auto rectangle(const Layout::Rectangle& rectangle, const CSS::Value& color)
+      -> Command;
 
   /**
-   * Accepts a renderer to the command
-   * @param renderer accepted renderer
+   * Returns the area the command paints over
+   * @return bounding rectangle
    */
-  virtual void acceptRenderer(Renderer& renderer) const = 0;
+  [[nodiscard]] auto bounds() const -> Layout::Rectangle;
 
   /**
-   * Creates a queue of display commands to execute
+   * Returns whether the command fully hides what is below it
+   * @return whether color is opaque
+   */
+  [[nodiscard]] auto isOpaque() const -> bool;
+
+  /**
+   * Determines whether two commands paint identically
+   * @param rhs command to compare
+   * @return whether commands are equal
+   */
+  auto operator==(const Command& rhs) const -> bool;
+
+  CommandType type;
+  Color color;
+  Rect rect;
+};
+
+static_assert(std::is_trivially_copyable<Command>::value, "commands must be POD");
+
+/**
+ * A retained list of display commands in painting order, stored contiguously.
+ * Rendering does not consume the list, so it can survive between frames and
+ * be diffed against its successor.
+ */
+class DisplayList : public Arena::Vector<Command> {
+ public:
+  /**
+   * Creates a display list from a layout tree
+   * @param root root layout node
+   * @return list of commands
+   */
+  static auto from(const Layout::BoxPtr& root) -> DisplayList;
+
+  /**
+   * Creates a display list of the part of a layout tree visible in a
+   * viewport. Subtrees entirely outside the viewport are skipped without
+   * being visited.
    * @param root root layout node
-   * @return queue of commands
+   * @param viewport visible region of the page
+   * @return list of commands
+   */
+  static auto from(const Layout::BoxPtr& root, const Layout::Rectangle& viewport)
+      -> DisplayList;
+
+  /**
+   * Reads a display list written by `serialize`
+   * @param in stream to read from
+   * @return deserialized list
+   * @throws std::runtime_error if the stream does not hold a valid list
+   */
+  static auto deserialize(std::istream& in) -> DisplayList;
+
+  /**
+   * Writes the list as a short header followed by the fields of each command,
+   * in host byte order and without padding
+   * @param out stream to write to
+   */
+  void serialize(std::ostream& out) const;
+
+  /**
+   * Removes commands that are fully hidden by later opaque rectangles, and
+   * trims rectangles that are hidden along an entire edge. The rendered result
+   * is unchanged.
+   * @return number of pixels of overdraw removed
+   */
+  auto cullOccluded() -> uint64_t;
+
+  /**
+   * Finds the regions that render differently between a previous list and
+   * *this list. Overlapping regions are merged.
+   * @param previous previously rendered list
+   * @return damaged rectangles
+   */
+  [[nodiscard]] auto diff(const DisplayList& previous) const -> DamageVector;
+
+  /**
+   * Accepts a renderer to the list
+   * @param renderer accepted renderer
    */
-  static auto createQueue(const Layout::BoxPtr& root) -> CommandQueue;
+  void acceptRenderer(Renderer& renderer) const;
 
  private:
   /**
-   * Creates the commands to render a box
+   * How far ahead `diff` searches for a matching command after a mismatch
+   */
+  static constexpr uint64_t resyncWindow = 8;
+
+  /**
+   * Identifies a serialized display list, and its format version
+   */
+  static constexpr char magic[4] = {'S', '4', '1', 'D'};
+  static constexpr uint32_t version = 2;
+
+  /**
+   * Size of a serialized command: its type, color, and rectangle
+   */
+  static constexpr uint64_t recordSize = sizeof(CommandType) + sizeof(Color) + sizeof(Rect);
+
+  /**
+   * Creates the commands to render a box and its visible descendants
    * @param box box to render
-   * @param queue queue to add commands to
+   * @param list list to add commands to
+   * @param viewport visible region, or nullopt if everything is visible
    */
-  static void renderBox(const Layout::BoxPtr& box, CommandQueue& queue);
+  static void renderBox(const Layout::BoxPtr& box,
+                        DisplayList& list,
+                        const std::optional<Layout::Rectangle>& viewport);
 
   /**
    * Creates the commands to render the background of a box
    * @param box box to render background of
-   * @param queue queue to add commands to
+   * @param list list to add commands to
    */
-  static void renderBackground(const Layout::BoxPtr& box, CommandQueue& queue);
+  static void renderBackground(const Layout::BoxPtr& box, DisplayList& list);
 
   /**
    * Creates the commands to render the borders of a box
    * @param box box to render borders of
-   * @param queue queue to add commands to
+   * @param list list to add commands to
+   */
+  static void renderBorders(const Layout::BoxPtr& box, DisplayList& list);
+
+  /**
+   * Trims the part of a rectangle hidden by an occluder, if the occluder spans
+   * an entire side of the rectangle
+   * @param rect rectangle to trim
+   * @param occluder opaque rectangle painted over `rect`
+   * @return trimmed rectangle
+   */
+  static auto trim(const Layout::Rectangle& rect, const Layout::Rectangle& occluder)
+      -> Layout::Rectangle;
+
+  /**
+   * Counts the pixels a rectangle covers when rasterized
+   * @param rect rectangle to measure
+   * @return number of pixels covered
    */
-  static void renderBorders(const Layout::BoxPtr& box, CommandQueue& queue);
+  static auto pixelArea(const Layout::Rectangle& rect) -> uint64_t;
 
   /**
-   * Gets the color value of a style from a box, or nullptr if no color is
+   * Gets the color value of a style from a box, or nothing if no color is
    * specified for that style
    * @tparam Args variadic arguments, should be strings
    * @param box box to get style from
    * @param style style to look up
    * @param backup backup styles to look up
-   * @return color value, or nullptr if it does not exist
+   * @return color value, or nothing if it does not exist
    */
   template <typename... Args>
   static auto getColor(const Layout::BoxPtr& box,
                        const std::string& style,
-                       const Args&... backup) -> CSS::ValuePtr;
+                       const Args&... backup) -> std::optional<CSS::Value>;
 };
 
 /**
- * A command to render a rectangle
+ * A uniform grid over the bounds of the commands in a display list. Each cell
+ * holds the indices of the commands overlapping it, in painting order, so
+ * queries only visit the commands near the queried region.
  */
-class RectangleCmd : public Command {
+class SpatialIndex {
  public:
+  SpatialIndex() = delete;
+
   /**
-   * Command to create a rectangle of a color
-   * @param rectangle rectangle to create
-   * @param color color to color rectangle
+   * Indexes the commands of a display list. Cells are grown past the given
+   * size if the grid would otherwise exceed `maxCells`.
+   * @param list list to index
+   * @param cellSize width and height of each grid cell, in pixels
+   * @param filter predicate of the commands to index, or empty to index all
+   *        of them. Queries return indices into the whole list.
+   * @throws std::invalid_argument if the cell size is not positive
    */
-  RectangleCmd(const Layout::Rectangle& rectangle, const CSS::ColorValue& color);
+  explicit SpatialIndex(const DisplayList& list,
+                        double cellSize = 128,
+                        const std::function<bool(const Command&)>& filter = nullptr);
 
   /**
-   * Accepts a renderer to the command
-   * @param renderer accepted renderer
+   * Finds the commands that overlap a region
+   * @param region region to query
+   * @param after index of a command to find only commands painted after, or
+   *        nothing to find every command
+   * @return indices of overlapping commands, in painting order
+   */
+  [[nodiscard]] auto query(const Layout::Rectangle& region,
+                           std::optional<uint64_t> after = std::nullopt) const
+      -> std::vector<uint64_t>;
+
+  /**
+   * Finds the commands that overlap a region into a buffer, so that one
+   * buffer may be reused across queries
+   * @param region region to query
+   * @param after index of a command to find only commands painted after, or
+   *        nothing to find every command
+   * @param found buffer to fill with the indices of overlapping commands, in
+   *        painting order; cleared first
+   */
+  void query(const Layout::Rectangle& region,
+             std::optional<uint64_t> after,
+             std::vector<uint64_t>& found) const;
+
+  /**
+   * Visits the commands that overlap a region cell by cell, in painting order
+   * within each cell, until the visitor asks to stop. Commands painted before
+   * `after` are skipped by a binary search rather than visited, and nothing is
+   * collected or sorted, so a search that stops at its first match costs only
+   * the commands it visits. A command spanning several cells may be visited
+   * once for each.
+   * @tparam Visitor callable taking a command index, returning false to stop
+   * @param region region to query
+   * @param after index of a command to visit only commands painted after, or
+   *        nothing to visit every command
+   * @param visitor visitor of command indices
+   * @return false if the visitor stopped the search
    */
-  void acceptRenderer(Renderer& renderer) const override;
+  template <typename Visitor>
+  auto visit(const Layout::Rectangle& region,
+             std::optional<uint64_t> after,
+             Visitor&& visitor) const -> bool {
+    if (cells.empty()) {
+      return true;
+    }
+    const auto x0 = toCell(region.origin.x, originX, columns);
+    const auto x1 = toCell(region.origin.x + region.width, originX, columns);
+    const auto y1 = toCell(region.origin.y + region.height, originY, rows);
+    for (auto y = toCell(region.origin.y, originY, rows); y <= y1; ++y) {
+      for (auto x = x0; x <= x1; ++x) {
+        const auto& cell = cells[x + y * columns];
+        auto entry =
+            after ? std::upper_bound(cell.begin(), cell.end(), *after) : cell.begin();
+        for (; entry != cell.end(); ++entry) {
+          const auto& rect = bounds[*entry];
+          const Layout::Rectangle overlap(rect.x, rect.y, rect.width, rect.height);
+          if (region.intersects(overlap) && !visitor(*entry)) {
+            return false;
+          }
+        }
+      }
+    }
+    return true;
+  }
 
   /**
-   * Returns encompassing rectangle
-   * @return rectangle
+   * Finds the last-painted command covering a point
+   * @param x x coordinate
+   * @param y y coordinate
+   * @return index of topmost command, if any covers the point
    */
-  [[nodiscard]] auto getRectangle() const -> Layout::Rectangle;
+  [[nodiscard]] auto topmost(double x, double y) const -> std::optional<uint64_t>;
 
   /**
-   * Returns color
-   * @return color
+   * Largest number of cells in a grid
    */
-  [[nodiscard]] auto getColor() const -> CSS::ColorValue;
+  static constexpr uint64_t maxCells = 1 << 20;
 
  private:
-  Layout::Rectangle rectangle;
-  CSS::ColorValue color;
+  /**
+   * Converts a coordinate to a cell column or row, bounded by the grid
+   * @param pos coordinate to convert
+   * @param start grid start along the same axis
+   * @param count number of cells along the axis
+   * @return cell column or row
+   */
+  [[nodiscard]] auto toCell(double pos, double start, uint64_t count) const -> uint64_t;
+
+  std::vector<Rect> bounds;
+  double cellSize;
+  double originX, originY;
+  uint64_t columns, rows;
+  std::vector<std::vector<uint64_t>> cells;
 };
 }  // namespace Display
 
@@ -37,6 +37,10 @@ auto DOM::AttributeMap::print() const -> std::string {
       [&assign](auto acc, auto attr) { return acc + " " + assign(attr); });
 }
 
+auto DOM::AttributeMap::getOrder() const -> const std::vector<std::string>& {
+  return order;
+}
+
 /**
  * Creates a DOM Node
  * @param tag node tag name
@@ -65,6 +69,17 @@ auto DOM::Node::tagName() const -> std::string {
   return tag;
 }
 
+/**
+ * Returns the position of the node among the elements of its parent,
+ * counted when the parent was created
+ * @return 1 for the first element child, 2 for the next, and so on; 1 for
+ *         a root element, the only child of its document; 0 for a text or
+ *         comment node
+ */
+auto DOM::Node::siblingIndex() const -> uint32_t {
+  return index;
+}
+
 /**
  * Creates a Text Node
  * @param tag node tag name
@@ -92,7 +107,7 @@ void DOM::TextNode::acceptVisitor(Visitor& visitor) const {
  * Clone the Text Node to a unique pointer
  * @return cloned Node
  */
-auto DOM::TextNode::clone() -> DOM::NodePtr {
+auto DOM::TextNode::clone() const -> DOM::NodePtr {
   return NodePtr(new TextNode(text));
 }
 
@@ -123,7 +138,7 @@ void DOM::CommentNode::acceptVisitor(Visitor& visitor) const {
  * Clone the Comment Node to a unique pointer
  * @return cloned Node
  */
-auto DOM::CommentNode::clone() -> DOM::NodePtr {
+auto DOM::CommentNode::clone() const -> DOM::NodePtr {
   return NodePtr(new CommentNode(comment));
 }
 
@@ -137,9 +152,15 @@ DOM::ElementNode::ElementNode(std::string tag,
                               AttributeMap attributes,
                               const NodeVector& children)
     : Node(std::move(tag)), attributes(std::move(attributes)), children() {
+  index = 1;  // until numbered among the children of a parent
   this->children.reserve(children.size());
-  std::for_each(children.begin(), children.end(),
-                [this](const auto& child) { this->children.push_back(child->clone()); });
+  uint32_t elements = 0;
+  for (const auto& child : children) {
+    this->children.push_back(child->clone());
+    if (dynamic_cast<const ElementNode*>(child.get()) != nullptr) {
+      this->children.back()->index = ++elements;
+    }
+  }
 }
 
 /**
@@ -153,6 +174,22 @@ auto DOM::ElementNode::getChildren() const -> DOM::NodeVector {
   return nodes;
 }
 
+/**
+ * Borrows children nodes without cloning them
+ * @return reference to children nodes
+ */
+auto DOM::ElementNode::borrowChildren() const -> const DOM::NodeVector& {
+  return children;
+}
+
+/**
+ * Borrows attributes without copying them
+ * @return reference to attributes
+ */
+auto DOM::ElementNode::borrowAttributes() const -> const DOM::AttributeMap& {
+  return attributes;
+}
+
 /**
  * Returns pretty-printed attributes
  * @return attributes
@@ -197,8 +234,10 @@ void DOM::ElementNode::acceptVisitor(Visitor& visitor) const {
  * Clone the Element Node to a unique pointer
  * @return cloned Node
  */
-auto DOM::ElementNode::clone() -> DOM::NodePtr {
-  return NodePtr(new ElementNode(tagName(), attributes, children));
+auto DOM::ElementNode::clone() const -> DOM::NodePtr {
+  auto* node = new ElementNode(tagName(), attributes, children);
+  node->index = index;
+  return NodePtr(node);
 }
 
 #endif
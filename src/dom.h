@@ -3,11 +3,14 @@
 #ifndef DOM_HPP
 #define DOM_HPP
 
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "arena.h"
+
 class Visitor;
 
 /**
@@ -26,12 +29,12 @@ namespace DOM {
 class Node;
 
 using NodePtr = std::unique_ptr<Node>;
-using NodeVector = std::vector<NodePtr>;
+using NodeVector = Arena::Vector<NodePtr>;
 
 /**
  * A map of DOM attributes, adapted to allow visitors
  */
-class AttributeMap : public std::map<std::string, std::string> {
+class AttributeMap : public Arena::Map<std::string, std::string> {
  public:
   /**
    * Inserts an attribute
@@ -46,6 +49,12 @@ class AttributeMap : public std::map<std::string, std::string> {
    */
   [[nodiscard]] auto print() const -> std::string;
 
+  /**
+   * Returns attribute names in the order they were inserted
+   * @return attribute names
+   */
+  [[nodiscard]] auto getOrder() const -> const std::vector<std::string>&;
+
  private:
   std::vector<std::string> order;
 };
@@ -79,6 +88,15 @@ class Node {
    */
   [[nodiscard]] auto tagName() const -> std::string;
 
+  /**
+   * Returns the position of the node among the elements of its parent,
+   * counted when the parent was created
+   * @return 1 for the first element child, 2 for the next, and so on; 1 for
+   *         a root element, the only child of its document; 0 for a text or
+   *         comment node
+   */
+  [[nodiscard]] auto siblingIndex() const -> uint32_t;
+
   /**
    * Accepts a visitor to the node
    * @param visitor accepted visitor
@@ -89,9 +107,14 @@ class Node {
    * Clone the Node to a unique pointer
    * @return cloned Node
    */
-  virtual auto clone() -> NodePtr = 0;
+  virtual auto clone() const -> NodePtr = 0;
+
+ protected:
+  uint32_t index = 0;  // kept by clones, so that a cloned subtree matches alike
 
  private:
+  friend class ElementNode;  // numbers its children
+
   std::string tag;
 };
 
@@ -130,7 +153,7 @@ class TextNode : public Node {
    * Clone the Text Node to a unique pointer
    * @return cloned Node
    */
-  auto clone() -> NodePtr override;
+  auto clone() const -> NodePtr override;
 
   std::string text;
 };
@@ -170,7 +193,7 @@ class CommentNode : public Node {
    * Clone the Comment Node to a unique pointer
    * @return cloned Node
    */
-  auto clone() -> NodePtr override;
+  auto clone() const -> NodePtr override;
 
   std::string comment;
 };
@@ -203,6 +226,18 @@ class ElementNode : public Node {
    */
   [[nodiscard]] auto getChildren() const -> NodeVector;
 
+  /**
+   * Borrows children nodes without cloning them
+   * @return reference to children nodes
+   */
+  [[nodiscard]] auto borrowChildren() const -> const NodeVector&;
+
+  /**
+   * Borrows attributes without copying them
+   * @return reference to attributes
+   */
+  [[nodiscard]] auto borrowAttributes() const -> const AttributeMap&;
+
   /**
    * Returns pretty-printed attributes
    * @return attributes
@@ -232,7 +267,7 @@ class ElementNode : public Node {
    * Clone the Element Node to a unique pointer
    * @return cloned Node
    */
-  auto clone() -> NodePtr override;
+  auto clone() const -> NodePtr override;
 
   AttributeMap attributes;
   NodeVector children;
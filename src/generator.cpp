@@ -0,0 +1,250 @@
+// sherpa_41's Generator module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef GENERATOR_CPP
+#define GENERATOR_CPP
+
+#include "generator.h"
+
+#include <algorithm>
+
+/**
+ * Tags of generated elements
+ */
+static const std::vector<std::string> tags{"div", "p",  "section", "article",
+                                           "ul",  "li", "span",    "h1"};
+
+/**
+ * Words of generated text
+ */
+static const std::vector<std::string> words{"lorem", "ipsum", "dolor", "sit", "amet"};
+
+/**
+ * Creates a generator
+ * @param seed initial state
+ */
+Generator::Random::Random(uint64_t seed) : state(seed) {}
+
+/**
+ * Returns the next number of the SplitMix64 sequence
+ * @return pseudo-random number
+ */
+auto Generator::Random::next() -> uint64_t {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * Returns a number below a bound. The slight bias of the modulo does not
+ * matter for generating test input.
+ * @param bound exclusive upper bound, at least 1
+ * @return pseudo-random number in [0, bound)
+ */
+auto Generator::Random::below(uint64_t bound) -> uint64_t {
+  return bound > 1 ? next() % bound : 0;
+}
+
+/**
+ * Picks an index by weight
+ * @param weights relative weights, not all 0
+ * @return index of the picked weight
+ */
+auto Generator::Random::pick(const std::vector<uint64_t>& weights) -> uint64_t {
+  uint64_t total(0);
+  for (auto weight : weights) {
+    total += weight;
+  }
+  auto target = below(total);
+  for (uint64_t i = 0; i < weights.size(); ++i) {
+    if (target < weights[i]) {
+      return i;
+    }
+    target -= weights[i];
+  }
+  return 0;
+}
+
+/**
+ * Writes a document: a spine of nested elements, then elements attached to
+ * random elements with room for another child
+ * @param options shape of the document
+ * @return HTML source
+ */
+auto Generator::document(const Options& options) -> std::string {
+  struct Element {
+    uint64_t depth;
+    std::vector<uint64_t> children;
+  };
+
+  Random random(options.seed);
+  const auto depth = std::max<uint64_t>(options.depth, 1);
+  const auto fanOut = std::max<uint64_t>(options.fanOut, 1);
+  const auto nodes = std::max<uint64_t>(options.nodes, 1);
+
+  std::vector<Element> elements{Element{1, {}}};
+  auto attach = [&](uint64_t parent) {
+    elements[parent].children.push_back(elements.size());
+    elements.push_back(Element{elements[parent].depth + 1, {}});
+  };
+
+  for (uint64_t parent = 0; elements.size() < std::min(nodes, depth); ++parent) {
+    attach(parent);
+  }
+
+  std::vector<uint64_t> open;  // elements with room for another child
+  for (uint64_t i = 0; i < elements.size(); ++i) {
+    if (elements[i].depth < depth && elements[i].children.size() < fanOut) {
+      open.push_back(i);
+    }
+  }
+  while (elements.size() < nodes && !open.empty()) {
+    const auto slot = random.below(open.size());
+    const auto parent = open[slot];
+    attach(parent);
+    if (elements[parent].children.size() >= fanOut) {
+      open[slot] = open.back();
+      open.pop_back();
+    }
+    if (elements.back().depth < depth) {
+      open.push_back(elements.size() - 1);
+    }
+  }
+
+  std::string html;
+  auto write = [&](const auto& self, uint64_t index) -> void {
+    const auto tag = index == 0 ? std::string("html") : tags[random.below(tags.size())];
+    html += "<" + tag + " id=\"n" + std::to_string(index) + "\"";
+    const auto classCount = random.below(options.classesPerNode + 1);
+    if (classCount > 0 && options.classes > 0) {
+      html += " class=\"";
+      for (uint64_t i = 0; i < classCount; ++i) {
+        html += (i > 0 ? " c" : "c") + std::to_string(random.below(options.classes));
+      }
+      html += "\"";
+    }
+    html += ">";
+
+    const auto& children = elements[index].children;
+    if (children.empty()) {
+      html += words[random.below(words.size())];
+    }
+    for (auto child : children) {
+      self(self, child);
+    }
+    html += "</" + tag + ">";
+  };
+  write(write, 0);
+  return html;
+}
+
+/**
+ * Writes a style sheet of random rules over the tags, ids, and classes of the
+ * documents of the same options
+ * @param options shape of the style sheet
+ * @return CSS source
+ */
+auto Generator::stylesheet(const Options& options) -> std::string {
+  Random random(options.seed ^ 0x5eed5eed5eed5eedULL);
+  const auto& mix = options.selectors;
+  const std::vector<uint64_t> weights{mix.tag,        options.classes > 0 ? mix.klass : 0,
+                                      mix.id,         mix.universal,
+                                      mix.compound,   mix.combinator,
+                                      mix.structural};
+  const bool anySelector =
+      std::any_of(weights.begin(), weights.end(), [](uint64_t w) { return w > 0; });
+  const auto nodes = std::max<uint64_t>(options.nodes, 1);
+
+  auto tag = [&]() { return tags[random.below(tags.size())]; };
+  auto id = [&]() { return "#n" + std::to_string(random.below(nodes)); };
+  auto klass = [&]() { return ".c" + std::to_string(random.below(options.classes)); };
+  auto px = [&](uint64_t max) { return std::to_string(random.below(max + 1)) + "px"; };
+  auto color = [&]() {
+    static constexpr char hex[] = "0123456789abcdef";
+    std::string color("#");
+    for (int i = 0; i < 6; ++i) {
+      color += hex[random.below(16)];
+    }
+    return color;
+  };
+
+  std::string css("* { display: block; }\n");
+  for (uint64_t rule = 0; rule < options.rules && anySelector; ++rule) {
+    const auto selectorCount =
+        1 + random.below(std::max<uint64_t>(options.selectorsPerRule, 1));
+    for (uint64_t i = 0; i < selectorCount; ++i) {
+      css += i > 0 ? ", " : "";
+      switch (random.pick(weights)) {
+        case 0:
+          css += tag();
+          break;
+        case 1:
+          css += klass();
+          break;
+        case 2:
+          css += id();
+          break;
+        case 3:
+          css += "*";
+          break;
+        case 4:
+          css += tag();
+          if (random.below(2) == 0) {
+            css += id();
+          }
+          css += options.classes > 0 ? klass() : "";
+          css += options.classes > 0 && random.below(2) == 0 ? klass() : "";
+          break;
+        case 5:
+          css += options.classes > 0 ? klass() : tag();
+          css += random.below(2) == 0 ? " > " : " ";
+          css += tag();
+          break;
+        default:
+          switch (random.below(3)) {
+            case 0:
+              css += tag() + ":first-child";
+              break;
+            case 1:
+              css += tag();
+              css += ":nth-child(" + std::to_string(1 + random.below(3)) + "n+";
+              css += std::to_string(random.below(3)) + ")";
+              break;
+            default:
+              css += "[id=" + id().substr(1) + "]";
+              break;
+          }
+          break;
+      }
+    }
+
+    css += " {";
+    const auto declarations = 1 + random.below(3);
+    for (uint64_t i = 0; i < declarations; ++i) {
+      switch (random.below(6)) {
+        case 0:
+          css += " margin: " + px(8) + ";";
+          break;
+        case 1:
+          css += " padding: " + px(8) + ";";
+          break;
+        case 2:
+          css += " border-width: " + px(2) + ";";
+          break;
+        case 3:
+          css += " border-color: " + color() + ";";
+          break;
+        case 4:
+          css += " height: " + px(32) + ";";
+          break;
+        default:
+          css += " background: " + color() + ";";
+          break;
+      }
+    }
+    css += " }\n";
+  }
+  return css;
+}
+
+#endif
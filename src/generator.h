@@ -0,0 +1,108 @@
+// sherpa_41's Generator module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * The Generator module writes synthetic HTML documents and CSS style sheets
+ * of controllable shape and size, so that every stage of the pipeline can be
+ * measured as its input grows. Output depends only on the options, seed
+ * included: the same options write the same bytes on every platform.
+ *
+ * Documents are trees of elements drawn from a small vocabulary of tags.
+ * Every element has a unique id, `n<index>`, and classes drawn from a
+ * vocabulary of `c0` to `c<classes - 1>`; elements without children hold a
+ * word of text. Style sheets start with `* { display: block; }`, followed by
+ * rules whose selectors use the same tags, ids, and classes, so that they
+ * match the generated documents.
+ */
+namespace Generator {
+/**
+ * Relative weights of the kinds of selectors in generated rules
+ */
+struct SelectorMix {
+  uint64_t tag = 2;         // p
+  uint64_t klass = 4;       // .c3
+  uint64_t id = 1;          // #n12
+  uint64_t universal = 0;   // *
+  uint64_t compound = 2;    // p#n12.c3.c5
+  uint64_t combinator = 0;  // .c3 p, or .c3 > p
+  uint64_t structural = 0;  // p:first-child, p:nth-child(3n+1), or [id=n12]
+};
+
+/**
+ * Shape and size of a generated page
+ */
+struct Options {
+  uint64_t seed = 41;
+  uint64_t nodes = 256;           // elements in the document, root included
+  uint64_t depth = 8;             // maximum nesting of elements, root included
+  uint64_t fanOut = 8;            // maximum children of an element
+  uint64_t classes = 16;          // size of the class vocabulary
+  uint64_t classesPerNode = 2;    // maximum classes of an element
+  uint64_t rules = 64;            // rules in the style sheet, besides the first
+  uint64_t selectorsPerRule = 2;  // maximum selectors of a rule
+  SelectorMix selectors;
+};
+
+/**
+ * A deterministic pseudo-random number generator (SplitMix64). Unlike the
+ * standard distributions, its sequence is the same on every platform.
+ */
+class Random {
+ public:
+  Random() = delete;
+
+  /**
+   * Creates a generator
+   * @param seed initial state
+   */
+  explicit Random(uint64_t seed);
+
+  /**
+   * Returns the next number of the sequence
+   * @return pseudo-random number
+   */
+  auto next() -> uint64_t;
+
+  /**
+   * Returns a number below a bound
+   * @param bound exclusive upper bound, at least 1
+   * @return pseudo-random number in [0, bound)
+   */
+  auto below(uint64_t bound) -> uint64_t;
+
+  /**
+   * Picks an index by weight
+   * @param weights relative weights, not all 0
+   * @return index of the picked weight
+   */
+  auto pick(const std::vector<uint64_t>& weights) -> uint64_t;
+
+ private:
+  uint64_t state;
+};
+
+/**
+ * Writes a document. A spine of nested elements reaches the maximum depth
+ * (or the node count, if smaller); the remaining elements are attached to
+ * random elements with room for another child, until the node count is
+ * reached or no element has room.
+ * @param options shape of the document
+ * @return HTML source
+ */
+auto document(const Options& options) -> std::string;
+
+/**
+ * Writes a style sheet for the documents of the same options
+ * @param options shape of the style sheet
+ * @return CSS source
+ */
+auto stylesheet(const Options& options) -> std::string;
+}  // namespace Generator
+
+#endif
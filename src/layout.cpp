@@ -5,22 +5,26 @@
 
 #include "layout.h"
 
-#include "css.h"
+#include <algorithm>
 
-auto Layout::stodisplay(const std::string& s) -> Layout::DisplayType {
-  if (s == "block") {
-    return Block;
-  }
-  if (s == "inline") {
-    return Inline;
-  } else {
-    return None;
+#include "css.h"
+#include "trace.h"
+
+auto Layout::stodisplay(const CSS::Value& value) -> Layout::DisplayType {
+  switch (value.getKeyword()) {
+    case CSS::Keyword::Block:
+      return Block;
+    case CSS::Keyword::Inline:
+      return Inline;
+    default:
+      return None;
   }
 }
 
-auto Layout::snodetodisplay(const Style::StyledNode& node, const std::string& deflt)
+auto Layout::snodetodisplay(const Style::StyledNode& node, DisplayType deflt)
     -> Layout::DisplayType {
-  return Layout::stodisplay(node.value_or("display", CSS::TextValue(deflt))->print());
+  const auto display = node.value("display");
+  return display ? Layout::stodisplay(*display) : deflt;
 }
 
 /**
@@ -43,6 +47,40 @@ auto Layout::Rectangle::expand(const Layout::Edges& edge) const -> Layout::Recta
                    height + edge.top + edge.bottom);
 }
 
+/**
+ * Determines whether a rectangle lies entirely within *this rectangle
+ * @param rhs rectangle to check
+ * @return whether `rhs` is contained
+ */
+auto Layout::Rectangle::contains(const Layout::Rectangle& rhs) const -> bool {
+  return rhs.origin.x >= origin.x && rhs.origin.y >= origin.y &&
+         rhs.origin.x + rhs.width <= origin.x + width &&
+         rhs.origin.y + rhs.height <= origin.y + height;
+}
+
+/**
+ * Determines whether a rectangle overlaps *this rectangle
+ * @param rhs rectangle to check
+ * @return whether the rectangles share any area
+ */
+auto Layout::Rectangle::intersects(const Layout::Rectangle& rhs) const -> bool {
+  return rhs.origin.x < origin.x + width && origin.x < rhs.origin.x + rhs.width &&
+         rhs.origin.y < origin.y + height && origin.y < rhs.origin.y + rhs.height;
+}
+
+/**
+ * Computes the smallest rectangle enclosing *this and another rectangle
+ * @param rhs rectangle to enclose
+ * @return bounding rectangle
+ */
+auto Layout::Rectangle::unite(const Layout::Rectangle& rhs) const -> Layout::Rectangle {
+  const auto x0 = std::min(origin.x, rhs.origin.x);
+  const auto y0 = std::min(origin.y, rhs.origin.y);
+  const auto x1 = std::max(origin.x + width, rhs.origin.x + rhs.width);
+  const auto y1 = std::max(origin.y + height, rhs.origin.y + rhs.height);
+  return Rectangle(x0, y0, x1 - x0, y1 - y0);
+}
+
 /**
  * Creates edge dimensions
  * @param top top edge width
@@ -95,16 +133,65 @@ auto Layout::BoxDimensions::marginArea() const -> Layout::Rectangle {
   return borderArea().expand(margin);
 }
 
+/**
+ * Creates a length from a style value. `auto` is kept as such, and any other
+ * value that is not a length is 0px.
+ * @param value style value
+ * @param node styled node of the value, whose font sizes resolve any `em` or
+ *        `rem` it was not styled with
+ * @return length
+ */
+auto Layout::Length::from(const CSS::Value& value, const Style::StyledNode& node)
+    -> Layout::Length {
+  Length length;
+  if (value.getType() == CSS::Value::Length) {
+    length.value = value.unitValue();
+    length.unit = value.getUnit();
+    if (length.unit == CSS::em) {
+      length = Length{length.value * node.getFontSize(), CSS::px, false};
+    } else if (length.unit == CSS::rem) {
+      length = Length{length.value * node.getRootFontSize(), CSS::px, false};
+    }
+  } else {
+    length.automatic = value.getKeyword() == CSS::Keyword::Auto;
+  }
+  return length;
+}
+
+/**
+ * Resolves the length to px
+ * @param containerWidth width of the containing block, for percentages
+ * @param viewport viewport, for `vw` and `vh`
+ * @return length in px, or 0 if it is auto
+ */
+auto Layout::Length::resolve(double containerWidth, const Layout::Rectangle& viewport) const
+    -> double {
+  if (automatic) {
+    return 0;
+  }
+  switch (unit) {
+    case CSS::percent:
+      return value / 100 * containerWidth;
+    case CSS::vw:
+      return value / 100 * viewport.width;
+    case CSS::vh:
+      return value / 100 * viewport.height;
+    default:
+      return value;
+  }
+}
+
 /**
  * Creates an abstract Box
  * @param dimensions box dimensions
  * @param children box children
  */
 Layout::Box::Box(Layout::BoxDimensions dimensions, const Layout::BoxVector& children)
-    : dimensions(dimensions), children() {
+    : dimensions(dimensions), children(), extent(0, 0, 0, 0) {
   this->children.reserve(children.size());
   std::for_each(children.begin(), children.end(),
                 [this](const auto& child) { this->children.push_back(child->clone()); });
+  updateExtent();
 }
 
 /**
@@ -126,6 +213,44 @@ auto Layout::Box::getChildren() const -> Layout::BoxVector {
   return boxes;
 }
 
+/**
+ * Borrows box children without cloning them
+ * @return reference to children
+ */
+auto Layout::Box::borrowChildren() const -> const Layout::BoxVector& {
+  return children;
+}
+
+/**
+ * Returns the area painted by the box and all of its descendants
+ * @return subtree extent
+ */
+auto Layout::Box::getExtent() const -> Layout::Rectangle {
+  return extent;
+}
+
+/**
+ * Recomputes the subtree extent from the box's dimensions and its children's
+ * extents. Empty areas, such as those of boxes that were never laid out, are
+ * ignored.
+ */
+void Layout::Box::updateExtent() {
+  auto nonEmpty = [](const Rectangle& rect) { return rect.width > 0 && rect.height > 0; };
+
+  extent = dimensions.borderArea();
+  bool found = nonEmpty(extent);
+  for (const auto& child : children) {
+    const auto childExtent = child->getExtent();
+    if (nonEmpty(childExtent)) {
+      extent = found ? extent.unite(childExtent) : childExtent;
+      found = true;
+    }
+  }
+  if (!found) {
+    extent = Rectangle(0, 0, 0, 0);
+  }
+}
+
 /**
  * Creates a tree of boxes from a styled node root and a browser window
  * @param root styled node root
@@ -134,13 +259,15 @@ auto Layout::Box::getChildren() const -> Layout::BoxVector {
  */
 auto Layout::Box::from(const Style::StyledNode& root, Layout::BoxDimensions window)
     -> Layout::BoxPtr {
-  // layout algorithm assumes height is initially zero
-  // TODO: Store window height for vmin/vmax/% values
+  TRACE_SPAN("layout", "Box::from window");
+  // the window's height is kept for vh lengths, but the layout algorithm
+  // assumes height is initially zero
+  const Rectangle viewport(window.origin.x, window.origin.y, window.width, window.height);
   window.height = 0;
 
   auto rootBox = from(root);
   if (auto sRoot = dynamic_cast<StyledBox*>(rootBox.get())) {
-    sRoot->layout(window);
+    sRoot->layout(window, viewport);
   }
   return rootBox;
 }
@@ -156,17 +283,21 @@ auto Layout::Box::from(const Style::StyledNode& styledRoot) -> Layout::BoxPtr {
     return nullptr;
   }
 
-  StyledBox root(BoxDimensions(Rectangle(0, 0, 0, 0)), styledRoot, display);
-  auto children = styledRoot.getChildren();
+  // built in place, as cloning each subtree on the way up would copy it once
+  // per ancestor
+  auto* root = new StyledBox(BoxDimensions(Rectangle(0, 0, 0, 0)), styledRoot, display);
+  BoxPtr box(root);
+  const auto& children = styledRoot.borrowChildren();
+  TRACE_SPAN_ARG("layout", "Box::from", "children", children.size());
 
   for (const auto& child : children) {
     auto cDisp = snodetodisplay(child);
     switch (cDisp) {
       case Block:
-        root.children.push_back(Box::from(child));
+        root->children.push_back(Box::from(child));
         break;
       case Inline:
-        root.getInlineContainer()->children.push_back(Box::from(child));
+        root->getInlineContainer()->children.push_back(Box::from(child));
         break;
       case None:
       default:
@@ -174,7 +305,7 @@ auto Layout::Box::from(const Style::StyledNode& styledRoot) -> Layout::BoxPtr {
     }
   }
 
-  return root.clone();
+  return box;
 }
 
 /**
@@ -190,7 +321,7 @@ Layout::AnonymousBox::AnonymousBox(const BoxVector& children)
  * @return cloned box
  */
 auto Layout::AnonymousBox::clone() const -> Layout::BoxPtr {
-  return BoxPtr(new AnonymousBox(getChildren()));
+  return BoxPtr(new AnonymousBox(borrowChildren()));
 }
 
 /**
@@ -204,14 +335,60 @@ Layout::StyledBox::StyledBox(Layout::BoxDimensions dimensions,
                              const Style::StyledNode& content,
                              Layout::DisplayType display,
                              const BoxVector& children)
-    : Box(dimensions, children), content(content), display(display) {}
+    : StyledBox(dimensions, content, display, children, lengthsOf(content)) {}
 
 /**
- * Clones a styled box
+ * Creates a styled box whose length styles were already looked up
+ * @param dimensions box dimensions
+ * @param content box content
+ * @param display display type
+ * @param children box children
+ * @param lengths length styles of the content
+ */
+Layout::StyledBox::StyledBox(Layout::BoxDimensions dimensions,
+                             const Style::StyledNode& content,
+                             Layout::DisplayType display,
+                             const BoxVector& children,
+                             const Lengths& lengths)
+    : Box(dimensions, children), content(content), display(display), lengths(lengths) {}
+
+/**
+ * Clones a styled box, sharing the lengths it looked up
  * @return styled box
  */
 auto Layout::StyledBox::clone() const -> Layout::BoxPtr {
-  return BoxPtr(new StyledBox(getDimensions(), content, display, getChildren()));
+  return BoxPtr(new StyledBox(getDimensions(), content, display, borrowChildren(), lengths));
+}
+
+/**
+ * Looks up the length styles of a styled node. Shorthands were expanded as
+ * they were parsed, so each is a single lookup of a longhand.
+ * @param content styled node
+ * @return length styles, auto or 0 if they are not set
+ */
+auto Layout::StyledBox::lengthsOf(const Style::StyledNode& content) -> Lengths {
+  auto length = [&content](const CSS::Value& value) { return Length::from(value, content); };
+  auto edges = [&content, &length](const std::array<std::string, 4>& names) {
+    return LengthEdges{length(content.value_or_zero(names[0])),
+                       length(content.value_or_zero(names[1])),
+                       length(content.value_or_zero(names[2])),
+                       length(content.value_or_zero(names[3]))};
+  };
+
+  Lengths lengths;
+  const auto width = content.value("width");
+  lengths.width = width ? length(*width) : Length{0, CSS::px, true};
+  lengths.height.automatic = true;
+  const auto height = content.value("height");
+  if (height && height->getType() == CSS::Value::Length) {
+    lengths.height = length(*height);
+  }
+  lengths.margin = edges({"margin-top", "margin-left", "margin-bottom", "margin-right"});
+  lengths.padding =
+      edges({"padding-top", "padding-left", "padding-bottom", "padding-right"});
+  lengths.border = edges({"border-top-width", "border-left-width", "border-bottom-width",
+                          "border-right-width"});
+  return lengths;
 }
 
 /**
@@ -222,26 +399,50 @@ auto Layout::StyledBox::getContent() const -> Style::StyledNode {
   return content;
 }
 
+/**
+ * Borrows content without cloning it
+ * @return reference to content of styled node
+ */
+auto Layout::StyledBox::borrowContent() const -> const Style::StyledNode& {
+  return content;
+}
+
+/**
+ * Returns display type
+ * @return display type
+ */
+auto Layout::StyledBox::getDisplay() const -> Layout::DisplayType {
+  return display;
+}
+
 /**
  * Lays out a block and its children
  * @param container parent container dimensions
+ * @param viewport browser window
  */
-void Layout::StyledBox::layout(const Layout::BoxDimensions& container) {
+void Layout::StyledBox::layout(const Layout::BoxDimensions& container,
+                               const Layout::Rectangle& viewport) {
+  TRACE_SPAN_ARG("layout", "StyledBox::layout", "children", children.size());
   switch (display) {
     case Block:
-      setBlockLayout(container);
+      setBlockLayout(container, viewport);
       break;
     case Inline:
     case None:
     default:
       break;
   }
+  updateExtent();
 }
 
-void Layout::StyledBox::layoutChildren() {
-  std::for_each(children.begin(), children.end(), [this](BoxPtr& child) {
+/**
+ * Lays out *this box's children, updating *this box's height
+ * @param viewport browser window
+ */
+void Layout::StyledBox::layoutChildren(const Layout::Rectangle& viewport) {
+  std::for_each(children.begin(), children.end(), [this, &viewport](BoxPtr& child) {
     if (auto styledChild = dynamic_cast<StyledBox*>(child.get())) {
-      styledChild->layout(dimensions);
+      styledChild->layout(dimensions, viewport);
 
       // parent height must be updated after each child is laid out so
       // block children are stacked below each other
@@ -253,106 +454,100 @@ void Layout::StyledBox::layoutChildren() {
 /**
  * Lays out a box with block display type and its children
  * @param container parent container dimensions
+ * @param viewport browser window
  */
-void Layout::StyledBox::setBlockLayout(const Layout::BoxDimensions& container) {
-  setWidth(container);     // determine width from parent
-  setPosition(container);  // determine position inside parent
-  layoutChildren();
-  setHeight();  // height depends on children
+void Layout::StyledBox::setBlockLayout(const Layout::BoxDimensions& container,
+                                       const Layout::Rectangle& viewport) {
+  setWidth(container, viewport);     // determine width from parent
+  setPosition(container, viewport);  // determine position inside parent
+  layoutChildren(viewport);
+  setHeight(viewport);  // height depends on children
 }
 
 /**
  * Calculates and sets box width based off parent
  * @param container parent container dimensions
+ * @param viewport browser window
  */
-void Layout::StyledBox::setWidth(const Layout::BoxDimensions& container) {
-  auto width = content.value_or("width", CSS::TextValue("auto"));
-
-  auto marginLeft = content.value_or_zero("margin-left", "margin");
-  auto marginRight = content.value_or_zero("margin-right", "margin");
-  auto paddingLeft = content.value_or_zero("padding-left", "padding");
-  auto paddingRight = content.value_or_zero("padding-right", "padding");
-  auto borderLeft = content.value_or_zero("border-left-width", "border-width");
-  auto borderRight = content.value_or_zero("border-right-width", "border-width");
-
-  double totalWidth(0);
-  for (const auto& dim : {&width, &marginLeft, &marginRight, &paddingLeft, &paddingRight,
-                          &borderLeft, &borderRight}) {
-    totalWidth += (*dim)->unitValue();
-  }
-
-  auto zero = CSS::make_value(CSS::UnitValue(0, CSS::px));
+void Layout::StyledBox::setWidth(const Layout::BoxDimensions& container,
+                                 const Layout::Rectangle& viewport) {
+  auto resolve = [&container, &viewport](const Length& length) {
+    return length.resolve(container.width, viewport);
+  };
+  double width = resolve(lengths.width);
+  double marginLeft = resolve(lengths.margin.left);
+  double marginRight = resolve(lengths.margin.right);
+  const double paddingLeft = resolve(lengths.padding.left);
+  const double paddingRight = resolve(lengths.padding.right);
+  const double borderLeft = resolve(lengths.border.left);
+  const double borderRight = resolve(lengths.border.right);
+
+  const double totalWidth = width + marginLeft + marginRight + paddingLeft + paddingRight +
+                            borderLeft + borderRight;
+
+  bool autoW = lengths.width.automatic, autoML = lengths.margin.left.automatic,
+       autoMR = lengths.margin.right.automatic;
 
   // if box is too big and width is not auto, zero the margins
-  if (totalWidth > container.width && !width->is("auto")) {
-    if (marginLeft->is("auto")) {
-      marginLeft = zero->clone();
-    }
-    if (marginRight->is("auto")) {
-      marginRight = zero->clone();
-    }
+  if (totalWidth > container.width && !autoW) {
+    autoML = false;
+    autoMR = false;
   }
 
   // calculate box underflow
   double underflow = container.width - totalWidth;
-  bool autoW = width->is("auto"), autoML = marginLeft->is("auto"),
-       autoMR = marginRight->is("auto");
 
   // Eliminate under/overflow by adjusting expandable (auto) dimensions
   if (!autoW && !autoML && !autoMR) {  // all dimensions constrained, update
                                        // right margin
-    marginRight =
-        CSS::make_value(CSS::UnitValue(marginRight->unitValue() + underflow, CSS::px));
+    marginRight += underflow;
   } else if (!autoW && !autoML) {  // only right margin adjustable
-    marginRight = CSS::make_value(CSS::UnitValue(underflow, CSS::px));
+    marginRight = underflow;
   } else if (!autoW && !autoMR) {  // only left margin adjustable
-    marginLeft = CSS::make_value(CSS::UnitValue(underflow, CSS::px));
-  } else if (autoW) {  // width is auto, zero other auto dimensions
-    if (autoML) {
-      marginLeft = zero->clone();
-    }
-    if (autoMR) {
-      marginRight = zero->clone();
-    }
-
+    marginLeft = underflow;
+  } else if (autoW) {  // width is auto, auto margins are already zero
     if (underflow >= 0) {  // set width to fit underflow
-      width = CSS::make_value(CSS::UnitValue(underflow, CSS::px));
+      width = underflow;
     } else {  // with overflow, adjust right margin
-      width = zero->clone();
-      marginRight =
-          CSS::make_value(CSS::UnitValue(marginRight->unitValue() + underflow, CSS::px));
+      width = 0;
+      marginRight += underflow;
     }
   } else {  // only margins are adjustable, make them evenly split underflow
-    marginLeft = CSS::make_value(CSS::UnitValue(underflow / 2, CSS::px));
-    marginRight = CSS::make_value(CSS::UnitValue(underflow / 2, CSS::px));
+    marginLeft = underflow / 2;
+    marginRight = underflow / 2;
   }
 
   // store computed values
-  dimensions.width = width->unitValue();
-  dimensions.margin.left = marginLeft->unitValue();
-  dimensions.margin.right = marginRight->unitValue();
-  dimensions.padding.left = paddingLeft->unitValue();
-  dimensions.padding.right = paddingRight->unitValue();
-  dimensions.border.left = borderLeft->unitValue();
-  dimensions.border.right = borderRight->unitValue();
+  dimensions.width = width;
+  dimensions.margin.left = marginLeft;
+  dimensions.margin.right = marginRight;
+  dimensions.padding.left = paddingLeft;
+  dimensions.padding.right = paddingRight;
+  dimensions.border.left = borderLeft;
+  dimensions.border.right = borderRight;
 }
 
 /**
  * Positions the box within its parent container using widths and parent
- * dimensions
+ * dimensions. Vertical percentages are, as horizontal ones, of the
+ * container's width.
  * @param container parent container dimensions
+ * @param viewport browser window
  */
-void Layout::StyledBox::setPosition(const Layout::BoxDimensions& container) {
-  const auto& c = content;
+void Layout::StyledBox::setPosition(const Layout::BoxDimensions& container,
+                                    const Layout::Rectangle& viewport) {
+  auto resolve = [&container, &viewport](const Length& length) {
+    return length.resolve(container.width, viewport);
+  };
   auto& d = dimensions;
 
   // transfer styles
-  d.margin.top = c.value_or_zero("margin-top", "margin")->unitValue();
-  d.margin.bottom = c.value_or_zero("margin-bottom", "margin")->unitValue();
-  d.padding.top = c.value_or_zero("padding-top", "padding")->unitValue();
-  d.padding.bottom = c.value_or_zero("padding-bottom", "padding")->unitValue();
-  d.border.top = c.value_or_zero("border-top-width", "border-width")->unitValue();
-  d.border.bottom = c.value_or_zero("border-bottom-width", "border-width")->unitValue();
+  d.margin.top = resolve(lengths.margin.top);
+  d.margin.bottom = resolve(lengths.margin.bottom);
+  d.padding.top = resolve(lengths.padding.top);
+  d.padding.bottom = resolve(lengths.padding.bottom);
+  d.border.top = resolve(lengths.border.top);
+  d.border.bottom = resolve(lengths.border.bottom);
 
   // set x-start coordinate
   d.origin.x = container.origin.x + d.margin.left + d.padding.left + d.border.left;
@@ -365,12 +560,13 @@ void Layout::StyledBox::setPosition(const Layout::BoxDimensions& container) {
 
 /**
  * Determines explicit height, or calculates height from children if no
- * explicit height is given
+ * explicit height is given. A percentage height is of a container whose
+ * height depends on its children, and so is auto.
+ * @param viewport browser window
  */
-void Layout::StyledBox::setHeight() {
-  auto heightPtr = content.value("height");
-  if (auto height = dynamic_cast<CSS::UnitValue*>(heightPtr.get())) {
-    dimensions.height = height->value;
+void Layout::StyledBox::setHeight(const Layout::Rectangle& viewport) {
+  if (!lengths.height.automatic && lengths.height.unit != CSS::percent) {
+    dimensions.height = lengths.height.resolve(0, viewport);
   }
 }
 
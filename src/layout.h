@@ -5,6 +5,7 @@
 
 #include <vector>
 
+#include "arena.h"
 #include "style.h"
 
 /**
@@ -24,14 +25,14 @@ class Box;
 struct Edges;
 
 using BoxPtr = std::unique_ptr<Box>;
-using BoxVector = std::vector<BoxPtr>;
+using BoxVector = Arena::Vector<BoxPtr>;
 
 /**
  * Block display types
  */
 enum DisplayType { Block, Inline, None };
-auto stodisplay(const std::string& s) -> DisplayType;
-auto snodetodisplay(const Style::StyledNode& node, const std::string& deflt = "inline")
+auto stodisplay(const CSS::Value& value) -> DisplayType;
+auto snodetodisplay(const Style::StyledNode& node, DisplayType deflt = Inline)
     -> DisplayType;
 
 /**
@@ -64,6 +65,27 @@ struct Rectangle {
    */
   [[nodiscard]] auto expand(const Edges& edge) const -> Rectangle;
 
+  /**
+   * Determines whether a rectangle lies entirely within *this rectangle
+   * @param rhs rectangle to check
+   * @return whether `rhs` is contained
+   */
+  [[nodiscard]] auto contains(const Rectangle& rhs) const -> bool;
+
+  /**
+   * Determines whether a rectangle overlaps *this rectangle
+   * @param rhs rectangle to check
+   * @return whether the rectangles share any area
+   */
+  [[nodiscard]] auto intersects(const Rectangle& rhs) const -> bool;
+
+  /**
+   * Computes the smallest rectangle enclosing *this and another rectangle
+   * @param rhs rectangle to enclose
+   * @return bounding rectangle
+   */
+  [[nodiscard]] auto unite(const Rectangle& rhs) const -> Rectangle;
+
   Coordinates origin;
   double width, height;
 };
@@ -130,6 +152,44 @@ struct BoxDimensions {
   Edges margin, padding, border;
 };
 
+/**
+ * A length style of a box, looked up once when the box is created. Lengths
+ * relative to the font were resolved to px by the Style module; percentages,
+ * of the containing block's width, and viewport units are resolved at layout.
+ */
+struct Length {
+ public:
+  /**
+   * Creates a length from a style value. `auto` is kept as such, and any
+   * other value that is not a length is 0px.
+   * @param value style value
+   * @param node styled node of the value, whose font sizes resolve any `em`
+   *        or `rem` it was not styled with
+   * @return length
+   */
+  static auto from(const CSS::Value& value, const Style::StyledNode& node) -> Length;
+
+  /**
+   * Resolves the length to px
+   * @param containerWidth width of the containing block, for percentages
+   * @param viewport viewport, for `vw` and `vh`
+   * @return length in px, or 0 if it is auto
+   */
+  [[nodiscard]] auto resolve(double containerWidth, const Rectangle& viewport) const
+      -> double;
+
+  double value = 0;
+  CSS::Unit unit = CSS::px;
+  bool automatic = false;
+};
+
+/**
+ * Length styles of the edges of a box
+ */
+struct LengthEdges {
+  Length top, left, bottom, right;
+};
+
 /**
  * An abstract base Box that describes any other layout box in the Layout Tree
  */
@@ -156,6 +216,19 @@ class Box {
    */
   [[nodiscard]] auto getChildren() const -> BoxVector;
 
+  /**
+   * Borrows box children without cloning them
+   * @return reference to children
+   */
+  [[nodiscard]] auto borrowChildren() const -> const BoxVector&;
+
+  /**
+   * Returns the area painted by the box and all of its descendants, that is
+   * the union of their non-empty border areas
+   * @return subtree extent
+   */
+  [[nodiscard]] auto getExtent() const -> Rectangle;
+
   /**
    * Clones a box into a unique_ptr
    * @return cloned box
@@ -178,8 +251,15 @@ class Box {
   static auto from(const Style::StyledNode& root) -> BoxPtr;
 
  protected:
+  /**
+   * Recomputes the subtree extent from the box's dimensions and its children's
+   * extents
+   */
+  void updateExtent();
+
   BoxDimensions dimensions;
   BoxVector children;
+  Rectangle extent;
 };
 
 /**
@@ -244,42 +324,89 @@ class StyledBox : public Box {
    */
   [[nodiscard]] auto getContent() const -> Style::StyledNode;
 
+  /**
+   * Borrows content without cloning it
+   * @return reference to content of styled node
+   */
+  [[nodiscard]] auto borrowContent() const -> const Style::StyledNode&;
+
+  /**
+   * Returns display type
+   * @return display type
+   */
+  [[nodiscard]] auto getDisplay() const -> DisplayType;
+
  private:
+  /**
+   * Length styles of a box
+   */
+  struct Lengths {
+    Length width, height;
+    LengthEdges margin, padding, border;
+  };
+
+  /**
+   * Creates a styled box whose length styles were already looked up
+   * @param dimensions box dimensions
+   * @param content box content
+   * @param display display type
+   * @param children box children
+   * @param lengths length styles of the content
+   */
+  StyledBox(BoxDimensions dimensions,
+            const Style::StyledNode& content,
+            DisplayType display,
+            const BoxVector& children,
+            const Lengths& lengths);
+
+  /**
+   * Looks up the length styles of a styled node
+   * @param content styled node
+   * @return length styles, auto or 0 if they are not set
+   */
+  static auto lengthsOf(const Style::StyledNode& content) -> Lengths;
+
   /**
    * Lays out a box and its children
    * @param container parent container dimensions
+   * @param viewport browser window
    */
-  void layout(const BoxDimensions& container);
+  void layout(const BoxDimensions& container, const Rectangle& viewport);
 
   /**
    * Lays out *this box's children, updating *this box's height
+   * @param viewport browser window
    */
-  void layoutChildren();
+  void layoutChildren(const Rectangle& viewport);
 
   /**
    * Lays out a box with block display type and its children
    * @param container parent container dimensions
+   * @param viewport browser window
    */
-  void setBlockLayout(const BoxDimensions& container);
+  void setBlockLayout(const BoxDimensions& container, const Rectangle& viewport);
 
   /**
    * Calculates and sets box width based off parent
    * @param container parent container dimensions
+   * @param viewport browser window
    */
-  void setWidth(const BoxDimensions& container);
+  void setWidth(const BoxDimensions& container, const Rectangle& viewport);
 
   /**
    * Positions the box within its parent container using widths and parent
    * dimensions
    * @param container parent container dimensions
+   * @param viewport browser window
    */
-  void setPosition(const BoxDimensions& container);
+  void setPosition(const BoxDimensions& container, const Rectangle& viewport);
 
   /**
    * Determines explicit height, or calculates height from children if no
    * explicit height is given
+   * @param viewport browser window
    */
-  void setHeight();
+  void setHeight(const Rectangle& viewport);
 
   /**
    * Get the box an inline node should go into, or a create a new one
@@ -289,6 +416,7 @@ class StyledBox : public Box {
 
   Style::StyledNode content;
   DisplayType display;
+  Lengths lengths;
 
   friend Box;
 };
@@ -1,19 +1,31 @@
 // The sherpa_41 browser engine, licensed under MIT. (c) hafiz, 2019
 
+#ifdef HAVE_MAGICK
 #include <Magick++.h>
+#endif
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <memory_resource>
 #include <sstream>
 #include <stdexcept>
 #include <unordered_map>
 
+#include "arena.h"
+#include "batch.h"
 #include "layout.h"
 #include "parser/args.h"
 #include "parser/css.h"
 #include "parser/html.h"
+#include "parser/manifest.h"
 #include "renderer/canvas.h"
+#include "renderer/encoder.h"
+#include "server.h"
+#include "stats.h"
 #include "style.h"
+#include "trace.h"
 #include "visitor/printer.h"
 
 auto inline odefault(const std::string& option) -> const std::string& {
@@ -22,6 +34,9 @@ auto inline odefault(const std::string& option) -> const std::string& {
       {"--css", "examples/sherpa-webpage.css"},
       {"--width", "2880"},
       {"--height", "1620"},
+      {"--scroll", "0"},
+      {"--strip-height", "0"},
+      {"--jobs", "0"},
       {"--out", "output.png"},
   };
   return defaults[option];
@@ -42,7 +57,20 @@ auto help() -> std::string {
        << deftext("--width");
   help << "        -H, --height <size>       Browser height, in pixels "
        << deftext("--height");
+  help << "        -Y, --scroll <px>         Vertical scroll offset, in pixels "
+       << deftext("--scroll");
+  help << "        --strip-height <px>       Render whole page as tiles of this height "
+       << deftext("--strip-height");
   help << "        -o, --out <file>          Output file " << deftext("--out");
+  help << "        --batch <manifest>        Render every job of a JSONL or TSV manifest\n";
+  help << "        -j, --jobs <count>        Batch worker threads, 0 for one per core "
+       << deftext("--jobs");
+  help << "        --parse-cache <dir>       Keep parsed sources of batches and servers\n";
+  help << "        --serve <socket>          Serve renders on a Unix socket until killed\n";
+  help << "        --connect <socket>        Render through a running server\n";
+  help << "        --stats                   Print the time and work of each render stage\n";
+  help << "        --stats-json <file>       Write render stage stats as JSON, or - to print\n";
+  help << "        --trace <file>            Write a Chrome trace, if built with TRACE\n";
   help << "        -h, --help                Show this help screen";
 
   return help.str();
@@ -77,46 +105,355 @@ auto getArg(const std::string& Long, const std::string& Short = "") -> const std
   }
 }
 
-auto main(int argc, char** argv) -> int {
-  auto& args = ArgsParser::instance(argc, argv);
+/**
+ * Numbers an output file name for one tile of a page, before its extension
+ * @param output output file name
+ * @param index tile index
+ * @return tile file name, e.g. "out-3.png" for "out.png"
+ */
+auto tileName(const std::string& output, uint64_t index) -> std::string {
+  auto dot = output.find_last_of('.');
+  auto slash = output.find_last_of('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    dot = output.size();
+  }
+  return output.substr(0, dot) + "-" + std::to_string(index) + output.substr(dot);
+}
 
-  if (args.cmdOptionExists("-h") || args.cmdOptionExists("--help")) {
-    std::cout << "A trivial browser engine.\n\n";
-    std::cout << help() << "\n";
-    return 0;
+/**
+ * Encodes RGBA pixels into an image file with Magick++, for formats without a
+ * built-in encoder. Magick++ is only initialized the first time it is needed.
+ * @param file file to write
+ * @param width image width
+ * @param height image height
+ * @param pixels RGBA pixels, row by row
+ */
+void writeImage(const std::string& file,
+                uint64_t width,
+                uint64_t height,
+                const uint8_t* pixels) {
+#ifdef HAVE_MAGICK
+  static bool initialized(false);
+  if (!initialized) {
+    Magick::InitializeMagick(nullptr);
+    initialized = true;
+  }
+
+  Magick::Image im;
+  im.read(width, height, "RGBA", Magick::CharPixel, pixels);
+  im.write(file);
+#else
+  (void)width, (void)height, (void)pixels;
+  throw std::invalid_argument("Cannot write " + file + " without Magick++");
+#endif
+}
+
+/**
+ * Renders every job of a manifest, then prints a summary of the run
+ * @param manifest manifest file to read jobs from
+ * @param workers number of worker threads, or 0 for one per hardware thread
+ * @param cacheDirectory directory to keep parsed sources in, or empty
+ * @return exit status; nonzero if any job failed
+ */
+auto runBatch(const std::string& manifest,
+              uint64_t workers,
+              const std::string& cacheDirectory) -> int {
+  std::ifstream file{manifest};
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+
+  Batch::JobVector jobs;
+  try {
+    jobs = ManifestParser(buffer.str()).evaluate();
+  } catch (const std::invalid_argument& exc) {
+    std::cout << "ERROR: " << exc.what() << "\n";
+    return 1;
+  }
+
+  Batch::Runner runner(workers, cacheDirectory);
+  auto summary = runner.run(jobs, std::cout);
+
+  std::cout << "\n"
+            << summary.succeeded << " rendered, " << summary.failed << " failed, "
+            << summary.stylesheets << " style sheets parsed in " << summary.seconds << " s\n"
+            << summary.throughput() << " documents/s, "
+            << static_cast<double>(summary.pixels) / 1e6 / summary.seconds << " Mpx/s\n";
+  return summary.failed > 0 ? 1 : 0;
+}
+
+/**
+ * Reports the measurements of a render, as asked for by `--stats` and
+ * `--stats-json`
+ * @param stats measurements to report
+ */
+void reportStats(const Stats::Report& stats) {
+  auto& args = ArgsParser::instance();
+  if (args.cmdOptionExists("--stats")) {
+    std::cout << "\n";
+    stats.print(std::cout);
+  }
+  if (args.cmdOptionExists("--stats-json")) {
+    const auto& path = getArg("--stats-json");
+    if (path == "-") {
+      stats.json(std::cout);
+    } else {
+      std::ofstream file(path);
+      stats.json(file);
+    }
+  }
+}
+
+#ifndef _WIN32
+/**
+ * Serves renders on a Unix domain socket until the process is killed
+ * @param path path of the socket
+ * @param cacheDirectory directory to keep parsed sources in, or empty
+ * @return exit status
+ */
+auto runServer(const std::string& path, const std::string& cacheDirectory) -> int {
+  try {
+    Server::RenderServer server(path, Server::RenderServer::canvasCacheSize, cacheDirectory);
+    std::cout << "Serving on " << path << "." << std::endl;
+    server.serve();
+  } catch (const std::runtime_error& exc) {
+    std::cout << "ERROR: " << exc.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Renders a document through a server, writing the image it replies with. The
+ * image format is that of the output file.
+ * @param path path of the server's socket
+ * @param html HTML source
+ * @param css CSS source
+ * @param width browser width, in pixels
+ * @param height browser height, in pixels
+ * @param output output file
+ * @return exit status
+ */
+auto runClient(const std::string& path,
+               std::string html,
+               std::string css,
+               uint32_t width,
+               uint32_t height,
+               const std::string& output) -> int {
+  const auto dot = output.find_last_of('.');
+  std::string format(dot == std::string::npos ? "" : output.substr(dot + 1));
+  std::transform(format.begin(), format.end(), format.begin(), ::tolower);
+
+  Server::Response response;
+  try {
+    response = Server::RenderServer::request(
+        path, Server::Request{width, height, format, std::move(html), std::move(css)});
+  } catch (const std::runtime_error& exc) {
+    std::cout << "ERROR: " << exc.what() << "\n";
+    return 1;
+  }
+  if (!response.ok) {
+    std::cout << "ERROR: " << response.body << "\n";
+    return 1;
   }
 
+  std::ofstream file(output, std::ios::binary);
+  file.write(response.body.data(), static_cast<std::streamsize>(response.body.size()));
+  std::cout << "Output written to " << output << ".\n";
+  return 0;
+}
+#endif
+
+/**
+ * Runs the mode of operation the CLI asks for
+ * @return exit status
+ */
+auto run() -> int {
+  auto& args = ArgsParser::instance();
+  const std::string cacheDirectory{
+      args.cmdOptionExists("--parse-cache") ? getArg("--parse-cache") : ""};
+  if (args.cmdOptionExists("--batch")) {
+    return runBatch(getArg("--batch"), std::stoull(getArg("--jobs", "-j")), cacheDirectory);
+  }
+#ifndef _WIN32
+  if (args.cmdOptionExists("--serve")) {
+    return runServer(getArg("--serve"), cacheDirectory);
+  }
+#endif
+
   std::ifstream fhtml{getArg("--html")};
   std::ifstream fcss{getArg("--css")};
   std::string output{getArg("--out", "-o")};
   float width{std::stof(getArg("--width", "-W"))};
   float height{std::stof(getArg("--height", "-H"))};
+  float scroll{std::stof(getArg("--scroll", "-Y"))};
+  uint64_t stripHeight{std::stoull(getArg("--strip-height"))};
+
+#ifndef HAVE_MAGICK
+  if (!Encoder::supports(output)) {
+    std::cout << "ERROR: Only PNG, PPM, and PAM output is supported without Magick++\n";
+    return 1;
+  }
+#endif
 
   std::stringstream buffer;
   buffer << fhtml.rdbuf();
-  HTMLParser htmlParser(buffer.str());
+  const std::string html(buffer.str());
 
   buffer.clear();
   buffer.str(std::string());
   buffer << fcss.rdbuf();
-  CSSParser cssParser(buffer.str());
+  const std::string css(buffer.str());
+
+#ifndef _WIN32
+  if (args.cmdOptionExists("--connect")) {
+    return runClient(getArg("--connect"), html, css, static_cast<uint32_t>(width),
+                     static_cast<uint32_t>(height), output);
+  }
+#endif
 
+  Stats::Report stats;
   Layout::Rectangle frame(0., 0., width, height);
 
-  auto dom = htmlParser.evaluate();
-  auto stylesheet = cssParser.evaluate();
-  auto styledDom = Style::StyledNode::from(dom, stylesheet);
-  auto paintLayout = Layout::Box::from(styledDom, Layout::BoxDimensions(frame));
+  // each stage allocates its tree from an arena of its own, released once
+  // its output is destroyed; parsing frees little, so it never frees at all
+  std::pmr::monotonic_buffer_resource parseArena;
+  std::pmr::unsynchronized_pool_resource styleArena;
+  std::pmr::unsynchronized_pool_resource layoutArena;
+  std::pmr::monotonic_buffer_resource displayArena;
 
-  Magick::InitializeMagick(*argv);
+  auto dom = stats.measure("parse-html", [&]() {
+    const Arena::Scope scope(&parseArena);
+    return HTMLParser(html).evaluate();
+  });
+  auto stylesheet = stats.measure("parse-css", [&]() {
+    const Arena::Scope scope(&parseArena);
+    return CSSParser(css).evaluate();
+  });
+  auto styledDom = stats.measure("style", [&]() {
+    const Arena::Scope scope(&styleArena);
+    return Style::StyledNode::from(*dom, stylesheet);
+  });
+  auto paintLayout = stats.measure("layout", [&]() {
+    const Arena::Scope scope(&layoutArena);
+    return Layout::Box::from(styledDom, Layout::BoxDimensions(frame));
+  });
+  stats.count("nodes", Stats::countNodes(*dom));
+  stats.count("style structs", Stats::countStyleStructs(styledDom));
+  stats.count("boxes", Stats::countBoxes(*paintLayout));
 
-  Canvas canvas(frame, paintLayout);
+  const auto pixelWidth = static_cast<uint64_t>(width);
+  const auto pixelHeight = static_cast<uint64_t>(height);
 
-  Magick::Image im;
-  im.read(static_cast<uint64_t>(width), static_cast<uint64_t>(height), "RGBA",
-          Magick::CharPixel, canvas.getPixels().data());
+  if (stripHeight > 0) {
+    // one strip-sized canvas is scrolled down the page, so memory use is
+    // bounded by the strip rather than the page
+    const auto extent = paintLayout->getExtent();
+    const auto pageHeight = static_cast<uint64_t>(
+        std::max<double>(height, std::ceil(extent.origin.y + extent.height)));
+    Canvas strip(pixelWidth, stripHeight);
+    uint64_t commands(0);
+    auto scrollStrip = [&](uint64_t y) {
+      const Layout::Rectangle viewport(0, static_cast<double>(y),
+                                       static_cast<double>(pixelWidth),
+                                       static_cast<double>(stripHeight));
+      auto list = stats.measure("display", [&]() {
+        const Arena::Scope scope(&displayArena);
+        return Display::DisplayList::from(paintLayout, viewport);
+      });
+      commands += list.size();
+      stats.measure("raster",
+                    [&]() { strip.scrollTo(std::move(list), 0, static_cast<double>(y)); });
+      // the strip's display list is painted and gone
+      displayArena.release();
+    };
 
-  im.write(output);
+    if (Encoder::supports(output)) {
+      // strips are streamed into one image
+      std::ofstream file(output, std::ios::binary);
+      auto encoder = Encoder::from(output, file, pixelWidth, pageHeight);
+      for (uint64_t y = 0; y < pageHeight; y += stripHeight) {
+        scrollStrip(y);
+        stats.measure("encode", [&]() {
+          strip.encode(*encoder, std::min(stripHeight, pageHeight - y));
+        });
+      }
+      stats.measure("encode", [&]() { encoder->finish(); });
+      stats.count("commands", commands);
+
+      std::cout << "Output written to " << output << ".\n";
+      reportStats(stats);
+      return 0;
+    }
+
+    // otherwise each strip is written as a separate tile
+    uint64_t tiles(0);
+    for (uint64_t y = 0; y < pageHeight; y += stripHeight, ++tiles) {
+      scrollStrip(y);
+      stats.measure("encode", [&]() {
+        writeImage(tileName(output, tiles), pixelWidth,
+                   std::min(stripHeight, pageHeight - y), strip.view().data);
+      });
+    }
+    stats.count("commands", commands);
+
+    std::cout << tiles << " tiles written to " << tileName(output, 0) << " onwards.\n";
+    reportStats(stats);
+    return 0;
+  }
+
+  const Layout::Rectangle viewport(0., scroll, static_cast<double>(pixelWidth),
+                                   static_cast<double>(pixelHeight));
+  auto list = stats.measure("display", [&]() {
+    const Arena::Scope scope(&displayArena);
+    return Display::DisplayList::from(paintLayout, viewport);
+  });
+  stats.count("commands", list.size());
+  auto canvas = stats.measure("raster", [&]() {
+    Canvas canvas(pixelWidth, pixelHeight);
+    canvas.scrollTo(std::move(list), 0., scroll);
+    return canvas;
+  });
+
+  stats.measure("encode", [&]() {
+    if (Encoder::supports(output)) {
+      std::ofstream file(output, std::ios::binary);
+      auto encoder = Encoder::from(output, file, pixelWidth, pixelHeight);
+      canvas.encode(*encoder);
+      encoder->finish();
+    } else {
+      writeImage(output, pixelWidth, pixelHeight, canvas.view().data);
+    }
+  });
 
   std::cout << "Output written to " << output << ".\n";
+  reportStats(stats);
+  return 0;
+}
+
+auto main(int argc, char** argv) -> int {
+  auto& args = ArgsParser::instance(argc, argv);
+
+  if (args.cmdOptionExists("-h") || args.cmdOptionExists("--help")) {
+    std::cout << "A trivial browser engine.\n\n";
+    std::cout << help() << "\n";
+    return 0;
+  }
+
+  if (args.cmdOptionExists("--trace")) {
+#ifdef HAVE_TRACE
+    const auto& path = getArg("--trace");
+    Trace::start();
+    const auto status = run();
+    Trace::stop();
+
+    std::ofstream file(path);
+    Trace::write(file);
+    std::cout << "Trace written to " << path << ".\n";
+    return status;
+#else
+    std::cout << "ERROR: Tracing needs a build configured with -DTRACE=ON\n";
+    return 1;
+#endif
+  }
+  return run();
 }
@@ -7,21 +7,27 @@
 
 #include <algorithm>
 #include <functional>
+#include <stdexcept>
 
 #include "parser.cpp"
+#include "trace.h"
 
 /**
  * Creates a CSS Parser
  * @param css
  */
-CSSParser::CSSParser(std::string css) : Parser<CSS::StyleSheet>(std::move(css)) {}
+CSSParser::CSSParser(std::string css)
+    : Parser<CSS::StyleSheet>(std::move(css)),
+      identifiers(std::make_shared<CSS::Identifiers>()) {}
 
 /**
  * Parses CSS into engine-operable format
  * @return vector of parsed CSS rules
  */
 auto CSSParser::evaluate() -> CSS::StyleSheet {
+  TRACE_SPAN("parse", "CSSParser::evaluate");
   CSS::StyleSheet styles;
+  styles.identifiers = identifiers;
   while (true) {
     consume_whitespace();
     if (eof()) {
@@ -44,46 +50,171 @@ auto CSSParser::parseRule() -> CSS::Rule {
 }
 
 /**
- * Parses rule selectors of form `tag#id.class`
+ * Parses comma-separated rule selectors of form `tag#id.class > tag .class`
  * @return vector of Selectors
  */
 auto CSSParser::parseSelectors() -> CSS::PrioritySelectorSet {
   CSS::PrioritySelectorSet res;
-  CSS::Selector selector;
-  auto invalid = [this](char c) { return !std::isalnum(c) && !peek("_") && !peek("-"); };
-  bool ranOnce = false;
-  while (!eof()) {
+  auto selectorStart = [](char c) {
+    return std::isalnum(c) || c == '_' || c == '-' || c == '#' || c == '.' || c == '*' ||
+           c == '[' || c == ':';
+  };
+  while (true) {
     consume_whitespace();
-    if (peek("{")) {  // end of selectors
-      if (ranOnce) {
-        res.insert(selector);
-      }
+    if (eof() || peek("{")) {  // end of selectors
       return res;
-    } else if (peek(",")) {
-      consume(",");
-      break;
-    } else if (peek("#")) {  // id
+    } else if (peek(selectorStart)) {
+      res.insert(parseSelector());
+    } else {  // separating comma, or unsupported character
+      pushPtr();
+    }
+  }
+}
+
+/**
+ * Parses a selector: compound selectors joined by combinators. Whitespace
+ * between compounds is a descendant combinator.
+ * @return Selector, with the compounds before the last as its ancestors
+ */
+auto CSSParser::parseSelector() -> CSS::Selector {
+  auto selector = parseCompound();
+  while (true) {
+    const bool spaced = peek(cisspace) || peek("/*");
+    consume_whitespace();
+
+    CSS::Combinator combinator;
+    if (peek(">")) {
+      consume(">");
+      consume_whitespace();
+      combinator = CSS::Child;
+    } else if (spaced && !eof() && !peek(",") && !peek("{")) {
+      combinator = CSS::Descendant;
+    } else {
+      return selector;
+    }
+
+    // the selector so far becomes the nearest ancestor of the next compound
+    auto compound = parseCompound();
+    compound.ancestors = std::move(selector.ancestors);
+    selector.ancestors.clear();
+    selector.combinator = combinator;
+    compound.ancestors.insert(compound.ancestors.begin(), std::move(selector));
+    selector = std::move(compound);
+  }
+}
+
+/**
+ * Parses a compound selector of form `tag#id.class[attr]:first-child`, or `*`
+ * @return Selector without ancestors
+ */
+auto CSSParser::parseCompound() -> CSS::Selector {
+  CSS::Selector compound;
+  auto invalid = [this](char c) { return !std::isalnum(c) && !peek("_") && !peek("-"); };
+  while (!eof()) {
+    if (peek("#")) {  // id
       consume("#");
-      selector.id = build_until(invalid);
+      compound.id = build_until(invalid);
     } else if (peek(".")) {  // class
       consume(".");
-      selector.klass.push_back(build_until(invalid));
+      compound.klass.push_back(build_until(invalid));
     } else if (peek("*")) {  // universal selector
       consume("*");
-    } else {  // tag
-      selector.tag = build_until(invalid);
+    } else if (peek("[")) {  // attribute
+      compound.attributes.push_back(parseAttribute());
+    } else if (peek(":")) {  // pseudo-class
+      compound.pseudoClasses.push_back(parsePseudoClass());
+    } else if (!peek(invalid)) {  // tag
+      compound.tag = build_until(invalid);
+    } else {
+      break;
+    }
+  }
+  return compound;
+}
+
+/**
+ * Parses an attribute selector of form `[name]` or `[name=value]`, where the
+ * value may be quoted
+ * @return AttributeSelector
+ */
+auto CSSParser::parseAttribute() -> CSS::AttributeSelector {
+  auto invalid = [this](char c) { return !std::isalnum(c) && !peek("_") && !peek("-"); };
+  CSS::AttributeSelector attribute;
+  consume("[");
+  attribute.name = build_until(invalid);
+  consume_whitespace();
+  if (peek("=")) {
+    consume("=");
+    consume_whitespace();
+    attribute.match = CSS::Equals;
+    if (peek("\"") || peek("'")) {
+      const auto quote = std::string(1, next());
+      attribute.value = build_until([this, &quote](char) { return peek(quote); });
+      consume(quote);
+    } else {
+      attribute.value = build_until(invalid);
     }
-    ranOnce = true;
   }
+  // skip anything unsupported, such as the other operators of `[a~=b]`
+  build_until([this](char) { return peek("]") || peek("{"); });
+  if (peek("]")) {
+    consume("]");
+  }
+  return attribute;
+}
 
-  auto rest = parseSelectors();
-  res.insert(selector);
-  res.insert(rest.begin(), rest.end());
-  return res;
+/**
+ * Parses a pseudo-class of form `:first-child` or `:nth-child(an+b)`, where
+ * the argument may also be `odd` or `even`
+ * @return NthChild, matching nothing if the pseudo-class is not supported
+ */
+auto CSSParser::parsePseudoClass() -> CSS::NthChild {
+  auto invalid = [this](char c) { return !std::isalnum(c) && !peek("_") && !peek("-"); };
+  consume(":");
+  std::string name;
+  if (peek(":")) {  // a pseudo-element, such as `::before`, is not supported either
+    consume(":");
+    build_until(invalid);
+  } else {
+    name = build_until(invalid);
+  }
+  std::string argument;
+  if (peek("(")) {
+    consume("(");
+    argument = build_until([this](char) { return peek(")") || peek("{"); });
+    if (peek(")")) {
+      consume(")");
+    }
+  }
+  argument.erase(std::remove_if(argument.begin(), argument.end(), cisspace), argument.end());
+
+  if (name == "first-child") {
+    return {0, 1};
+  } else if (name != "nth-child") {
+    return {0, 0};
+  } else if (argument == "odd") {
+    return {2, 1};
+  } else if (argument == "even") {
+    return {2, 0};
+  }
+
+  try {
+    const auto n = argument.find('n');
+    if (n == std::string::npos) {
+      return {0, std::stoll(argument)};
+    }
+    const auto a = argument.substr(0, n);
+    const auto b = argument.substr(n + 1);
+    return {a.empty() || a == "+" ? 1 : a == "-" ? -1 : std::stoll(a),
+            b.empty() ? 0 : std::stoll(b)};
+  } catch (const std::logic_error&) {  // not of form an+b
+    return {0, 0};
+  }
 }
 
 /**
- * Parses rule declarations of form `{ rule: value; }`
+ * Parses rule declarations of form `{ rule: value; }`, expanding shorthands
+ * such as `{ margin: 1px 2px; }` into their longhands
  * @return vector of Declarations
  */
 auto CSSParser::parseDeclarations() -> CSS::DeclarationSet {
@@ -97,7 +228,17 @@ auto CSSParser::parseDeclarations() -> CSS::DeclarationSet {
     auto name = build_until([this](char c) { return !std::isalpha(c) && !peek("-"); });
     consume_whitespace(":");
     consume_whitespace();
-    declarations.emplace_back(CSS::Declaration(name, parseValue()));
+    std::vector<CSS::Value> values;
+    while (!eof() && !peek(";") && !peek("}")) {
+      values.push_back(parseValue());
+      if (values.back() == CSS::Value()) {  // nothing was parsed
+        values.pop_back();
+        break;
+      }
+      consume_whitespace();
+    }
+    const auto expanded = CSS::Declaration::expand(name, values);
+    declarations.insert(declarations.end(), expanded.begin(), expanded.end());
     consume_whitespace(";");
   }
   consume("}");
@@ -106,30 +247,35 @@ auto CSSParser::parseDeclarations() -> CSS::DeclarationSet {
 
 /**
  * Parses a value, for example `15px` or `rgba(0,0,0,0)`
- * @return pointer to Value
+ * @return parsed value
  */
-auto CSSParser::parseValue() -> CSS::ValuePtr {
+auto CSSParser::parseValue() -> CSS::Value {
   auto invalid = [this](char c) { return !std::isalnum(c) && !peek("_") && !peek("-"); };
   auto notFloat = std::not_fn(cisfloat);
 
   if (peek(cisfloat)) {
     auto val = std::stod(build_until(notFloat));
     auto unit = parseUnit();
-    return CSS::ValuePtr(new CSS::UnitValue(val, unit));
+    return CSS::Value::length(val, unit);
   } else if (peek("rgb")) {
     return parseRGB();
   } else if (peek("#")) {
     return parseHex();
   } else {
-    return CSS::ValuePtr(new CSS::TextValue(build_until(invalid)));
+    const auto identifier = build_until(invalid);
+    const auto value = CSS::Value::keyword(identifier);
+    // only identifiers that are not enumerated are viewed, so kept by the sheet
+    return value.getKeyword() == CSS::Keyword::Count
+               ? CSS::Value::keyword(identifiers->intern(identifier))
+               : value;
   }
 }
 
 /**
  * Parses RGB color
- * @return RGB ColorValue
+ * @return RGB color value
  */
-auto CSSParser::parseRGB() -> CSS::ValuePtr {
+auto CSSParser::parseRGB() -> CSS::Value {
   auto notDigit = std::not_fn(cisdigit);
   bool hasAlpha = peek("rgba");
   hasAlpha ? consume("rgba") : consume("rgb");
@@ -148,14 +294,14 @@ auto CSSParser::parseRGB() -> CSS::ValuePtr {
 
   consume(")");
 
-  return CSS::ValuePtr(new CSS::ColorValue(vals[0], vals[1], vals[2], alpha));
+  return CSS::Value::color(vals[0], vals[1], vals[2], alpha);
 }
 
 /**
  * Parses Hex color
- * @return Hex to RGB ColorValue
+ * @return Hex to RGB color value
  */
-auto CSSParser::parseHex() -> CSS::ValuePtr {
+auto CSSParser::parseHex() -> CSS::Value {
   consume("#");
   auto hexStr = build_until(std::not_fn(cisalnum));
   auto hex = std::stoul(hexStr, nullptr, 16);
@@ -165,9 +311,9 @@ auto CSSParser::parseHex() -> CSS::ValuePtr {
     // 0x0R0G0B | 0xR0G0B0 => 0xRRGGBB
     hex = hhex | hhex << 4;
   }
-  return CSS::ValuePtr(new CSS::ColorValue(static_cast<uint8_t>((hex >> 16) & 255),
-                                           static_cast<uint8_t>((hex >> 8) & 255),
-                                           static_cast<uint8_t>(hex & 255), 1));
+  return CSS::Value::color(static_cast<uint8_t>((hex >> 16) & 255),
+                           static_cast<uint8_t>((hex >> 8) & 255),
+                           static_cast<uint8_t>(hex & 255), 1);
 }
 
 /**
@@ -175,6 +321,10 @@ auto CSSParser::parseHex() -> CSS::ValuePtr {
  * @return Unit
  */
 auto CSSParser::parseUnit() -> CSS::Unit {
+  if (peek("%")) {
+    consume("%");
+    return CSS::percent;
+  }
   auto raw = build_until(std::not_fn(cisalpha));
   auto rawArr = CSS::UnitRaw();
   return static_cast<CSS::Unit>(std::find(rawArr.begin(), rawArr.end(), raw) -
@@ -4,6 +4,7 @@
 #define PARSER_CSS_HPP
 
 #include <cctype>
+#include <memory>
 
 #include "../css.h"
 #include "parser/parser.h"
@@ -13,6 +14,7 @@
  *
  * So far, the following features are supported:
  *  - tag, id, class, and wildcard selectors
+ *  - descendant and child combinators
  *  - text, numerical unit, and color (RGB/A, #HEX) declarations
  *  - comments (simply ignored)
  *  - mandatory semicolons at the end of declarations
@@ -44,34 +46,60 @@ class CSSParser : public Parser<CSS::StyleSheet> {
   auto parseRule() -> CSS::Rule;
 
   /**
-   * Parses rule selectors of form `tag#id.class`
+   * Parses comma-separated rule selectors of form `tag#id.class > tag .class`
    * @return vector of Selectors
    */
   auto parseSelectors() -> CSS::PrioritySelectorSet;
 
   /**
-   * Parses rule declarations of form `rule: value;`
+   * Parses a selector: compound selectors joined by combinators
+   * @return Selector
+   */
+  auto parseSelector() -> CSS::Selector;
+
+  /**
+   * Parses a compound selector of form `tag#id.class[attr]:first-child`, or
+   * `*`
+   * @return Selector without ancestors
+   */
+  auto parseCompound() -> CSS::Selector;
+
+  /**
+   * Parses an attribute selector of form `[name]` or `[name=value]`
+   * @return AttributeSelector
+   */
+  auto parseAttribute() -> CSS::AttributeSelector;
+
+  /**
+   * Parses a pseudo-class of form `:first-child` or `:nth-child(an+b)`
+   * @return NthChild, matching nothing if the pseudo-class is not supported
+   */
+  auto parsePseudoClass() -> CSS::NthChild;
+
+  /**
+   * Parses rule declarations of form `rule: value;`, expanding shorthands
+   * such as `margin: 1px 2px;` into their longhands
    * @return vector of Declarations
    */
   auto parseDeclarations() -> CSS::DeclarationSet;
 
   /**
    * Parses a value, for example `15px` or `rgba(0,0,0,0)`
-   * @return pointer to Value
+   * @return parsed value
    */
-  auto parseValue() -> CSS::ValuePtr;
+  auto parseValue() -> CSS::Value;
 
   /**
    * Parses RGB color
-   * @return RGB ColorValue
+   * @return RGB color value
    */
-  auto parseRGB() -> CSS::ValuePtr;
+  auto parseRGB() -> CSS::Value;
 
   /**
    * Parses Hex color
-   * @return Hex to RGB ColorValue
+   * @return Hex to RGB color value
    */
-  auto parseHex() -> CSS::ValuePtr;
+  auto parseHex() -> CSS::Value;
 
   /**
    * Parses Unit
@@ -94,6 +122,9 @@ class CSSParser : public Parser<CSS::StyleSheet> {
   static constexpr auto cisalpha = static_cast<int (*)(int)>(std::isalpha);
   static constexpr auto cisalnum = static_cast<int (*)(int)>(std::isalnum);
   static constexpr auto cisspace = static_cast<int (*)(int)>(std::isspace);
+
+  // identifiers of the keywords parsed so far, handed to the style sheet
+  std::shared_ptr<CSS::Identifiers> identifiers;
 };
 
 #endif
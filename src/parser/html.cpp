@@ -8,6 +8,7 @@
 #include <cctype>
 
 #include "parser.cpp"
+#include "trace.h"
 
 /**
  * Creates an HTML Parser
@@ -20,6 +21,7 @@ HTMLParser::HTMLParser(std::string html) : Parser<DOM::NodePtr>(std::move(html))
  * @return DOM tree
  */
 auto HTMLParser::evaluate() -> DOM::NodePtr {
+  TRACE_SPAN("parse", "HTMLParser::evaluate");
   auto roots = parseChildren();
 
   if (roots.size() == 1 && roots.front()->is("html")) {
@@ -110,10 +112,18 @@ auto HTMLParser::parseAttributes() -> DOM::AttributeMap {
     if (eof() || peek(">")) {
       break;
     }
-    auto attrName = build_until([](char c) { return !std::isalnum(c); });
-    consume("=\"");
-    auto attrValue = build_until([](char c) { return c == '"'; });
-    consume("\"");
+    auto attrName =
+        build_until([](char c) { return !std::isalnum(c) && c != '-' && c != '_'; });
+    if (attrName.empty()) {
+      pushPtr();  // skip what cannot start an attribute
+      continue;
+    }
+    std::string attrValue;  // empty for a boolean attribute, e.g. `disabled`
+    if (peek("=\"")) {
+      consume("=\"");
+      attrValue = build_until([](char c) { return c == '"'; });
+      consume("\"");
+    }
     attr.insert(attrName, attrValue);
   }
   return attr;
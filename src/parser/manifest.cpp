@@ -0,0 +1,218 @@
+// sherpa_41's Manifest Parser, licensed under MIT. (c) hafiz, 2018
+
+#ifndef PARSER_MANIFEST_CPP
+#define PARSER_MANIFEST_CPP
+
+#include "parser/manifest.h"
+
+#include <cctype>
+#include <map>
+#include <stdexcept>
+
+#include "parser.cpp"
+
+/**
+ * Creates a Manifest Parser
+ * @param manifest manifest to parse
+ */
+ManifestParser::ManifestParser(std::string manifest)
+    : Parser<Batch::JobVector>(std::move(manifest)) {}
+
+/**
+ * Parses the manifest into batch jobs, one per line
+ * @return parsed jobs
+ */
+auto ManifestParser::evaluate() -> Batch::JobVector {
+  Batch::JobVector jobs;
+  while (true) {
+    consume_whitespace();
+    if (eof()) {
+      break;
+    }
+    ++entry;
+
+    if (peek("#")) {
+      build_until([](char c) { return c == '\n'; });
+    } else if (peek("{")) {
+      jobs.push_back(parseObject());
+    } else {
+      Batch::Job job;
+      if (parseRow(job)) {
+        jobs.push_back(job);
+      }
+    }
+  }
+  return jobs;
+}
+
+/**
+ * Parses a job written as a JSON object of string and number values. Keys
+ * other than those of a job are ignored.
+ * @return parsed job
+ */
+auto ManifestParser::parseObject() -> Batch::Job {
+  std::map<std::string, std::string> fields;
+  expect("{");
+  consume_whitespace();
+  while (!peek("}")) {
+    auto key = parseString();
+    consume_whitespace();
+    expect(":");
+    consume_whitespace();
+    fields[key] = parseValue();
+    consume_whitespace();
+    if (!peek("}")) {
+      expect(",");
+      consume_whitespace();
+    }
+  }
+  expect("}");
+
+  for (const auto& key : {"html", "css", "width", "height", "out"}) {
+    if (fields.count(key) == 0) {
+      throw std::invalid_argument("Manifest entry " + std::to_string(entry) + " has no \"" +
+                                  key + "\"");
+    }
+  }
+  return Batch::Job{fields["html"], fields["css"], toSize(fields["width"], "width"),
+                    toSize(fields["height"], "height"), fields["out"]};
+}
+
+/**
+ * Parses a job written as a line of tab-separated fields, in the order html,
+ * css, width, height, out
+ * @param job job to fill in
+ * @return whether the line was a job, rather than a header
+ */
+auto ManifestParser::parseRow(Batch::Job& job) -> bool {
+  std::vector<std::string> fields;
+  while (fields.size() < 5) {
+    fields.push_back(rtrim(build_until([](char c) { return c == '\t' || c == '\n'; })));
+    if (!peek("\t")) {
+      break;
+    }
+    pushPtr();
+  }
+
+  if (fields.size() != 5 || !(eof() || peek("\n"))) {
+    throw std::invalid_argument("Manifest entry " + std::to_string(entry) +
+                                " does not have 5 tab-separated fields");
+  }
+  if (entry == 1 && fields[0] == "html") {
+    return false;
+  }
+
+  job = Batch::Job{fields[0], fields[1], toSize(fields[2], "width"),
+                   toSize(fields[3], "height"), fields[4]};
+  return true;
+}
+
+/**
+ * Parses a JSON string, resolving its escapes. Unicode escapes are encoded
+ * as UTF-8.
+ * @return parsed string
+ */
+auto ManifestParser::parseString() -> std::string {
+  expect("\"");
+  std::string str;
+  while (!peek("\"")) {
+    if (eof() || peek("\n")) {
+      throw std::invalid_argument("Manifest entry " + std::to_string(entry) +
+                                  " has an unterminated string");
+    }
+
+    auto c = next();
+    if (c != '\\') {
+      str += c;
+      continue;
+    }
+
+    switch (c = next()) {
+      case 'b':
+        str += '\b';
+        break;
+      case 'f':
+        str += '\f';
+        break;
+      case 'n':
+        str += '\n';
+        break;
+      case 'r':
+        str += '\r';
+        break;
+      case 't':
+        str += '\t';
+        break;
+      case 'u': {
+        uint32_t code(0);
+        for (int i = 0; i < 4; ++i) {
+          const auto digit = std::tolower(static_cast<unsigned char>(next()));
+          if (!std::isxdigit(digit)) {
+            throw std::invalid_argument("Manifest entry " + std::to_string(entry) +
+                                        " has a malformed unicode escape");
+          }
+          code = code * 16 +
+                 static_cast<uint32_t>(std::isdigit(digit) ? digit - '0' : digit - 'a' + 10);
+        }
+        if (code < 0x80) {
+          str += static_cast<char>(code);
+        } else if (code < 0x800) {
+          str += static_cast<char>(0xc0 | (code >> 6));
+          str += static_cast<char>(0x80 | (code & 0x3f));
+        } else {
+          str += static_cast<char>(0xe0 | (code >> 12));
+          str += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+          str += static_cast<char>(0x80 | (code & 0x3f));
+        }
+        break;
+      }
+      default:
+        // \" \\ \/, and anything else, stand for themselves
+        str += c;
+    }
+  }
+  expect("\"");
+  return str;
+}
+
+/**
+ * Parses a JSON value, either a string or a number, as a string
+ * @return parsed value
+ */
+auto ManifestParser::parseValue() -> std::string {
+  if (peek("\"")) {
+    return parseString();
+  }
+  return build_until([](char c) { return c == ',' || c == '}' || std::isspace(c); });
+}
+
+/**
+ * Ensures that the next characters are as expected, then consumes them
+ * @param next characters to ensure
+ */
+void ManifestParser::expect(const std::string& next) {
+  if (!peek(next)) {
+    throw std::invalid_argument("Manifest entry " + std::to_string(entry) + " expected \"" +
+                                next + "\"");
+  }
+  consume(next);
+}
+
+/**
+ * Converts a field to a pixel size
+ * @param field field to convert
+ * @param name name of the field, for errors
+ * @return size
+ */
+auto ManifestParser::toSize(const std::string& field, const std::string& name) const
+    -> uint64_t {
+  auto isDigit = [](unsigned char c) { return std::isdigit(c); };
+  if (field.empty() || field.size() > 9 ||
+      !std::all_of(field.begin(), field.end(), isDigit) || std::stoull(field) == 0) {
+    throw std::invalid_argument("Manifest entry " + std::to_string(entry) +
+                                " has an invalid " + name + " \"" + field + "\"");
+  }
+  return std::stoull(field);
+}
+
+#endif
@@ -0,0 +1,84 @@
+// sherpa_41's Manifest Parser, licensed under MIT. (c) hafiz, 2018
+
+#ifndef PARSER_MANIFEST_HPP
+#define PARSER_MANIFEST_HPP
+
+#include "../batch.h"
+#include "parser/parser.h"
+
+/**
+ * Manifest Parser, parsing a list of batch jobs. Each line holds one job,
+ * either as a JSON object or as tab-separated fields:
+ *
+ *     {"html": "a.html", "css": "a.css", "width": 800, "height": 600, "out": "a.png"}
+ *     a.html	a.css	800	600	a.png
+ *
+ * Blank lines and lines starting with `#` are ignored, as is a TSV header
+ * line whose first field is `html`.
+ */
+class ManifestParser : public Parser<Batch::JobVector> {
+ public:
+  /**
+   * Creates a Manifest Parser
+   * @param manifest manifest to parse
+   */
+  explicit ManifestParser(std::string manifest);
+
+  /**
+   * Default dtor
+   */
+  ~ManifestParser() override = default;
+
+  /**
+   * Parses the manifest into batch jobs
+   * @return parsed jobs
+   * @throws std::invalid_argument if a job is malformed
+   */
+  auto evaluate() -> Batch::JobVector override;
+
+ private:
+  /**
+   * Parses a job written as a JSON object of string and number values
+   * @return parsed job
+   */
+  auto parseObject() -> Batch::Job;
+
+  /**
+   * Parses a job written as a line of tab-separated fields
+   * @param job job to fill in
+   * @return whether the line was a job, rather than a header
+   */
+  auto parseRow(Batch::Job& job) -> bool;
+
+  /**
+   * Parses a JSON string, resolving its escapes
+   * @return parsed string
+   */
+  auto parseString() -> std::string;
+
+  /**
+   * Parses a JSON value, either a string or a number, as a string
+   * @return parsed value
+   */
+  auto parseValue() -> std::string;
+
+  /**
+   * Ensures that the next characters are as expected, then consumes them
+   * @param next characters to ensure
+   * @throws std::invalid_argument if the characters do not match
+   */
+  void expect(const std::string& next);
+
+  /**
+   * Converts a field to a pixel size
+   * @param field field to convert
+   * @param name name of the field, for errors
+   * @return size
+   * @throws std::invalid_argument if the field is not a positive integer
+   */
+  auto toSize(const std::string& field, const std::string& name) const -> uint64_t;
+
+  uint64_t entry = 0;
+};
+
+#endif
@@ -65,6 +65,16 @@ void Parser<EvalType>::consume_whitespace(const std::string& next) {
   consume(next);
 }
 
+/**
+ * Reads the next character of the program as is, then pushes the program
+ * pointer past it
+ * @return next character
+ */
+template <typename EvalType>
+auto Parser<EvalType>::next() -> char {
+  return program[ptr++];
+}
+
 /**
  * Pushes the program pointer some units ahead
  * @param dist distance to push pointer
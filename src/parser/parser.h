@@ -64,6 +64,13 @@ class Parser {
    */
   void consume_whitespace(const std::string& next = "");
 
+  /**
+   * Reads the next character of the program as is, then pushes the program
+   * pointer past it
+   * @return next character
+   */
+  auto next() -> char;
+
   /**
    * Pushes the program pointer some units ahead
    * @param dist distance to push pointer
@@ -5,48 +5,157 @@
 
 #include "renderer/canvas.h"
 
+#include <algorithm>
+#include <cmath>
+
+#include "renderer/encoder.h"
+#include "stats.h"
+#include "trace.h"
+
+static_assert(sizeof(Display::Color) == 4, "canvas pixels must be packed");
+
 /**
  * Creates blank canvas of a width and height
  * @param width canvas width
  * @param height canvas height
  */
 Canvas::Canvas(uint64_t width, uint64_t height)
-    : width(width), height(height), pixels(PxVector(width * height, RGBA(1, 1, 1, 0))) {}
+    : width(width),
+      height(height),
+      pixels(PxVector(width * height, blank)),
+      clip{0, 0, width, height} {}
 
 /**
- * Creates a canvas from a root box and a specified frame width/height
+ * Creates a canvas showing one region of the page, drawn from a root box
+ * @param frame region of the page to draw; its origin is the scroll offset
  * @param root box to start drawing from
- * @param frame width and height to draw in
  */
 Canvas::Canvas(const Layout::Rectangle& frame, const Layout::BoxPtr& root)
-    : width(static_cast<uint64_t>(frame.width)),
-      height(static_cast<uint64_t>(frame.height)),
-      pixels(PxVector(width * height, RGBA(1, 1, 1, 0))) {
-  auto cmds = Display::Command::createQueue(root);
-  while (!cmds.empty()) {
-    cmds.front()->acceptRenderer(*this);
-    cmds.pop();
+    : Canvas(static_cast<uint64_t>(frame.width), static_cast<uint64_t>(frame.height)) {
+  scrollTo(root, frame.origin.x, frame.origin.y);
+}
+
+/**
+ * Renders every command of a display list, in order
+ * @param list display list to paint
+ */
+void Canvas::render(const Display::DisplayList& list) {
+  for (const auto& cmd : list) {
+    paint(cmd);
+  }
+}
+
+/**
+ * Redraws the canvas to show the region of the page at another scroll offset.
+ * The pixel buffer is cleared in place rather than reallocated, so a single
+ * canvas can rasterize a tall page one strip at a time.
+ * @param root box to start drawing from
+ * @param x horizontal scroll offset
+ * @param y vertical scroll offset
+ */
+void Canvas::scrollTo(const Layout::BoxPtr& root, double x, double y) {
+  scrollTo(Display::DisplayList::from(root, Layout::Rectangle(x, y, width, height)), x, y);
+}
+
+/**
+ * Redraws the canvas to show the region of the page at another scroll offset,
+ * from a display list already built for that region
+ * @param list display list of the region, which is culled of occluded
+ *             commands as it is painted
+ * @param x horizontal scroll offset
+ * @param y vertical scroll offset
+ */
+void Canvas::scrollTo(Display::DisplayList list, double x, double y) {
+  TRACE_SPAN_ARG("canvas", "Canvas::scrollTo", "y", y);
+  offsetX = x;
+  offsetY = y;
+  std::fill(pixels.begin(), pixels.end(), blank);
+
+  culledPixels = list.cullOccluded();
+  list.acceptRenderer(*this);
+}
+
+/**
+ * Repaints only the damaged regions of the canvas from a display list. Each
+ * region is cleared, then the commands a spatial index finds overlapping it
+ * are replayed with painting clipped to the region.
+ * @param list display list to paint from
+ * @param damage regions to repaint
+ * @return number of pixels repainted
+ */
+auto Canvas::repaint(const Display::DisplayList& list, const Display::DamageVector& damage)
+    -> uint64_t {
+  if (damage.empty()) {
+    return 0;
+  }
+
+  const PxBounds frame{0, 0, width, height};
+  const Display::SpatialIndex index(list);
+  std::vector<uint64_t> found;  // reused by the query of each region
+  uint64_t repainted(0);
+  for (const auto& region : damage) {
+    // damage covers every pixel the region touches, even partially
+    const auto x0 = region.origin.x - offsetX, y0 = region.origin.y - offsetY;
+    clip = PxBounds{toPx(std::floor(x0), 0, width), toPx(std::floor(y0), 0, height),
+                    toPx(std::ceil(x0 + region.width), 0, width),
+                    toPx(std::ceil(y0 + region.height), 0, height)};
+    if (clip.x0 >= clip.x1 || clip.y0 >= clip.y1) {
+      continue;
+    }
+    TRACE_SPAN_ARG("canvas", "Canvas::repaint region", "pixels",
+                   (clip.x1 - clip.x0) * (clip.y1 - clip.y0));
+
+    for (uint64_t y = clip.y0; y < clip.y1; ++y) {
+      std::fill(pixels.begin() + y * width + clip.x0, pixels.begin() + y * width + clip.x1,
+                blank);
+    }
+    // commands starting inside a pixel paint all of it, so widen the query
+    const auto clipWidth = static_cast<double>(clip.x1 - clip.x0);
+    const auto clipHeight = static_cast<double>(clip.y1 - clip.y0);
+    const Layout::Rectangle px(clip.x0 + offsetX - 1, clip.y0 + offsetY - 1, clipWidth + 2,
+                               clipHeight + 2);
+    index.query(px, std::nullopt, found);
+    for (auto i : found) {
+      paint(list[i]);
+    }
+    repainted += (clip.x1 - clip.x0) * (clip.y1 - clip.y0);
   }
+  clip = frame;
+  return repainted;
 }
 
 /**
- * Renders a Rectangle Command
- * @param cmd command to render
+ * Paints a single display command
+ * @param cmd command to paint
  */
-void Canvas::render(const Display::RectangleCmd& cmd) {
-  const auto rect = cmd.getRectangle();
-  const auto color = RGBA(cmd.getColor());
+void Canvas::paint(const Display::Command& cmd) {
+  switch (cmd.type) {
+    case Display::CommandType::Rectangle:
+      paintRectangle(cmd);
+      break;
+  }
+}
 
+/**
+ * Paints a rectangle command
+ * @param cmd command to paint
+ */
+void Canvas::paintRectangle(const Display::Command& cmd) {
   // set rectangle edges, bounded to canvas
-  const auto x0 = toPx(rect.origin.x, 0, width);
-  const auto y0 = toPx(rect.origin.y, 0, height);
-  const auto x1 = toPx(rect.origin.x + rect.width, 0, width);
-  const auto y1 = toPx(rect.origin.y + rect.height, 0, height);
-
-  // color rectangle pixels accordingly
-  for (uint64_t y = y0; y < y1; ++y) {
-    for (uint64_t x = x0; x < x1; ++x) {
-      setPixel(x + y * width, color);
+  const auto px = toPxBounds(cmd.bounds());
+  if (px.x1 > px.x0 && px.y1 > px.y0) {
+    Stats::local().pixelsBlended += (px.x1 - px.x0) * (px.y1 - px.y0);
+  }
+
+  // color rectangle pixels accordingly; opaque rows are simply filled
+  for (uint64_t y = px.y0; y < px.y1; ++y) {
+    if (cmd.isOpaque()) {
+      std::fill(pixels.begin() + y * width + px.x0, pixels.begin() + y * width + px.x1,
+                cmd.color);
+      continue;
+    }
+    for (uint64_t x = px.x0; x < px.x1; ++x) {
+      setPixel(x + y * width, cmd.color);
     }
   }
 }
@@ -56,51 +165,134 @@ void Canvas::render(const Display::RectangleCmd& cmd) {
  * @return pixels
  */
 auto Canvas::getPixels() const -> std::vector<uint8_t> {
-  std::vector<uint8_t> rawPixels;
-  rawPixels.reserve(width * height * 4);
-  std::for_each(pixels.begin(), pixels.end(), [&rawPixels](const RGBA& pixel) {
-    for (auto channel : pixel.channels()) {
-      rawPixels.push_back(static_cast<uint8_t>(channel * 255));
-    }
-  });
-  return rawPixels;
+  const auto pixelView = view();
+  return std::vector<uint8_t>(pixelView.data, pixelView.data + pixelView.size());
+}
+
+/**
+ * Returns a view of the canvas framebuffer, without copying it
+ * @return framebuffer view
+ */
+auto Canvas::view() const -> Canvas::View {
+  return View{reinterpret_cast<const uint8_t*>(pixels.data()), width, height};
 }
 
-Canvas::RGBA::RGBA(double r, double g, double b, double a) : r(r), g(g), b(b), a(a) {}
+/**
+ * Converts the canvas pixels into a caller's buffer in a single pass. Each
+ * order is its own instantiation, so the loop has no per-pixel branches and
+ * can be vectorized.
+ * @param dest buffer of at least `width * height * 4` bytes
+ * @param order channel order to write
+ * @param premultiply whether to multiply color channels by alpha
+ */
+void Canvas::exportPixels(uint8_t* dest, ChannelOrder order, bool premultiply) const {
+  switch (order) {
+    case ChannelOrder::RGBA:
+      convert<0, 1, 2, 3>(pixels.data(), dest, pixels.size(), premultiply);
+      break;
+    case ChannelOrder::BGRA:
+      convert<2, 1, 0, 3>(pixels.data(), dest, pixels.size(), premultiply);
+      break;
+    case ChannelOrder::ARGB:
+      convert<1, 2, 3, 0>(pixels.data(), dest, pixels.size(), premultiply);
+      break;
+    case ChannelOrder::ABGR:
+      convert<3, 2, 1, 0>(pixels.data(), dest, pixels.size(), premultiply);
+      break;
+  }
+}
 
 /**
- * Creates an RGBA from a ColorValue
- * @param color ColorValue to convert
+ * Streams rows of the canvas, from the top, to an image encoder. Rows are
+ * passed straight from the framebuffer.
+ * @param encoder encoder to write rows to
+ * @param rows number of rows to write, by default all of them
  */
-Canvas::RGBA::RGBA(const CSS::ColorValue& color)
-    : r(color.r / 255.), g(color.g / 255.), b(color.b / 255.), a(color.a) {}
+void Canvas::encode(Encoder& encoder, uint64_t rows) const {
+  TRACE_SPAN_ARG("encode", "Canvas::encode", "rows", std::min(rows, height));
+  const auto pixelView = view();
+  for (uint64_t y = 0; y < std::min(rows, height); ++y) {
+    encoder.writeRow(pixelView.row(y));
+  }
+}
 
 /**
- * Returns an array of RGBA channels
- * @return RGBA color channels
+ * Returns the number of pixels of overdraw skipped by occlusion culling
+ * @return culled pixels
  */
-auto Canvas::RGBA::channels() const -> std::array<double, 4> {
-  return {{r, g, b, a}};
+auto Canvas::getCulledPixels() const -> uint64_t {
+  return culledPixels;
 }
 
 /**
- * Sets a pixel by blending a color with the background
+ * Sets a pixel by blending a color with the background. Blending is done in
+ * integer arithmetic, in units of 1/255^2, and rounded back to 8 bits.
  * @param location pixel to color
  * @param fg foreground color to apply to pixel
  */
-void Canvas::setPixel(uint64_t location, const RGBA& fg) {
-  RGBA stacked(0, 0, 0, 0);
-  RGBA bg(pixels[location]);
+void Canvas::setPixel(uint64_t location, const Display::Color& fg) {
+  if (fg.a == 255) {
+    pixels[location] = fg;
+    return;
+  }
 
   // alpha channel blending
-  stacked.a = 1 - (1 - bg.a) * (1 - fg.a);
-  if (stacked.a != 0) {
-    stacked.r = (bg.r * bg.a * (1 - fg.a) / stacked.a) + (fg.r * fg.a / stacked.a);
-    stacked.g = (bg.g * bg.a * (1 - fg.a) / stacked.a) + (fg.g * fg.a / stacked.a);
-    stacked.b = (bg.b * bg.a * (1 - fg.a) / stacked.a) + (fg.b * fg.a / stacked.a);
+  const auto bg = pixels[location];
+  const uint32_t under = bg.a * (255u - fg.a);
+  const uint32_t alpha = fg.a * 255u + under;
+  if (alpha == 0) {
+    pixels[location] = Display::Color{0, 0, 0, 0};
+    return;
+  }
+
+  auto blend = [&](uint32_t f, uint32_t b) {
+    return static_cast<uint8_t>((f * fg.a * 255u + b * under + alpha / 2) / alpha);
+  };
+  pixels[location] = Display::Color{blend(fg.r, bg.r), blend(fg.g, bg.g), blend(fg.b, bg.b),
+                                    static_cast<uint8_t>((alpha + 127) / 255)};
+}
+
+/**
+ * Converts pixels to a channel order, optionally premultiplying them
+ * @tparam R index of red in a converted pixel
+ * @tparam G index of green in a converted pixel
+ * @tparam B index of blue in a converted pixel
+ * @tparam A index of alpha in a converted pixel
+ * @param src pixels to convert
+ * @param dest buffer to write converted pixels to
+ * @param count number of pixels
+ * @param premultiply whether to multiply color channels by alpha
+ */
+template <int R, int G, int B, int A>
+void Canvas::convert(const Display::Color* src,
+                     uint8_t* dest,
+                     uint64_t count,
+                     bool premultiply) {
+  for (uint64_t i = 0; i < count; ++i, dest += 4) {
+    // an alpha of 255 leaves channels unchanged
+    const uint32_t alpha = premultiply ? src[i].a : 255u;
+    dest[R] = static_cast<uint8_t>((src[i].r * alpha + 127) / 255);
+    dest[G] = static_cast<uint8_t>((src[i].g * alpha + 127) / 255);
+    dest[B] = static_cast<uint8_t>((src[i].b * alpha + 127) / 255);
+    dest[A] = src[i].a;
   }
+}
+
+/**
+ * Returns the first byte of a row of pixels
+ * @param y row to get
+ * @return row of `width * 4` bytes
+ */
+auto Canvas::View::row(uint64_t y) const -> const uint8_t* {
+  return data + y * width * 4;
+}
 
-  pixels[location] = stacked;
+/**
+ * Returns the size of the framebuffer
+ * @return size, in bytes
+ */
+auto Canvas::View::size() const -> uint64_t {
+  return width * height * 4;
 }
 
 /**
@@ -111,7 +303,21 @@ void Canvas::setPixel(uint64_t location, const RGBA& fg) {
  * @return converted location, bounded by canvas size
  */
 auto Canvas::toPx(double x, uint64_t min, uint64_t max) -> uint64_t {
-  return std::min(max, std::max(min, static_cast<uint64_t>(x)));
+  return static_cast<uint64_t>(
+      std::min(static_cast<double>(max), std::max(static_cast<double>(min), x)));
+}
+
+/**
+ * Converts a rectangle in page coordinates to the pixels it paints on the
+ * canvas, bounded by the clip region
+ * @param rect rectangle to convert
+ * @return pixel bounds
+ */
+auto Canvas::toPxBounds(const Layout::Rectangle& rect) -> Canvas::PxBounds {
+  const auto x0 = rect.origin.x - offsetX, y0 = rect.origin.y - offsetY;
+  return PxBounds{toPx(x0, clip.x0, clip.x1), toPx(y0, clip.y0, clip.y1),
+                  toPx(x0 + rect.width, clip.x0, clip.x1),
+                  toPx(y0 + rect.height, clip.y0, clip.y1)};
 }
 
 #endif
@@ -3,18 +3,52 @@
 #ifndef RENDERER_CANVAS_HPP
 #define RENDERER_CANVAS_HPP
 
-#include <array>
+#include <limits>
 
 #include "display.h"
 #include "renderer/renderer.h"
 
+class Encoder;
+
 /**
  * The Canvas is a rendering scheme designed for image rasterization,
  * particularly into PNG or JPG formats. It renders a Layout tree hierarchically
  * into an array of pixels, each pixel composed of an RGBA color value.
+ *
+ * Pixels are stored packed, 8 bits per channel in RGBA order with straight
+ * alpha, so the framebuffer can be handed to encoders without conversion.
  */
 class Canvas : public Renderer {
  public:
+  /**
+   * Orders of the channels of an exported pixel
+   */
+  enum class ChannelOrder { RGBA, BGRA, ARGB, ABGR };
+
+  /**
+   * A read-only view of the canvas framebuffer: `width * height` packed RGBA
+   * pixels, row by row. A view is invalidated by drawing to or destroying the
+   * canvas.
+   */
+  struct View {
+   public:
+    /**
+     * Returns the first byte of a row of pixels
+     * @param y row to get
+     * @return row of `width * 4` bytes
+     */
+    [[nodiscard]] auto row(uint64_t y) const -> const uint8_t*;
+
+    /**
+     * Returns the size of the framebuffer
+     * @return size, in bytes
+     */
+    [[nodiscard]] auto size() const -> uint64_t;
+
+    const uint8_t* data;
+    uint64_t width, height;
+  };
+
   /**
    * Creates blank canvas of a width and height
    * @param width canvas width
@@ -23,8 +57,9 @@ class Canvas : public Renderer {
   Canvas(uint64_t width, uint64_t height);
 
   /**
-   * Creates a canvas from a root box and a specified frame width/height
-   * @param frame width and height to draw in
+   * Creates a canvas showing one region of the page, drawn from a root box.
+   * Only the part of the box tree visible in the frame is rendered.
+   * @param frame region of the page to draw; its origin is the scroll offset
    * @param root box to start drawing from
    */
   Canvas(const Layout::Rectangle& frame, const Layout::BoxPtr& root);
@@ -35,10 +70,40 @@ class Canvas : public Renderer {
   ~Canvas() override = default;
 
   /**
-   * Renders a Rectangle Command
-   * @param cmd command to paint
+   * Renders every command of a display list, in order
+   * @param list display list to paint
    */
-  void render(const Display::RectangleCmd& cmd) override;
+  void render(const Display::DisplayList& list) override;
+
+  /**
+   * Redraws the canvas to show the region of the page at another scroll
+   * offset, reusing the existing pixel buffer
+   * @param root box to start drawing from
+   * @param x horizontal scroll offset
+   * @param y vertical scroll offset
+   */
+  void scrollTo(const Layout::BoxPtr& root, double x, double y);
+
+  /**
+   * Redraws the canvas to show the region of the page at another scroll
+   * offset, from a display list already built for that region, e.g. by
+   * `DisplayList::from(root, viewport)`
+   * @param list display list of the region
+   * @param x horizontal scroll offset
+   * @param y vertical scroll offset
+   */
+  void scrollTo(Display::DisplayList list, double x, double y);
+
+  /**
+   * Repaints only the damaged regions of the canvas from a display list,
+   * leaving all other pixels untouched
+   * @param list display list to paint from
+   * @param damage regions to repaint in page coordinates, usually from
+   *               `DisplayList::diff`
+   * @return number of pixels repainted
+   */
+  auto repaint(const Display::DisplayList& list, const Display::DamageVector& damage)
+      -> uint64_t;
 
   /**
    * Returns vector of RGBA pixels representing the Canvas
@@ -46,46 +111,85 @@ class Canvas : public Renderer {
    */
   [[nodiscard]] auto getPixels() const -> std::vector<uint8_t>;
 
- private:
   /**
-   * A ColorValue-like struct that only deals with channels in [0, 1] for
-   * blending purposes.
+   * Returns a view of the canvas framebuffer, without copying it
+   * @return framebuffer view
    */
-  struct RGBA {
-    RGBA() = default;
+  [[nodiscard]] auto view() const -> View;
 
-    /**
-     * Creates an RGBA from color channels
-     * @param r red channel
-     * @param g green channel
-     * @param b blue channel
-     * @param a alpha channel
-     */
-    RGBA(double r, double g, double b, double a);
+  /**
+   * Converts the canvas pixels into a caller's buffer in a single pass
+   * @param dest buffer of at least `width * height * 4` bytes
+   * @param order channel order to write
+   * @param premultiply whether to multiply color channels by alpha
+   */
+  void exportPixels(uint8_t* dest,
+                    ChannelOrder order = ChannelOrder::RGBA,
+                    bool premultiply = false) const;
 
-    /**
-     * Creates an RGBA from a ColorValue
-     * @param color ColorValue to convert
-     */
-    explicit RGBA(const CSS::ColorValue& color);
+  /**
+   * Streams rows of the canvas, from the top, to an image encoder
+   * @param encoder encoder to write rows to
+   * @param rows number of rows to write, by default all of them
+   */
+  void encode(Encoder& encoder, uint64_t rows = std::numeric_limits<uint64_t>::max()) const;
 
-    /**
-     * Returns an array of RGBA channels
-     * @return RGBA color channels
-     */
-    [[nodiscard]] auto channels() const -> std::array<double, 4>;
+  /**
+   * Returns the number of pixels of overdraw skipped by occlusion culling
+   * @return culled pixels
+   */
+  [[nodiscard]] auto getCulledPixels() const -> uint64_t;
+
+ private:
+  using PxVector = std::vector<Display::Color>;
 
-    double r, g, b, a;
+  /**
+   * Color of a pixel that has not been painted
+   */
+  static constexpr Display::Color blank{255, 255, 255, 0};
+
+  /**
+   * Pixel bounds of a region on the canvas, with exclusive ends
+   */
+  struct PxBounds {
+    uint64_t x0, y0, x1, y1;
   };
 
-  using PxVector = std::vector<RGBA>;
+  /**
+   * Paints a single display command
+   * @param cmd command to paint
+   */
+  void paint(const Display::Command& cmd);
+
+  /**
+   * Paints a rectangle command
+   * @param cmd command to paint
+   */
+  void paintRectangle(const Display::Command& cmd);
 
   /**
    * Sets a pixel by blending a color with the background
    * @param location pixel to color
    * @param fg foreground color to apply to pixel
    */
-  void setPixel(uint64_t location, const RGBA& fg);
+  void setPixel(uint64_t location, const Display::Color& fg);
+
+  /**
+   * Converts pixels to a channel order, optionally premultiplying them
+   * @tparam R index of red in a converted pixel
+   * @tparam G index of green in a converted pixel
+   * @tparam B index of blue in a converted pixel
+   * @tparam A index of alpha in a converted pixel
+   * @param src pixels to convert
+   * @param dest buffer to write converted pixels to
+   * @param count number of pixels
+   * @param premultiply whether to multiply color channels by alpha
+   */
+  template <int R, int G, int B, int A>
+  static void convert(const Display::Color* src,
+                      uint8_t* dest,
+                      uint64_t count,
+                      bool premultiply);
 
   /**
    * Converts a start location to a pixel position on the canvas
@@ -96,8 +200,19 @@ class Canvas : public Renderer {
    */
   auto toPx(double x, uint64_t min, uint64_t max) -> uint64_t;
 
+  /**
+   * Converts a rectangle in page coordinates to the pixels it paints on the
+   * canvas, bounded by the clip region
+   * @param rect rectangle to convert
+   * @return pixel bounds
+   */
+  auto toPxBounds(const Layout::Rectangle& rect) -> PxBounds;
+
   uint64_t width, height;
+  double offsetX = 0, offsetY = 0;
   PxVector pixels;
+  uint64_t culledPixels = 0;
+  PxBounds clip;
 };
 
 #endif
@@ -0,0 +1,517 @@
+// sherpa_41's Image Encoders, licensed under MIT. (c) hafiz, 2018
+
+#ifndef RENDERER_ENCODER_CPP
+#define RENDERER_ENCODER_CPP
+
+#include "renderer/encoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+/**
+ * Creates an encoder for the format named by a file's extension
+ * @param file file name to choose the format by
+ * @param out stream to write the image to
+ * @param width image width
+ * @param height image height
+ * @return encoder, or nullptr if the format is not supported
+ */
+auto Encoder::from(const std::string& file,
+                   std::ostream& out,
+                   uint64_t width,
+                   uint64_t height) -> std::unique_ptr<Encoder> {
+  const auto format = extension(file);
+  if (format == "png") {
+    return std::make_unique<PNGEncoder>(out, width, height);
+  } else if (format == "pam") {
+    return std::make_unique<PAMEncoder>(out, width, height);
+  } else if (format == "ppm") {
+    return std::make_unique<PPMEncoder>(out, width, height);
+  }
+  return nullptr;
+}
+
+/**
+ * Determines whether a file's extension names a supported format
+ * @param file file name to check
+ * @return whether `from` can create an encoder for the file
+ */
+auto Encoder::supports(const std::string& file) -> bool {
+  const auto format = extension(file);
+  return format == "png" || format == "pam" || format == "ppm";
+}
+
+/**
+ * Returns the lowercase extension of a file name
+ * @param file file name
+ * @return extension, without its dot
+ */
+auto Encoder::extension(const std::string& file) -> std::string {
+  const auto dot = file.find_last_of("./");
+  if (dot == std::string::npos || file[dot] != '.') {
+    return "";
+  }
+
+  auto format = file.substr(dot + 1);
+  std::transform(format.begin(), format.end(), format.begin(),
+                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return format;
+}
+
+/**
+ * Creates an encoder of an image of a width and height
+ * @param out stream to write the image to
+ * @param width image width
+ * @param height image height
+ */
+Encoder::Encoder(std::ostream& out, uint64_t width, uint64_t height)
+    : out(out), width(width), height(height) {}
+
+/**
+ * Encodes the next row of the image
+ * @param row `width` RGBA pixels
+ */
+void Encoder::writeRow(const uint8_t* row) {
+  if (rows == height) {
+    throw std::logic_error("Image already has all of its rows");
+  }
+  encodeRow(row);
+  ++rows;
+}
+
+/**
+ * Completes the image after its last row
+ */
+void Encoder::finish() {
+  if (rows != height) {
+    throw std::logic_error("Image is missing " + std::to_string(height - rows) + " rows");
+  }
+  encodeEnd();
+  out.flush();
+}
+
+/**
+ * Creates a PAM encoder, writing its header
+ * @param out stream to write the image to
+ * @param width image width
+ * @param height image height
+ */
+PAMEncoder::PAMEncoder(std::ostream& out, uint64_t width, uint64_t height)
+    : Encoder(out, width, height) {
+  out << "P7\nWIDTH " << width << "\nHEIGHT " << height
+      << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+}
+
+/**
+ * Writes one row of the image as is
+ * @param row `width` RGBA pixels
+ */
+void PAMEncoder::encodeRow(const uint8_t* row) {
+  out.write(reinterpret_cast<const char*>(row), static_cast<std::streamsize>(width * 4));
+}
+
+/**
+ * PAM images have no trailer
+ */
+void PAMEncoder::encodeEnd() {}
+
+/**
+ * Creates a PPM encoder, writing its header
+ * @param out stream to write the image to
+ * @param width image width
+ * @param height image height
+ */
+PPMEncoder::PPMEncoder(std::ostream& out, uint64_t width, uint64_t height)
+    : Encoder(out, width, height), rgb(width * 3) {
+  out << "P6\n" << width << " " << height << "\n255\n";
+}
+
+/**
+ * Writes one row of the image without its alpha channel
+ * @param row `width` RGBA pixels
+ */
+void PPMEncoder::encodeRow(const uint8_t* row) {
+  for (uint64_t x = 0; x < width; ++x) {
+    std::copy(row + x * 4, row + x * 4 + 3, rgb.begin() + x * 3);
+  }
+  out.write(reinterpret_cast<const char*>(rgb.data()),
+            static_cast<std::streamsize>(rgb.size()));
+}
+
+/**
+ * PPM images have no trailer
+ */
+void PPMEncoder::encodeEnd() {}
+
+/**
+ * Creates a PNG encoder, writing its signature, header, and the start of its
+ * compressed stream
+ * @param out stream to write the image to
+ * @param width image width
+ * @param height image height
+ * @param compression how to compress image data
+ */
+PNGEncoder::PNGEncoder(std::ostream& out,
+                       uint64_t width,
+                       uint64_t height,
+                       Compression compression)
+    : Encoder(out, width, height), compression(compression), filtered(width * 4 + 1) {
+  out.write("\x89PNG\r\n\x1a\n", 8);
+
+  // 8-bit RGBA, deflated, standard filtering, not interlaced
+  uint8_t header[13] = {0, 0, 0, 0, 0, 0, 0, 0, 8, 6, 0, 0, 0};
+  putBigEndian(header, static_cast<uint32_t>(width));
+  putBigEndian(header + 4, static_cast<uint32_t>(height));
+  writeChunk("IHDR", header, sizeof(header));
+
+#ifdef HAVE_ZLIB
+  if (compression == Compression::Deflate) {
+    zlib.reset(new z_stream_s());
+    if (deflateInit(zlib.get(), Z_BEST_SPEED) != Z_OK) {
+      throw std::runtime_error("Could not initialize zlib");
+    }
+    return;
+  }
+#endif
+  if (compression == Compression::Deflate) {
+    this->compression = Compression::RunLength;
+  }
+
+  // zlib header: 32K window, deflate, fastest compression
+  compressed.push_back(0x78);
+  compressed.push_back(0x01);
+  if (this->compression == Compression::RunLength) {
+    // a single final block with fixed Huffman codes
+    putBits(1, 1);
+    putBits(1, 2);
+  }
+}
+
+/**
+ * Releases a zlib stream
+ * @param stream stream to release
+ */
+void PNGEncoder::ZlibDeleter::operator()(z_stream_s* stream) const {
+#ifdef HAVE_ZLIB
+  deflateEnd(stream);
+  delete stream;
+#else
+  (void)stream;
+#endif
+}
+
+/**
+ * Compresses one row of the image. Rows are not filtered, which costs little
+ * for the large flat regions of rendered pages.
+ * @param row `width` RGBA pixels
+ */
+void PNGEncoder::encodeRow(const uint8_t* row) {
+  filtered[0] = 0;
+  std::copy(row, row + width * 4, filtered.begin() + 1);
+
+  switch (compression) {
+    case Compression::Stored:
+      adler = adler32(adler, filtered.data(), filtered.size());
+      storeData(filtered.data(), filtered.size());
+      break;
+    case Compression::RunLength:
+      adler = adler32(adler, filtered.data(), filtered.size());
+      runLengthData(filtered.data(), filtered.size());
+      break;
+    case Compression::Deflate:
+#ifdef HAVE_ZLIB
+      zlibData(filtered.data(), filtered.size(), Z_NO_FLUSH);
+#endif
+      break;
+  }
+  flushData(false);
+}
+
+/**
+ * Ends the compressed stream and writes the remaining chunks
+ */
+void PNGEncoder::encodeEnd() {
+  switch (compression) {
+    case Compression::Stored: {
+      // final block, possibly empty
+      const auto size = static_cast<uint16_t>(block.size());
+      compressed.insert(compressed.end(),
+                        {1, static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8),
+                         static_cast<uint8_t>(~size), static_cast<uint8_t>(~size >> 8)});
+      compressed.insert(compressed.end(), block.begin(), block.end());
+      block.clear();
+      break;
+    }
+    case Compression::RunLength:
+      // end of block, then pad to a byte
+      putSymbol(256);
+      putBits(0, (8 - bitCount % 8) % 8);
+      break;
+    case Compression::Deflate:
+#ifdef HAVE_ZLIB
+      zlibData(nullptr, 0, Z_FINISH);
+#endif
+      break;
+  }
+
+  if (compression != Compression::Deflate) {
+    uint8_t checksum[4];
+    putBigEndian(checksum, adler);
+    compressed.insert(compressed.end(), checksum, checksum + 4);
+  }
+  flushData(true);
+  writeChunk("IEND", nullptr, 0);
+}
+
+/**
+ * Writes a PNG chunk with its length and checksum
+ * @param type chunk type
+ * @param data chunk data
+ * @param size chunk data size
+ */
+void PNGEncoder::writeChunk(const char* type, const uint8_t* data, uint64_t size) {
+  uint8_t field[4];
+  putBigEndian(field, static_cast<uint32_t>(size));
+  out.write(reinterpret_cast<const char*>(field), 4);
+  out.write(type, 4);
+  out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+
+  auto crc = crc32(0, reinterpret_cast<const uint8_t*>(type), 4);
+  crc = crc32(crc, data, size);
+  putBigEndian(field, crc);
+  out.write(reinterpret_cast<const char*>(field), 4);
+}
+
+/**
+ * Writes buffered compressed data as IDAT chunks
+ * @param all whether to write a final partial chunk
+ */
+void PNGEncoder::flushData(bool all) {
+  uint64_t written(0);
+  while (compressed.size() - written >= chunkSize || (all && written < compressed.size())) {
+    const auto size = std::min(chunkSize, compressed.size() - written);
+    writeChunk("IDAT", compressed.data() + written, size);
+    written += size;
+  }
+  compressed.erase(compressed.begin(),
+                   compressed.begin() + static_cast<std::ptrdiff_t>(written));
+}
+
+/**
+ * Adds uncompressed image data to the current stored block, writing out
+ * blocks as they fill
+ * @param bytes data to add
+ * @param size size of data
+ */
+void PNGEncoder::storeData(const uint8_t* bytes, uint64_t size) {
+  while (size > 0) {
+    const auto take = std::min(size, storedBlockSize - block.size());
+    block.insert(block.end(), bytes, bytes + take);
+    bytes += take;
+    size -= take;
+
+    if (block.size() == storedBlockSize) {
+      // non-final stored block of maximum size
+      compressed.insert(compressed.end(), {0, 0xff, 0xff, 0, 0});
+      compressed.insert(compressed.end(), block.begin(), block.end());
+      block.clear();
+    }
+  }
+}
+
+/**
+ * Compresses image data as literals and back-references to the byte four
+ * positions back, the same channel of the previous pixel. Runs of a repeated
+ * pixel, common in rendered pages, collapse to a few symbols each.
+ * @param bytes data to compress
+ * @param size size of data
+ */
+void PNGEncoder::runLengthData(const uint8_t* bytes, uint64_t size) {
+  // the byte four positions before index i of bytes
+  auto behind = [&](uint64_t i) { return i >= 4 ? bytes[i - 4] : history[i]; };
+
+  uint64_t i(0);
+  while (i < size) {
+    uint32_t length(0);
+    if (consumed + i >= 4) {
+      while (i + length < size && length < 258 && bytes[i + length] == behind(i + length)) {
+        ++length;
+      }
+    }
+
+    if (length >= 3) {
+      putMatch(length);
+      i += length;
+    } else {
+      putSymbol(bytes[i]);
+      ++i;
+    }
+  }
+
+  // keep the last four bytes for matches at the start of the next call
+  std::array<uint8_t, 4> last{};
+  for (uint64_t j = 0; j < 4; ++j) {
+    last[j] = behind(size + j);
+  }
+  history = last;
+  consumed += size;
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * Compresses image data with zlib
+ * @param bytes data to compress
+ * @param size size of data
+ * @param flush zlib flush mode
+ */
+void PNGEncoder::zlibData(const uint8_t* bytes, uint64_t size, int flush) {
+  zlib->next_in = const_cast<Bytef*>(bytes);
+  zlib->avail_in = static_cast<uInt>(size);
+
+  uint8_t buffer[chunkSize];
+  int status;
+  do {
+    zlib->next_out = buffer;
+    zlib->avail_out = sizeof(buffer);
+    status = deflate(zlib.get(), flush);
+    if (status == Z_STREAM_ERROR) {
+      throw std::runtime_error("zlib could not compress image data");
+    }
+    compressed.insert(compressed.end(), buffer, buffer + (sizeof(buffer) - zlib->avail_out));
+  } while (zlib->avail_out == 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+}
+#endif
+
+/**
+ * Appends bits to the compressed data, least significant bit first
+ * @param value bits to append
+ * @param count number of bits
+ */
+void PNGEncoder::putBits(uint32_t value, uint32_t count) {
+  bits |= static_cast<uint64_t>(value) << bitCount;
+  bitCount += count;
+  while (bitCount >= 8) {
+    compressed.push_back(static_cast<uint8_t>(bits));
+    bits >>= 8;
+    bitCount -= 8;
+  }
+}
+
+/**
+ * Appends a symbol of the fixed Huffman literal/length code. Huffman codes
+ * are packed most significant bit first, so their bits are reversed.
+ * @param symbol literal or length symbol to append
+ */
+void PNGEncoder::putSymbol(uint32_t symbol) {
+  uint32_t code, length;
+  if (symbol < 144) {
+    code = 0x30 + symbol, length = 8;
+  } else if (symbol < 256) {
+    code = 0x190 + symbol - 144, length = 9;
+  } else if (symbol < 280) {
+    code = symbol - 256, length = 7;
+  } else {
+    code = 0xc0 + symbol - 280, length = 8;
+  }
+
+  uint32_t reversed(0);
+  for (uint32_t bit = 0; bit < length; ++bit) {
+    reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+  }
+  putBits(reversed, length);
+}
+
+/**
+ * Appends a back-reference of a length to the previous pixel
+ * @param length match length, in [3, 258]
+ */
+void PNGEncoder::putMatch(uint32_t length) {
+  static constexpr uint32_t bases[] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,
+                                       15, 17, 19, 23, 27, 31, 35, 43, 51,  59,
+                                       67, 83, 99, 115, 131, 163, 195, 227, 258};
+  static constexpr uint32_t extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                       2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+  uint32_t code(28);
+  while (bases[code] > length) {
+    --code;
+  }
+  putSymbol(257 + code);
+  putBits(length - bases[code], extra[code]);
+
+  // distance 4 is distance code 3, five bits with no extra bits
+  putBits(0b11000, 5);
+}
+
+/**
+ * Writes a 32-bit value in big-endian byte order
+ * @param dest buffer to write to
+ * @param value value to write
+ */
+void PNGEncoder::putBigEndian(uint8_t* dest, uint32_t value) {
+  dest[0] = static_cast<uint8_t>(value >> 24);
+  dest[1] = static_cast<uint8_t>(value >> 16);
+  dest[2] = static_cast<uint8_t>(value >> 8);
+  dest[3] = static_cast<uint8_t>(value);
+}
+
+/**
+ * Updates a CRC-32 checksum, as used by PNG chunks
+ * @param crc checksum so far, 0 to start
+ * @param data data to checksum
+ * @param size size of data
+ * @return updated checksum
+ */
+auto PNGEncoder::crc32(uint32_t crc, const uint8_t* data, uint64_t size) -> uint32_t {
+  static const auto table = [] {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t n = 0; n < 256; ++n) {
+      uint32_t c(n);
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      }
+      table[n] = c;
+    }
+    return table;
+  }();
+
+  crc = ~crc;
+  for (uint64_t i = 0; i < size; ++i) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+/**
+ * Updates an Adler-32 checksum, as used by zlib streams
+ * @param adler checksum so far, 1 to start
+ * @param data data to checksum
+ * @param size size of data
+ * @return updated checksum
+ */
+auto PNGEncoder::adler32(uint32_t adler, const uint8_t* data, uint64_t size) -> uint32_t {
+  static constexpr uint32_t modulus = 65521;
+  // the most bytes that can be summed before the sums may overflow
+  static constexpr uint64_t run = 5552;
+
+  uint32_t a = adler & 0xffff, b = adler >> 16;
+  while (size > 0) {
+    const auto take = std::min(size, run);
+    for (uint64_t i = 0; i < take; ++i) {
+      a += data[i];
+      b += a;
+    }
+    a %= modulus;
+    b %= modulus;
+    data += take;
+    size -= take;
+  }
+  return (b << 16) | a;
+}
+
+#endif
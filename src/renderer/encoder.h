@@ -0,0 +1,311 @@
+// sherpa_41's Image Encoders, licensed under MIT. (c) hafiz, 2018
+
+#ifndef RENDERER_ENCODER_HPP
+#define RENDERER_ENCODER_HPP
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// zlib's stream state, only defined when built with zlib
+struct z_stream_s;
+
+/**
+ * An Encoder streams an image to an output stream one row at a time, so that
+ * a renderer never needs to hold more than a row of encoded pixels. Rows are
+ * given as 8-bit RGBA, top to bottom.
+ *
+ * The following formats are supported:
+ *  - PAM: raw RGBA netpbm image
+ *  - PPM: raw RGB netpbm image, without alpha
+ *  - PNG: RGBA PNG, deflated with zlib when it is available
+ */
+class Encoder {
+ public:
+  Encoder() = delete;
+
+  /**
+   * Default dtor
+   */
+  virtual ~Encoder() = default;
+
+  /**
+   * Creates an encoder for the format named by a file's extension
+   * @param file file name to choose the format by
+   * @param out stream to write the image to
+   * @param width image width
+   * @param height image height
+   * @return encoder, or nullptr if the format is not supported
+   */
+  static auto from(const std::string& file,
+                   std::ostream& out,
+                   uint64_t width,
+                   uint64_t height) -> std::unique_ptr<Encoder>;
+
+  /**
+   * Determines whether a file's extension names a supported format
+   * @param file file name to check
+   * @return whether `from` can create an encoder for the file
+   */
+  static auto supports(const std::string& file) -> bool;
+
+  /**
+   * Encodes the next row of the image
+   * @param row `width` RGBA pixels
+   * @throws std::logic_error if every row has already been written
+   */
+  void writeRow(const uint8_t* row);
+
+  /**
+   * Completes the image after its last row
+   * @throws std::logic_error if not every row has been written
+   */
+  void finish();
+
+ protected:
+  /**
+   * Creates an encoder of an image of a width and height
+   * @param out stream to write the image to
+   * @param width image width
+   * @param height image height
+   */
+  Encoder(std::ostream& out, uint64_t width, uint64_t height);
+
+  /**
+   * Encodes one row of the image
+   * @param row `width` RGBA pixels
+   */
+  virtual void encodeRow(const uint8_t* row) = 0;
+
+  /**
+   * Writes anything that must follow the last row
+   */
+  virtual void encodeEnd() = 0;
+
+  std::ostream& out;
+  uint64_t width, height;
+
+ private:
+  /**
+   * Returns the lowercase extension of a file name
+   * @param file file name
+   * @return extension, without its dot
+   */
+  static auto extension(const std::string& file) -> std::string;
+
+  uint64_t rows = 0;
+};
+
+/**
+ * Writes a raw RGBA netpbm (PAM) image
+ */
+class PAMEncoder : public Encoder {
+ public:
+  /**
+   * Creates a PAM encoder, writing its header
+   * @param out stream to write the image to
+   * @param width image width
+   * @param height image height
+   */
+  PAMEncoder(std::ostream& out, uint64_t width, uint64_t height);
+
+ protected:
+  /**
+   * Writes one row of the image as is
+   * @param row `width` RGBA pixels
+   */
+  void encodeRow(const uint8_t* row) override;
+
+  /**
+   * PAM images have no trailer
+   */
+  void encodeEnd() override;
+};
+
+/**
+ * Writes a raw RGB netpbm (PPM) image. Alpha is discarded.
+ */
+class PPMEncoder : public Encoder {
+ public:
+  /**
+   * Creates a PPM encoder, writing its header
+   * @param out stream to write the image to
+   * @param width image width
+   * @param height image height
+   */
+  PPMEncoder(std::ostream& out, uint64_t width, uint64_t height);
+
+ protected:
+  /**
+   * Writes one row of the image without its alpha channel
+   * @param row `width` RGBA pixels
+   */
+  void encodeRow(const uint8_t* row) override;
+
+  /**
+   * PPM images have no trailer
+   */
+  void encodeEnd() override;
+
+ private:
+  std::vector<uint8_t> rgb;
+};
+
+/**
+ * Writes an 8-bit RGBA PNG image. Compressed data is emitted in IDAT chunks
+ * as it is produced.
+ */
+class PNGEncoder : public Encoder {
+ public:
+  /**
+   * How image data is deflated
+   *  - Stored: uncompressed deflate blocks
+   *  - RunLength: repeated pixels as back-references, with fixed Huffman codes
+   *  - Deflate: zlib's fastest level, or RunLength without zlib
+   */
+  enum class Compression { Stored, RunLength, Deflate };
+
+  /**
+   * Creates a PNG encoder, writing its signature and header
+   * @param out stream to write the image to
+   * @param width image width
+   * @param height image height
+   * @param compression how to compress image data
+   */
+  PNGEncoder(std::ostream& out,
+             uint64_t width,
+             uint64_t height,
+             Compression compression = Compression::Deflate);
+
+ protected:
+  /**
+   * Filters and compresses one row of the image
+   * @param row `width` RGBA pixels
+   */
+  void encodeRow(const uint8_t* row) override;
+
+  /**
+   * Ends the compressed stream and writes the remaining chunks
+   */
+  void encodeEnd() override;
+
+ private:
+  /**
+   * Ends and frees a zlib stream
+   */
+  struct ZlibDeleter {
+    /**
+     * Releases a zlib stream
+     * @param stream stream to release
+     */
+    void operator()(z_stream_s* stream) const;
+  };
+
+  /**
+   * Size of the IDAT chunks compressed data is split into
+   */
+  static constexpr uint64_t chunkSize = 1 << 16;
+
+  /**
+   * Largest stored deflate block
+   */
+  static constexpr uint64_t storedBlockSize = 0xffff;
+
+  /**
+   * Writes a PNG chunk with its length and checksum
+   * @param type chunk type
+   * @param data chunk data
+   * @param size chunk data size
+   */
+  void writeChunk(const char* type, const uint8_t* data, uint64_t size);
+
+  /**
+   * Writes buffered compressed data as IDAT chunks
+   * @param all whether to write a final partial chunk
+   */
+  void flushData(bool all);
+
+  /**
+   * Adds uncompressed image data to the current stored block, writing out
+   * blocks as they fill
+   * @param bytes data to add
+   * @param size size of data
+   */
+  void storeData(const uint8_t* bytes, uint64_t size);
+
+  /**
+   * Compresses image data as literals and back-references to the previous
+   * pixel
+   * @param bytes data to compress
+   * @param size size of data
+   */
+  void runLengthData(const uint8_t* bytes, uint64_t size);
+
+  /**
+   * Compresses image data with zlib
+   * @param bytes data to compress
+   * @param size size of data
+   * @param flush zlib flush mode
+   */
+  void zlibData(const uint8_t* bytes, uint64_t size, int flush);
+
+  /**
+   * Appends bits to the compressed data, least significant bit first
+   * @param value bits to append
+   * @param count number of bits
+   */
+  void putBits(uint32_t value, uint32_t count);
+
+  /**
+   * Appends a symbol of the fixed Huffman literal/length code
+   * @param symbol literal or length symbol to append
+   */
+  void putSymbol(uint32_t symbol);
+
+  /**
+   * Appends a back-reference of a length to the previous pixel
+   * @param length match length, in [3, 258]
+   */
+  void putMatch(uint32_t length);
+
+  /**
+   * Writes a 32-bit value in big-endian byte order
+   * @param dest buffer to write to
+   * @param value value to write
+   */
+  static void putBigEndian(uint8_t* dest, uint32_t value);
+
+  /**
+   * Updates a CRC-32 checksum, as used by PNG chunks
+   * @param crc checksum so far, 0 to start
+   * @param data data to checksum
+   * @param size size of data
+   * @return updated checksum
+   */
+  static auto crc32(uint32_t crc, const uint8_t* data, uint64_t size) -> uint32_t;
+
+  /**
+   * Updates an Adler-32 checksum, as used by zlib streams
+   * @param adler checksum so far, 1 to start
+   * @param data data to checksum
+   * @param size size of data
+   * @return updated checksum
+   */
+  static auto adler32(uint32_t adler, const uint8_t* data, uint64_t size) -> uint32_t;
+
+  Compression compression;
+  std::unique_ptr<z_stream_s, ZlibDeleter> zlib;
+  std::vector<uint8_t> filtered;
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> block;
+  std::array<uint8_t, 4> history{};
+  uint64_t consumed = 0;
+  uint32_t adler = 1;
+  uint64_t bits = 0;
+  uint32_t bitCount = 0;
+};
+
+#endif
@@ -9,13 +9,14 @@
  * A renderer interface for specific rendering applications to extend, currently
  * for the Canvas.
  *
- * Allows for rendering various display commands through visitation.
+ * Renderers iterate a display list directly, dispatching on each command's
+ * type.
  */
 class Renderer {
  public:
   virtual ~Renderer() = default;
 
-  virtual void render(const Display::RectangleCmd&) = 0;
+  virtual void render(const Display::DisplayList&) = 0;
 };
 
 #endif  // VISITOR_HPP
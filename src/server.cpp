@@ -0,0 +1,364 @@
+// sherpa_41's Server module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef SERVER_CPP
+#define SERVER_CPP
+
+#include "server.h"
+
+#ifndef _WIN32
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "layout.h"
+#include "renderer/canvas.h"
+#include "renderer/encoder.h"
+#include "style.h"
+#include "trace.h"
+
+#ifdef MSG_NOSIGNAL
+static constexpr int sendFlags = MSG_NOSIGNAL;
+#else
+static constexpr int sendFlags = 0;
+#endif
+
+/**
+ * Creates a server listening on a socket, replacing any stale socket file
+ * @param path path of the socket
+ * @param cacheSize largest total size of the canvases kept warm, in bytes
+ * @param cacheDirectory directory to keep parsed sources in, or empty
+ * @param timeout longest a client may take to send a request, or to take a
+ *        response
+ */
+Server::RenderServer::RenderServer(std::string path,
+                                   uint64_t cacheSize,
+                                   std::string cacheDirectory,
+                                   std::chrono::milliseconds timeout)
+    : path(std::move(path)),
+      listener(socket(AF_UNIX, SOCK_STREAM, 0)),
+      timeout(timeout),
+      running(true),
+      parses(parseCacheSize, std::move(cacheDirectory)),
+      canvases(cacheSize) {
+  if (listener < 0) {
+    throw std::runtime_error("Cannot create socket: " + std::string(std::strerror(errno)));
+  }
+
+  unlink(this->path.c_str());
+  if (!open(this->path, listener, true) || listen(listener, SOMAXCONN) != 0) {
+    const std::string error(std::strerror(errno));
+    close(listener);
+    throw std::runtime_error("Cannot listen on " + this->path + ": " + error);
+  }
+}
+
+/**
+ * Closes and removes the socket
+ */
+Server::RenderServer::~RenderServer() {
+  close(listener);
+  unlink(path.c_str());
+}
+
+/**
+ * Accepts and answers connections until stopped. Connections are answered
+ * one at a time, so the caches need no locking. Each message has a deadline,
+ * and each connection a number of requests, so that one client cannot starve
+ * the others.
+ */
+void Server::RenderServer::serve() {
+  while (running) {
+    const int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (running) {
+      answer(fd);
+    }
+    close(fd);
+  }
+}
+
+/**
+ * Stops the server. A waiting server is woken by connecting to it.
+ */
+void Server::RenderServer::stop() {
+  running = false;
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd >= 0) {
+    open(path, fd, false);
+    close(fd);
+  }
+}
+
+/**
+ * Renders a single request, reusing its parsed CSS and HTML and a canvas of
+ * its size when they are cached. Canvases are cached by their size in bytes.
+ * @param request request to render
+ * @return encoded image, or the reason the request failed
+ */
+auto Server::RenderServer::handle(const Request& request) -> Response {
+  TRACE_SPAN("server", "RenderServer::handle");
+  const auto bytes = static_cast<uint64_t>(request.width) * request.height * 4;
+  if (request.width == 0 || request.height == 0 || request.width > maxSize ||
+      request.height > maxSize || bytes > maxCanvasBytes) {
+    return Response{false, "Invalid size"};
+  }
+  if (!Encoder::supports("." + request.format)) {
+    return Response{false, "Unsupported format " + request.format};
+  }
+
+  const auto stylesheet = parses.stylesheet(request.css);
+  const auto dom = parses.document(request.html);
+
+  const auto size = static_cast<uint64_t>(request.width) << 32 | request.height;
+  std::shared_ptr<Canvas> canvas;
+  if (const auto cached = canvases.find(size)) {
+    canvas = *cached;
+  } else {
+    canvas = std::make_shared<Canvas>(request.width, request.height);
+    if (bytes <= canvases.getCapacity()) {
+      canvases.insert(size, canvas, bytes);
+    }
+  }
+
+  auto styledDom = Style::StyledNode::from(dom, *stylesheet);
+  const Layout::Rectangle frame(0, 0, request.width, request.height);
+  auto layout = Layout::Box::from(styledDom, Layout::BoxDimensions(frame));
+  canvas->scrollTo(layout, 0, 0);
+
+  std::stringstream image;
+  auto encoder = Encoder::from("." + request.format, image, request.width, request.height);
+  canvas->encode(*encoder);
+  encoder->finish();
+  return Response{true, image.str()};
+}
+
+/**
+ * Sends a request to a server and waits for its response
+ * @param path path of the server's socket
+ * @param request request to send
+ * @return server's response
+ */
+auto Server::RenderServer::request(const std::string& path, const Request& request)
+    -> Response {
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || !open(path, fd, false)) {
+    const std::string error(std::strerror(errno));
+    if (fd >= 0) {
+      close(fd);
+    }
+    throw std::runtime_error("Cannot connect to " + path + ": " + error);
+  }
+
+  const uint32_t size[2] = {request.width, request.height};
+  const auto never = Clock::time_point::max();
+  uint8_t status(1);
+  Response response{false, ""};
+  const bool ok =
+      writeAll(fd, size, sizeof(size), never) && writeField(fd, request.format, never) &&
+      writeField(fd, request.html, never) && writeField(fd, request.css, never) &&
+      readAll(fd, &status, 1, never) && readField(fd, response.body, UINT32_MAX, never);
+  close(fd);
+
+  if (!ok) {
+    throw std::runtime_error("Connection to " + path + " was lost");
+  }
+  response.ok = status == 0;
+  return response;
+}
+
+/**
+ * Answers requests on a connection until the client closes it, or has sent
+ * `maxRequests` requests. Requests that cannot be read in time end the
+ * connection, as do responses that cannot be written in time.
+ * @param fd connection to answer
+ */
+void Server::RenderServer::answer(int fd) {
+  for (uint32_t served = 0; running && served < maxRequests; ++served) {
+    uint32_t size[2];
+    Request request;
+    const auto received = Clock::now() + timeout;
+    if (!readAll(fd, size, sizeof(size), received) ||
+        !readField(fd, request.format, 16, received) ||
+        !readField(fd, request.html, maxDocument, received) ||
+        !readField(fd, request.css, maxDocument, received)) {
+      return;
+    }
+    request.width = size[0];
+    request.height = size[1];
+
+    Response response;
+    try {
+      response = handle(request);
+    } catch (const std::exception& exc) {
+      response = Response{false, exc.what()};
+    }
+
+    const uint8_t status = response.ok ? 0 : 1;
+    const auto sent = Clock::now() + timeout;
+    if (!writeAll(fd, &status, 1, sent) || !writeField(fd, response.body, sent)) {
+      return;
+    }
+  }
+}
+
+/**
+ * Opens a Unix domain socket address for a path
+ * @param path path of the socket
+ * @param fd socket to connect or bind
+ * @param bind whether to bind, rather than connect
+ * @return whether the operation succeeded
+ */
+auto Server::RenderServer::open(const std::string& path, int fd, bool bind) -> bool {
+  sockaddr_un address{};
+  if (path.size() >= sizeof(address.sun_path)) {
+    errno = ENAMETOOLONG;
+    return false;
+  }
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+  const auto addr = reinterpret_cast<const sockaddr*>(&address);
+  if (bind) {
+    return ::bind(fd, addr, sizeof(address)) == 0;
+  }
+  return connect(fd, addr, sizeof(address)) == 0;
+}
+
+/**
+ * Writes a message field of bytes, preceded by its length
+ * @param fd socket to write to
+ * @param bytes bytes to write
+ * @param deadline time by which the whole message must be written
+ * @return whether the write succeeded
+ */
+auto Server::RenderServer::writeField(int fd,
+                                      const std::string& bytes,
+                                      Clock::time_point deadline) -> bool {
+  const auto length = static_cast<uint32_t>(bytes.size());
+  return writeAll(fd, &length, sizeof(length), deadline) &&
+         writeAll(fd, bytes.data(), bytes.size(), deadline);
+}
+
+/**
+ * Reads a message field of bytes, preceded by its length
+ * @param fd socket to read from
+ * @param bytes read bytes
+ * @param limit largest length to accept
+ * @param deadline time by which the whole message must be read
+ * @return whether the read succeeded
+ */
+auto Server::RenderServer::readField(int fd,
+                                     std::string& bytes,
+                                     uint32_t limit,
+                                     Clock::time_point deadline) -> bool {
+  uint32_t length;
+  if (!readAll(fd, &length, sizeof(length), deadline) || length > limit) {
+    return false;
+  }
+  bytes.resize(length);
+  return readAll(fd, &bytes[0], length, deadline);
+}
+
+/**
+ * Writes raw bytes to a socket, retrying short and interrupted writes, each
+ * once the socket can take more
+ * @param fd socket to write to
+ * @param data bytes to write
+ * @param size number of bytes
+ * @param deadline time by which the whole message must be written
+ * @return whether every byte was written in time
+ */
+auto Server::RenderServer::writeAll(int fd,
+                                    const void* data,
+                                    uint64_t size,
+                                    Clock::time_point deadline) -> bool {
+  auto bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    if (!wait(fd, POLLOUT, deadline)) {
+      return false;
+    }
+    const auto written = send(fd, bytes, size, sendFlags);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    } else if (written <= 0) {
+      return false;
+    }
+    bytes += written;
+    size -= static_cast<uint64_t>(written);
+  }
+  return true;
+}
+
+/**
+ * Reads raw bytes from a socket, retrying short and interrupted reads, each
+ * once the socket has more
+ * @param fd socket to read from
+ * @param data buffer to read into
+ * @param size number of bytes
+ * @param deadline time by which the whole message must be read
+ * @return whether every byte was read in time
+ */
+auto Server::RenderServer::readAll(int fd,
+                                   void* data,
+                                   uint64_t size,
+                                   Clock::time_point deadline) -> bool {
+  auto bytes = static_cast<char*>(data);
+  while (size > 0) {
+    if (!wait(fd, POLLIN, deadline)) {
+      return false;
+    }
+    const auto received = recv(fd, bytes, size, 0);
+    if (received < 0 && errno == EINTR) {
+      continue;
+    } else if (received <= 0) {
+      return false;
+    }
+    bytes += received;
+    size -= static_cast<uint64_t>(received);
+  }
+  return true;
+}
+
+/**
+ * Waits until a socket is ready, or a deadline passes, retrying interrupted
+ * waits with the time that is left
+ * @param fd socket to wait on
+ * @param events poll events to wait for
+ * @param deadline time to stop waiting at, or the largest time point to wait
+ *        indefinitely
+ * @return whether the socket became ready, or failed, before the deadline
+ */
+auto Server::RenderServer::wait(int fd, short events, Clock::time_point deadline) -> bool {
+  pollfd ready{fd, events, 0};
+  while (true) {
+    int left = -1;
+    if (deadline != Clock::time_point::max()) {
+      const auto remaining =
+          std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now()).count();
+      left = static_cast<int>(std::clamp<int64_t>(remaining, 0, INT_MAX));
+    }
+    const int polled = poll(&ready, 1, left);
+    if (polled < 0 && errno == EINTR) {
+      continue;
+    }
+    return polled > 0;
+  }
+}
+
+#endif
+
+#endif
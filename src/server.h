@@ -0,0 +1,225 @@
+// sherpa_41's Server module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#ifndef _WIN32
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "cache.h"
+#include "css.h"
+
+class Canvas;
+
+/**
+ * The Server module keeps a renderer running behind a Unix domain socket, so
+ * that clients pay neither process startup nor parsing for each render.
+ * Parsed style sheets and documents, and canvases, are kept warm in LRU
+ * caches. A client must send each request, and take each response, within
+ * the server's timeout, or it is disconnected, so that however slowly it
+ * trickles its bytes it cannot hold up the clients behind it.
+ *
+ * A connection carries up to `maxRequests` requests, each answered in turn,
+ * after which the server moves on to the next connection. Every message is a
+ * sequence of fields in host byte order:
+ *  - request: u32 width, u32 height, then the output format ("png", "ppm", or
+ *    "pam"), the HTML, and the CSS, each as a u32 length and its bytes
+ *  - response: u8 status (0 on success), then the encoded image or an error
+ *    message as a u32 length and its bytes
+ */
+namespace Server {
+/**
+ * A document to render, and the image format to reply with
+ */
+struct Request {
+  uint32_t width;
+  uint32_t height;
+  std::string format;
+  std::string html;
+  std::string css;
+};
+
+/**
+ * The reply to a request: an encoded image, or an error message
+ */
+struct Response {
+  bool ok;
+  std::string body;
+};
+
+/**
+ * Renders requests from clients of a Unix domain socket, one at a time
+ */
+class RenderServer {
+ public:
+  RenderServer() = delete;
+  RenderServer(const RenderServer&) = delete;
+
+  /**
+   * Creates a server listening on a socket, replacing any stale socket file
+   * @param path path of the socket
+   * @param cacheSize largest total size of the canvases kept warm, in bytes
+   * @param cacheDirectory directory to keep parsed sources in between runs of
+   *        the server, or empty to keep them in memory only
+   * @param timeout longest a client may take to send a whole request, or to
+   *        take a whole response
+   * @throws std::runtime_error if the socket cannot be created
+   */
+  explicit RenderServer(std::string path,
+                        uint64_t cacheSize = canvasCacheSize,
+                        std::string cacheDirectory = "",
+                        std::chrono::milliseconds timeout = std::chrono::seconds(10));
+
+  /**
+   * Closes and removes the socket
+   */
+  ~RenderServer();
+
+  /**
+   * Accepts and answers connections until stopped
+   */
+  void serve();
+
+  /**
+   * Stops the server, waking it if it is waiting for a connection. Safe to
+   * call from another thread, and before the server is served.
+   */
+  void stop();
+
+  /**
+   * Renders a single request
+   * @param request request to render
+   * @return encoded image, or the reason the request failed
+   */
+  auto handle(const Request& request) -> Response;
+
+  /**
+   * Sends a request to a server and waits for its response
+   * @param path path of the server's socket
+   * @param request request to send
+   * @return server's response
+   * @throws std::runtime_error if the server cannot be reached
+   */
+  static auto request(const std::string& path, const Request& request) -> Response;
+
+  /**
+   * Largest HTML or CSS document a request may carry, in bytes
+   */
+  static constexpr uint32_t maxDocument = 64 << 20;
+
+  /**
+   * Largest width or height a request may ask for, in pixels
+   */
+  static constexpr uint32_t maxSize = 16384;
+
+  /**
+   * Largest canvas a request may ask for, in bytes
+   */
+  static constexpr uint64_t maxCanvasBytes = 64 << 20;
+
+  /**
+   * Most requests answered on one connection before it is closed
+   */
+  static constexpr uint32_t maxRequests = 64;
+
+  /**
+   * Largest total size of the sources of cached style sheets, and of cached
+   * documents, in bytes
+   */
+  static constexpr uint64_t parseCacheSize = 64 << 20;
+
+  /**
+   * Default largest total size of cached canvases, in bytes. Canvases larger
+   * than the cache are rendered to and dropped.
+   */
+  static constexpr uint64_t canvasCacheSize = 256 << 20;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Answers requests on a connection until the client closes it, or has sent
+   * `maxRequests` requests
+   * @param fd connection to answer
+   */
+  void answer(int fd);
+
+  /**
+   * Opens a Unix domain socket address for a path
+   * @param path path of the socket
+   * @param fd socket to connect or bind
+   * @param bind whether to bind, rather than connect
+   * @return whether the operation succeeded
+   */
+  static auto open(const std::string& path, int fd, bool bind) -> bool;
+
+  /**
+   * Writes a message field of bytes, preceded by its length
+   * @param fd socket to write to
+   * @param bytes bytes to write
+   * @param deadline time by which the whole message must be written
+   * @return whether the write succeeded
+   */
+  static auto writeField(int fd, const std::string& bytes, Clock::time_point deadline)
+      -> bool;
+
+  /**
+   * Reads a message field of bytes, preceded by its length
+   * @param fd socket to read from
+   * @param bytes read bytes
+   * @param limit largest length to accept
+   * @param deadline time by which the whole message must be read
+   * @return whether the read succeeded
+   */
+  static auto readField(int fd,
+                        std::string& bytes,
+                        uint32_t limit,
+                        Clock::time_point deadline) -> bool;
+
+  /**
+   * Writes raw bytes to a socket
+   * @param fd socket to write to
+   * @param data bytes to write
+   * @param size number of bytes
+   * @param deadline time by which the whole message must be written
+   * @return whether every byte was written in time
+   */
+  static auto writeAll(int fd, const void* data, uint64_t size, Clock::time_point deadline)
+      -> bool;
+
+  /**
+   * Reads raw bytes from a socket
+   * @param fd socket to read from
+   * @param data buffer to read into
+   * @param size number of bytes
+   * @param deadline time by which the whole message must be read
+   * @return whether every byte was read in time
+   */
+  static auto readAll(int fd, void* data, uint64_t size, Clock::time_point deadline)
+      -> bool;
+
+  /**
+   * Waits until a socket is ready, or a deadline passes
+   * @param fd socket to wait on
+   * @param events poll events to wait for
+   * @param deadline time to stop waiting at
+   * @return whether the socket became ready before the deadline
+   */
+  static auto wait(int fd, short events, Clock::time_point deadline) -> bool;
+
+  std::string path;
+  int listener;
+  std::chrono::milliseconds timeout;
+  std::atomic<bool> running;
+  ParseCache parses;
+  LRUCache<uint64_t, std::shared_ptr<Canvas>> canvases;
+};
+}  // namespace Server
+
+#endif
+
+#endif
@@ -0,0 +1,534 @@
+// sherpa_41's Stats module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef STATS_CPP
+#define STATS_CPP
+
+#include "stats.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <new>
+#include <ostream>
+#include <unordered_set>
+
+/**
+ * Counters and memory of each thread. Zero-initialized, so that operator new
+ * can count into them before any constructor runs.
+ */
+static thread_local Stats::Counters counters;
+static thread_local Stats::Memory threadMemory;
+
+#ifdef HAVE_ALLOC_HOOKS
+/**
+ * Prefix of each allocation: its size, and its offset from the start of the
+ * block it was allocated in
+ */
+struct Header {
+  std::size_t size;
+  std::size_t offset;
+};
+
+/**
+ * Space before each allocation that holds its header, keeping the
+ * allocation aligned for any type
+ */
+static constexpr std::size_t headerSize = alignof(std::max_align_t);
+static_assert(sizeof(Header) <= headerSize, "allocation header does not fit");
+
+/**
+ * Allocates aligned memory prefixed with its header, counting the allocation
+ * for the calling thread
+ * @param size number of bytes
+ * @param alignment alignment of the memory, a power of 2
+ * @return allocated memory, or nullptr if it cannot be allocated
+ */
+static auto allocate(std::size_t size, std::size_t alignment = headerSize) noexcept
+    -> void* {
+  alignment = std::max(alignment, headerSize);
+  // malloc aligns for any type, so at most `alignment - headerSize` bytes are
+  // skipped to align the memory past its header
+  auto base = static_cast<char*>(std::malloc(size + alignment));
+  if (base == nullptr) {
+    return nullptr;
+  }
+  const auto address = reinterpret_cast<std::uintptr_t>(base) + headerSize;
+  const auto offset = ((address + alignment - 1) & ~(alignment - 1)) -
+                      reinterpret_cast<std::uintptr_t>(base);
+  const Header header{size, offset};
+  std::memcpy(base + offset - headerSize, &header, sizeof(header));
+
+  ++counters.allocations;
+  counters.allocatedBytes += size;
+  threadMemory.live += static_cast<int64_t>(size);
+  threadMemory.peak = std::max(threadMemory.peak, threadMemory.live);
+  return base + offset;
+}
+
+/**
+ * Frees memory from `allocate`, uncounting its size from the calling thread
+ * @param allocated memory to free, or nullptr
+ */
+static void deallocate(void* allocated) noexcept {
+  if (allocated == nullptr) {
+    return;
+  }
+  Header header;
+  std::memcpy(&header, static_cast<char*>(allocated) - headerSize, sizeof(header));
+  threadMemory.live -= static_cast<int64_t>(header.size);
+  std::free(static_cast<char*>(allocated) - header.offset);
+}
+
+/**
+ * Allocates memory, counting the allocation for the calling thread
+ * @param size number of bytes
+ * @return allocated memory
+ * @throws std::bad_alloc if memory cannot be allocated
+ */
+auto operator new(std::size_t size) -> void* {
+  if (void* allocated = allocate(size)) {
+    return allocated;
+  }
+  throw std::bad_alloc();
+}
+
+/**
+ * Allocates an array, counting the allocation for the calling thread
+ * @param size number of bytes
+ * @return allocated memory
+ * @throws std::bad_alloc if memory cannot be allocated
+ */
+auto operator new[](std::size_t size) -> void* {
+  return operator new(size);
+}
+
+/**
+ * Allocates memory, counting the allocation for the calling thread
+ * @param size number of bytes
+ * @return allocated memory, or nullptr if it cannot be allocated
+ */
+auto operator new(std::size_t size, const std::nothrow_t&) noexcept -> void* {
+  return allocate(size);
+}
+
+/**
+ * Allocates an array, counting the allocation for the calling thread
+ * @param size number of bytes
+ * @return allocated memory, or nullptr if it cannot be allocated
+ */
+auto operator new[](std::size_t size, const std::nothrow_t&) noexcept -> void* {
+  return allocate(size);
+}
+
+/**
+ * Frees memory allocated by operator new
+ * @param allocated memory to free
+ */
+void operator delete(void* allocated) noexcept {
+  deallocate(allocated);
+}
+
+/**
+ * Frees an array allocated by operator new[]
+ * @param allocated memory to free
+ */
+void operator delete[](void* allocated) noexcept {
+  deallocate(allocated);
+}
+
+/**
+ * Frees memory allocated by operator new, of a known size
+ * @param allocated memory to free
+ */
+void operator delete(void* allocated, std::size_t) noexcept {
+  deallocate(allocated);
+}
+
+/**
+ * Frees an array allocated by operator new[], of a known size
+ * @param allocated memory to free
+ */
+void operator delete[](void* allocated, std::size_t) noexcept {
+  deallocate(allocated);
+}
+
+/**
+ * Frees memory allocated by nothrow operator new, if its constructor threw
+ * @param allocated memory to free
+ */
+void operator delete(void* allocated, const std::nothrow_t&) noexcept {
+  deallocate(allocated);
+}
+
+/**
+ * Frees an array allocated by nothrow operator new[], if a constructor threw
+ * @param allocated memory to free
+ */
+void operator delete[](void* allocated, const std::nothrow_t&) noexcept {
+  deallocate(allocated);
+}
+
+/**
+ * Allocates over-aligned memory, counting the allocation for the calling
+ * thread
+ * @param size number of bytes
+ * @param alignment alignment of the memory
+ * @return allocated memory
+ * @throws std::bad_alloc if memory cannot be allocated
+ */
+auto operator new(std::size_t size, std::align_val_t alignment) -> void* {
+  if (void* allocated = allocate(size, static_cast<std::size_t>(alignment))) {
+    return allocated;
+  }
+  throw std::bad_alloc();
+}
+
+/**
+ * Allocates an over-aligned array, counting the allocation for the calling
+ * thread
+ * @param size number of bytes
+ * @param alignment alignment of the memory
+ * @return allocated memory
+ * @throws std::bad_alloc if memory cannot be allocated
+ */
+auto operator new[](std::size_t size, std::align_val_t alignment) -> void* {
+  return operator new(size, alignment);
+}
+
+/**
+ * Allocates over-aligned memory, counting the allocation for the calling
+ * thread
+ * @param size number of bytes
+ * @param alignment alignment of the memory
+ * @return allocated memory, or nullptr if it cannot be allocated
+ */
+auto operator new(std::size_t size,
+                  std::align_val_t alignment,
+                  const std::nothrow_t&) noexcept -> void* {
+  return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+/**
+ * Allocates an over-aligned array, counting the allocation for the calling
+ * thread
+ * @param size number of bytes
+ * @param alignment alignment of the memory
+ * @return allocated memory, or nullptr if it cannot be allocated
+ */
+auto operator new[](std::size_t size,
+                    std::align_val_t alignment,
+                    const std::nothrow_t&) noexcept -> void* {
+  return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+/**
+ * Frees over-aligned memory allocated by operator new
+ * @param allocated memory to free
+ */
+void operator delete(void* allocated, std::align_val_t) noexcept {
+  deallocate(allocated);
+}
+
+/**
+ * Frees an over-aligned array allocated by operator new[]
+ * @param allocated memory to free
+ */
+void operator delete[](void* allocated, std::align_val_t) noexcept {
+  deallocate(allocated);
+}
+
+/**
+ * Frees over-aligned memory allocated by operator new, of a known size
+ * @param allocated memory to free
+ */
+void operator delete(void* allocated, std::size_t, std::align_val_t) noexcept {
+  deallocate(allocated);
+}
+
+/**
+ * Frees an over-aligned array allocated by operator new[], of a known size
+ * @param allocated memory to free
+ */
+void operator delete[](void* allocated, std::size_t, std::align_val_t) noexcept {
+  deallocate(allocated);
+}
+
+/**
+ * Frees over-aligned memory allocated by nothrow operator new, if its
+ * constructor threw
+ * @param allocated memory to free
+ */
+void operator delete(void* allocated, std::align_val_t, const std::nothrow_t&) noexcept {
+  deallocate(allocated);
+}
+
+/**
+ * Frees an over-aligned array allocated by nothrow operator new[], if a
+ * constructor threw
+ * @param allocated memory to free
+ */
+void operator delete[](void* allocated, std::align_val_t, const std::nothrow_t&) noexcept {
+  deallocate(allocated);
+}
+#endif
+
+/**
+ * Returns the work counted since an earlier snapshot
+ * @param start earlier snapshot
+ * @return difference of the counters
+ */
+auto Stats::Counters::since(const Counters& start) const -> Counters {
+  return Counters{allocations - start.allocations, allocatedBytes - start.allocatedBytes,
+                  selectorMatches - start.selectorMatches,
+                  pixelsBlended - start.pixelsBlended};
+}
+
+/**
+ * Adds other counters to *this
+ * @param rhs counters to add
+ * @return *this
+ */
+auto Stats::Counters::operator+=(const Counters& rhs) -> Counters& {
+  allocations += rhs.allocations;
+  allocatedBytes += rhs.allocatedBytes;
+  selectorMatches += rhs.selectorMatches;
+  pixelsBlended += rhs.pixelsBlended;
+  return *this;
+}
+
+/**
+ * Returns the counters of the calling thread
+ * @return thread counters
+ */
+auto Stats::local() -> Counters& {
+  return counters;
+}
+
+/**
+ * Returns the allocated memory of the calling thread
+ * @return thread memory
+ */
+auto Stats::memory() -> Memory& {
+  return threadMemory;
+}
+
+/**
+ * Returns whether allocations are tracked
+ * @return whether the allocation hooks were built
+ */
+auto Stats::tracksAllocations() -> bool {
+#ifdef HAVE_ALLOC_HOOKS
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * Records the size of something a stage built
+ * @param name what was counted
+ * @param value count
+ */
+void Stats::Report::count(const std::string& name, uint64_t value) {
+  counts.emplace_back(name, value);
+}
+
+/**
+ * Returns the measured stages
+ * @return stages, in the order they first ran
+ */
+auto Stats::Report::getStages() const -> const std::vector<Stage>& {
+  return stages;
+}
+
+/**
+ * Returns the recorded sizes
+ * @return names and counts, in the order they were recorded
+ */
+auto Stats::Report::getCounts() const -> const CountVector& {
+  return counts;
+}
+
+/**
+ * Returns the totals of every stage
+ * @return stage named "total"
+ */
+auto Stats::Report::total() const -> Stage {
+  Stage total{"total", 0, 0, 0, Counters{0, 0, 0, 0}, 0, 0};
+  for (const auto& stage : stages) {
+    total.runs += stage.runs;
+    total.wallSeconds += stage.wallSeconds;
+    total.cpuSeconds += stage.cpuSeconds;
+    total.counters += stage.counters;
+    const auto peak = std::max<int64_t>(
+        total.retainedBytes + static_cast<int64_t>(stage.peakBytes), 0);
+    total.peakBytes = std::max(total.peakBytes, static_cast<uint64_t>(peak));
+    total.retainedBytes += stage.retainedBytes;
+  }
+  return total;
+}
+
+/**
+ * Prints the report as a table of stages, followed by the recorded sizes
+ * @param out stream to print to
+ */
+void Stats::Report::print(std::ostream& out) const {
+  auto row = [&out](const Stage& stage) {
+    out << std::left << std::setw(12) << stage.name << std::right << std::fixed
+        << std::setprecision(3) << std::setw(11) << stage.wallSeconds * 1e3 << std::setw(11)
+        << stage.cpuSeconds * 1e3 << std::setw(10) << stage.counters.allocations
+        << std::setprecision(1) << std::setw(12)
+        << static_cast<double>(stage.counters.allocatedBytes) / 1024 << std::setw(11)
+        << static_cast<double>(stage.peakBytes) / 1024 << std::setw(11)
+        << static_cast<double>(stage.retainedBytes) / 1024 << std::setw(11)
+        << stage.counters.selectorMatches << std::setw(12) << stage.counters.pixelsBlended
+        << "\n";
+  };
+
+  const auto flags = out.flags();
+  const auto precision = out.precision();
+  out << std::left << std::setw(12) << "stage" << std::right << std::setw(11) << "wall ms"
+      << std::setw(11) << "cpu ms" << std::setw(10) << "allocs" << std::setw(12)
+      << "alloc KiB" << std::setw(11) << "peak KiB" << std::setw(11) << "kept KiB"
+      << std::setw(11) << "matches" << std::setw(12) << "pixels"
+      << "\n";
+  for (const auto& stage : stages) {
+    row(stage);
+  }
+  row(total());
+  out.flags(flags);
+  out.precision(precision);
+
+  for (uint64_t i = 0; i < counts.size(); ++i) {
+    out << (i > 0 ? ", " : "") << counts[i].first << ": " << counts[i].second;
+  }
+  out << (counts.empty() ? "" : "\n");
+}
+
+/**
+ * Prints the report as a JSON object. Stage and count names are printed as
+ * they are, so they must not need escaping.
+ * @param out stream to print to
+ */
+void Stats::Report::json(std::ostream& out) const {
+  auto object = [&out](const Stage& stage) {
+    out << "{\"name\": \"" << stage.name << "\", \"runs\": " << stage.runs
+        << ", \"wall_ms\": " << stage.wallSeconds * 1e3
+        << ", \"cpu_ms\": " << stage.cpuSeconds * 1e3
+        << ", \"allocations\": " << stage.counters.allocations
+        << ", \"allocated_bytes\": " << stage.counters.allocatedBytes
+        << ", \"peak_bytes\": " << stage.peakBytes
+        << ", \"retained_bytes\": " << stage.retainedBytes
+        << ", \"selector_matches\": " << stage.counters.selectorMatches
+        << ", \"pixels_blended\": " << stage.counters.pixelsBlended << "}";
+  };
+
+  out << "{\"stages\": [";
+  for (uint64_t i = 0; i < stages.size(); ++i) {
+    out << (i > 0 ? ", " : "");
+    object(stages[i]);
+  }
+  out << "], \"total\": ";
+  object(total());
+  out << ", \"counts\": {";
+  for (uint64_t i = 0; i < counts.size(); ++i) {
+    out << (i > 0 ? ", " : "") << "\"" << counts[i].first << "\": " << counts[i].second;
+  }
+  out << "}}\n";
+}
+
+/**
+ * Starts a run of a stage
+ * @return start of the run
+ */
+auto Stats::Report::begin() -> Start {
+  const Start start{local(), memory(), std::chrono::steady_clock::now(), std::clock()};
+  memory().peak = memory().live;
+  return start;
+}
+
+/**
+ * Adds a run to the measurements of a stage, adding the stage if it has not
+ * run before
+ * @param name name of the stage
+ * @param start start of the run
+ */
+void Stats::Report::end(const std::string& name, const Start& start) {
+  const auto wall =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start.wall).count();
+  const auto cpu = static_cast<double>(std::clock() - start.cpu) / CLOCKS_PER_SEC;
+  const auto counted = local().since(start.counters);
+  auto& current = memory();
+  const auto peak = static_cast<uint64_t>(
+      std::max<int64_t>(current.peak - start.memory.live, 0));
+  const auto retained = current.live - start.memory.live;
+  current.peak = std::max(current.peak, start.memory.peak);
+
+  auto stage = std::find_if(stages.begin(), stages.end(),
+                            [&name](const Stage& run) { return run.name == name; });
+  if (stage == stages.end()) {
+    stages.push_back(Stage{name, 0, 0, 0, Counters{0, 0, 0, 0}, 0, 0});
+    stage = stages.end() - 1;
+  }
+  ++stage->runs;
+  stage->wallSeconds += wall;
+  stage->cpuSeconds += cpu;
+  stage->counters += counted;
+  stage->peakBytes = std::max(stage->peakBytes, peak);
+  stage->retainedBytes += retained;
+}
+
+/**
+ * Counts the nodes of a DOM tree
+ * @param root root node
+ * @return number of nodes, root included
+ */
+auto Stats::countNodes(const DOM::Node& root) -> uint64_t {
+  uint64_t nodes(1);
+  if (auto element = dynamic_cast<const DOM::ElementNode*>(&root)) {
+    for (const auto& child : element->borrowChildren()) {
+      nodes += countNodes(*child);
+    }
+  }
+  return nodes;
+}
+
+/**
+ * Counts the distinct style structs of a styled tree
+ * @param root root node
+ * @return number of distinct structs, empty ones excluded
+ */
+auto Stats::countStyleStructs(const Style::StyledNode& root) -> uint64_t {
+  std::unordered_set<const Style::PropertyMap*> structs;
+  std::function<void(const Style::StyledNode&)> visit = [&](const auto& node) {
+    for (uint64_t group = 0; group < Style::GroupCount; ++group) {
+      if (const auto& values = node.borrowStyleStruct(static_cast<Style::Group>(group))) {
+        structs.insert(values.get());
+      }
+    }
+    for (const auto& child : node.borrowChildren()) {
+      visit(child);
+    }
+  };
+  visit(root);
+  return structs.size();
+}
+
+/**
+ * Counts the boxes of a layout tree
+ * @param root root box
+ * @return number of boxes, root included
+ */
+auto Stats::countBoxes(const Layout::Box& root) -> uint64_t {
+  uint64_t boxes(1);
+  for (const auto& child : root.borrowChildren()) {
+    boxes += countBoxes(*child);
+  }
+  return boxes;
+}
+
+#endif
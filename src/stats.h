@@ -0,0 +1,226 @@
+// sherpa_41's Stats module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <iosfwd>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "dom.h"
+#include "layout.h"
+
+/**
+ * The Stats module measures the stages of a render, so that a slow render
+ * can be pinned on the stage to blame. Each stage records its wall and CPU
+ * time, and the work counted while it ran:
+ *  - allocations, and bytes allocated, by global operator new
+ *  - the high-water mark of allocated memory, and the memory left allocated
+ *  - attempts to match a selector to an element
+ *  - pixels painted by display commands, whether blended or filled
+ *
+ * Counting costs an increment of a thread-local counter, so counts are those
+ * of the measuring thread only; memory freed by another thread than the one
+ * that allocated it is not attributed correctly.
+ *
+ * Allocations are tracked by replacing global operator new and delete, which
+ * prefixes each allocation with a 16-byte header. The hooks are only built
+ * if the project is configured with `-DALLOC_HOOKS=ON`, as they replace the
+ * allocator of the whole program; otherwise allocation and memory figures
+ * are 0.
+ */
+namespace Stats {
+/**
+ * Work counted by the pipeline
+ */
+struct Counters {
+ public:
+  /**
+   * Returns the work counted since an earlier snapshot
+   * @param start earlier snapshot
+   * @return difference of the counters
+   */
+  [[nodiscard]] auto since(const Counters& start) const -> Counters;
+
+  /**
+   * Adds other counters to *this
+   * @param rhs counters to add
+   * @return *this
+   */
+  auto operator+=(const Counters& rhs) -> Counters&;
+
+  uint64_t allocations;
+  uint64_t allocatedBytes;
+  uint64_t selectorMatches;
+  uint64_t pixelsBlended;
+};
+
+/**
+ * Memory allocated by a thread through operator new
+ */
+struct Memory {
+  int64_t live;  // negative if the thread freed more than it allocated
+  int64_t peak;  // high-water mark of live, since it was last reset
+};
+
+/**
+ * Returns the counters of the calling thread
+ * @return thread counters
+ */
+auto local() -> Counters&;
+
+/**
+ * Returns the allocated memory of the calling thread
+ * @return thread memory
+ */
+auto memory() -> Memory&;
+
+/**
+ * Returns whether allocations are tracked, i.e. whether the allocation hooks
+ * were built
+ * @return whether allocations are tracked
+ */
+auto tracksAllocations() -> bool;
+
+/**
+ * A measured stage of a render
+ */
+struct Stage {
+  std::string name;
+  uint64_t runs;
+  double wallSeconds;
+  double cpuSeconds;
+  Counters counters;
+  uint64_t peakBytes;     // high-water of memory above that at the start of a run
+  int64_t retainedBytes;  // memory left allocated by the runs, e.g. their output
+};
+
+/**
+ * Named sizes of what a render built
+ */
+using CountVector = std::vector<std::pair<std::string, uint64_t>>;
+
+/**
+ * The stages of a render, in the order they first ran, and the sizes of what
+ * they built
+ */
+class Report {
+ public:
+  /**
+   * Runs and measures the work of a stage. A stage that runs more than once,
+   * such as rasterizing each strip of a page, accumulates its measurements.
+   * @tparam Work type of the work
+   * @param name name of the stage
+   * @param work work to run
+   * @return result of the work
+   */
+  template <typename Work>
+  auto measure(const std::string& name, Work&& work) -> decltype(work()) {
+    const auto start = begin();
+    if constexpr (std::is_void_v<decltype(work())>) {
+      work();
+      end(name, start);
+    } else {
+      auto result = work();
+      end(name, start);
+      return result;
+    }
+  }
+
+  /**
+   * Records the size of something a stage built, e.g. the number of nodes
+   * @param name what was counted
+   * @param value count
+   */
+  void count(const std::string& name, uint64_t value);
+
+  /**
+   * Returns the measured stages
+   * @return stages, in the order they first ran
+   */
+  [[nodiscard]] auto getStages() const -> const std::vector<Stage>&;
+
+  /**
+   * Returns the recorded sizes
+   * @return names and counts, in the order they were recorded
+   */
+  [[nodiscard]] auto getCounts() const -> const CountVector&;
+
+  /**
+   * Returns the totals of every stage. The peak is that of the stages run
+   * one after the other, each keeping the memory its runs retained.
+   * @return stage named "total"
+   */
+  [[nodiscard]] auto total() const -> Stage;
+
+  /**
+   * Prints the report as a human-readable table
+   * @param out stream to print to
+   */
+  void print(std::ostream& out) const;
+
+  /**
+   * Prints the report as a JSON object, of the form
+   * `{"stages": [{"name": ..., "wall_ms": ..., ...}], "counts": {...}}`
+   * @param out stream to print to
+   */
+  void json(std::ostream& out) const;
+
+ private:
+  /**
+   * Where a run of a stage started
+   */
+  struct Start {
+    Counters counters;
+    Memory memory;
+    std::chrono::steady_clock::time_point wall;
+    std::clock_t cpu;
+  };
+
+  /**
+   * Starts a run of a stage, resetting the memory high-water mark
+   * @return start of the run
+   */
+  static auto begin() -> Start;
+
+  /**
+   * Adds a run to the measurements of a stage, restoring the high-water mark
+   * for any enclosing run
+   * @param name name of the stage
+   * @param start start of the run
+   */
+  void end(const std::string& name, const Start& start);
+
+  std::vector<Stage> stages;
+  CountVector counts;
+};
+
+/**
+ * Counts the nodes of a DOM tree
+ * @param root root node
+ * @return number of nodes, root included
+ */
+auto countNodes(const DOM::Node& root) -> uint64_t;
+
+/**
+ * Counts the distinct style structs of a styled tree. A tree whose nodes
+ * shared none would have as many per group as it has nodes.
+ * @param root root node
+ * @return number of distinct structs, empty ones excluded
+ */
+auto countStyleStructs(const Style::StyledNode& root) -> uint64_t;
+
+/**
+ * Counts the boxes of a layout tree
+ * @param root root box
+ * @return number of boxes, root included
+ */
+auto countBoxes(const Layout::Box& root) -> uint64_t;
+}  // namespace Stats
+
+#endif
@@ -5,26 +5,185 @@
 
 #include "style.h"
 
+#include <algorithm>
+#include <functional>
+
+#include "stats.h"
+#include "trace.h"
+
+/**
+ * Returns the group of an inherited property
+ * @param property property name
+ * @return group of the property, or nothing if it is not inherited
+ */
+auto Style::groupOf(std::string_view property) -> std::optional<Group> {
+  // sorted by name, for a binary search
+  static constexpr std::array<std::pair<std::string_view, Group>, 20> groups{{
+      {"color", Text},
+      {"cursor", Text},
+      {"direction", Text},
+      {"font", Font},
+      {"font-family", Font},
+      {"font-size", Font},
+      {"font-style", Font},
+      {"font-variant", Font},
+      {"font-weight", Font},
+      {"letter-spacing", Text},
+      {"line-height", Font},
+      {"list-style", Text},
+      {"list-style-position", Text},
+      {"list-style-type", Text},
+      {"text-align", Text},
+      {"text-indent", Text},
+      {"text-transform", Text},
+      {"visibility", Text},
+      {"white-space", Text},
+      {"word-spacing", Text},
+  }};
+  const auto group = std::lower_bound(
+      groups.begin(), groups.end(), property,
+      [](const auto& entry, std::string_view name) { return entry.first < name; });
+  return group != groups.end() && group->first == property ? std::optional(group->second)
+                                                           : std::nullopt;
+}
+
+/**
+ * Adds an element below the current ones, adding its tag, id, classes, and
+ * attribute names to the filter
+ * @param element element to add
+ */
+void Style::Ancestors::push(const DOM::ElementNode& element) {
+  const auto start = keys.size();
+  keys.push_back(hash(Tag, element.tagName()));
+  const auto id = element.getId();
+  if (!id.empty()) {
+    keys.push_back(hash(Id, id));
+  }
+  for (const auto& klass : element.getClasses()) {
+    keys.push_back(hash(Class, klass));
+  }
+  for (const auto& attribute : element.borrowAttributes()) {
+    keys.push_back(hash(Attribute, attribute.first));
+  }
+  for (auto key = keys.begin() + static_cast<int64_t>(start); key != keys.end(); ++key) {
+    update(*key, true);
+  }
+  keyCounts.push_back(keys.size() - start);
+  elements.push_back(&element);
+}
+
+/**
+ * Removes the last element added, and its names from the filter
+ */
+void Style::Ancestors::pop() {
+  for (uint64_t i = 0; i < keyCounts.back(); ++i) {
+    update(keys.back(), false);
+    keys.pop_back();
+  }
+  keyCounts.pop_back();
+  elements.pop_back();
+}
+
+/**
+ * Borrows the elements
+ * @return elements, root first
+ */
+auto Style::Ancestors::borrowElements() const
+    -> const std::vector<const DOM::ElementNode*>& {
+  return elements;
+}
+
+/**
+ * Determines whether the ancestors could match the ancestor compounds of a
+ * selector: every tag, id, class, and attribute they name must be in the
+ * filter
+ * @param selector selector to check
+ * @return false if the selector cannot match
+ */
+auto Style::Ancestors::mayMatch(const CSS::Selector& selector) const -> bool {
+  return std::all_of(
+      selector.ancestors.begin(), selector.ancestors.end(), [this](const auto& compound) {
+        return (compound.tag.empty() || contains(Tag, compound.tag)) &&
+               (compound.id.empty() || contains(Id, compound.id)) &&
+               std::all_of(compound.klass.begin(), compound.klass.end(),
+                           [this](const auto& klass) { return contains(Class, klass); }) &&
+               std::all_of(compound.attributes.begin(), compound.attributes.end(),
+                           [this](const auto& attribute) {
+                             return contains(Attribute, attribute.name);
+                           });
+      });
+}
+
+/**
+ * Hashes a name into the filter's key space
+ * @param kind kind of name
+ * @param name name to hash
+ * @return hash, of which two filter indices are taken
+ */
+auto Style::Ancestors::hash(Kind kind, std::string_view name) -> uint64_t {
+  // SplitMix64 finalizer, so that both indices depend on every bit
+  uint64_t key = std::hash<std::string_view>()(name) ^ (kind * 0x9e3779b97f4a7c15ULL);
+  key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+  return key ^ (key >> 31);
+}
+
+/**
+ * Determines whether a name may have been added
+ * @param kind kind of name
+ * @param name name to look up
+ * @return false if the name was certainly not added
+ */
+auto Style::Ancestors::contains(Kind kind, std::string_view name) const -> bool {
+  const auto key = hash(kind, name);
+  constexpr uint64_t mask = (1ULL << filterBits) - 1;
+  return counters[key & mask] > 0 && counters[(key >> filterBits) & mask] > 0;
+}
+
+/**
+ * Adds or removes a hash from the filter, at two indices. Saturated counters
+ * stay saturated, which only adds false positives.
+ * @param key hash to add or remove
+ * @param add whether to add, rather than remove
+ */
+void Style::Ancestors::update(uint64_t key, bool add) {
+  constexpr uint64_t mask = (1ULL << filterBits) - 1;
+  for (const auto index : {key & mask, (key >> filterBits) & mask}) {
+    auto& counter = counters[index];
+    if (counter < UINT8_MAX) {
+      counter = add ? counter + 1 : counter - 1;
+    }
+  }
+}
+
 /**
  * Creates a Styled Node
- * @param node reference to DOM Node
+ * @param node reference to DOM Node, shared with copies of the styled node
  * @param props CSS properties to apply
  * @param children styled DOM children
+ * @param inherited style structs of inherited properties not in `props`
  */
-Style::StyledNode::StyledNode(DOM::NodePtr node,
+Style::StyledNode::StyledNode(SharedNodePtr node,
                               Style::PropertyMap props,
-                              Style::StyledNodeVector children)
-    : node(std::move(node)), props(std::move(props)), children(std::move(children)) {}
+                              Style::StyledNodeVector children,
+                              Style::StyleStructs inherited)
+    : node(std::move(node)),
+      props(std::move(props)),
+      inherited(std::move(inherited)),
+      children(std::move(children)) {}
 
 /**
- * Copy ctor
+ * Copy ctor. DOM nodes and style structs are immutable, so they are shared,
+ * not copied.
  * @param rhs StyledNode to copy
  */
 Style::StyledNode::StyledNode(const Style::StyledNode& rhs)
-    : node(rhs.node->clone()), props(), children(rhs.children) {
-  std::for_each(rhs.props.begin(), rhs.props.end(),
-                [this](const auto& prop) { props[prop.first] = prop.second->clone(); });
-}
+    : node(rhs.node),
+      props(rhs.props),
+      inherited(rhs.inherited),
+      fontSize(rhs.fontSize),
+      rootFontSize(rhs.rootFontSize),
+      children(rhs.children) {}
 
 /**
  * Returns children
@@ -35,70 +194,288 @@ auto Style::StyledNode::getChildren() const -> Style::StyledNodeVector {
 }
 
 /**
- * Creates a StyledNode tree from a DOM tree and CSS style sheet
+ * Borrows children without copying them
+ * @return reference to children
+ */
+auto Style::StyledNode::borrowChildren() const -> const Style::StyledNodeVector& {
+  return children;
+}
+
+/**
+ * Borrows the styled DOM node without cloning it
+ * @return reference to DOM node
+ */
+auto Style::StyledNode::borrowNode() const -> const DOM::Node& {
+  return *node;
+}
+
+/**
+ * Borrows the styles set on the node itself without cloning them
+ * @return reference to styles, less those it inherited
+ */
+auto Style::StyledNode::borrowProperties() const -> const Style::PropertyMap& {
+  return props;
+}
+
+/**
+ * Borrows the style struct of a group of inherited properties
+ * @param group group of the struct
+ * @return reference to the shared struct, or to nullptr if it is empty
+ */
+auto Style::StyledNode::borrowStyleStruct(Group group) const -> const Style::StyleStruct& {
+  return inherited[group];
+}
+
+/**
+ * Returns the computed font size, which `em` lengths were resolved against
+ * @return font size in px
+ */
+auto Style::StyledNode::getFontSize() const -> double {
+  return fontSize;
+}
+
+/**
+ * Returns the font size of the root element, which `rem` lengths were
+ * resolved against
+ * @return root font size in px
+ */
+auto Style::StyledNode::getRootFontSize() const -> double {
+  return rootFontSize;
+}
+
+/**
+ * Returns every computed style, inherited ones included
+ * @return copied styles
+ */
+auto Style::StyledNode::getProperties() const -> Style::PropertyMap {
+  auto res = props;
+  for (const auto& values : inherited) {
+    if (values) {
+      res.insert(values->begin(), values->end());  // the node's own take precedence
+    }
+  }
+  return res;
+}
+
+/**
+ * Creates a StyledNode tree from a DOM tree and CSS style sheet, sharing
+ * ownership of the DOM tree
+ * @param domRoot DOM root node
+ * @param css style sheet
+ * @return root to StyledNode tree
+ */
+auto Style::StyledNode::from(const SharedNodePtr& domRoot, const CSS::StyleSheet& css)
+    -> Style::StyledNode {
+  Ancestors ancestors;
+  const StyledNode none(nullptr);
+  return StyledNode::from(domRoot, css, ancestors, none);
+}
+
+/**
+ * Creates a StyledNode tree from a DOM tree owned elsewhere. The styled nodes
+ * hold pointers that do not own the DOM nodes.
  * @param domRoot DOM root node
  * @param css style sheet
  * @return root to StyledNode tree
  */
-auto Style::StyledNode::from(const DOM::NodePtr& domRoot, const CSS::StyleSheet& css)
+auto Style::StyledNode::from(const DOM::Node& domRoot, const CSS::StyleSheet& css)
     -> Style::StyledNode {
-  if (auto elem = dynamic_cast<DOM::ElementNode*>(domRoot.get())) {
-    auto children = elem->getChildren();
-    StyledNodeVector styledChildren;
-    std::transform(
-        children.begin(), children.end(), std::back_inserter(styledChildren),
-        [&css](const auto& child) { return StyledNode::from(child->clone(), css); });
+  return StyledNode::from(SharedNodePtr(SharedNodePtr(), &domRoot), css);
+}
 
-    return StyledNode(domRoot->clone(), StyledNode::mapStyles(elem, css),
-                      std::move(styledChildren));
-  } else {
-    return StyledNode(domRoot->clone());
+/**
+ * Creates a StyledNode tree from a DOM subtree, keeping track of the elements
+ * above each node as it descends. A node is styled before its children, so
+ * that they may inherit from it. Children are borrowed from the DOM, and each
+ * styled node points into it through the owner of the whole tree.
+ * @param domRoot DOM root node of the subtree, sharing ownership of the tree
+ * @param css style sheet
+ * @param ancestors elements above the subtree
+ * @param parent styled parent of the subtree, whose children are not set yet
+ * @return root to StyledNode tree
+ */
+auto Style::StyledNode::from(const SharedNodePtr& domRoot,
+                             const CSS::StyleSheet& css,
+                             Ancestors& ancestors,
+                             const StyledNode& parent) -> Style::StyledNode {
+  StyledNode styled(domRoot, PropertyMap(), StyledNodeVector(), parent.inherited);
+  styled.fontSize = parent.fontSize;
+  styled.rootFontSize = parent.rootFontSize;
+  const auto* elem = dynamic_cast<const DOM::ElementNode*>(domRoot.get());
+  if (elem == nullptr) {  // text inherits the styles of its element
+    return styled;
   }
+
+  const auto& children = elem->borrowChildren();
+  TRACE_SPAN_ARG("style", "StyledNode::from", "children", children.size());
+  StyledNode::mapStyles(elem, css, ancestors, parent, styled);
+
+  styled.children.reserve(children.size());
+  ancestors.push(*elem);
+  std::transform(children.begin(), children.end(), std::back_inserter(styled.children),
+                 [&domRoot, &css, &ancestors, &styled](const auto& child) {
+                   const SharedNodePtr shared(domRoot, child.get());
+                   return StyledNode::from(shared, css, ancestors, styled);
+                 });
+  ancestors.pop();
+  return styled;
+}
+
+/**
+ * `value` base case - no style found, nothing returned
+ * @return nothing
+ */
+auto Style::StyledNode::value() const -> std::optional<CSS::Value> {
+  return std::nullopt;
 }
 
 /**
- * `value` base case - no style found, nullptr returned
- * @return nullptr
+ * Looks up a style on the node, then in its inherited style structs
+ * @param style style to find
+ * @return borrowed value of the style, or nullptr if DNE
  */
-auto Style::StyledNode::value() const -> CSS::ValuePtr {
-  return nullptr;
+auto Style::StyledNode::find(const std::string& style) const -> const CSS::Value* {
+  const auto own = props.find(style);
+  if (own != props.end()) {
+    return &own->second;
+  }
+  const auto group = groupOf(style);
+  if (!group || !inherited[*group]) {
+    return nullptr;
+  }
+  const auto& values = *inherited[*group];
+  const auto cand = values.find(style);
+  return cand != values.end() ? &cand->second : nullptr;
 }
 
 /**
- * Builds the styles for a single DOM node
+ * Builds the styles for a single DOM node. Inherited properties are written
+ * to copies of the parent's style structs, made once per group the node
+ * sets, and every other group keeps sharing the parent's struct. Lengths
+ * relative to the font are then resolved to px, so that descendants inherit
+ * them as computed. A font-size reset to its initial value is 16px. The
+ * viewport is not known until layout, so a font-size in viewport units is
+ * rejected as invalid, leaving whichever font-size it would have overridden.
  * @param node DOM node
  * @param css style sheet to apply
- * @return map of styles
+ * @param ancestors elements above the node
+ * @param parent styled parent of the node
+ * @param styled styled node to build, whose structs and font sizes are
+ *        initially its parent's
  */
-auto Style::StyledNode::mapStyles(const DOM::ElementNode* const node,
-                                  const CSS::StyleSheet& css) -> Style::PropertyMap {
-  PropertyMap props;
-  auto rules = matchRules(node, css);
-  std::for_each(rules.begin(), rules.end(), [&props](const auto& rule) {
+void Style::StyledNode::mapStyles(const DOM::ElementNode* const node,
+                                  const CSS::StyleSheet& css,
+                                  const Ancestors& ancestors,
+                                  const StyledNode& parent,
+                                  StyledNode& styled) {
+  auto& props = styled.props;
+  auto& inherited = styled.inherited;
+  std::array<std::shared_ptr<PropertyMap>, GroupCount> written;
+  auto rules = matchRules(node, css, ancestors);
+  std::for_each(rules.begin(), rules.end(), [&](const auto& rule) {
     const auto& decls = rule.first;
 
     for (const auto& decl : decls) {
-      props[decl.name] = decl.value->clone();
+      if (decl.name == "font-size" && decl.value.getType() == CSS::Value::Length &&
+          (decl.value.getUnit() == CSS::vw || decl.value.getUnit() == CSS::vh)) {
+        continue;
+      }
+      const CSS::Value* value = &decl.value;
+      if (value->getKeyword() == CSS::Keyword::Inherit) {
+        value = parent.find(decl.name);
+      } else if (value->getKeyword() == CSS::Keyword::Initial) {
+        value = nullptr;
+      }
+
+      auto* target = &props;
+      if (const auto group = groupOf(decl.name)) {
+        auto& values = written[*group];
+        if (!values) {  // copy on first write
+          values = std::make_shared<PropertyMap>(
+              inherited[*group] ? *inherited[*group] : PropertyMap());
+        }
+        target = values.get();
+      }
+      if (value != nullptr) {
+        (*target)[decl.name] = *value;
+      } else {
+        target->erase(decl.name);
+      }
     }
   });
-  return props;
+
+  // font-size is relative to the parent's font, and other lengths to the node's
+  if (written[Font]) {
+    const auto size = written[Font]->find("font-size");
+    auto* unit = size != written[Font]->end() && size->second.getType() == CSS::Value::Length
+                     ? &size->second
+                     : nullptr;
+    if (unit != nullptr && unit->getUnit() == CSS::percent) {
+      *unit = CSS::Value::length(unit->unitValue() / 100 * parent.fontSize, CSS::px);
+    } else if (unit != nullptr) {
+      resolveFontUnits(*unit, parent.fontSize, parent.rootFontSize);
+    }
+    if (unit != nullptr && unit->getUnit() == CSS::px) {
+      styled.fontSize = unit->unitValue();
+    } else if (size == written[Font]->end()) {  // reset, so no longer the parent's
+      styled.fontSize = initialFontSize;
+    }
+  }
+  if (parent.node == nullptr) {  // the root element's font size is the rem
+    styled.rootFontSize = styled.fontSize;
+  }
+
+  for (auto* values : {&props, written[Font].get(), written[Text].get()}) {
+    if (values != nullptr) {
+      for (auto& prop : *values) {
+        resolveFontUnits(prop.second, styled.fontSize, styled.rootFontSize);
+      }
+    }
+  }
+
+  for (uint64_t group = 0; group < GroupCount; ++group) {
+    if (written[group]) {
+      inherited[group] = written[group]->empty() ? nullptr : std::move(written[group]);
+    }
+  }
+}
+
+/**
+ * Resolves a length relative to the font to px, leaving other values be
+ * @param value value to resolve
+ * @param fontSize font size in px, that is 1em
+ * @param rootFontSize font size of the root element in px, that is 1rem
+ */
+void Style::StyledNode::resolveFontUnits(CSS::Value& value,
+                                         double fontSize,
+                                         double rootFontSize) {
+  if (value.getType() != CSS::Value::Length) {
+    return;
+  }
+  if (value.getUnit() == CSS::em) {
+    value = CSS::Value::length(value.unitValue() * fontSize, CSS::px);
+  } else if (value.getUnit() == CSS::rem) {
+    value = CSS::Value::length(value.unitValue() * rootFontSize, CSS::px);
+  }
 }
 
 /**
  * Matches css rules to a DOM node
  * @param node DOM node
  * @param css style sheet to apply
+ * @param ancestors elements above the node
  * @return set of rules, ordered by increasing specificity
  */
 auto Style::StyledNode::matchRules(const DOM::ElementNode* const node,
-                                   const CSS::StyleSheet& css) -> Style::PriorityRuleSet {
+                                   const CSS::StyleSheet& css,
+                                   const Ancestors& ancestors) -> Style::PriorityRuleSet {
   PriorityRuleSet rules;
-  std::for_each(css.begin(), css.end(), [&node, &rules](const auto& rule) {
+  std::for_each(css.begin(), css.end(), [&node, &rules, &ancestors](const auto& rule) {
     const auto& sels = rule.selectors;
 
     // find first selector that matches the node
-    auto selector = std::find_if(sels.begin(), sels.end(), [&node](const auto& sel) {
-      return StyledNode::selectorMatches(sel, node);
+    auto selector = std::find_if(sels.begin(), sels.end(), [&](const auto& sel) {
+      return StyledNode::selectorMatches(sel, node, ancestors);
     });
 
     // add rule into set if it matches node
@@ -111,23 +488,77 @@ auto Style::StyledNode::matchRules(const DOM::ElementNode* const node,
 }
 
 /**
- * Determines if a selector matches a node
+ * Determines if a selector matches a node. Selectors with combinators are
+ * first checked against the ancestor filter, and only walk the ancestors if
+ * it and the node itself match.
  * @param selector selector to match
  * @param node DOM node to match
+ * @param ancestors elements above the node
  * @return whether selector matches node
  */
 auto Style::StyledNode::selectorMatches(const CSS::Selector& selector,
+                                        const DOM::ElementNode* const node,
+                                        const Ancestors& ancestors) -> bool {
+  if (!selector.ancestors.empty() && !ancestors.mayMatch(selector)) {
+    return false;
+  }
+  if (!compoundMatches(selector, node)) {
+    return false;
+  }
+  const auto& elements = ancestors.borrowElements();
+  return ancestorsMatch(selector, 0, elements.size(), elements);
+}
+
+/**
+ * Determines if the ancestor compounds of a selector match the elements
+ * above some element, backtracking over descendant combinators
+ * @param selector selector to match
+ * @param next index of the ancestor compound to match
+ * @param below number of elements above the element matched so far
+ * @param elements elements above the node, root first
+ * @return whether the remaining compounds match
+ */
+auto Style::StyledNode::ancestorsMatch(const CSS::Selector& selector,
+                                       uint64_t next,
+                                       uint64_t below,
+                                       const std::vector<const DOM::ElementNode*>& elements)
+    -> bool {
+  if (next == selector.ancestors.size()) {
+    return true;
+  }
+  const auto& compound = selector.ancestors[next];
+  if (compound.combinator == CSS::Child) {
+    return below > 0 && compoundMatches(compound, elements[below - 1]) &&
+           ancestorsMatch(selector, next + 1, below - 1, elements);
+  }
+  for (auto i = below; i-- > 0;) {
+    if (compoundMatches(compound, elements[i]) &&
+        ancestorsMatch(selector, next + 1, i, elements)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Determines if a compound selector matches a node, ignoring its ancestors
+ * @param compound selector to match
+ * @param node DOM node to match
+ * @return whether the compound matches node
+ */
+auto Style::StyledNode::compoundMatches(const CSS::Selector& compound,
                                         const DOM::ElementNode* const node) -> bool {
+  ++Stats::local().selectorMatches;
   auto tag = node->tagName();
   auto id = node->getId();
   auto cls = node->getClasses();
-  auto& checkCls = selector.klass;
+  auto& checkCls = compound.klass;
 
-  if (!selector.tag.empty() && selector.tag != tag) {
+  if (!compound.tag.empty() && compound.tag != tag) {
     return false;
   }
 
-  if (!selector.id.empty() && selector.id != id) {
+  if (!compound.id.empty() && compound.id != id) {
     return false;
   }
 
@@ -139,6 +570,22 @@ auto Style::StyledNode::selectorMatches(const CSS::Selector& selector,
     }
   }
 
+  const auto& attributes = node->borrowAttributes();
+  for (const auto& attribute : compound.attributes) {
+    const auto found = attributes.find(attribute.name);
+    if (found == attributes.end() ||
+        (attribute.match == CSS::Equals && found->second != attribute.value)) {
+      return false;
+    }
+  }
+
+  // positions were numbered when the parent was built, so no siblings are counted
+  for (const auto& pseudoClass : compound.pseudoClasses) {
+    if (node->siblingIndex() == 0 || !pseudoClass.matches(node->siblingIndex())) {
+      return false;
+    }
+  }
+
   return true;  // all selectors accounted for
 }
 
@@ -3,9 +3,14 @@
 #ifndef STYLE_HPP
 #define STYLE_HPP
 
+#include <array>
 #include <map>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 
+#include "arena.h"
 #include "css.h"
 #include "dom.h"
 
@@ -14,6 +19,20 @@
  * elements with CSS styles directly attached to them. This provides a layer of
  * separation between the DOM tree/Stylesheet parsing and the positional Layout
  * module, and arbitrarily styles ___any___ node.
+ *
+ * Inherited properties, such as `color` and the font properties, pass from a
+ * node to its children, text included, unless a child sets them itself. They
+ * are kept apart from a node's own properties, in groups of immutable style
+ * structs shared by reference count, as Gecko and Servo do: a child that sets
+ * nothing in a group shares its parent's struct, and one that does copies it
+ * once. Any property may also take the keyword `inherit`, for its parent's
+ * value, or `initial`, for none.
+ *
+ * Lengths relative to the font are computed values: `em` and `rem` are
+ * resolved to px as a node is styled, against its font size and the root
+ * element's (`font-size` itself against its parent's, and 16px when reset).
+ * Lengths relative to the viewport or the containing block are left to the
+ * Layout module, so a `font-size` in `vw` or `vh` is rejected.
  */
 namespace Style {
 
@@ -21,17 +40,107 @@ namespace Style {
 class StyledNode;
 struct RuleOrder;
 
-using StyledNodeVector = std::vector<StyledNode>;
-using PropertyMap = std::map<std::string, CSS::ValuePtr>;
+using StyledNodeVector = Arena::Vector<StyledNode>;
+using SharedNodePtr = std::shared_ptr<const DOM::Node>;
+using PropertyMap = Arena::Map<std::string, CSS::Value>;
 using ScoredRule = std::pair<CSS::DeclarationSet, CSS::Specificity>;
 using PriorityRuleSet = std::multiset<ScoredRule, RuleOrder>;
 
+/**
+ * Groups of inherited properties, each kept in a style struct
+ */
+enum Group { Font, Text, GroupCount };
+
+/**
+ * An immutable struct of the inherited properties of a group, shared by the
+ * nodes that inherit it. nullptr when the group has no properties set.
+ */
+using StyleStruct = std::shared_ptr<const PropertyMap>;
+using StyleStructs = std::array<StyleStruct, GroupCount>;
+
+/**
+ * Returns the group of an inherited property
+ * @param property property name
+ * @return group of the property, or nothing if it is not inherited
+ */
+auto groupOf(std::string_view property) -> std::optional<Group>;
+
 struct RuleOrder {
   auto operator()(const ScoredRule& a, const ScoredRule& b) const -> bool {
     return a.second < b.second;
   }
 };
 
+/**
+ * The elements above a node being styled, root first, with a counting bloom
+ * filter of their tags, ids, classes, and attribute names. A selector whose
+ * ancestor compounds name anything the filter has not seen cannot match, so
+ * most selectors with combinators are rejected without walking the ancestors.
+ */
+class Ancestors {
+ public:
+  /**
+   * Adds an element below the current ones
+   * @param element element to add
+   */
+  void push(const DOM::ElementNode& element);
+
+  /**
+   * Removes the last element added
+   */
+  void pop();
+
+  /**
+   * Borrows the elements
+   * @return elements, root first
+   */
+  [[nodiscard]] auto borrowElements() const -> const std::vector<const DOM::ElementNode*>&;
+
+  /**
+   * Determines whether the ancestors could match the ancestor compounds of a
+   * selector. False positives are possible, false negatives are not.
+   * @param selector selector to check
+   * @return false if the selector cannot match
+   */
+  [[nodiscard]] auto mayMatch(const CSS::Selector& selector) const -> bool;
+
+ private:
+  /**
+   * Kinds of names, hashed apart so that e.g. tag `a` and class `a` differ
+   */
+  enum Kind : uint64_t { Tag = 1, Id = 2, Class = 3, Attribute = 4 };
+
+  /**
+   * Hashes a name into the filter's key space
+   * @param kind kind of name
+   * @param name name to hash
+   * @return hash, of which two filter indices are taken
+   */
+  static auto hash(Kind kind, std::string_view name) -> uint64_t;
+
+  /**
+   * Determines whether a name may have been added
+   * @param kind kind of name
+   * @param name name to look up
+   * @return false if the name was certainly not added
+   */
+  [[nodiscard]] auto contains(Kind kind, std::string_view name) const -> bool;
+
+  /**
+   * Adds or removes a hash from the filter. Saturated counters stay
+   * saturated, which only adds false positives.
+   * @param key hash to add or remove
+   * @param add whether to add, rather than remove
+   */
+  void update(uint64_t key, bool add);
+
+  static constexpr uint64_t filterBits = 12;
+  std::vector<const DOM::ElementNode*> elements;
+  std::vector<uint64_t> keys;        // hashes added, element by element
+  std::vector<uint64_t> keyCounts;   // number of hashes added per element
+  std::array<uint8_t, 1ULL << filterBits> counters{};
+};
+
 /**
  * A DOM Node with CSS styles applied
  */
@@ -41,13 +150,15 @@ class StyledNode {
 
   /**
    * Creates a Styled Node
-   * @param node reference to DOM Node
+   * @param node reference to DOM Node, shared with copies of the styled node
    * @param props CSS properties to apply
    * @param children styled DOM children
+   * @param inherited style structs of inherited properties not in `props`
    */
-  explicit StyledNode(DOM::NodePtr node,
+  explicit StyledNode(SharedNodePtr node,
                       PropertyMap props = PropertyMap(),
-                      StyledNodeVector children = StyledNodeVector());
+                      StyledNodeVector children = StyledNodeVector(),
+                      StyleStructs inherited = StyleStructs());
 
   /**
    * Copy ctor
@@ -57,20 +168,19 @@ class StyledNode {
 
   /**
    * Returns the value of a style, or any number of backup styles on the node,
-   * or nullptr if the style is not applied.
+   * or nothing if the style is not applied.
    * @tparam Args variadic arguments, should be strings
    * @param style style to get
    * @param backup any number of backup styles to check
-   * @return value of style, or nullptr if DNE
+   * @return value of style, or nothing if DNE
    */
   template <typename... Args>
-  auto value(const std::string& style, const Args&... backup) const -> CSS::ValuePtr {
-    auto cand = props.find(style);
-    if (cand != props.end()) {
-      return cand->second->clone();
-    } else {
-      return value(backup...);
+  auto value(const std::string& style, const Args&... backup) const
+      -> std::optional<CSS::Value> {
+    if (const auto* cand = find(style)) {
+      return *cand;
     }
+    return value(backup...);
   }
 
   /**
@@ -85,11 +195,8 @@ class StyledNode {
   template <typename... Args>
   auto value_or(const std::string& style,
                 const Args&... backup,
-                const CSS::Value& deflt) const -> CSS::ValuePtr {
-    if (auto cand = value(style, backup...)) {
-      return cand;
-    }
-    return deflt.clone();
+                const CSS::Value& deflt) const -> CSS::Value {
+    return value(style, backup...).value_or(deflt);
   }
 
   /**
@@ -101,9 +208,8 @@ class StyledNode {
    * @return value of style, or zero if DNE
    */
   template <typename... Args>
-  auto value_or_zero(const std::string& style, const Args&... backup) const
-      -> CSS::ValuePtr {
-    return value_or<std::string>(style, backup..., CSS::UnitValue(0, CSS::px));
+  auto value_or_zero(const std::string& style, const Args&... backup) const -> CSS::Value {
+    return value_or<Args...>(style, backup..., CSS::Value::length(0, CSS::px));
   }
 
   /**
@@ -113,49 +219,175 @@ class StyledNode {
   [[nodiscard]] auto getChildren() const -> StyledNodeVector;
 
   /**
-   * Creates a StyledNode tree from a DOM tree and CSS style sheet
+   * Borrows children without copying them
+   * @return reference to children
+   */
+  [[nodiscard]] auto borrowChildren() const -> const StyledNodeVector&;
+
+  /**
+   * Borrows the styled DOM node without cloning it
+   * @return reference to DOM node
+   */
+  [[nodiscard]] auto borrowNode() const -> const DOM::Node&;
+
+  /**
+   * Borrows the styles set on the node itself without cloning them
+   * @return reference to styles, less those it inherited
+   */
+  [[nodiscard]] auto borrowProperties() const -> const PropertyMap&;
+
+  /**
+   * Borrows the style struct of a group of inherited properties
+   * @param group group of the struct
+   * @return reference to the shared struct, or to nullptr if it is empty
+   */
+  [[nodiscard]] auto borrowStyleStruct(Group group) const -> const StyleStruct&;
+
+  /**
+   * Returns the computed font size, which `em` lengths were resolved against
+   * @return font size in px
+   */
+  [[nodiscard]] auto getFontSize() const -> double;
+
+  /**
+   * Returns the font size of the root element, which `rem` lengths were
+   * resolved against
+   * @return root font size in px
+   */
+  [[nodiscard]] auto getRootFontSize() const -> double;
+
+  /**
+   * Returns every computed style, inherited ones included
+   * @return copied styles
+   */
+  [[nodiscard]] auto getProperties() const -> PropertyMap;
+
+  /**
+   * Font size of an element that sets none, nor inherits one
+   */
+  static constexpr double initialFontSize = 16;
+
+  /**
+   * Creates a StyledNode tree from a DOM tree and CSS style sheet. Keyword
+   * values of the tree view the identifiers of the style sheet, which must
+   * outlive the tree and any layout tree made from it. Styled nodes refer to
+   * the DOM nodes rather than copy them, and share ownership of the DOM tree.
+   * @param domRoot DOM root node
+   * @param css style sheet
+   * @return root to StyledNode tree
+   */
+  static auto from(const SharedNodePtr& domRoot, const CSS::StyleSheet& css) -> StyledNode;
+
+  /**
+   * Creates a StyledNode tree from a DOM tree owned elsewhere, which must
+   * outlive the tree and any layout tree made from it
    * @param domRoot DOM root node
    * @param css style sheet
    * @return root to StyledNode tree
    */
-  static auto from(const DOM::NodePtr& domRoot, const CSS::StyleSheet& css) -> StyledNode;
+  static auto from(const DOM::Node& domRoot, const CSS::StyleSheet& css) -> StyledNode;
 
  private:
   /**
-   * `value` base case - no style found, nullptr returned
-   * @return nullptr
+   * `value` base case - no style found, nothing returned
+   * @return nothing
+   */
+  [[nodiscard]] auto value() const -> std::optional<CSS::Value>;
+
+  /**
+   * Looks up a style on the node, then in its inherited style structs
+   * @param style style to find
+   * @return borrowed value of the style, or nullptr if DNE
+   */
+  [[nodiscard]] auto find(const std::string& style) const -> const CSS::Value*;
+
+  /**
+   * Creates a StyledNode tree from a DOM subtree
+   * @param domRoot DOM root node of the subtree, sharing ownership of the tree
+   * @param css style sheet
+   * @param ancestors elements above the subtree
+   * @param parent styled parent of the subtree, whose children are not set yet
+   * @return root to StyledNode tree
    */
-  [[nodiscard]] auto value() const -> CSS::ValuePtr;
+  static auto from(const SharedNodePtr& domRoot,
+                   const CSS::StyleSheet& css,
+                   Ancestors& ancestors,
+                   const StyledNode& parent) -> StyledNode;
 
   /**
-   * Builds the styles for a single DOM node
+   * Builds the styles for a single DOM node, resolving lengths relative to
+   * the font to px
    * @param node DOM node
    * @param css style sheet to apply
-   * @return map of styles
+   * @param ancestors elements above the node
+   * @param parent styled parent of the node
+   * @param styled styled node to build, whose structs and font sizes are
+   *        initially its parent's
    */
-  static auto mapStyles(const DOM::ElementNode* node, const CSS::StyleSheet& css)
-      -> PropertyMap;
+  static void mapStyles(const DOM::ElementNode* node,
+                        const CSS::StyleSheet& css,
+                        const Ancestors& ancestors,
+                        const StyledNode& parent,
+                        StyledNode& styled);
+
+  /**
+   * Resolves a length relative to the font to px, leaving other values be
+   * @param value value to resolve
+   * @param fontSize font size in px, that is 1em
+   * @param rootFontSize font size of the root element in px, that is 1rem
+   */
+  static void resolveFontUnits(CSS::Value& value, double fontSize, double rootFontSize);
 
   /**
    * Matches css rules to a DOM node
    * @param node DOM node
    * @param css style sheet to apply
+   * @param ancestors elements above the node
    * @return set of rules, ordered by increasing specificity
    */
-  static auto matchRules(const DOM::ElementNode* node, const CSS::StyleSheet& css)
-      -> PriorityRuleSet;
+  static auto matchRules(const DOM::ElementNode* node,
+                         const CSS::StyleSheet& css,
+                         const Ancestors& ancestors) -> PriorityRuleSet;
 
   /**
    * Determines if a selector matches a node
    * @param selector selector to match
    * @param node DOM node to match
+   * @param ancestors elements above the node
    * @return whether selector matches node
    */
-  static auto selectorMatches(const CSS::Selector& selector, const DOM::ElementNode* node)
+  static auto selectorMatches(const CSS::Selector& selector,
+                              const DOM::ElementNode* node,
+                              const Ancestors& ancestors) -> bool;
+
+  /**
+   * Determines if the ancestor compounds of a selector match the elements
+   * above some element, backtracking over descendant combinators
+   * @param selector selector to match
+   * @param next index of the ancestor compound to match
+   * @param below number of elements above the element matched so far
+   * @param elements elements above the node, root first
+   * @return whether the remaining compounds match
+   */
+  static auto ancestorsMatch(const CSS::Selector& selector,
+                             uint64_t next,
+                             uint64_t below,
+                             const std::vector<const DOM::ElementNode*>& elements) -> bool;
+
+  /**
+   * Determines if a compound selector matches a node, ignoring its ancestors
+   * @param compound selector to match
+   * @param node DOM node to match
+   * @return whether the compound matches node
+   */
+  static auto compoundMatches(const CSS::Selector& compound, const DOM::ElementNode* node)
       -> bool;
 
-  DOM::NodePtr node;
+  SharedNodePtr node;
   PropertyMap props;
+  StyleStructs inherited;
+  double fontSize = initialFontSize;
+  double rootFontSize = initialFontSize;
   StyledNodeVector children;
 };
 }  // namespace Style
@@ -0,0 +1,198 @@
+// sherpa_41's Trace module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef TRACE_CPP
+#define TRACE_CPP
+
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+
+
+/**
+ * Events recorded by one thread. The lock is only contended while the trace
+ * is collected.
+ */
+struct ThreadBuffer {
+  std::mutex mutex;
+  std::vector<Trace::Event> events;
+  uint64_t thread;
+};
+
+/**
+ * Buffers of every thread that has recorded an event, and the events of
+ * threads that have since exited
+ */
+struct Registry {
+  std::mutex mutex;
+  std::vector<ThreadBuffer*> buffers;
+  std::vector<Trace::Event> finished;
+  uint64_t threads = 0;
+};
+
+/**
+ * Returns the registry, created on first use so that it outlives every
+ * thread's buffer
+ * @return registry of buffers
+ */
+static auto registry() -> Registry& {
+  static Registry registry;
+  return registry;
+}
+
+static std::atomic<bool> recording(false);
+
+/**
+ * Registers a buffer for the calling thread, and hands its events to the
+ * registry when the thread exits
+ */
+struct LocalBuffer {
+  LocalBuffer() {
+    auto& all = registry();
+    std::lock_guard<std::mutex> lock(all.mutex);
+    buffer.thread = ++all.threads;
+    all.buffers.push_back(&buffer);
+  }
+
+  ~LocalBuffer() {
+    auto& all = registry();
+    std::lock_guard<std::mutex> lock(all.mutex);
+    all.finished.insert(all.finished.end(), buffer.events.begin(), buffer.events.end());
+    all.buffers.erase(std::find(all.buffers.begin(), all.buffers.end(), &buffer));
+  }
+
+  ThreadBuffer buffer;
+};
+
+/**
+ * Discards any recorded events and starts recording
+ */
+void Trace::start() {
+  auto& all = registry();
+  {
+    std::lock_guard<std::mutex> lock(all.mutex);
+    all.finished.clear();
+    for (auto buffer : all.buffers) {
+      std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+      buffer->events.clear();
+    }
+  }
+  recording = true;
+}
+
+/**
+ * Stops recording
+ */
+void Trace::stop() {
+  recording = false;
+}
+
+/**
+ * Returns whether events are being recorded
+ * @return whether recording
+ */
+auto Trace::enabled() -> bool {
+  return recording.load(std::memory_order_relaxed);
+}
+
+/**
+ * Returns the current time on the trace clock
+ * @return nanoseconds since an arbitrary epoch
+ */
+auto Trace::now() -> uint64_t {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count());
+}
+
+/**
+ * Records an event into the calling thread's buffer
+ * @param event event to record
+ */
+void Trace::record(const Event& event) {
+  thread_local LocalBuffer local;
+  std::lock_guard<std::mutex> lock(local.buffer.mutex);
+  local.buffer.events.push_back(event);
+  local.buffer.events.back().thread = local.buffer.thread;
+}
+
+/**
+ * Returns every recorded event, from running and exited threads
+ * @return events, ordered by start time
+ */
+auto Trace::events() -> std::vector<Event> {
+  auto& all = registry();
+  std::vector<Event> collected;
+  {
+    std::lock_guard<std::mutex> lock(all.mutex);
+    collected = all.finished;
+    for (auto buffer : all.buffers) {
+      std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+      collected.insert(collected.end(), buffer->events.begin(), buffer->events.end());
+    }
+  }
+  std::stable_sort(collected.begin(), collected.end(),
+                   [](const Event& a, const Event& b) { return a.start < b.start; });
+  return collected;
+}
+
+/**
+ * Writes every recorded event as a complete ("X") Chrome trace event, with
+ * times in microseconds
+ * @param out stream to write to
+ */
+void Trace::write(std::ostream& out) {
+  const auto collected = events();
+  const auto epoch = collected.empty() ? 0 : collected.front().start;
+  auto micros = [](uint64_t nanos) {
+    return std::to_string(nanos / 1000) + "." + std::to_string(nanos % 1000 / 100) +
+           std::to_string(nanos % 100 / 10) + std::to_string(nanos % 10);
+  };
+
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  for (uint64_t i = 0; i < collected.size(); ++i) {
+    const auto& event = collected[i];
+    out << (i > 0 ? ",\n" : "\n") << "{\"cat\": \"" << event.category << "\", \"name\": \""
+        << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.thread
+        << ", \"ts\": " << micros(event.start - epoch)
+        << ", \"dur\": " << micros(event.duration);
+    if (event.argName != nullptr) {
+      out << ", \"args\": {\"" << event.argName << "\": " << event.argValue << "}";
+    }
+    out << "}";
+  }
+  out << "\n]}\n";
+}
+
+/**
+ * Starts a span, if recording
+ * @param category category of the span
+ * @param name name of the span
+ * @param argName name of an argument to show with the span, or nullptr
+ * @param argValue value of the argument
+ */
+Trace::Span::Span(const char* category,
+                  const char* name,
+                  const char* argName,
+                  uint64_t argValue)
+    : event{category, name, 0, 0, 0, argName, argValue}, active(enabled()) {
+  if (active) {
+    event.start = now();
+  }
+}
+
+/**
+ * Ends the span, recording it if it was started while recording
+ */
+Trace::Span::~Span() {
+  if (active) {
+    event.duration = now() - event.start;
+    record(event);
+  }
+}
+
+#endif
@@ -0,0 +1,140 @@
+// sherpa_41's Trace module, licensed under MIT. (c) hafiz, 2018
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+/**
+ * The Trace module records spans of work as Chrome trace events, to be viewed
+ * in Perfetto (https://ui.perfetto.dev) or chrome://tracing. Where Stats
+ * totals each stage, a trace shows when and on which thread every stage,
+ * subtree, and tile was worked on.
+ *
+ * Spans are marked with the TRACE_SPAN macros, which compile to nothing
+ * unless the project is configured with `-DTRACE=ON` (defining HAVE_TRACE).
+ * When compiled in, spans are only recorded between `start` and `stop`, and
+ * cost a check of a flag otherwise.
+ *
+ * Each thread records into its own buffer, so threads do not contend while
+ * tracing. Names and categories must be string literals, or otherwise
+ * outlive the trace, and must not need escaping in JSON.
+ */
+namespace Trace {
+/**
+ * A completed span of work
+ */
+struct Event {
+  const char* category;
+  const char* name;
+  uint64_t start;     // nanoseconds since an arbitrary epoch
+  uint64_t duration;  // nanoseconds
+  uint64_t thread;    // sequential id of the recording thread, from 1
+  const char* argName;
+  uint64_t argValue;
+};
+
+/**
+ * Discards any recorded events and starts recording
+ */
+void start();
+
+/**
+ * Stops recording
+ */
+void stop();
+
+/**
+ * Returns whether events are being recorded
+ * @return whether recording
+ */
+auto enabled() -> bool;
+
+/**
+ * Returns the current time on the trace clock
+ * @return nanoseconds since an arbitrary epoch
+ */
+auto now() -> uint64_t;
+
+/**
+ * Records an event into the calling thread's buffer
+ * @param event event to record
+ */
+void record(const Event& event);
+
+/**
+ * Returns every recorded event. Threads should be done recording, e.g. by
+ * stopping the trace first.
+ * @return events, ordered by start time
+ */
+auto events() -> std::vector<Event>;
+
+/**
+ * Writes every recorded event as a Chrome trace event JSON file
+ * @param out stream to write to
+ */
+void write(std::ostream& out);
+
+/**
+ * Records the span of its own lifetime, if recording when it was created.
+ * Use through the TRACE_SPAN macros, rather than directly.
+ */
+class Span {
+ public:
+  Span() = delete;
+  Span(const Span&) = delete;
+
+  /**
+   * Starts a span
+   * @param category category of the span, e.g. the module
+   * @param name name of the span
+   * @param argName name of an argument to show with the span, or nullptr
+   * @param argValue value of the argument
+   */
+  Span(const char* category,
+       const char* name,
+       const char* argName = nullptr,
+       uint64_t argValue = 0);
+
+  /**
+   * Ends the span, recording it
+   */
+  ~Span();
+
+ private:
+  Event event;
+  bool active;
+};
+}  // namespace Trace
+
+#ifdef HAVE_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+/**
+ * Traces the rest of the enclosing scope
+ * @param category category of the span
+ * @param name name of the span
+ */
+#define TRACE_SPAN(category, name) \
+  const Trace::Span TRACE_CONCAT(traceSpan, __LINE__)(category, name)
+
+/**
+ * Traces the rest of the enclosing scope, showing an integer argument
+ * @param category category of the span
+ * @param name name of the span
+ * @param argName name of the argument
+ * @param argValue value of the argument, which is not evaluated when tracing
+ *        is compiled out
+ */
+#define TRACE_SPAN_ARG(category, name, argName, argValue)               \
+  const Trace::Span TRACE_CONCAT(traceSpan, __LINE__)(category, name, argName, \
+                                                      static_cast<uint64_t>(argValue))
+#else
+#define TRACE_SPAN(category, name) static_cast<void>(0)
+#define TRACE_SPAN_ARG(category, name, argName, argValue) static_cast<void>(0)
+#endif
+
+#endif
@@ -0,0 +1,126 @@
+// sherpa_41's Archive module test fixture, licensed under MIT. (c) hafiz, 2018
+
+#include "archive.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <fstream>
+
+#include "display.h"
+#include "parser/css.h"
+#include "parser/html.h"
+#include "util.h"
+
+class ArchiveTest : public ::testing::Test {
+ protected:
+  /**
+   * Prints a style sheet
+   * @param ss style sheet
+   * @return printed style sheet
+   */
+  static auto print(const CSS::StyleSheet& ss) -> std::string {
+    Printer printer;
+    ss.acceptVisitor(printer);
+    return printer.result();
+  }
+};
+
+TEST_F(ArchiveTest, Document) {
+  auto dom = HTMLParser(
+                 "<html lang=\"en\" id=\"top\"><!-- note --><p class=\"a b\">hi</p><p></p>"
+                 "</html>")
+                 .evaluate();
+  Archive::Image image(Archive::Writer::from(*dom));
+  ASSERT_EQ(image.kind(), Archive::Kind::Document);
+
+  auto root = image.document();
+  ASSERT_EQ(root.type(), Archive::NodeType::Element);
+  ASSERT_EQ(root.name(), "html");
+  ASSERT_EQ(root.attributeCount(), 2);
+  ASSERT_EQ(root.attribute(1).first, "id");
+  ASSERT_EQ(root.attribute(1).second, "top");
+  ASSERT_EQ(root.childCount(), 3);
+  ASSERT_EQ(root.child(0).type(), Archive::NodeType::Comment);
+  ASSERT_EQ(root.child(1).child(0).name(), "hi");
+
+  Printer expected, actual;
+  dom->acceptVisitor(expected);
+  root.toNode()->acceptVisitor(actual);
+  ASSERT_EQ(actual.result(), expected.result());
+}
+
+TEST_F(ArchiveTest, StyleSheet) {
+  auto ss = CSSParser(
+                "h1, p.a#b { width: 12.5px; font: serif; color: #102030; }\n"
+                "ul > li .a, #c p { height: 1px; }\n"
+                "[data-x] > li:nth-child(-2n+3), [type=a]:first-child { top: 0px; }\n"
+                "* { background: rgba(1, 2, 3, 0.5); }")
+                .evaluate();
+  Archive::Image image(Archive::Writer::from(ss));
+  ASSERT_EQ(print(image.stylesheet()), print(ss));
+  ASSERT_THROW((void)image.document(), std::invalid_argument);
+
+  ASSERT_TRUE(Archive::Image(Archive::Writer::from(CSS::StyleSheet())).stylesheet().empty());
+}
+
+TEST_F(ArchiveTest, Layout) {
+  auto dom = HTMLParser("<html><div><p></p><span></span></div></html>").evaluate();
+  auto ss = CSSParser(
+                "* { display: block; padding: 2px; }\n"
+                "div { background: #ff0000; border-width: 1px; border-color: #00ff00; }\n"
+                "span { display: inline; height: 5px; }")
+                .evaluate();
+  auto layout = Layout::Box::from(Style::StyledNode::from(*dom, ss),
+                                  Layout::BoxDimensions(Layout::Rectangle(0, 0, 50, 0)));
+
+  Archive::Image image(Archive::Writer::from(*layout));
+  auto root = image.layout();
+  ASSERT_FALSE(root.isAnonymous());
+  ASSERT_EQ(root.display(), Layout::Block);
+  ASSERT_EQ(root.node().name(), "html");
+  ASSERT_EQ(root.node().childCount(), 0);
+  ASSERT_EQ(root.dimensions().width, layout->getDimensions().width);
+
+  const auto expected = Display::DisplayList::from(layout);
+  const auto actual = Display::DisplayList::from(root.toBox());
+  ASSERT_FALSE(expected.empty());
+  ASSERT_EQ(actual.size(), expected.size());
+  for (uint64_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(actual[i].type, expected[i].type);
+    ASSERT_EQ(actual[i].color.r, expected[i].color.r);
+    ASSERT_EQ(actual[i].color.a, expected[i].color.a);
+    ASSERT_EQ(actual[i].rect.x, expected[i].rect.x);
+    ASSERT_EQ(actual[i].rect.y, expected[i].rect.y);
+    ASSERT_EQ(actual[i].rect.width, expected[i].rect.width);
+    ASSERT_EQ(actual[i].rect.height, expected[i].rect.height);
+  }
+}
+
+TEST_F(ArchiveTest, Map) {
+  const auto path = ::testing::TempDir() + "sherpa_41.s41";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << Archive::Writer::from(*HTMLParser("<html><p></p></html>").evaluate());
+  }
+  auto image = Archive::Image::map(path);
+  ASSERT_EQ(image.document().child(0).name(), "p");
+  ASSERT_THROW(Archive::Image::map(path + ".missing"), std::runtime_error);
+}
+
+TEST_F(ArchiveTest, Malformed) {
+  auto bytes = Archive::Writer::from(*HTMLParser("<html><p></p></html>").evaluate());
+  ASSERT_THROW(Archive::Image(""), std::invalid_argument);
+  ASSERT_THROW(Archive::Image(bytes.substr(0, bytes.size() - 4)), std::invalid_argument);
+  ASSERT_THROW(Archive::Image("XXXX" + bytes.substr(4)), std::invalid_argument);
+
+  auto future = bytes;
+  future[4] = 99;
+  ASSERT_THROW(Archive::Image{future}, std::invalid_argument);
+
+  // a root pointing past the end is caught when it is read
+  auto outside = bytes;
+  const uint32_t root = 1 << 20;
+  std::memcpy(&outside[8], &root, sizeof(root));
+  ASSERT_THROW((void)Archive::Image(outside).document().name(), std::invalid_argument);
+}
@@ -0,0 +1,112 @@
+// sherpa_41's Arena module test fixture, licensed under MIT. (c) hafiz, 2018
+
+#include "arena.h"
+
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <vector>
+
+#include "generator.h"
+#include "parser/css.h"
+#include "parser/html.h"
+#include "renderer/canvas.h"
+#include "style.h"
+
+/**
+ * A heap resource that counts what is allocated from it
+ */
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  uint64_t allocations = 0;
+  uint64_t deallocations = 0;
+
+ private:
+  auto do_allocate(std::size_t bytes, std::size_t alignment) -> void* override {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+    ++deallocations;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  [[nodiscard]] auto do_is_equal(const std::pmr::memory_resource& rhs) const noexcept
+      -> bool override {
+    return this == &rhs;
+  }
+};
+
+TEST(ArenaTest, Scopes) {
+  CountingResource outer, inner;
+  const auto heap = std::pmr::new_delete_resource();
+  ASSERT_EQ(Arena::resource(), heap);
+  {
+    const Arena::Scope outerScope(&outer);
+    ASSERT_EQ(Arena::resource(), &outer);
+    {
+      const Arena::Scope innerScope(&inner);
+      ASSERT_EQ(Arena::resource(), &inner);
+      const Arena::Scope heapScope(nullptr);
+      ASSERT_EQ(Arena::resource(), heap);
+    }
+    ASSERT_EQ(Arena::resource(), &outer);
+  }
+  ASSERT_EQ(Arena::resource(), heap);
+}
+
+TEST(ArenaTest, AllocatesFromResource) {
+  CountingResource arena;
+  std::optional<Arena::Vector<uint64_t>> values;
+  {
+    const Arena::Scope scope(&arena);
+    values.emplace(1, 41);
+  }
+  ASSERT_EQ(arena.allocations, 1);
+
+  // a container keeps its resource once its scope is closed, through moves
+  values->resize(64);
+  ASSERT_EQ(arena.allocations, 2);
+  ASSERT_EQ(arena.deallocations, 1);
+  {
+    const auto moved = std::move(*values);
+    ASSERT_EQ(moved.get_allocator().resource(), &arena);
+
+    // but a copy allocates from the heap, outside of the scope
+    const auto copy = moved;
+    ASSERT_EQ(copy.get_allocator().resource(), std::pmr::new_delete_resource());
+    ASSERT_EQ(arena.allocations, 2);
+  }
+  ASSERT_EQ(arena.deallocations, 2);
+}
+
+TEST(ArenaTest, RendersOnMonotonicBuffers) {
+  Generator::Options options;
+  options.nodes = 100;
+  const auto html = Generator::document(options);
+  const auto css = Generator::stylesheet(options);
+  auto render = [&](std::pmr::memory_resource* arena) {
+    const Arena::Scope scope(arena);
+    const auto dom = HTMLParser(html).evaluate();
+    const auto stylesheet = CSSParser(css).evaluate();
+    const auto styledDom = Style::StyledNode::from(*dom, stylesheet);
+    const Layout::BoxDimensions window(Layout::Rectangle(0, 0, 200, 400));
+    const auto root = Layout::Box::from(styledDom, window);
+    Canvas canvas(200, 400);
+    canvas.scrollTo(root, 0, 0);
+    const auto view = canvas.view();
+    return std::vector<uint8_t>(view.data, view.data + view.size());
+  };
+
+  CountingResource upstream;
+  std::pmr::monotonic_buffer_resource arena(&upstream);
+  const auto pixels = render(&arena);
+  ASSERT_EQ(pixels, render(nullptr));
+  ASSERT_GT(upstream.allocations, 0);
+
+  // nothing is freed until the buffer is released
+  ASSERT_EQ(upstream.deallocations, 0);
+  arena.release();
+  ASSERT_EQ(upstream.deallocations, upstream.allocations);
+}
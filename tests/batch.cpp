@@ -0,0 +1,83 @@
+// sherpa_41's Batch module test fixture, licensed under MIT. (c) hafiz, 2018
+
+#include "batch.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+class BatchTest : public ::testing::Test {
+ protected:
+  /**
+   * Writes a file to the test's temporary directory
+   * @param name file name
+   * @param contents file contents
+   * @return path of the written file
+   */
+  static auto write(const std::string& name, const std::string& contents) -> std::string {
+    auto path = ::testing::TempDir() + name;
+    std::ofstream(path) << contents;
+    return path;
+  }
+
+  /**
+   * Reads a file back
+   * @param path file to read
+   * @return file contents
+   */
+  static auto read(const std::string& path) -> std::string {
+    std::stringstream buffer;
+    buffer << std::ifstream(path, std::ios::binary).rdbuf();
+    return buffer.str();
+  }
+};
+
+TEST_F(BatchTest, Summary) {
+  Batch::Summary summary{4, 0, 1, 0, 2};
+  ASSERT_EQ(summary.throughput(), 2);
+  ASSERT_EQ(Batch::Summary({0, 0, 0, 0, 0}).throughput(), 0);
+}
+
+TEST_F(BatchTest, Run) {
+  const auto html = write("batch.html", "<html><div></div></html>");
+  const auto css =
+      write("batch.css", "* { display: block; height: 1px; background: #ff0000; }");
+  const auto out = ::testing::TempDir() + "batch-";
+
+  Batch::JobVector jobs;
+  for (uint64_t i = 0; i < 6; ++i) {
+    jobs.push_back(Batch::Job{html, css, 1 + i % 2, 1, out + std::to_string(i) + ".pam"});
+  }
+  jobs.push_back(Batch::Job{html, css + ".missing", 1, 1, out + "missing.pam"});
+  jobs.push_back(Batch::Job{html, css, 1, 1, out + "unsupported.gif"});
+
+  Batch::Runner runner(3);
+  std::stringstream log;
+  auto summary = runner.run(jobs, log);
+  ASSERT_EQ(summary.succeeded, 6);
+  ASSERT_EQ(summary.failed, 2);
+  ASSERT_EQ(summary.stylesheets, 1);
+  ASSERT_EQ(summary.pixels, 9);
+
+  const std::string header = "P7\nWIDTH 1\nHEIGHT 1\nDEPTH 4\nMAXVAL 255\n";
+  const std::string pixel("\xff\x00\x00\xff", 4);
+  ASSERT_EQ(read(out + "0.pam"), header + "TUPLTYPE RGB_ALPHA\nENDHDR\n" + pixel);
+  ASSERT_EQ(read(out + "4.pam"), read(out + "0.pam"));
+
+  // style sheets are kept between runs
+  ASSERT_EQ(runner.run({jobs.front()}, log).stylesheets, 0);
+
+  std::string line;
+  uint64_t lines(0);
+  while (std::getline(log, line)) {
+    ++lines;
+  }
+  ASSERT_EQ(lines, jobs.size() + 1);
+  ASSERT_NE(log.str().find("[failed] " + out + "unsupported.gif"), std::string::npos);
+
+  for (uint64_t i = 0; i < 6; ++i) {
+    std::remove((out + std::to_string(i) + ".pam").c_str());
+  }
+}
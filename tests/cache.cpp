@@ -0,0 +1,114 @@
+// sherpa_41's Cache module test fixture, licensed under MIT. (c) hafiz, 2018
+
+#include "cache.h"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "archive.h"
+#include "parser/css.h"
+
+class CacheTest : public ::testing::Test {};
+
+TEST_F(CacheTest, FindInsert) {
+  LRUCache<std::string, int> cache(2);
+  ASSERT_EQ(cache.find("a"), nullptr);
+  cache.insert("a", 1);
+  ASSERT_EQ(*cache.find("a"), 1);
+  cache.insert("a", 2);
+  ASSERT_EQ(*cache.find("a"), 2);
+  ASSERT_EQ(cache.size(), 1);
+  ASSERT_EQ(cache.getHits(), 2);
+  ASSERT_EQ(cache.getMisses(), 1);
+}
+
+TEST_F(CacheTest, EvictsLeastRecentlyUsed) {
+  LRUCache<int, std::unique_ptr<int>> cache(2);
+  cache.insert(1, std::make_unique<int>(1));
+  cache.insert(2, std::make_unique<int>(2));
+  ASSERT_NE(cache.find(1), nullptr);
+  cache.insert(3, std::make_unique<int>(3));
+
+  ASSERT_EQ(cache.size(), 2);
+  ASSERT_EQ(cache.find(2), nullptr);
+  ASSERT_EQ(**cache.find(1), 1);
+  ASSERT_EQ(**cache.find(3), 3);
+}
+
+TEST_F(CacheTest, EvictsByCost) {
+  LRUCache<int, int> cache(10);
+  cache.insert(1, 1, 4);
+  cache.insert(2, 2, 4);
+  ASSERT_EQ(cache.cost(), 8);
+  cache.insert(3, 3, 4);
+
+  ASSERT_EQ(cache.size(), 2);
+  ASSERT_EQ(cache.cost(), 8);
+  ASSERT_EQ(cache.find(1), nullptr);
+  cache.insert(4, 4, 20);
+  ASSERT_EQ(cache.size(), 1);
+  ASSERT_EQ(*cache.find(4), 4);
+}
+
+TEST_F(CacheTest, ParseCacheSharesByContent) {
+  ParseCache cache(1 << 20);
+  const std::string css("p { color: #ff0000; }");
+  const std::string html("<html><p>hi</p></html>");
+
+  auto sheet = cache.stylesheet(css);
+  ASSERT_EQ(sheet->size(), 1);
+  ASSERT_EQ(cache.stylesheet(std::string(css)), sheet);
+  ASSERT_NE(cache.stylesheet(css + " "), sheet);
+
+  auto dom = cache.document(html);
+  ASSERT_TRUE(dom->is("html"));
+  ASSERT_EQ(cache.document(html), dom);
+
+  ASSERT_EQ(cache.getHits(), 2);
+  ASSERT_EQ(cache.getMisses(), 3);
+}
+
+TEST_F(CacheTest, Hash) {
+  ASSERT_EQ(ParseCache::hash("sherpa_41"), ParseCache::hash(std::string("sherpa_41")));
+  ASSERT_NE(ParseCache::hash("sherpa_41"), ParseCache::hash("sherpa_42"));
+  ASSERT_NE(ParseCache::hash(""), ParseCache::hash(std::string(1, '\0')));
+  ASSERT_NE(ParseCache::hash("abcdefgh"), ParseCache::hash("abcdefgh "));
+}
+
+TEST_F(CacheTest, ParseCacheDirectory) {
+  const std::string css("p { color: #ff0000; }");
+  const std::string other("h1 { width: 1px; }\nh2 { width: 2px; }");
+  auto archive = [](const std::string& source, const std::string& extension) {
+    std::stringstream path;
+    path << ::testing::TempDir() << "/" << std::hex << std::setw(16) << std::setfill('0')
+         << ParseCache::hash(source) << "." << extension << ".s41";
+    return path.str();
+  };
+  {
+    ParseCache cache(1 << 20, ::testing::TempDir());
+    cache.stylesheet(css);
+    cache.document("<html></html>");
+  }
+  ASSERT_TRUE(std::ifstream(archive(css, "css")).good());
+  ASSERT_TRUE(std::ifstream(archive("<html></html>", "html")).good());
+
+  // archives start with their source, so one planted under another source's
+  // hash is ignored, while one planted with that source is read in its place
+  auto plant = [&](const std::string& source, const std::string& parsed) {
+    const uint64_t length = source.size();
+    std::ofstream file(archive(other, "css"), std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    file << source << Archive::Writer::from(CSSParser(parsed).evaluate());
+  };
+  plant(css, css);
+  ASSERT_EQ(ParseCache(1 << 20, ::testing::TempDir()).stylesheet(other)->size(), 2);
+  plant(other, css);
+  ParseCache cache(1 << 20, ::testing::TempDir());
+  ASSERT_EQ(cache.stylesheet(other)->size(), 1);
+  ASSERT_TRUE(cache.document("<html></html>")->is("html"));
+}
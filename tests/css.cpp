@@ -4,69 +4,107 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+
 class CSSTest : public ::testing::Test {};
 
 using namespace CSS;
 
 TEST_F(CSSTest, ValueCtorDtor) {
-  TextValue text("txt");
-  UnitValue unit(1.0, px);
-  ColorValue color(0, 0, 0, 0);
-  TextValue text2(text);
-  UnitValue unit2(unit);
-  ColorValue color2(color);
-  ValuePtr text3 = ValuePtr(new TextValue("txt"));
-  ValuePtr unit3 = ValuePtr(new UnitValue(1.0, px));
-  ValuePtr color3 = ValuePtr(new ColorValue(0, 0, 0, 0));
-  Value* text4 = new TextValue("txt");
-  Value* unit4 = new UnitValue(1.0, px);
-  Value* color4 = new ColorValue(0, 0, 0, 0);
-  TextValue* text5 = new TextValue("txt");
-  UnitValue* unit5 = new UnitValue(1.0, px);
-  ColorValue* color5 = new ColorValue(0, 0, 0, 0);
-
-  ASSERT_NO_THROW(delete text4);
-  ASSERT_NO_THROW(delete unit4);
-  ASSERT_NO_THROW(delete color4);
-  ASSERT_NO_THROW(delete text5);
-  ASSERT_NO_THROW(delete unit5);
-  ASSERT_NO_THROW(delete color5);
+  Value empty;
+  auto text = Value::keyword("txt");
+  auto unit = Value::length(1.0, px);
+  auto color = Value::color(0, 0, 0, 0);
+  Value text2(text);
+  Value unit2(unit);
+  Value color2(color);
+
+  ASSERT_EQ(empty.getType(), Value::Keyword);
+  ASSERT_EQ(text2.getType(), Value::Keyword);
+  ASSERT_EQ(unit2.getType(), Value::Length);
+  ASSERT_EQ(color2.getType(), Value::Color);
 }
 
-TEST_F(CSSTest, makeValue) {
-  TextValue val("hello");
-
-  ASSERT_EQ(make_value(val)->print(), "hello");
-  ASSERT_FALSE(make_value(val) == make_value(val));
+TEST_F(CSSTest, valueEquality) {
+  ASSERT_EQ(Value::keyword("hello"), Value::keyword(std::string("hel") + "lo"));
+  ASSERT_NE(Value::keyword("hello"), Value::keyword("hell"));
+  ASSERT_EQ(Value(), Value::keyword(""));
+  ASSERT_EQ(Value::length(1.5, em), Value::length(1.5, em));
+  ASSERT_NE(Value::length(1.5, em), Value::length(1.5, rem));
+  ASSERT_NE(Value::length(0, px), Value());
+  ASSERT_EQ(Value::color(1, 2, 3, 0.5), Value::color(1, 2, 3, 0.5));
+  ASSERT_NE(Value::color(1, 2, 3, 0.5), Value::color(3, 2, 1, 0.5));
+  ASSERT_NE(Value::color(1, 2, 3, 0.5), Value::color(1, 2, 3, 1));
 }
 
 TEST_F(CSSTest, valueIs) {
-  TextValue text("txt");
-  UnitValue unit(1.0, px);
-  ColorValue color(0, 0, 0, 0);
+  auto text = Value::keyword("txt");
+  auto unit = Value::length(1.0, px);
+  auto color = Value::color(0, 0, 0, 0);
 
   ASSERT_TRUE(text.is("txt"));
-  ASSERT_TRUE(unit.is("1px"));
-  ASSERT_TRUE(color.is("rgba(0, 0, 0, 0)"));
+  ASSERT_FALSE(text.is("tx"));
+  ASSERT_FALSE(unit.is("1px"));  // only keywords are compared
+  ASSERT_FALSE(color.is("rgba(0, 0, 0, 0)"));
+}
+
+TEST_F(CSSTest, keywords) {
+  const std::vector<std::pair<std::string, Keyword>> known = {
+      {"auto", Keyword::Auto},       {"block", Keyword::Block},
+      {"inline", Keyword::Inline},   {"none", Keyword::None},
+      {"inherit", Keyword::Inherit}, {"initial", Keyword::Initial}};
+  for (const auto& [identifier, keyword] : known) {
+    ASSERT_EQ(Value::keyword(identifier).getKeyword(), keyword);
+    ASSERT_EQ(Value::keyword(identifier), Value::keyword(keyword));
+    ASSERT_EQ(Value::keyword(keyword).getIdentifier(), identifier);
+  }
+
+  // others are numbered Count, and may share a known one's slot
+  for (const auto* identifier : {"inlinE", "autos", "nonf", "red"}) {
+    const auto value = Value::keyword(identifier);
+    ASSERT_EQ(value.getKeyword(), Keyword::Count);
+    ASSERT_EQ(value.getIdentifier(), identifier);
+  }
+  ASSERT_EQ(Value().getKeyword(), Keyword::Empty);
+  ASSERT_EQ(Value::length(0, px).getKeyword(), Keyword::Empty);
+}
+
+TEST_F(CSSTest, identifiers) {
+  Identifiers identifiers;
+  std::string name("sans-serif");
+  const auto interned = identifiers.intern(name);
+  ASSERT_EQ(identifiers.intern("sans-serif").data(), interned.data());
+  ASSERT_EQ(identifiers.size(), 1);
+
+  // the value views the table, not the string it was interned from
+  const auto value = Value::keyword(interned);
+  name = "serif";
+  ASSERT_EQ(value.getIdentifier(), "sans-serif");
+  ASSERT_EQ(value, Value::keyword("sans-serif"));
+  ASSERT_NE(value, Value::keyword("serif"));
 }
 
 TEST_F(CSSTest, unitValue) {
-  TextValue text("txt");
-  UnitValue unit(1.0, px);
+  auto text = Value::keyword("txt");
+  auto unit = Value::length(1.0, px);
 
   ASSERT_EQ(text.unitValue(), 0);
   ASSERT_EQ(unit.unitValue(), 1);
+  ASSERT_EQ(unit.getUnit(), px);
 }
 
 TEST_F(CSSTest, printing) {
-  TextValue text("txt");
-  UnitValue unit(1.0, px);
-  ColorValue color(0, 0, 0, 0);
+  auto text = Value::keyword("txt");
+  auto unit = Value::length(1.0, px);
+  auto color = Value::color(10, 20, 30, 0.2);
 
   ASSERT_EQ(text.print(), "txt");
+  ASSERT_EQ(text.getIdentifier(), "txt");
   ASSERT_EQ(unit.print(), "1px");
-  ASSERT_EQ(color.print(), "rgba(0, 0, 0, 0)");
-  ASSERT_EQ(color.channels(), (std::array<uint8_t, 3>{{0, 0, 0}}));
+  ASSERT_EQ(unit.getIdentifier(), "");
+  ASSERT_EQ(color.print(), "rgba(10, 20, 30, 0.2)");
+  ASSERT_EQ(color.channels(), (std::array<uint8_t, 3>{{10, 20, 30}}));
+  ASSERT_EQ(color.getAlpha(), 0.2);
 }
 
 TEST_F(CSSTest, SelectorCtorDtor) {
@@ -74,7 +112,7 @@ TEST_F(CSSTest, SelectorCtorDtor) {
 }
 
 TEST_F(CSSTest, DeclarationCtorDtor) {
-  Declaration declaration("key", make_value(TextValue("value")));
+  Declaration declaration("key", Value::keyword("value"));
   Declaration declaration2(declaration);
 }
 
@@ -4,6 +4,9 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <sstream>
+
 #include "parser/css.h"
 #include "parser/html.h"
 
@@ -12,50 +15,272 @@ class DisplayTest : public ::testing::Test {};
 using namespace Display;
 
 TEST_F(DisplayTest, CommandCtorDtor) {
-  RectangleCmd rectangleCmd(Layout::Rectangle(0, 0, 0, 0), CSS::ColorValue(0, 0, 0, 0));
+  auto cmd =
+      Command::rectangle(Layout::Rectangle(0, 0, 0, 0), CSS::Value::color(0, 0, 0, 0));
+  ASSERT_EQ(cmd.type, CommandType::Rectangle);
+  ASSERT_FALSE(cmd.isOpaque());
+  ASSERT_EQ(sizeof(Command), 24);
+}
+
+TEST_F(DisplayTest, CommandColor) {
+  auto cmd =
+      Command::rectangle(Layout::Rectangle(1, 2, 3, 4), CSS::Value::color(1, 2, 3, 0.2));
+  ASSERT_EQ(cmd.color.r, 1);
+  ASSERT_EQ(cmd.color.g, 2);
+  ASSERT_EQ(cmd.color.b, 3);
+  ASSERT_EQ(cmd.color.a, 51);
+  ASSERT_EQ(cmd.rect.x, 1);
+  ASSERT_EQ(cmd.rect.height, 4);
 }
 
-TEST_F(DisplayTest, CreateQueueEmpty) {
-  auto queue = Command::createQueue(Layout::BoxPtr(new Layout::AnonymousBox()));
-  ASSERT_TRUE(queue.empty());
+TEST_F(DisplayTest, DisplayListEmpty) {
+  auto list = DisplayList::from(Layout::BoxPtr(new Layout::AnonymousBox()));
+  ASSERT_TRUE(list.empty());
 }
 
-TEST_F(DisplayTest, CreateQueue) {
+TEST_F(DisplayTest, DisplayListFrom) {
   HTMLParser html("<html><div></div><div></div></html>");
   CSSParser css("* { background: #000000; display: block; padding: 12px; }");
   auto style = Style::StyledNode::from(html.evaluate(), css.evaluate());
   auto layout =
       Layout::Box::from(style, Layout::BoxDimensions(Layout::Rectangle(0, 0, 800, 600)));
-  auto queue = Command::createQueue(layout);
-  ASSERT_EQ(queue.size(), 15);  // 5 x html, 5 x div
-
-  const auto& htmlTag = dynamic_cast<RectangleCmd*>(queue.front().get());
-  ASSERT_FALSE(htmlTag == nullptr);
+  auto list = DisplayList::from(layout);
+  ASSERT_EQ(list.size(), 15);  // 5 x html, 5 x div
 
   // first command: html
-  ASSERT_EQ(htmlTag->getColor().print(), "rgba(0, 0, 0, 1)");
-  ASSERT_EQ(htmlTag->getRectangle().width, 800);
-  ASSERT_EQ(htmlTag->getRectangle().height, 72);
+  const auto& htmlTag = list[0];
+  ASSERT_EQ(htmlTag.type, CommandType::Rectangle);
+  ASSERT_TRUE(htmlTag.isOpaque());
+  ASSERT_EQ(htmlTag.color.r, 0);
+  ASSERT_EQ(htmlTag.rect.width, 800);
+  ASSERT_EQ(htmlTag.rect.height, 72);
 
-  for (uint64_t i = 0; i < 5; ++i)
-    queue.pop();  // html borders
+  // second command: div
+  const auto& divTag = list[5];
+  ASSERT_TRUE(divTag.isOpaque());
+  ASSERT_EQ(divTag.rect.y, 12);
+  ASSERT_EQ(divTag.rect.width, 776);
+  ASSERT_EQ(divTag.rect.height, 24);
 
-  const auto& divTag = dynamic_cast<RectangleCmd*>(queue.front().get());
+  // third command: div
+  const auto& divTag2 = list[10];
+  ASSERT_TRUE(divTag2.isOpaque());
+  ASSERT_EQ(divTag2.rect.y, 36);
+  ASSERT_EQ(divTag2.rect.width, 776);
+  ASSERT_EQ(divTag2.rect.height, 24);
 
-  // second command: div
-  ASSERT_EQ(divTag->getColor().print(), "rgba(0, 0, 0, 1)");
-  ASSERT_EQ(divTag->getRectangle().origin.y, 12);
-  ASSERT_EQ(divTag->getRectangle().width, 776);
-  ASSERT_EQ(divTag->getRectangle().height, 24);
+  ASSERT_TRUE(list.diff(DisplayList::from(layout)).empty());
+}
+
+TEST_F(DisplayTest, BorderColorsPerSide) {
+  HTMLParser html("<html></html>");
+  CSSParser css(
+      "html { display: block; height: 10px; border: 2px solid #ff0000; "
+      "border-left-color: #0000ff; }");
+  auto style = Style::StyledNode::from(html.evaluate(), css.evaluate());
+  auto layout =
+      Layout::Box::from(style, Layout::BoxDimensions(Layout::Rectangle(0, 0, 100, 100)));
+  auto list = DisplayList::from(layout);
+  ASSERT_EQ(list.size(), 4);  // no background; top, right, bottom, left borders
+  ASSERT_EQ(list[0].rect.height, 2);
+  ASSERT_EQ(list[0].color.r, 255);
+  ASSERT_EQ(list[2].color.r, 255);
+  ASSERT_EQ(list[3].rect.width, 2);
+  ASSERT_EQ(list[3].color.r, 0);
+  ASSERT_EQ(list[3].color.b, 255);
+}
 
-  for (uint64_t i = 0; i < 5; ++i)
-    queue.pop();  // div borders
+TEST_F(DisplayTest, Serialize) {
+  DisplayList list;
+  list.push_back(
+      Command::rectangle(Layout::Rectangle(1, 2, 3, 4), CSS::Value::color(5, 6, 7, 1)));
+  list.push_back(
+      Command::rectangle(Layout::Rectangle(0.5, 0, 8, 9), CSS::Value::color(0, 0, 0, 0.5)));
 
-  const auto& divTag2 = dynamic_cast<RectangleCmd*>(queue.front().get());
+  std::stringstream stream;
+  list.serialize(stream);
+  auto read = DisplayList::deserialize(stream);
+  ASSERT_EQ(read.size(), 2);
+  ASSERT_TRUE(read[0] == list[0]);
+  ASSERT_TRUE(read[1] == list[1]);
 
-  // third command: div
-  ASSERT_EQ(divTag2->getColor().print(), "rgba(0, 0, 0, 1)");
-  ASSERT_EQ(divTag2->getRectangle().origin.y, 36);
-  ASSERT_EQ(divTag2->getRectangle().width, 776);
-  ASSERT_EQ(divTag2->getRectangle().height, 24);
+  std::stringstream garbage("not a display list");
+  ASSERT_THROW(DisplayList::deserialize(garbage), std::runtime_error);
+
+  // commands are written field by field, so padding never reaches the stream
+  auto bytes = stream.str();
+  ASSERT_EQ(bytes.size(), 16 + 2 * (1 + sizeof(Color) + sizeof(Rect)));
+
+  // a count longer than the stream is rejected before it is allocated
+  const uint64_t count = UINT64_MAX / sizeof(Command);
+  bytes.replace(8, sizeof(count), reinterpret_cast<const char*>(&count), sizeof(count));
+  std::stringstream oversized(bytes);
+  ASSERT_THROW(DisplayList::deserialize(oversized), std::runtime_error);
+  std::stringstream truncated(stream.str().substr(0, stream.str().size() - 1));
+  ASSERT_THROW(DisplayList::deserialize(truncated), std::runtime_error);
+}
+
+TEST_F(DisplayTest, CullOccludedHidden) {
+  DisplayList list;
+  list.push_back(
+      Command::rectangle(Layout::Rectangle(1, 1, 2, 2), CSS::Value::color(255, 0, 0, 1)));
+  list.push_back(
+      Command::rectangle(Layout::Rectangle(0, 0, 4, 4), CSS::Value::color(0, 0, 255, 1)));
+  ASSERT_EQ(list.cullOccluded(), 4);
+  ASSERT_EQ(list.size(), 1);
+  ASSERT_EQ(list[0].rect.width, 4);
+}
+
+TEST_F(DisplayTest, CullOccludedTranslucent) {
+  DisplayList list;
+  list.push_back(
+      Command::rectangle(Layout::Rectangle(1, 1, 2, 2), CSS::Value::color(255, 0, 0, 1)));
+  list.push_back(
+      Command::rectangle(Layout::Rectangle(0, 0, 4, 4), CSS::Value::color(0, 0, 255, 0.5)));
+  ASSERT_EQ(list.cullOccluded(), 0);
+  ASSERT_EQ(list.size(), 2);
+}
+
+TEST_F(DisplayTest, CullOccludedTrim) {
+  DisplayList list;
+  list.push_back(
+      Command::rectangle(Layout::Rectangle(0, 0, 10, 10), CSS::Value::color(255, 0, 0, 1)));
+  list.push_back(
+      Command::rectangle(Layout::Rectangle(0, 0, 10, 4), CSS::Value::color(0, 0, 255, 1)));
+  ASSERT_EQ(list.cullOccluded(), 40);
+  ASSERT_EQ(list.size(), 2);
+  ASSERT_EQ(list[0].rect.y, 4);
+  ASSERT_EQ(list[0].rect.height, 6);
+  ASSERT_EQ(list[0].rect.width, 10);
+}
+
+TEST_F(DisplayTest, CullOccludedEmptyBorders) {
+  HTMLParser html("<html><div></div><div></div></html>");
+  CSSParser css("* { background: #000000; display: block; padding: 12px; }");
+  auto style = Style::StyledNode::from(html.evaluate(), css.evaluate());
+  auto layout =
+      Layout::Box::from(style, Layout::BoxDimensions(Layout::Rectangle(0, 0, 800, 600)));
+  auto list = DisplayList::from(layout);
+  list.cullOccluded();
+  ASSERT_EQ(list.size(), 3);  // zero-width borders are dropped
+}
+
+TEST_F(DisplayTest, DisplayListDiff) {
+  auto rect = [](double x, double y, double w, double h, uint8_t r) {
+    return Command::rectangle(Layout::Rectangle(x, y, w, h), CSS::Value::color(r, 0, 0, 1));
+  };
+  DisplayList prev, next;
+  prev.push_back(rect(0, 0, 100, 100, 0));
+  prev.push_back(rect(10, 10, 5, 5, 0));
+  prev.push_back(rect(50, 50, 5, 5, 0));
+  next.push_back(rect(0, 0, 100, 100, 0));
+  next.push_back(rect(10, 10, 5, 5, 255));  // recolored
+  next.push_back(rect(50, 50, 5, 5, 0));
+  next.push_back(rect(90, 90, 2, 2, 0));  // appended
+
+  auto damage = next.diff(prev);
+  ASSERT_EQ(damage.size(), 2);
+  ASSERT_EQ(damage[0].origin.x, 10);
+  ASSERT_EQ(damage[0].width, 5);
+  ASSERT_EQ(damage[1].origin.x, 90);
+  ASSERT_EQ(damage[1].width, 2);
+}
+
+TEST_F(DisplayTest, DisplayListDiffMergesOverlaps) {
+  DisplayList prev, next;
+  prev.push_back(
+      Command::rectangle(Layout::Rectangle(0, 0, 10, 10), CSS::Value::color(0, 0, 0, 1)));
+  next.push_back(
+      Command::rectangle(Layout::Rectangle(5, 5, 10, 10), CSS::Value::color(0, 0, 0, 1)));
+
+  auto damage = next.diff(prev);
+  ASSERT_EQ(damage.size(), 1);
+  ASSERT_EQ(damage[0].width, 15);
+  ASSERT_EQ(damage[0].height, 15);
+}
+
+TEST_F(DisplayTest, SpatialIndexQuery) {
+  DisplayList list;
+  list.push_back(Command::rectangle(Layout::Rectangle(0, 0, 1000, 1000),
+                                    CSS::Value::color(0, 0, 0, 1)));
+  list.push_back(
+      Command::rectangle(Layout::Rectangle(10, 10, 10, 10), CSS::Value::color(0, 0, 0, 1)));
+  list.push_back(Command::rectangle(Layout::Rectangle(900, 900, 50, 50),
+                                    CSS::Value::color(0, 0, 0, 1)));
+  list.push_back(
+      Command::rectangle(Layout::Rectangle(15, 15, 0, 0), CSS::Value::color(0, 0, 0, 1)));
+  SpatialIndex index(list, 64);
+
+  ASSERT_EQ(index.query(Layout::Rectangle(0, 0, 30, 30)), std::vector<uint64_t>({0, 1}));
+  ASSERT_EQ(index.query(Layout::Rectangle(500, 500, 500, 500)),
+            std::vector<uint64_t>({0, 2}));
+  ASSERT_TRUE(index.query(Layout::Rectangle(2000, 2000, 5, 5)).empty());
+
+  ASSERT_EQ(index.query(Layout::Rectangle(0, 0, 30, 30), 0), std::vector<uint64_t>({1}));
+  ASSERT_TRUE(index.query(Layout::Rectangle(0, 0, 30, 30), 1).empty());
+  ASSERT_EQ(index.query(Layout::Rectangle(0, 0, 1000, 1000), 1), std::vector<uint64_t>({2}));
+
+  // indices of a filtered index are still those of the whole list
+  SpatialIndex small(list, 64, [](const Command& cmd) { return cmd.rect.width < 100; });
+  ASSERT_EQ(small.query(Layout::Rectangle(0, 0, 1000, 1000)), std::vector<uint64_t>({1, 2}));
+
+  // a buffer is cleared and reused across queries
+  std::vector<uint64_t> found{7};
+  index.query(Layout::Rectangle(0, 0, 30, 30), std::nullopt, found);
+  ASSERT_EQ(found, std::vector<uint64_t>({0, 1}));
+  index.query(Layout::Rectangle(0, 0, 30, 30), 0, found);
+  ASSERT_EQ(found, std::vector<uint64_t>({1}));
+
+  // visits stop once the visitor asks to
+  std::vector<uint64_t> visited;
+  ASSERT_FALSE(index.visit(Layout::Rectangle(0, 0, 1000, 1000), std::nullopt, [&](auto i) {
+    visited.push_back(i);
+    return visited.size() < 2;
+  }));
+  ASSERT_EQ(visited, std::vector<uint64_t>({0, 1}));
+  const auto none = [](auto) { return false; };
+  ASSERT_TRUE(index.visit(Layout::Rectangle(2000, 2000, 5, 5), std::nullopt, none));
+}
+
+TEST_F(DisplayTest, SpatialIndexBounds) {
+  DisplayList list;
+  list.push_back(
+      Command::rectangle(Layout::Rectangle(0, 0, 10, 10), CSS::Value::color(0, 0, 0, 1)));
+  list.push_back(Command::rectangle(Layout::Rectangle(1e9, 1e9, 10, 10),
+                                    CSS::Value::color(0, 0, 0, 1)));
+  ASSERT_THROW(SpatialIndex(list, 0), std::invalid_argument);
+  ASSERT_THROW(SpatialIndex(list, -1), std::invalid_argument);
+
+  // a grid of 1e18 cells is coarsened rather than allocated
+  SpatialIndex index(list, 1);
+  ASSERT_EQ(index.query(Layout::Rectangle(0, 0, 5, 5)), std::vector<uint64_t>({0}));
+  ASSERT_EQ(index.query(Layout::Rectangle(1e9, 1e9, 5, 5)), std::vector<uint64_t>({1}));
+  ASSERT_EQ(index.topmost(5, 5), 0);
+}
+
+TEST_F(DisplayTest, SpatialIndexTopmost) {
+  DisplayList list;
+  list.push_back(
+      Command::rectangle(Layout::Rectangle(0, 0, 100, 100), CSS::Value::color(0, 0, 0, 1)));
+  list.push_back(
+      Command::rectangle(Layout::Rectangle(10, 10, 10, 10), CSS::Value::color(0, 0, 0, 1)));
+  SpatialIndex index(list, 16);
+
+  ASSERT_EQ(index.topmost(15, 15), 1);
+  ASSERT_EQ(index.topmost(20, 15), 0);
+  ASSERT_EQ(index.topmost(150, 15), std::nullopt);
+  ASSERT_EQ(SpatialIndex(DisplayList()).topmost(0, 0), std::nullopt);
+}
+
+TEST_F(DisplayTest, DisplayListFromViewport) {
+  HTMLParser html("<html><div class=\"a\"></div><div class=\"b\"></div></html>");
+  CSSParser css("* { display: block; height: 10px; } div { background: #ff0000; }");
+  auto layout = Layout::Box::from(Style::StyledNode::from(html.evaluate(), css.evaluate()),
+                                  Layout::BoxDimensions(Layout::Rectangle(0, 0, 100, 0)));
+
+  auto full = DisplayList::from(layout);
+  auto list = DisplayList::from(layout, Layout::Rectangle(0, 12, 100, 5));
+  ASSERT_EQ(list.size() * 2, full.size());
+  ASSERT_TRUE(std::equal(list.begin(), list.end(), full.end() - list.size()));
+  ASSERT_TRUE(DisplayList::from(layout, Layout::Rectangle(0, 30, 100, 5)).empty());
 }
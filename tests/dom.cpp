@@ -19,3 +19,22 @@ TEST_F(DOMTest, NodeCtorDtor) {
   TextNode textNode("hello text!");
   ElementNode elementNode("div");
 }
+
+TEST_F(DOMTest, SiblingIndex) {
+  NodeVector children;
+  children.emplace_back(new TextNode("text"));
+  children.emplace_back(new ElementNode("p"));
+  children.emplace_back(new CommentNode("comment"));
+  children.emplace_back(new ElementNode("p"));
+  ElementNode parent("div", AttributeMap(), children);
+  ASSERT_EQ(parent.siblingIndex(), 1);  // a root is the first child of its document
+
+  const auto& borrowed = parent.borrowChildren();
+  ASSERT_EQ(borrowed[0]->siblingIndex(), 0);
+  ASSERT_EQ(borrowed[1]->siblingIndex(), 1);
+  ASSERT_EQ(borrowed[2]->siblingIndex(), 0);
+  ASSERT_EQ(borrowed[3]->siblingIndex(), 2);
+
+  // clones keep their position
+  ASSERT_EQ(parent.getChildren()[3]->siblingIndex(), 2);
+}
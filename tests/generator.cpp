@@ -0,0 +1,156 @@
+// sherpa_41's Generator module test fixture, licensed under MIT. (c) hafiz, 2018
+
+#include "generator.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "display.h"
+#include "layout.h"
+#include "parser/css.h"
+#include "parser/html.h"
+
+class GeneratorTest : public ::testing::Test {
+ protected:
+  /**
+   * Shape of a parsed document
+   */
+  struct Shape {
+    uint64_t nodes = 0;
+    uint64_t depth = 0;
+    uint64_t fanOut = 0;
+  };
+
+  /**
+   * Measures the elements of a DOM tree
+   * @param node root of the tree
+   * @param depth depth of the root
+   * @param shape shape to add the tree to
+   */
+  static void measure(const DOM::Node& node, uint64_t depth, Shape& shape) {
+    auto element = dynamic_cast<const DOM::ElementNode*>(&node);
+    if (element == nullptr) {
+      return;
+    }
+    ++shape.nodes;
+    shape.depth = std::max(shape.depth, depth);
+    uint64_t children(0);
+    for (const auto& child : element->borrowChildren()) {
+      children += dynamic_cast<const DOM::ElementNode*>(child.get()) != nullptr;
+      measure(*child, depth + 1, shape);
+    }
+    shape.fanOut = std::max(shape.fanOut, children);
+  }
+
+  /**
+   * Parses a generated document and measures its shape
+   * @param options options to generate the document with
+   * @return shape of the document
+   */
+  static auto shapeOf(const Generator::Options& options) -> Shape {
+    Shape shape;
+    measure(*HTMLParser(Generator::document(options)).evaluate(), 1, shape);
+    return shape;
+  }
+};
+
+TEST_F(GeneratorTest, Deterministic) {
+  Generator::Options options;
+  ASSERT_EQ(Generator::document(options), Generator::document(options));
+  ASSERT_EQ(Generator::stylesheet(options), Generator::stylesheet(options));
+
+  auto reseeded = options;
+  reseeded.seed = 42;
+  ASSERT_NE(Generator::document(options), Generator::document(reseeded));
+  ASSERT_NE(Generator::stylesheet(options), Generator::stylesheet(reseeded));
+
+  Generator::Random a(7), b(7);
+  for (int i = 0; i < 16; ++i) {
+    ASSERT_EQ(a.next(), b.next());
+    ASSERT_LT(a.below(10), 10);
+    b.below(10);
+  }
+}
+
+TEST_F(GeneratorTest, DocumentShape) {
+  Generator::Options options;
+  options.nodes = 500;
+  options.depth = 6;
+  options.fanOut = 4;
+  auto shape = shapeOf(options);
+  ASSERT_EQ(shape.nodes, 500);
+  ASSERT_EQ(shape.depth, 6);
+  ASSERT_LE(shape.fanOut, 4);
+
+  // a chain
+  options.nodes = 20;
+  options.depth = 100;
+  options.fanOut = 1;
+  shape = shapeOf(options);
+  ASSERT_EQ(shape.nodes, 20);
+  ASSERT_EQ(shape.depth, 20);
+  ASSERT_EQ(shape.fanOut, 1);
+
+  // siblings
+  options.nodes = 100;
+  options.depth = 2;
+  options.fanOut = 1000;
+  shape = shapeOf(options);
+  ASSERT_EQ(shape.nodes, 100);
+  ASSERT_EQ(shape.depth, 2);
+  ASSERT_EQ(shape.fanOut, 99);
+
+  // too small to hold every node
+  options.depth = 3;
+  options.fanOut = 3;
+  ASSERT_EQ(shapeOf(options).nodes, 13);
+}
+
+TEST_F(GeneratorTest, StyleSheetRules) {
+  Generator::Options options;
+  options.rules = 100;
+  auto stylesheet = CSSParser(Generator::stylesheet(options)).evaluate();
+  ASSERT_EQ(stylesheet.size(), 101);
+
+  options.selectors = Generator::SelectorMix{0, 1, 0, 0, 0};
+  options.selectorsPerRule = 1;
+  stylesheet = CSSParser(Generator::stylesheet(options)).evaluate();
+  ASSERT_EQ(stylesheet.size(), 101);
+  for (uint64_t i = 1; i < stylesheet.size(); ++i) {
+    const auto& selectors = stylesheet[i].selectors;
+    ASSERT_EQ(selectors.size(), 1);
+    ASSERT_TRUE(selectors.begin()->tag.empty());
+    ASSERT_TRUE(selectors.begin()->id.empty());
+    ASSERT_EQ(selectors.begin()->klass.size(), 1);
+  }
+
+  options.selectors = Generator::SelectorMix{0, 0, 0, 0, 0, 0, 1};
+  stylesheet = CSSParser(Generator::stylesheet(options)).evaluate();
+  ASSERT_EQ(stylesheet.size(), 101);
+  for (uint64_t i = 1; i < stylesheet.size(); ++i) {
+    const auto& selector = *stylesheet[i].selectors.begin();
+    ASSERT_EQ(selector.attributes.size() + selector.pseudoClasses.size(), 1);
+  }
+
+  options.selectors = Generator::SelectorMix{0, 0, 0, 0, 0};
+  ASSERT_EQ(CSSParser(Generator::stylesheet(options)).evaluate().size(), 1);
+}
+
+TEST_F(GeneratorTest, StressPipeline) {
+  Generator::Options options;
+  options.nodes = 200;
+  options.depth = 5;
+  options.rules = 100;
+  options.selectors.universal = 1;
+  for (uint64_t seed = 0; seed < 4; ++seed) {
+    options.seed = seed;
+    auto dom = HTMLParser(Generator::document(options)).evaluate();
+    auto stylesheet = CSSParser(Generator::stylesheet(options)).evaluate();
+    auto styledDom = Style::StyledNode::from(*dom, stylesheet);
+    auto layout = Layout::Box::from(
+        styledDom, Layout::BoxDimensions(Layout::Rectangle(0, 0, 800, 600)));
+    ASSERT_GT(layout->getDimensions().marginArea().height, 0);
+    ASSERT_FALSE(Display::DisplayList::from(layout).empty());
+  }
+}
@@ -4,7 +4,23 @@
 
 #include <gtest/gtest.h>
 
-class LayoutTest : public ::testing::Test {};
+class LayoutTest : public ::testing::Test {
+ protected:
+  /**
+   * Declares a property of computed styles, expanding a shorthand into its
+   * longhands as the CSS parser would
+   * @param props computed styles
+   * @param name property name
+   * @param value property value
+   */
+  static void declare(Style::PropertyMap& props,
+                      const std::string& name,
+                      const CSS::Value& value) {
+    for (const auto& declaration : CSS::Declaration::expand(name, {value})) {
+      props[declaration.name] = declaration.value;
+    }
+  }
+};
 
 using namespace Layout;
 
@@ -18,21 +34,22 @@ TEST_F(LayoutTest, BoxCtorDtor) {
 }
 
 TEST_F(LayoutTest, stringToDisplayType) {
-  ASSERT_EQ(stodisplay("block"), Block);
-  ASSERT_EQ(stodisplay("inline"), Inline);
-  ASSERT_EQ(stodisplay("none"), None);
-  ASSERT_EQ(stodisplay("literally not even a display type"), None);
+  ASSERT_EQ(stodisplay(CSS::Value::keyword("block")), Block);
+  ASSERT_EQ(stodisplay(CSS::Value::keyword("inline")), Inline);
+  ASSERT_EQ(stodisplay(CSS::Value::keyword("none")), None);
+  ASSERT_EQ(stodisplay(CSS::Value::keyword("literally-not-even-a-display-type")), None);
+  ASSERT_EQ(stodisplay(CSS::Value::length(1, CSS::px)), None);
 }
 
 TEST_F(LayoutTest, styledNodeToDisplayType) {
   Style::PropertyMap propertyMap;
-  propertyMap["display"] = CSS::make_value(CSS::TextValue("block"));
+  propertyMap["display"] = CSS::Value::keyword("block");
   auto snode =
       Style::StyledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap));
-  ASSERT_EQ(snodetodisplay(snode, ""), Block);
+  ASSERT_EQ(snodetodisplay(snode, None), Block);
 
   auto snode2 = Style::StyledNode(DOM::NodePtr(new DOM::TextNode("")));
-  ASSERT_EQ(snodetodisplay(snode2, "inline"), Inline);
+  ASSERT_EQ(snodetodisplay(snode2, Inline), Inline);
 }
 
 TEST_F(LayoutTest, Rectangle) {
@@ -45,6 +62,19 @@ TEST_F(LayoutTest, Rectangle) {
   ASSERT_EQ(rect2.width, 3);
 }
 
+TEST_F(LayoutTest, RectangleRelations) {
+  Rectangle outer(0, 0, 10, 10), inner(2, 2, 4, 4), apart(20, 0, 1, 1);
+
+  ASSERT_TRUE(outer.contains(inner));
+  ASSERT_FALSE(inner.contains(outer));
+  ASSERT_TRUE(outer.intersects(inner));
+  ASSERT_FALSE(outer.intersects(apart));
+
+  auto united = outer.unite(apart);
+  ASSERT_EQ(united.width, 21);
+  ASSERT_EQ(united.height, 10);
+}
+
 TEST_F(LayoutTest, Edges) {
   Edges edges(0, 0, 0, 0);
 }
@@ -68,7 +98,7 @@ TEST_F(LayoutTest, BoxDimensions) {
 TEST_F(LayoutTest, FromDisplayNone) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap;
-  propertyMap["display"] = CSS::make_value(CSS::TextValue("none"));
+  propertyMap["display"] = CSS::Value::keyword("none");
   Style::StyledNode styledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap));
 
   ASSERT_EQ(Box::from(styledNode, boxDimensions), nullptr);
@@ -77,9 +107,9 @@ TEST_F(LayoutTest, FromDisplayNone) {
 TEST_F(LayoutTest, FromChildrenDisplayBlock) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap1;
-  propertyMap1["display"] = CSS::make_value(CSS::TextValue("block"));
+  propertyMap1["display"] = CSS::Value::keyword("block");
   Style::PropertyMap propertyMap2;
-  propertyMap2["display"] = CSS::make_value(CSS::TextValue("block"));
+  propertyMap2["display"] = CSS::Value::keyword("block");
   Style::StyledNode styledNode(
       DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap1),
       {Style::StyledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap2))});
@@ -91,9 +121,9 @@ TEST_F(LayoutTest, FromChildrenDisplayBlock) {
 TEST_F(LayoutTest, FromChildrenDisplayInline_One) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap1;
-  propertyMap1["display"] = CSS::make_value(CSS::TextValue("block"));
+  propertyMap1["display"] = CSS::Value::keyword("block");
   Style::PropertyMap propertyMap2;
-  propertyMap2["display"] = CSS::make_value(CSS::TextValue("inline"));
+  propertyMap2["display"] = CSS::Value::keyword("inline");
   Style::StyledNode styledNode(
       DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap1),
       {Style::StyledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap2))});
@@ -108,13 +138,13 @@ TEST_F(LayoutTest, FromChildrenDisplayInline_One) {
 TEST_F(LayoutTest, FromChildrenDisplayInline_Multiple) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap1;
-  propertyMap1["display"] = CSS::make_value(CSS::TextValue("block"));
+  propertyMap1["display"] = CSS::Value::keyword("block");
   Style::PropertyMap propertyMap2;
-  propertyMap2["display"] = CSS::make_value(CSS::TextValue("inline"));
+  propertyMap2["display"] = CSS::Value::keyword("inline");
   Style::PropertyMap propertyMap3;
-  propertyMap3["display"] = CSS::make_value(CSS::TextValue("inline"));
+  propertyMap3["display"] = CSS::Value::keyword("inline");
   Style::PropertyMap propertyMap4;
-  propertyMap4["display"] = CSS::make_value(CSS::TextValue("inline"));
+  propertyMap4["display"] = CSS::Value::keyword("inline");
   Style::StyledNode styledNode(
       DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap1),
       {Style::StyledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap2)),
@@ -135,11 +165,11 @@ TEST_F(LayoutTest, FromChildrenDisplayInline_Multiple) {
 TEST_F(LayoutTest, FromChildrenDisplayInline_Within_Inline) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap1;
-  propertyMap1["display"] = CSS::make_value(CSS::TextValue("block"));
+  propertyMap1["display"] = CSS::Value::keyword("block");
   Style::PropertyMap propertyMap2;
-  propertyMap2["display"] = CSS::make_value(CSS::TextValue("inline"));
+  propertyMap2["display"] = CSS::Value::keyword("inline");
   Style::PropertyMap propertyMap3;
-  propertyMap3["display"] = CSS::make_value(CSS::TextValue("inline"));
+  propertyMap3["display"] = CSS::Value::keyword("inline");
 
   auto iISN =
       Style::StyledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap3));
@@ -172,9 +202,9 @@ TEST_F(LayoutTest, FromChildrenDisplayInline_Within_Inline) {
 TEST_F(LayoutTest, FromChildrenDisplayNone) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap1;
-  propertyMap1["display"] = CSS::make_value(CSS::TextValue("block"));
+  propertyMap1["display"] = CSS::Value::keyword("block");
   Style::PropertyMap propertyMap2;
-  propertyMap2["display"] = CSS::make_value(CSS::TextValue("none"));
+  propertyMap2["display"] = CSS::Value::keyword("none");
   Style::StyledNode styledNode(
       DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap1),
       {Style::StyledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap2))});
@@ -186,7 +216,7 @@ TEST_F(LayoutTest, FromChildrenDisplayNone) {
 TEST_F(LayoutTest, LayoutDisplayBlock) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap;
-  propertyMap["display"] = CSS::make_value(CSS::TextValue("block"));
+  propertyMap["display"] = CSS::Value::keyword("block");
   Style::StyledNode styledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap));
 
   ASSERT_TRUE(dynamic_cast<StyledBox*>(Box::from(styledNode, boxDimensions).get()));
@@ -195,10 +225,10 @@ TEST_F(LayoutTest, LayoutDisplayBlock) {
 TEST_F(LayoutTest, LayoutDisplayBlock_WidthGTContainer_NotAutoWidth) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap;
-  propertyMap["display"] = CSS::make_value(CSS::TextValue("block"));
-  propertyMap["width"] = CSS::make_value(CSS::UnitValue(0, CSS::px));
-  propertyMap["margin"] = CSS::make_value(CSS::TextValue("auto"));
-  propertyMap["padding"] = CSS::make_value(CSS::UnitValue(10, CSS::px));
+  propertyMap["display"] = CSS::Value::keyword("block");
+  propertyMap["width"] = CSS::Value::length(0, CSS::px);
+  declare(propertyMap, "margin", CSS::Value::keyword("auto"));
+  declare(propertyMap, "padding", CSS::Value::length(10, CSS::px));
   Style::StyledNode styledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap));
   auto box = Box::from(styledNode, boxDimensions);
   auto dims = box->getDimensions();
@@ -211,10 +241,10 @@ TEST_F(LayoutTest, LayoutDisplayBlock_WidthGTContainer_NotAutoWidth) {
 TEST_F(LayoutTest, LayoutDisplayBlock_AllConstrained) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap;
-  propertyMap["display"] = CSS::make_value(CSS::TextValue("block"));
-  propertyMap["width"] = CSS::make_value(CSS::UnitValue(0, CSS::px));
-  propertyMap["margin"] = CSS::make_value(CSS::UnitValue(0, CSS::px));
-  propertyMap["padding"] = CSS::make_value(CSS::UnitValue(0, CSS::px));
+  propertyMap["display"] = CSS::Value::keyword("block");
+  propertyMap["width"] = CSS::Value::length(0, CSS::px);
+  declare(propertyMap, "margin", CSS::Value::length(0, CSS::px));
+  declare(propertyMap, "padding", CSS::Value::length(0, CSS::px));
   Style::StyledNode styledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap));
   auto box = Box::from(styledNode, boxDimensions);
   auto dims = box->getDimensions();
@@ -227,11 +257,11 @@ TEST_F(LayoutTest, LayoutDisplayBlock_AllConstrained) {
 TEST_F(LayoutTest, LayoutDisplayBlock_AutoMarginRight) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap;
-  propertyMap["display"] = CSS::make_value(CSS::TextValue("block"));
-  propertyMap["width"] = CSS::make_value(CSS::UnitValue(0, CSS::px));
-  propertyMap["margin"] = CSS::make_value(CSS::UnitValue(0, CSS::px));
-  propertyMap["margin-right"] = CSS::make_value(CSS::TextValue("auto"));
-  propertyMap["padding"] = CSS::make_value(CSS::UnitValue(0, CSS::px));
+  propertyMap["display"] = CSS::Value::keyword("block");
+  propertyMap["width"] = CSS::Value::length(0, CSS::px);
+  declare(propertyMap, "margin", CSS::Value::length(0, CSS::px));
+  propertyMap["margin-right"] = CSS::Value::keyword("auto");
+  declare(propertyMap, "padding", CSS::Value::length(0, CSS::px));
   Style::StyledNode styledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap));
   auto box = Box::from(styledNode, boxDimensions);
   auto dims = box->getDimensions();
@@ -244,11 +274,11 @@ TEST_F(LayoutTest, LayoutDisplayBlock_AutoMarginRight) {
 TEST_F(LayoutTest, LayoutDisplayBlock_AutoMarginLeft) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap;
-  propertyMap["display"] = CSS::make_value(CSS::TextValue("block"));
-  propertyMap["width"] = CSS::make_value(CSS::UnitValue(0, CSS::px));
-  propertyMap["margin"] = CSS::make_value(CSS::UnitValue(0, CSS::px));
-  propertyMap["margin-left"] = CSS::make_value(CSS::TextValue("auto"));
-  propertyMap["padding"] = CSS::make_value(CSS::UnitValue(0, CSS::px));
+  propertyMap["display"] = CSS::Value::keyword("block");
+  propertyMap["width"] = CSS::Value::length(0, CSS::px);
+  declare(propertyMap, "margin", CSS::Value::length(0, CSS::px));
+  propertyMap["margin-left"] = CSS::Value::keyword("auto");
+  declare(propertyMap, "padding", CSS::Value::length(0, CSS::px));
   Style::StyledNode styledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap));
   auto box = Box::from(styledNode, boxDimensions);
   auto dims = box->getDimensions();
@@ -261,9 +291,9 @@ TEST_F(LayoutTest, LayoutDisplayBlock_AutoMarginLeft) {
 TEST_F(LayoutTest, LayoutDisplayBlock_AutoWidth_FitUnderflow) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap;
-  propertyMap["display"] = CSS::make_value(CSS::TextValue("block"));
-  propertyMap["width"] = CSS::make_value(CSS::TextValue("auto"));
-  propertyMap["margin"] = CSS::make_value(CSS::TextValue("auto"));
+  propertyMap["display"] = CSS::Value::keyword("block");
+  propertyMap["width"] = CSS::Value::keyword("auto");
+  declare(propertyMap, "margin", CSS::Value::keyword("auto"));
   Style::StyledNode styledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap));
   auto box = Box::from(styledNode, boxDimensions);
   auto dims = box->getDimensions();
@@ -276,10 +306,10 @@ TEST_F(LayoutTest, LayoutDisplayBlock_AutoWidth_FitUnderflow) {
 TEST_F(LayoutTest, LayoutDisplayBlock_AutoWidth_MarginRightFitUnderflow) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap;
-  propertyMap["display"] = CSS::make_value(CSS::TextValue("block"));
-  propertyMap["width"] = CSS::make_value(CSS::TextValue("auto"));
-  propertyMap["margin"] = CSS::make_value(CSS::TextValue("auto"));
-  propertyMap["padding"] = CSS::make_value(CSS::UnitValue(10, CSS::px));
+  propertyMap["display"] = CSS::Value::keyword("block");
+  propertyMap["width"] = CSS::Value::keyword("auto");
+  declare(propertyMap, "margin", CSS::Value::keyword("auto"));
+  declare(propertyMap, "padding", CSS::Value::length(10, CSS::px));
   Style::StyledNode styledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap));
   auto box = Box::from(styledNode, boxDimensions);
   auto dims = box->getDimensions();
@@ -292,10 +322,10 @@ TEST_F(LayoutTest, LayoutDisplayBlock_AutoWidth_MarginRightFitUnderflow) {
 TEST_F(LayoutTest, LayoutDisplayBlock_AutoLeftMargin_AutoRightMargin) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap;
-  propertyMap["display"] = CSS::make_value(CSS::TextValue("block"));
-  propertyMap["width"] = CSS::make_value(CSS::UnitValue(0, CSS::px));
-  propertyMap["margin"] = CSS::make_value(CSS::TextValue("auto"));
-  propertyMap["padding"] = CSS::make_value(CSS::UnitValue(0, CSS::px));
+  propertyMap["display"] = CSS::Value::keyword("block");
+  propertyMap["width"] = CSS::Value::length(0, CSS::px);
+  declare(propertyMap, "margin", CSS::Value::keyword("auto"));
+  declare(propertyMap, "padding", CSS::Value::length(0, CSS::px));
   Style::StyledNode styledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap));
   auto box = Box::from(styledNode, boxDimensions);
   auto dims = box->getDimensions();
@@ -308,7 +338,7 @@ TEST_F(LayoutTest, LayoutDisplayBlock_AutoLeftMargin_AutoRightMargin) {
 TEST_F(LayoutTest, LayoutDisplayInline) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap;
-  propertyMap["display"] = CSS::make_value(CSS::TextValue("inline"));
+  propertyMap["display"] = CSS::Value::keyword("inline");
   Style::StyledNode styledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap));
 
   ASSERT_TRUE(dynamic_cast<StyledBox*>(Box::from(styledNode, boxDimensions).get()));
@@ -317,11 +347,55 @@ TEST_F(LayoutTest, LayoutDisplayInline) {
 TEST_F(LayoutTest, SetHeightExplicitly) {
   BoxDimensions boxDimensions(Rectangle(0, 0, 1, 1));
   Style::PropertyMap propertyMap;
-  propertyMap["display"] = CSS::make_value(CSS::TextValue("block"));
-  propertyMap["height"] = CSS::make_value(CSS::UnitValue(50, CSS::px));
+  propertyMap["display"] = CSS::Value::keyword("block");
+  propertyMap["height"] = CSS::Value::length(50, CSS::px);
   Style::StyledNode styledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap));
   auto box = Box::from(styledNode, boxDimensions);
   auto dims = box->getDimensions();
 
   ASSERT_EQ(dims.height, 50);
 }
+
+TEST_F(LayoutTest, RelativeUnits) {
+  BoxDimensions boxDimensions(Rectangle(0, 0, 200, 100));
+  Style::PropertyMap propertyMap;
+  propertyMap["display"] = CSS::Value::keyword("block");
+  propertyMap["width"] = CSS::Value::length(50, CSS::percent);
+  propertyMap["margin-left"] = CSS::Value::length(10, CSS::vw);
+  propertyMap["margin-top"] = CSS::Value::length(5, CSS::percent);
+  declare(propertyMap, "padding", CSS::Value::length(1, CSS::em));
+  declare(propertyMap, "border-width", CSS::Value::length(0.5, CSS::rem));
+  propertyMap["height"] = CSS::Value::length(10, CSS::vh);
+  Style::StyledNode styledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap));
+  auto box = Box::from(styledNode, boxDimensions);
+  auto dims = box->getDimensions();
+
+  ASSERT_EQ(dims.width, 100);           // of the container
+  ASSERT_EQ(dims.margin.left, 20);      // of the viewport
+  ASSERT_EQ(dims.margin.top, 10);       // of the container's width
+  ASSERT_EQ(dims.padding.left, 16);     // of the initial font size
+  ASSERT_EQ(dims.border.bottom, 8);     // of the initial root font size
+  ASSERT_EQ(dims.margin.right, 200 - (20 + 100 + 32 + 16));  // fills the container
+  ASSERT_EQ(dims.height, 10);
+
+  // a percentage of a height that depends on the box is auto
+  Style::PropertyMap percentHeight;
+  percentHeight["display"] = CSS::Value::keyword("block");
+  percentHeight["height"] = CSS::Value::length(50, CSS::percent);
+  Style::StyledNode percentNode(DOM::NodePtr(new DOM::TextNode("")),
+                                std::move(percentHeight));
+  ASSERT_EQ(Box::from(percentNode, boxDimensions)->getDimensions().height, 0);
+}
+
+TEST_F(LayoutTest, ExtentCoversLaidOutBox) {
+  BoxDimensions boxDimensions(Rectangle(0, 0, 10, 0));
+  Style::PropertyMap propertyMap;
+  propertyMap["display"] = CSS::Value::keyword("block");
+  propertyMap["height"] = CSS::Value::length(50, CSS::px);
+  Style::StyledNode styledNode(DOM::NodePtr(new DOM::TextNode("")), std::move(propertyMap));
+  auto extent = Box::from(styledNode, boxDimensions)->getExtent();
+
+  ASSERT_EQ(extent.width, 10);
+  ASSERT_EQ(extent.height, 50);
+  ASSERT_TRUE(AnonymousBox().getExtent().width == 0);
+}
@@ -123,6 +123,92 @@ div.first {
 )");
 }
 
+TEST_F(CSSParserTest, ShorthandDeclaration) {
+  CSSParser parser(
+      "p { margin: 1px 2px 3px 4px; padding: 1px 2px; border-width: 1px 2px 3px; } "
+      "div { border: #fff 2px solid; background: #000; margin: inherit; } "
+      "a { border: 1px; margin: 1px 2px 3px 4px 5px; padding: inherit 1px; } "
+      "em { border: thin solid #000; border: 1px 2px solid; border: solid dashed; } "
+      "b { background: #00ff00 no-repeat; } "
+      "i { background: green no-repeat; background: inherit; }");
+  auto eval = parser.evaluate();
+  ASSERT_PRINT(&eval, R"(
+p {
+	margin-top: 1px;
+	margin-right: 2px;
+	margin-bottom: 3px;
+	margin-left: 4px;
+	padding-top: 1px;
+	padding-right: 2px;
+	padding-bottom: 1px;
+	padding-left: 2px;
+	border-top-width: 1px;
+	border-right-width: 2px;
+	border-bottom-width: 3px;
+	border-left-width: 2px;
+}
+
+div {
+	border-top-width: 2px;
+	border-right-width: 2px;
+	border-bottom-width: 2px;
+	border-left-width: 2px;
+	border-top-style: solid;
+	border-right-style: solid;
+	border-bottom-style: solid;
+	border-left-style: solid;
+	border-top-color: rgba(255, 255, 255, 1);
+	border-right-color: rgba(255, 255, 255, 1);
+	border-bottom-color: rgba(255, 255, 255, 1);
+	border-left-color: rgba(255, 255, 255, 1);
+	background-color: rgba(0, 0, 0, 1);
+	margin-top: inherit;
+	margin-right: inherit;
+	margin-bottom: inherit;
+	margin-left: inherit;
+}
+
+a {
+	border-top-width: 1px;
+	border-right-width: 1px;
+	border-bottom-width: 1px;
+	border-left-width: 1px;
+	border-top-style: initial;
+	border-right-style: initial;
+	border-bottom-style: initial;
+	border-left-style: initial;
+	border-top-color: initial;
+	border-right-color: initial;
+	border-bottom-color: initial;
+	border-left-color: initial;
+}
+
+em {
+	border-top-width: thin;
+	border-right-width: thin;
+	border-bottom-width: thin;
+	border-left-width: thin;
+	border-top-style: solid;
+	border-right-style: solid;
+	border-bottom-style: solid;
+	border-left-style: solid;
+	border-top-color: rgba(0, 0, 0, 1);
+	border-right-color: rgba(0, 0, 0, 1);
+	border-bottom-color: rgba(0, 0, 0, 1);
+	border-left-color: rgba(0, 0, 0, 1);
+}
+
+b {
+	background-color: rgba(0, 255, 0, 1);
+}
+
+i {
+	background-color: inherit;
+}
+
+)");
+}
+
 TEST_F(CSSParserTest, WhitespaceAndComments) {
   CSSParser parser(R"(
 body     , /* this is a body tag */
@@ -145,3 +231,48 @@ color:     rgba(  0, 10 , /* a useless comment,
 
 )");
 }
+
+TEST_F(CSSParserTest, Combinators) {
+  CSSParser parser("ul > li .title, div>p,.a  /* descendant */ .b >#c {}");
+  auto eval = parser.evaluate();
+  ASSERT_PRINT(&eval, R"(
+.a .b > #c, ul > li .title, div > p {
+}
+
+)");
+}
+
+TEST_F(CSSParserTest, AttributesAndPseudoClasses) {
+  CSSParser parser(
+      "input[type=text], [ data-x ], a[href='#top']:first-child {}\n"
+      "li:nth-child( 2n + 1 ), li:nth-child(odd):nth-child(even), li:nth-child(-n+3) {}\n"
+      "li:nth-child(4), a:hover, p::before {}");
+  auto eval = parser.evaluate();
+  ASSERT_PRINT(&eval, R"(
+a[href="#top"]:first-child, input[type="text"], [data-x] {
+}
+
+li:nth-child(2n+1):nth-child(2n), li:nth-child(2n+1), li:nth-child(-n+3) {
+}
+
+li:nth-child(4), a:nth-child(0), p:nth-child(0) {
+}
+
+)");
+}
+
+TEST_F(CSSParserTest, InternsIdentifiers) {
+  auto eval = CSSParser("a { font-family: serif; display: block; }\n"
+                        "b { font-family: serif; text-align: center; }")
+                  .evaluate();
+  // enumerated keywords are not stored, and others are stored once per sheet
+  ASSERT_EQ(eval.identifiers->size(), 2);
+  const auto& a = eval[0].declarations[0].value;
+  const auto& b = eval[1].declarations[0].value;
+  ASSERT_EQ(a.getIdentifier().data(), b.getIdentifier().data());
+
+  // copies of the sheet keep the identifiers alive
+  const auto copy = std::make_unique<CSS::StyleSheet>(eval);
+  eval = CSS::StyleSheet();
+  ASSERT_EQ(copy->front().declarations[0].value.getIdentifier(), "serif");
+}
@@ -53,6 +53,16 @@ TEST_F(HTMLParserTest, Attributes) {
   ASSERT_PRINT(HTMLParser(html).evaluate(), html);
 }
 
+TEST_F(HTMLParserTest, DashedAndBooleanAttributes) {
+  auto html = R"(<html data-x="1" aria_label="a"><input disabled></input></html>)";
+  ASSERT_PRINT(HTMLParser(html).evaluate(), R"(
+<html data-x="1" aria_label="a">
+	<input disabled="">
+	</input>
+</html>
+)");
+}
+
 TEST_F(HTMLParserTest, NestedElements) {
   auto html = R"(
 <html lang="en" itemtype="schema">
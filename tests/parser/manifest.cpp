@@ -0,0 +1,49 @@
+// sherpa_41's Manifest Parser test fixture, licensed under MIT. (c) hafiz, 2018
+
+#include "parser/manifest.h"
+
+#include <gtest/gtest.h>
+
+class ManifestParserTest : public ::testing::Test {};
+
+TEST_F(ManifestParserTest, TSV) {
+  ManifestParser parser(
+      "html\tcss\twidth\theight\tout\n"
+      "a.html\ta.css\t800\t600\ta.png\n"
+      "\n"
+      "# comment\n"
+      "b.html\ta.css\t10\t20\tout dir/b.ppm\n");
+  auto jobs = parser.evaluate();
+  ASSERT_EQ(jobs.size(), 2);
+  ASSERT_EQ(jobs[0].html, "a.html");
+  ASSERT_EQ(jobs[0].css, "a.css");
+  ASSERT_EQ(jobs[0].width, 800);
+  ASSERT_EQ(jobs[0].height, 600);
+  ASSERT_EQ(jobs[0].out, "a.png");
+  ASSERT_EQ(jobs[1].out, "out dir/b.ppm");
+}
+
+TEST_F(ManifestParserTest, JSONL) {
+  ManifestParser parser(
+      "{\"html\": \"a.html\", \"css\": \"a.css\", \"width\": 800, \"height\": 600, "
+      "\"out\": \"a.png\"}\n"
+      "{ \"out\" : \"\\u00e9\\\"q\\\".pam\",\"width\":\"1\",\"height\":2,\"html\":\"b\","
+      "\"css\":\"c\", \"extra\": true }\n");
+  auto jobs = parser.evaluate();
+  ASSERT_EQ(jobs.size(), 2);
+  ASSERT_EQ(jobs[0].html, "a.html");
+  ASSERT_EQ(jobs[0].width, 800);
+  ASSERT_EQ(jobs[1].out, "\xc3\xa9\"q\".pam");
+  ASSERT_EQ(jobs[1].width, 1);
+  ASSERT_EQ(jobs[1].height, 2);
+}
+
+TEST_F(ManifestParserTest, Malformed) {
+  ASSERT_THROW(ManifestParser("a.html\ta.css\t800\ta.png").evaluate(),
+               std::invalid_argument);
+  ASSERT_THROW(ManifestParser("a.html\ta.css\t-1\t600\ta.png").evaluate(),
+               std::invalid_argument);
+  ASSERT_THROW(ManifestParser("{\"html\": \"a.html\"}").evaluate(), std::invalid_argument);
+  ASSERT_THROW(ManifestParser("{\"html\": \"a.html}").evaluate(), std::invalid_argument);
+  ASSERT_THROW(ManifestParser("{\"html\" \"a.html\"}").evaluate(), std::invalid_argument);
+}
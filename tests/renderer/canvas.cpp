@@ -4,8 +4,11 @@
 
 #include <gtest/gtest.h>
 
+#include <sstream>
+
 #include "parser/css.h"
 #include "parser/html.h"
+#include "renderer/encoder.h"
 
 class CanvasTest : public ::testing::Test {};
 
@@ -20,11 +23,12 @@ TEST_F(CanvasTest, getPixels) {
 }
 
 TEST_F(CanvasTest, renderRectangle) {
-  Display::RectangleCmd rectangleCmd(Layout::Rectangle(0, 0, 1, 1),
-                                     CSS::ColorValue(111, 111, 111, 0.2));
+  Display::DisplayList list;
+  list.push_back(Display::Command::rectangle(Layout::Rectangle(0, 0, 1, 1),
+                                             CSS::Value::color(111, 111, 111, 0.2)));
   Canvas canvas(1, 1);
-  canvas.render(rectangleCmd);
-  ASSERT_EQ(canvas.getPixels(), std::vector<uint8_t>({111, 111, 111, 50}));
+  canvas.render(list);
+  ASSERT_EQ(canvas.getPixels(), std::vector<uint8_t>({111, 111, 111, 51}));
 }
 
 TEST_F(CanvasTest, renderFromSource) {
@@ -36,3 +40,118 @@ TEST_F(CanvasTest, renderFromSource) {
   Canvas canvas(Layout::Rectangle(0, 0, 1, 1), layout);
   ASSERT_EQ(canvas.getPixels(), std::vector<uint8_t>({0, 0, 0, 255}));
 }
+
+TEST_F(CanvasTest, cullsOverdraw) {
+  HTMLParser html("<html><div></div></html>");
+  CSSParser css("* { background: #000000; display: block; height: 2px; }");
+  auto style = Style::StyledNode::from(html.evaluate(), css.evaluate());
+  auto layout =
+      Layout::Box::from(style, Layout::BoxDimensions(Layout::Rectangle(0, 0, 2, 2)));
+  Canvas canvas(Layout::Rectangle(0, 0, 2, 2), layout);
+  ASSERT_EQ(canvas.getCulledPixels(), 4);
+  ASSERT_EQ(canvas.getPixels(), std::vector<uint8_t>({0, 0, 0, 255, 0, 0, 0, 255,  //
+                                                      0, 0, 0, 255, 0, 0, 0, 255}));
+}
+
+TEST_F(CanvasTest, repaintDamage) {
+  HTMLParser html("<html><div class=\"a\"></div><div class=\"b\"></div></html>");
+  CSSParser css1("* { display: block; height: 10px; } .a { background: #ff0000; }");
+  CSSParser css2("* { display: block; height: 10px; } .a { background: #00ff00; }");
+  auto dom = html.evaluate();
+  const Layout::Rectangle frame(0, 0, 100, 20);
+  auto layout1 = Layout::Box::from(Style::StyledNode::from(*dom, css1.evaluate()),
+                                   Layout::BoxDimensions(frame));
+  auto layout2 = Layout::Box::from(Style::StyledNode::from(*dom, css2.evaluate()),
+                                   Layout::BoxDimensions(frame));
+
+  Canvas canvas(100, 20);
+  auto prev = Display::DisplayList::from(layout1);
+  prev.acceptRenderer(canvas);
+
+  auto next = Display::DisplayList::from(layout2);
+  ASSERT_EQ(canvas.repaint(next, next.diff(prev)), 1000);
+  ASSERT_EQ(canvas.getPixels(), Canvas(frame, layout2).getPixels());
+}
+
+TEST_F(CanvasTest, scrollOffset) {
+  HTMLParser html("<html><div class=\"a\"></div><div class=\"b\"></div></html>");
+  CSSParser css(
+      "* { display: block; height: 1px; } .a { background: #ff0000; } "
+      ".b { background: #00ff00; }");
+  auto layout = Layout::Box::from(Style::StyledNode::from(html.evaluate(), css.evaluate()),
+                                  Layout::BoxDimensions(Layout::Rectangle(0, 0, 1, 0)));
+  Canvas canvas(Layout::Rectangle(0, 1, 1, 1), layout);
+  ASSERT_EQ(canvas.getPixels(), std::vector<uint8_t>({0, 255, 0, 255}));
+}
+
+TEST_F(CanvasTest, scrollToReusesCanvas) {
+  HTMLParser html("<html><div class=\"a\"></div><div class=\"b\"></div></html>");
+  CSSParser css(
+      "* { display: block; height: 1px; } .a { background: #ff0000; } "
+      ".b { background: #00ff00; }");
+  auto layout = Layout::Box::from(Style::StyledNode::from(html.evaluate(), css.evaluate()),
+                                  Layout::BoxDimensions(Layout::Rectangle(0, 0, 1, 0)));
+  Canvas strip(1, 1);
+  strip.scrollTo(layout, 0, 0);
+  ASSERT_EQ(strip.getPixels(), std::vector<uint8_t>({255, 0, 0, 255}));
+  strip.scrollTo(layout, 0, 1);
+  ASSERT_EQ(strip.getPixels(), std::vector<uint8_t>({0, 255, 0, 255}));
+  strip.scrollTo(layout, 0, 2);
+  ASSERT_EQ(strip.getPixels(), std::vector<uint8_t>({255, 255, 255, 0}));
+}
+
+TEST_F(CanvasTest, encodeRows) {
+  Display::DisplayList list;
+  list.push_back(Display::Command::rectangle(Layout::Rectangle(0, 1, 2, 1),
+                                             CSS::Value::color(10, 20, 30, 1)));
+  Canvas canvas(2, 2);
+  canvas.render(list);
+
+  std::stringstream full, top;
+  PAMEncoder fullEncoder(full, 2, 2), topEncoder(top, 2, 1);
+  canvas.encode(fullEncoder);
+  canvas.encode(topEncoder, 1);
+  const auto pixels = canvas.getPixels();
+  const std::string raw(pixels.begin(), pixels.end());
+  ASSERT_EQ(full.str().substr(full.str().size() - 16), raw);
+  ASSERT_EQ(top.str().substr(top.str().size() - 8), raw.substr(0, 8));
+}
+
+TEST_F(CanvasTest, view) {
+  Display::DisplayList list;
+  list.push_back(Display::Command::rectangle(Layout::Rectangle(1, 0, 1, 1),
+                                             CSS::Value::color(10, 20, 30, 1)));
+  Canvas canvas(2, 2);
+  canvas.render(list);
+
+  const auto view = canvas.view();
+  ASSERT_EQ(view.size(), 16);
+  ASSERT_EQ(std::vector<uint8_t>(view.row(0), view.row(1)),
+            std::vector<uint8_t>({255, 255, 255, 0, 10, 20, 30, 255}));
+  ASSERT_EQ(std::vector<uint8_t>(view.data, view.data + view.size()), canvas.getPixels());
+}
+
+TEST_F(CanvasTest, exportPixels) {
+  Display::DisplayList list;
+  list.push_back(Display::Command::rectangle(Layout::Rectangle(0, 0, 1, 1),
+                                             CSS::Value::color(100, 150, 200, 0.2)));
+  Canvas canvas(1, 1);
+  canvas.render(list);
+
+  uint8_t px[4];
+  canvas.exportPixels(px, Canvas::ChannelOrder::BGRA);
+  ASSERT_EQ(std::vector<uint8_t>(px, px + 4), std::vector<uint8_t>({200, 150, 100, 51}));
+  canvas.exportPixels(px, Canvas::ChannelOrder::ARGB, true);
+  ASSERT_EQ(std::vector<uint8_t>(px, px + 4), std::vector<uint8_t>({51, 20, 30, 40}));
+}
+
+TEST_F(CanvasTest, blendTranslucent) {
+  Display::DisplayList list;
+  list.push_back(Display::Command::rectangle(Layout::Rectangle(0, 0, 1, 1),
+                                             CSS::Value::color(255, 0, 0, 1)));
+  list.push_back(Display::Command::rectangle(Layout::Rectangle(0, 0, 1, 1),
+                                             CSS::Value::color(0, 0, 255, 0.5)));
+  Canvas canvas(1, 1);
+  canvas.render(list);
+  ASSERT_EQ(canvas.getPixels(), std::vector<uint8_t>({127, 0, 128, 255}));
+}
@@ -0,0 +1,157 @@
+// sherpa_41's Image Encoders test fixture, licensed under MIT. (c) hafiz, 2018
+
+#include "renderer/encoder.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+class EncoderTest : public ::testing::Test {
+ protected:
+  /**
+   * Reads a big-endian 32-bit value
+   * @param bytes bytes to read
+   * @param at offset to read at
+   * @return value
+   */
+  static auto readBigEndian(const std::string& bytes, uint64_t at) -> uint32_t {
+    uint32_t value(0);
+    for (uint64_t i = 0; i < 4; ++i) {
+      value = (value << 8) | static_cast<uint8_t>(bytes[at + i]);
+    }
+    return value;
+  }
+
+  /**
+   * Encodes a PNG of rows of two flat colors, like a rendered page
+   * @param width image width
+   * @param height image height
+   * @param compression how to compress image data
+   * @return encoded PNG
+   */
+  static auto encodePNG(uint64_t width,
+                        uint64_t height,
+                        PNGEncoder::Compression compression) -> std::string {
+    std::stringstream out;
+    PNGEncoder encoder(out, width, height, compression);
+    std::vector<uint8_t> row(width * 4);
+    for (uint64_t y = 0; y < height; ++y) {
+      for (uint64_t x = 0; x < width; ++x) {
+        row[x * 4] = static_cast<uint8_t>(y);
+        row[x * 4 + 1] = static_cast<uint8_t>(x < width / 2 ? 7 : 9);
+        row[x * 4 + 2] = 0;
+        row[x * 4 + 3] = 255;
+      }
+      encoder.writeRow(row.data());
+    }
+    encoder.finish();
+    return out.str();
+  }
+
+  /**
+   * Checks a PNG's chunks and returns the concatenated IDAT data
+   * @param png encoded PNG
+   * @return compressed image data
+   */
+  static auto idat(const std::string& png) -> std::string {
+    EXPECT_EQ(png.substr(0, 8), std::string("\x89PNG\r\n\x1a\n", 8));
+    std::string data;
+    std::string type;
+    uint64_t at(8);
+    while (at < png.size()) {
+      const auto size = readBigEndian(png, at);
+      type = png.substr(at + 4, 4);
+      if (type == "IDAT") {
+        data += png.substr(at + 8, size);
+      }
+      at += 12 + size;
+    }
+    EXPECT_EQ(type, "IEND");
+    EXPECT_EQ(at, png.size());
+    return data;
+  }
+};
+
+TEST_F(EncoderTest, from) {
+  std::stringstream out;
+  ASSERT_TRUE(dynamic_cast<PNGEncoder*>(Encoder::from("a.PNG", out, 1, 1).get()));
+  ASSERT_TRUE(dynamic_cast<PAMEncoder*>(Encoder::from("dir/a.pam", out, 1, 1).get()));
+  ASSERT_TRUE(dynamic_cast<PPMEncoder*>(Encoder::from("a.ppm", out, 1, 1).get()));
+  ASSERT_EQ(Encoder::from("a.jpg", out, 1, 1), nullptr);
+  ASSERT_FALSE(Encoder::supports("dir.png/a"));
+  ASSERT_TRUE(Encoder::supports("a.png"));
+}
+
+TEST_F(EncoderTest, PAM) {
+  std::stringstream out;
+  PAMEncoder encoder(out, 2, 1);
+  const uint8_t row[] = {1, 2, 3, 4, 5, 6, 7, 8};
+  encoder.writeRow(row);
+  encoder.finish();
+  ASSERT_EQ(out.str(),
+            "P7\nWIDTH 2\nHEIGHT 1\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n"
+            "\x01\x02\x03\x04\x05\x06\x07\x08");
+}
+
+TEST_F(EncoderTest, PPM) {
+  std::stringstream out;
+  PPMEncoder encoder(out, 2, 1);
+  const uint8_t row[] = {1, 2, 3, 4, 5, 6, 7, 8};
+  encoder.writeRow(row);
+  encoder.finish();
+  ASSERT_EQ(out.str(), "P6\n2 1\n255\n\x01\x02\x03\x05\x06\x07");
+}
+
+TEST_F(EncoderTest, RowCount) {
+  std::stringstream out;
+  PAMEncoder encoder(out, 1, 1);
+  const uint8_t row[] = {0, 0, 0, 0};
+  ASSERT_THROW(encoder.finish(), std::logic_error);
+  encoder.writeRow(row);
+  ASSERT_THROW(encoder.writeRow(row), std::logic_error);
+}
+
+TEST_F(EncoderTest, PNGHeader) {
+  const auto png = encodePNG(3, 2, PNGEncoder::Compression::Stored);
+  ASSERT_EQ(png.substr(12, 4), "IHDR");
+  ASSERT_EQ(readBigEndian(png, 16), 3);
+  ASSERT_EQ(readBigEndian(png, 20), 2);
+  ASSERT_EQ(png.substr(24, 2), std::string("\x08\x06", 2));
+  // CRC-32 of the IHDR chunk
+  ASSERT_EQ(readBigEndian(png, 29), 0x9d74661a);
+}
+
+TEST_F(EncoderTest, PNGCompression) {
+  // large enough to span several stored blocks and IDAT chunks
+  const uint64_t width = 300, height = 200;
+  std::string raw;
+  for (uint64_t y = 0; y < height; ++y) {
+    raw.push_back(0);
+    for (uint64_t x = 0; x < width; ++x) {
+      raw += {static_cast<char>(y), static_cast<char>(x < width / 2 ? 7 : 9), 0,
+              static_cast<char>(255)};
+    }
+  }
+
+  using Compression = PNGEncoder::Compression;
+  for (auto compression :
+       {Compression::Stored, Compression::RunLength, Compression::Deflate}) {
+    const auto data = idat(encodePNG(width, height, compression));
+    if (compression != Compression::Stored) {
+      ASSERT_LT(data.size(), raw.size() / 4);
+    }
+#ifdef HAVE_ZLIB
+    std::string inflated(raw.size(), '\0');
+    auto size = static_cast<uLongf>(inflated.size());
+    ASSERT_EQ(uncompress(reinterpret_cast<Bytef*>(&inflated[0]), &size,
+                         reinterpret_cast<const Bytef*>(data.data()),
+                         static_cast<uLong>(data.size())),
+              Z_OK);
+    ASSERT_EQ(inflated, raw);
+#endif
+  }
+}
@@ -0,0 +1,148 @@
+// sherpa_41's Server module test fixture, licensed under MIT. (c) hafiz, 2018
+
+#ifndef _WIN32
+
+#include "server.h"
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <thread>
+
+#ifdef MSG_NOSIGNAL
+static constexpr int sendFlags = MSG_NOSIGNAL;
+#else
+static constexpr int sendFlags = 0;
+#endif
+
+class ServerTest : public ::testing::Test {
+ protected:
+  /**
+   * Returns a socket path in the test's temporary directory
+   * @return socket path
+   */
+  static auto socketPath() -> std::string { return ::testing::TempDir() + "sherpa_41.sock"; }
+
+  /**
+   * Connects a raw socket to the server
+   * @return connected socket
+   */
+  static auto connectRaw() -> int {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath().c_str(), sizeof(address.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+};
+
+TEST_F(ServerTest, Handle) {
+  Server::RenderServer server(socketPath());
+  Server::Request request{2, 1, "pam", "<html></html>",
+                          "* { display: block; height: 1px; background: #0000ff; }"};
+
+  auto response = server.handle(request);
+  ASSERT_TRUE(response.ok);
+  ASSERT_EQ(response.body.substr(response.body.size() - 8),
+            std::string("\x00\x00\xff\xff\x00\x00\xff\xff", 8));
+
+  request.format = "gif";
+  ASSERT_FALSE(server.handle(request).ok);
+  request.format = "png";
+  request.width = 0;
+  ASSERT_FALSE(server.handle(request).ok);
+
+  // canvases are bounded by their area, not only by their sides
+  request.width = request.height = Server::RenderServer::maxSize;
+  ASSERT_EQ(server.handle(request).body, "Invalid size");
+}
+
+TEST_F(ServerTest, RequestOverSocket) {
+  Server::Request request{1, 1, "ppm", "<html></html>",
+                          "* { display: block; height: 1px; background: #102030; }"};
+  Server::Response rendered, failed;
+  {
+    Server::RenderServer server(socketPath());
+    std::thread serving([&server]() { server.serve(); });
+    rendered = Server::RenderServer::request(socketPath(), request);
+    request.format = "jpg";
+    failed = Server::RenderServer::request(socketPath(), request);
+    server.stop();
+    serving.join();
+  }
+
+  ASSERT_TRUE(rendered.ok);
+  ASSERT_EQ(rendered.body, "P6\n1 1\n255\n\x10\x20\x30");
+  ASSERT_FALSE(failed.ok);
+  ASSERT_EQ(failed.body, "Unsupported format jpg");
+  ASSERT_THROW(Server::RenderServer::request(socketPath(), request), std::runtime_error);
+}
+
+TEST_F(ServerTest, DropsStalledClients) {
+  Server::Request request{1, 1, "ppm", "<html></html>",
+                          "* { display: block; height: 1px; background: #102030; }"};
+  Server::Response rendered;
+  {
+    Server::RenderServer server(socketPath(), Server::RenderServer::canvasCacheSize, "",
+                                std::chrono::milliseconds(50));
+    std::thread serving([&server]() { server.serve(); });
+
+    // a client that connects and never sends its request is answered first
+    const int stalled = connectRaw();
+    ASSERT_GE(stalled, 0);
+    rendered = Server::RenderServer::request(socketPath(), request);
+    close(stalled);
+    server.stop();
+    serving.join();
+  }
+
+  ASSERT_TRUE(rendered.ok);
+  ASSERT_EQ(rendered.body, "P6\n1 1\n255\n\x10\x20\x30");
+}
+
+TEST_F(ServerTest, DropsDripFedClients) {
+  Server::Request request{1, 1, "ppm", "<html></html>",
+                          "* { display: block; height: 1px; background: #102030; }"};
+  Server::Response rendered;
+  uint64_t dripped = 0;
+  {
+    Server::RenderServer server(socketPath(), Server::RenderServer::canvasCacheSize, "",
+                                std::chrono::milliseconds(200));
+    std::thread serving([&server]() { server.serve(); });
+
+    // a client sending a byte well within the timeout, but its request not,
+    // is answered first and dropped
+    const int dripping = connectRaw();
+    ASSERT_GE(dripping, 0);
+    std::thread drip([dripping, &dripped]() {
+      const uint32_t fields[4] = {1, 1, 3, 1 << 10};
+      std::string head(reinterpret_cast<const char*>(fields), 3 * sizeof(uint32_t));
+      head += "ppm";
+      head.append(reinterpret_cast<const char*>(&fields[3]), sizeof(uint32_t));
+      head.append(1 << 10, ' ');
+      while (dripped < head.size() && send(dripping, &head[dripped], 1, sendFlags) == 1) {
+        ++dripped;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      }
+    });
+    rendered = Server::RenderServer::request(socketPath(), request);
+    drip.join();
+    close(dripping);
+    server.stop();
+    serving.join();
+  }
+
+  ASSERT_TRUE(rendered.ok);
+  ASSERT_EQ(rendered.body, "P6\n1 1\n255\n\x10\x20\x30");
+  ASSERT_GT(dripped, 19);  // its fields were valid, its html cut short
+  ASSERT_LT(dripped, 1 << 10);
+}
+
+#endif
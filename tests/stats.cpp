@@ -0,0 +1,198 @@
+// sherpa_41's Stats module test fixture, licensed under MIT. (c) hafiz, 2018
+
+#include "stats.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+
+#include "generator.h"
+#include "parser/css.h"
+#include "parser/html.h"
+#include "renderer/canvas.h"
+#include "style.h"
+
+TEST(StatsTest, CountsAllocations) {
+  if (!Stats::tracksAllocations()) {
+    GTEST_SKIP() << "allocation hooks are not built";
+  }
+  const auto start = Stats::local();
+  auto value = std::make_unique<uint64_t>(41);
+  auto counted = Stats::local().since(start);
+  ASSERT_EQ(counted.allocations, 1);
+  ASSERT_EQ(counted.allocatedBytes, sizeof(uint64_t));
+
+  std::vector<char> bytes(1000);
+  counted = Stats::local().since(start);
+  ASSERT_EQ(counted.allocations, 2);
+  ASSERT_EQ(counted.allocatedBytes, sizeof(uint64_t) + 1000);
+}
+
+TEST(StatsTest, CountsAlignedAllocations) {
+  if (!Stats::tracksAllocations()) {
+    GTEST_SKIP() << "allocation hooks are not built";
+  }
+  struct alignas(256) Aligned {
+    char bytes[256];
+  };
+  const auto start = Stats::local();
+  const auto startMemory = Stats::memory().live;
+  {
+    auto value = std::make_unique<Aligned>();
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(value.get()) % alignof(Aligned), 0);
+    const auto counted = Stats::local().since(start);
+    ASSERT_EQ(counted.allocations, 1);
+    ASSERT_EQ(counted.allocatedBytes, sizeof(Aligned));
+  }
+  ASSERT_EQ(Stats::memory().live, startMemory);
+}
+
+TEST(StatsTest, TracksMemory) {
+  if (!Stats::tracksAllocations()) {
+    GTEST_SKIP() << "allocation hooks are not built";
+  }
+  Stats::Report stats;
+  auto kept = stats.measure("kept", []() {
+    std::vector<char> scratch(4000);
+    return std::make_unique<std::vector<char>>(1000);
+  });
+  stats.measure("freed", []() { std::vector<char> scratch(2000); });
+  stats.measure("outer", [&]() {
+    std::vector<char> scratch(500);
+    stats.measure("inner", []() { std::vector<char> scratch(3000); });
+  });
+
+  const auto& stages = stats.getStages();
+  ASSERT_EQ(stages[0].name, "kept");
+  ASSERT_GE(stages[0].peakBytes, 5000);
+  ASSERT_LT(stages[0].peakBytes, 5100);
+  ASSERT_GE(stages[0].retainedBytes, 1000);
+  ASSERT_LT(stages[0].retainedBytes, 1100);
+  ASSERT_EQ(stages[1].name, "freed");
+  ASSERT_EQ(stages[1].peakBytes, 2000);
+  ASSERT_EQ(stages[1].retainedBytes, 0);
+  // the inner stage ends first, and its peak counts toward the outer stage
+  ASSERT_EQ(stages[2].name, "inner");
+  ASSERT_EQ(stages[2].peakBytes, 3000);
+  ASSERT_EQ(stages[3].name, "outer");
+  ASSERT_EQ(stages[3].peakBytes, 3500);
+
+  // the freed stage peaks on top of the memory the kept stage retained
+  const auto total = stats.total();
+  const auto retained = static_cast<uint64_t>(stages[0].retainedBytes);
+  ASSERT_EQ(total.peakBytes, std::max(stages[0].peakBytes, retained + 3500));
+  ASSERT_EQ(total.retainedBytes, stages[0].retainedBytes + stages[1].retainedBytes +
+                                     stages[2].retainedBytes + stages[3].retainedBytes);
+}
+
+TEST(StatsTest, AllocationBudget) {
+  if (!Stats::tracksAllocations()) {
+    GTEST_SKIP() << "allocation hooks are not built";
+  }
+  Generator::Options options;
+  options.nodes = 200;
+  const auto html = Generator::document(options);
+  const auto css = Generator::stylesheet(options);
+
+  Stats::Report stats;
+  auto dom = stats.measure("parse-html", [&]() { return HTMLParser(html).evaluate(); });
+  auto stylesheet = stats.measure("parse-css", [&]() { return CSSParser(css).evaluate(); });
+  auto styledDom =
+      stats.measure("style", [&]() { return Style::StyledNode::from(*dom, stylesheet); });
+  const Layout::BoxDimensions window(Layout::Rectangle(0, 0, 800, 600));
+  auto root =
+      stats.measure("layout", [&]() { return Layout::Box::from(styledDom, window); });
+  const auto nodes = Stats::countNodes(*dom);
+
+  // allocations and peak bytes per node that each stage may not exceed,
+  // with some headroom over what they take at the time of writing
+  struct Budget {
+    std::string stage;
+    double allocations;
+    double peakBytes;
+  };
+  const std::vector<Budget> budgets{
+      {"parse-html", 40, 1024}, {"style", 640, 6 * 1024}, {"layout", 8000, 48 * 1024}};
+  for (const auto& budget : budgets) {
+    const auto& stages = stats.getStages();
+    auto named = [&budget](const Stats::Stage& run) { return run.name == budget.stage; };
+    const auto stage = std::find_if(stages.begin(), stages.end(), named);
+    ASSERT_NE(stage, stages.end());
+    EXPECT_LE(static_cast<double>(stage->counters.allocations) / nodes, budget.allocations)
+        << budget.stage;
+    EXPECT_LE(static_cast<double>(stage->peakBytes) / nodes, budget.peakBytes)
+        << budget.stage;
+  }
+}
+
+TEST(StatsTest, MeasuresStages) {
+  Stats::Report stats;
+  auto dom = stats.measure("parse-html", []() {
+    return HTMLParser("<html><p class=\"a\">hi</p><p></p></html>").evaluate();
+  });
+  auto stylesheet = stats.measure(
+      "parse-css", []() { return CSSParser("* { display: block; } p, .a { height: 10px; }"
+                                           ".a { background: #ff0000; }")
+                                     .evaluate(); });
+  auto styledDom =
+      stats.measure("style", [&]() { return Style::StyledNode::from(*dom, stylesheet); });
+  const Layout::BoxDimensions window(Layout::Rectangle(0, 0, 20, 20));
+  auto root =
+      stats.measure("layout", [&]() { return Layout::Box::from(styledDom, window); });
+  Canvas canvas(20, 20);
+  for (int i = 0; i < 2; ++i) {
+    stats.measure("raster", [&]() { canvas.scrollTo(root, 0, 0); });
+  }
+  stats.count("nodes", Stats::countNodes(*dom));
+  stats.count("boxes", Stats::countBoxes(*root));
+
+  const auto& stages = stats.getStages();
+  ASSERT_EQ(stages.size(), 5);
+  ASSERT_EQ(stages[0].name, "parse-html");
+  ASSERT_EQ(stages[0].counters.allocations > 0, Stats::tracksAllocations());
+  ASSERT_EQ(stages[0].counters.selectorMatches, 0);
+  // every element tries `*` and `.a`, and `p, .a` until one matches: by
+  // specificity, `.a` is tried before `p`
+  ASSERT_EQ(stages[2].counters.selectorMatches, 4 + 3 + 4);
+  ASSERT_EQ(stages[4].name, "raster");
+  ASSERT_EQ(stages[4].runs, 2);
+  // only the first paragraph has a background to paint
+  ASSERT_EQ(stages[4].counters.pixelsBlended, 2 * 20 * 10);
+
+  const auto total = stats.total();
+  ASSERT_EQ(total.runs, 6);
+  ASSERT_GE(total.wallSeconds, stages[0].wallSeconds);
+  ASSERT_EQ(total.counters.selectorMatches, stages[2].counters.selectorMatches);
+
+  ASSERT_EQ(stats.getCounts().size(), 2);
+  ASSERT_EQ(stats.getCounts()[0], std::make_pair(std::string("nodes"), uint64_t(4)));
+}
+
+TEST(StatsTest, Print) {
+  Stats::Report stats;
+  stats.measure("style", []() {});
+  stats.count("nodes", 3);
+  stats.count("boxes", 2);
+
+  std::stringstream text;
+  stats.print(text);
+  std::string line;
+  std::getline(text, line);
+  ASSERT_EQ(line.find("stage"), 0);
+  std::getline(text, line);
+  ASSERT_EQ(line.find("style"), 0);
+  std::getline(text, line);
+  ASSERT_EQ(line.find("total"), 0);
+  std::getline(text, line);
+  ASSERT_EQ(line, "nodes: 3, boxes: 2");
+
+  std::stringstream json;
+  stats.json(json);
+  const auto printed = json.str();
+  ASSERT_EQ(printed.find(R"({"stages": [{"name": "style", "runs": 1, "wall_ms": )"), 0);
+  ASSERT_NE(printed.find(R"("total": {"name": "total", "runs": 1, )"), std::string::npos);
+  ASSERT_NE(printed.find(R"("counts": {"nodes": 3, "boxes": 2}})"), std::string::npos);
+}
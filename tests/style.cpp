@@ -4,8 +4,11 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 #include "parser/css.h"
 #include "parser/html.h"
+#include "stats.h"
 
 class StyleTest : public ::testing::Test {};
 
@@ -30,12 +33,13 @@ TEST_F(StyleTest, value) {
   ASSERT_EQ(root.value("font-size", "other-size", "rah")->print(), "15px");
   ASSERT_EQ(root.value("font-size", "font-size")->print(), "15px");
   ASSERT_EQ(root.value("other-size", "font-size", "rah")->print(), "15px");
-  ASSERT_EQ(root.value("other-size", "another-size"), nullptr);
-  ASSERT_EQ(root.value_or("font-size", CSS::TextValue("NO VALUE"))->print(), "15px");
-  ASSERT_EQ(root.value_or<std::string>("other-size", "font-size", CSS::TextValue("NO VALUE"))
-                ->print(),
-            "15px");
-  ASSERT_EQ(root.value_or_zero("other-size", "another-size")->print(), "0px");
+  ASSERT_EQ(root.value("other-size", "another-size"), std::nullopt);
+  ASSERT_EQ(root.value_or("font-size", CSS::Value::keyword("NO VALUE")).print(), "15px");
+  ASSERT_EQ(
+      root.value_or<std::string>("other-size", "font-size", CSS::Value::keyword("NO VALUE"))
+          .print(),
+      "15px");
+  ASSERT_EQ(root.value_or_zero("other-size", "another-size").print(), "0px");
 }
 
 TEST_F(StyleTest, OneSelector) {
@@ -50,7 +54,7 @@ TEST_F(StyleTest, WorksWithSelectors) {
   CSSParser css(R"(
 html#id.class1.class2{font-size:15px;}
 .class1{color:red;}
-.class2{background:green;}
+.class2{background:#008000;}
 #id{text-decoration:none;}
 html{display:block;}
 *{font-style:normal;}
@@ -63,7 +67,7 @@ html{display:block;}
 
   ASSERT_EQ(root.value("font-size")->print(), "15px");
   ASSERT_EQ(root.value("color")->print(), "red");
-  ASSERT_EQ(root.value("background")->print(), "green");
+  ASSERT_EQ(root.value("background-color")->print(), "rgba(0, 128, 0, 1)");
   ASSERT_EQ(root.value("text-decoration")->print(), "none");
   ASSERT_EQ(root.value("display")->print(), "block");
   ASSERT_EQ(root.value("font-style")->print(), "normal");
@@ -96,7 +100,7 @@ TEST_F(StyleTest, UselessRules) {
 
   auto root = StyledNode::from(html.evaluate(), css.evaluate());
 
-  ASSERT_EQ(root.value_or("color", CSS::TextValue("NO VALUE"))->print(), "NO VALUE");
+  ASSERT_EQ(root.value_or("color", CSS::Value::keyword("NO VALUE")).print(), "NO VALUE");
 }
 
 TEST_F(StyleTest, NestedNodes) {
@@ -111,8 +115,29 @@ TEST_F(StyleTest, NestedNodes) {
   ASSERT_EQ(children[1].value("color")->print(), "blue");
 }
 
+TEST_F(StyleTest, BorrowsDOM) {
+  CSSParser css("div{color:blue;}");
+  const SharedNodePtr dom = HTMLParser("<html><div>text</div></html>").evaluate();
+  const auto& element = dynamic_cast<const DOM::ElementNode&>(*dom);
+  const auto& div = dynamic_cast<const DOM::ElementNode&>(*element.borrowChildren()[0]);
+
+  // styled nodes, and their copies, point into the DOM rather than copying it
+  auto root = StyledNode::from(dom, css.evaluate());
+  const auto copy = root;
+  ASSERT_EQ(&copy.borrowNode(), dom.get());
+  ASSERT_EQ(&copy.borrowChildren()[0].borrowNode(), &div);
+  ASSERT_EQ(&copy.borrowChildren()[0].borrowChildren()[0].borrowNode(),
+            div.borrowChildren()[0].get());
+
+  // and share ownership of it, unless it is owned elsewhere
+  ASSERT_EQ(dom.use_count(), 1 + 2 * 3);
+  const auto borrowed = StyledNode::from(*dom, css.evaluate());
+  ASSERT_EQ(&borrowed.borrowChildren()[0].borrowNode(), &div);
+  ASSERT_EQ(dom.use_count(), 1 + 2 * 3);
+}
+
 TEST_F(StyleTest, NonElementNodes) {
-  CSSParser css("*{color:red;}");
+  CSSParser css("*{color:red;margin:1px;}");
   HTMLParser html(R"(
 <html>
 	<!-- comment! -->
@@ -123,7 +148,229 @@ TEST_F(StyleTest, NonElementNodes) {
   auto root = StyledNode::from(html.evaluate(), css.evaluate());
   auto children = root.getChildren();
 
-  ASSERT_EQ(root.value("color")->print(), "red");
-  ASSERT_EQ(children[0].value("color"), nullptr);
-  ASSERT_EQ(children[1].value("color"), nullptr);
+  ASSERT_EQ(root.value("margin-top")->print(), "1px");
+  ASSERT_EQ(children[0].value("margin-top"), std::nullopt);
+  ASSERT_EQ(children[1].value("margin-top"), std::nullopt);
+
+  // selectors match no text, but text inherits from its element
+  ASSERT_EQ(children[1].value("color")->print(), "red");
+}
+
+TEST_F(StyleTest, Combinators) {
+  CSSParser css(R"(
+.card .title{color:red;}
+ul > li{color:green;}
+body > .title{color:blue;text-align:left;}
+.card > .title{font-size:2px;}
+.card .body .title{display:block;}
+.other .title{font-style:italic;}
+)");
+  HTMLParser html(R"(
+<body class="card">
+  <div class="body"><p class="title"></p></div>
+  <ul><li></li><div><li></li></div></ul>
+  <p class="title"></p>
+</body>
+)");
+
+  // the body is wrapped in an html element
+  auto root = StyledNode::from(html.evaluate(), css.evaluate());
+  auto children = root.getChildren()[0].getChildren();
+  auto deep = children[0].getChildren()[0];
+  ASSERT_EQ(deep.value("color")->print(), "red");
+  ASSERT_EQ(deep.value("display")->print(), "block");
+  ASSERT_EQ(deep.value("font-size"), std::nullopt);
+  ASSERT_EQ(deep.value("font-style"), std::nullopt);
+
+  auto list = children[1].getChildren();
+  ASSERT_EQ(list[0].value("color")->print(), "green");
+  ASSERT_EQ(list[1].getChildren()[0].value("color"), std::nullopt);
+
+  // `.card .title` is more specific than `body > .title`
+  ASSERT_EQ(children[2].value("color")->print(), "red");
+  ASSERT_EQ(children[2].value("text-align")->print(), "left");
+  ASSERT_EQ(deep.value("text-align"), std::nullopt);
+  ASSERT_EQ(children[2].value("font-size")->print(), "2px");
+  ASSERT_EQ(children[2].value("display"), std::nullopt);
+}
+
+TEST_F(StyleTest, AttributesAndPseudoClasses) {
+  CSSParser css(R"(
+[data-x]{color:red;}
+input[type=text]{display:inline;}
+li:first-child{font-size:1px;}
+li:nth-child(2n+1){font-style:italic;}
+li:nth-child(-n+2){text-align:left;}
+[data-x] > li:nth-child(3){height:3px;}
+html:first-child{height:4px;}
+)");
+  HTMLParser html(R"(
+<ul data-x="">
+  <li></li><!-- not an element --><li></li>
+  text
+  <li></li>
+  <input type="text"></input><input type="password"></input>
+</ul>
+)");
+
+  auto root = StyledNode::from(html.evaluate(), css.evaluate());
+  ASSERT_EQ(root.value("height")->print(), "4px");  // a root is its document's first child
+  auto list = root.getChildren()[0];
+  ASSERT_EQ(list.value("color")->print(), "red");
+  ASSERT_EQ(list.value("font-size"), std::nullopt);
+
+  auto children = list.getChildren();
+  auto element = [&children](uint64_t index) {
+    return *std::find_if(children.begin(), children.end(), [&index](const auto& child) {
+      return child.borrowNode().siblingIndex() == index;
+    });
+  };
+  ASSERT_EQ(element(1).value("font-size")->print(), "1px");
+  ASSERT_EQ(element(1).value("font-style")->print(), "italic");
+  ASSERT_EQ(element(1).value("text-align")->print(), "left");
+  ASSERT_EQ(element(1).value("color")->print(), "red");  // inherited from the list
+
+  // the comment and text between the items do not count as siblings
+  ASSERT_EQ(element(2).value("font-size"), std::nullopt);
+  ASSERT_EQ(element(2).value("font-style"), std::nullopt);
+  ASSERT_EQ(element(2).value("text-align")->print(), "left");
+  ASSERT_EQ(element(3).value("font-style")->print(), "italic");
+  ASSERT_EQ(element(3).value("text-align"), std::nullopt);
+  ASSERT_EQ(element(3).value("height")->print(), "3px");
+
+  ASSERT_EQ(element(4).value("display")->print(), "inline");
+  ASSERT_EQ(element(5).value("display"), std::nullopt);
+}
+
+TEST_F(StyleTest, Inheritance) {
+  CSSParser css(R"(
+body{color:red;font-size:12px;margin:1px;}
+.blue{color:blue;}
+.reset{margin:inherit;color:initial;}
+)");
+  HTMLParser html(R"(
+<body>
+  <div><p>text</p></div>
+  <div class="blue"><p></p></div>
+  <div class="reset"></div>
+</body>
+)");
+
+  // the body is wrapped in an html element
+  auto root = StyledNode::from(html.evaluate(), css.evaluate());
+  const auto& body = root.borrowChildren()[0];
+  const auto& plain = body.borrowChildren()[0];
+  const auto& paragraph = plain.borrowChildren()[0];
+  ASSERT_EQ(root.value("color"), std::nullopt);
+  ASSERT_EQ(plain.value("color")->print(), "red");
+  ASSERT_EQ(paragraph.borrowChildren()[0].value("font-size")->print(), "12px");
+  ASSERT_EQ(plain.value("margin-left"), std::nullopt);  // not inherited
+  ASSERT_TRUE(plain.borrowProperties().empty());
+
+  // descendants that set nothing share their ancestor's structs
+  ASSERT_NE(body.borrowStyleStruct(Text), nullptr);
+  ASSERT_EQ(paragraph.borrowStyleStruct(Text), body.borrowStyleStruct(Text));
+  ASSERT_EQ(paragraph.borrowStyleStruct(Font), body.borrowStyleStruct(Font));
+  ASSERT_EQ(StyledNode(paragraph).borrowStyleStruct(Text), body.borrowStyleStruct(Text));
+
+  const auto& blue = body.borrowChildren()[1];
+  ASSERT_EQ(blue.borrowChildren()[0].value("color")->print(), "blue");
+  ASSERT_EQ(blue.value("font-size")->print(), "12px");
+  ASSERT_NE(blue.borrowStyleStruct(Text), body.borrowStyleStruct(Text));
+  ASSERT_EQ(blue.borrowStyleStruct(Font), body.borrowStyleStruct(Font));
+
+  const auto& reset = body.borrowChildren()[2];
+  ASSERT_EQ(reset.value("margin-left")->print(), "1px");
+  ASSERT_EQ(reset.value("color"), std::nullopt);
+  ASSERT_EQ(reset.borrowStyleStruct(Text), nullptr);
+  ASSERT_EQ(reset.getProperties().size(), 5);  // margins and font-size
+
+  // the body's Font and Text structs, and the blue div's Text struct
+  ASSERT_EQ(Stats::countStyleStructs(root), 3);
+}
+
+TEST_F(StyleTest, FontRelativeUnits) {
+  CSSParser css(R"(
+html{font-size:20px;}
+div{font-size:1.5em;margin:2em;padding:1rem;width:50%;}
+p{font-size:50%;border-width:1em;}
+span{font-size:2rem;}
+)");
+  HTMLParser html("<html><div><p><span></span></p></div></html>");
+
+  auto root = StyledNode::from(html.evaluate(), css.evaluate());
+  ASSERT_EQ(root.getFontSize(), 20);
+  ASSERT_EQ(root.getRootFontSize(), 20);
+
+  const auto& div = root.borrowChildren()[0];
+  ASSERT_EQ(div.getFontSize(), 30);
+  ASSERT_EQ(div.value("font-size")->print(), "30px");
+  ASSERT_EQ(div.value("margin-top")->print(), "60px");    // of its own font size
+  ASSERT_EQ(div.value("padding-left")->print(), "20px");  // of the root's
+  ASSERT_EQ(div.value("width")->print(), "50%");          // left to layout
+
+  const auto& p = div.borrowChildren()[0];
+  ASSERT_EQ(p.value("font-size")->print(), "15px");  // of its parent's
+  ASSERT_EQ(p.value("border-right-width")->print(), "15px");
+  ASSERT_EQ(p.getRootFontSize(), 20);
+
+  const auto& span = p.borrowChildren()[0];
+  ASSERT_EQ(span.getFontSize(), 40);
+}
+
+TEST_F(StyleTest, FontSizeReset) {
+  CSSParser css(R"(
+html{font-size:20px;font-size:initial;}
+div{font-size:30px;}
+p{font-size:initial;font-size:10vw;}
+span{font-size:2em;}
+)");
+  HTMLParser html("<html><div><p><span></span></p></div></html>");
+
+  // the root's reset size is the rem, and its children's em
+  auto root = StyledNode::from(html.evaluate(), css.evaluate());
+  ASSERT_EQ(root.value("font-size"), std::nullopt);
+  ASSERT_EQ(root.getFontSize(), StyledNode::initialFontSize);
+  ASSERT_EQ(root.getRootFontSize(), StyledNode::initialFontSize);
+
+  // viewport units are rejected, so the reset before them stands
+  const auto& p = root.borrowChildren()[0].borrowChildren()[0];
+  ASSERT_EQ(p.value("font-size"), std::nullopt);
+  ASSERT_EQ(p.getFontSize(), StyledNode::initialFontSize);
+
+  const auto& span = p.borrowChildren()[0];
+  ASSERT_EQ(span.value("font-size")->print(), "32px");
+  ASSERT_EQ(span.getFontSize(), 2 * StyledNode::initialFontSize);
+}
+
+TEST_F(StyleTest, AncestorFilter) {
+  auto dom = HTMLParser(R"(<div id="a" class="b c"><p class="d"></p></div>)").evaluate();
+  auto child = [](const DOM::Node& node) -> const DOM::ElementNode& {
+    const auto& element = dynamic_cast<const DOM::ElementNode&>(node);
+    return dynamic_cast<const DOM::ElementNode&>(*element.borrowChildren().front());
+  };
+  const auto& div = child(*dom);
+  const auto& p = child(div);
+  auto selector = [](const std::string& source) {
+    return *CSSParser(source + " {}").evaluate().front().selectors.begin();
+  };
+
+  Ancestors ancestors;
+  ancestors.push(div);
+  ancestors.push(p);
+  ASSERT_EQ(ancestors.borrowElements().size(), 2);
+  ASSERT_TRUE(ancestors.mayMatch(selector("div#a.b.c p.d span")));
+  ASSERT_TRUE(ancestors.mayMatch(selector("span")));
+  // no false negatives are possible, but these few names collide with none
+  ASSERT_FALSE(ancestors.mayMatch(selector("section span")));
+  ASSERT_FALSE(ancestors.mayMatch(selector(".a span")));
+  ASSERT_FALSE(ancestors.mayMatch(selector("#b span")));
+  ASSERT_TRUE(ancestors.mayMatch(selector("[class=z] span")));
+  ASSERT_FALSE(ancestors.mayMatch(selector("[href] span")));
+
+  ancestors.pop();
+  ASSERT_FALSE(ancestors.mayMatch(selector(".d span")));
+  ASSERT_TRUE(ancestors.mayMatch(selector(".c span")));
+  ancestors.pop();
+  ASSERT_FALSE(ancestors.mayMatch(selector("div span")));
 }
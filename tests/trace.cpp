@@ -0,0 +1,93 @@
+// sherpa_41's Trace module test fixture, licensed under MIT. (c) hafiz, 2018
+
+#include "trace.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+
+#include "parser/html.h"
+
+class TraceTest : public ::testing::Test {
+ protected:
+  void TearDown() override { Trace::stop(); }
+};
+
+TEST_F(TraceTest, RecordsSpans) {
+  Trace::start();
+  ASSERT_TRUE(Trace::enabled());
+  {
+    Trace::Span outer("test", "outer", "n", 3);
+    Trace::Span inner("test", "inner");
+  }
+  Trace::stop();
+  {
+    Trace::Span ignored("test", "ignored");
+  }
+
+  const auto events = Trace::events();
+  ASSERT_EQ(events.size(), 2);
+  ASSERT_STREQ(events[0].name, "outer");
+  ASSERT_STREQ(events[0].argName, "n");
+  ASSERT_EQ(events[0].argValue, 3);
+  ASSERT_STREQ(events[1].name, "inner");
+  ASSERT_EQ(events[1].argName, nullptr);
+  ASSERT_LE(events[0].start, events[1].start);
+  ASSERT_GE(events[0].start + events[0].duration, events[1].start + events[1].duration);
+  ASSERT_EQ(events[0].thread, events[1].thread);
+
+  Trace::start();
+  ASSERT_TRUE(Trace::events().empty());
+}
+
+TEST_F(TraceTest, RecordsThreads) {
+  Trace::start();
+  {
+    Trace::Span span("test", "main");
+  }
+  std::thread([]() { Trace::Span span("test", "worker"); }).join();
+  Trace::stop();
+
+  // events of exited threads are kept
+  const auto events = Trace::events();
+  ASSERT_EQ(events.size(), 2);
+  ASSERT_NE(events[0].thread, events[1].thread);
+}
+
+TEST_F(TraceTest, Write) {
+  Trace::start();
+  Trace::record(Trace::Event{"test", "first", 1000, 2500, 0, nullptr, 0});
+  Trace::record(Trace::Event{"test", "second", 2000, 7, 0, "y", 40});
+  Trace::stop();
+
+  std::stringstream json;
+  Trace::write(json);
+  const auto written = json.str();
+  ASSERT_EQ(written.find(R"({"displayTimeUnit": "ms", "traceEvents": [)"), 0);
+  ASSERT_NE(written.find(R"({"cat": "test", "name": "first", "ph": "X", "pid": 1, )"),
+            std::string::npos);
+  ASSERT_NE(written.find(R"("ts": 0.000, "dur": 2.500})"), std::string::npos);
+  ASSERT_NE(written.find(R"("ts": 1.000, "dur": 0.007, "args": {"y": 40}})"),
+            std::string::npos);
+  ASSERT_EQ(written.substr(written.size() - 4), "\n]}\n");
+}
+
+TEST_F(TraceTest, Macros) {
+  Trace::start();
+  {
+    TRACE_SPAN("test", "macro");
+    TRACE_SPAN_ARG("test", "macro arg", "n", 1);
+  }
+  auto dom = HTMLParser("<p></p>").evaluate();
+  Trace::stop();
+
+  const auto events = Trace::events();
+#ifdef HAVE_TRACE
+  ASSERT_EQ(events.size(), 3);
+  ASSERT_STREQ(events[2].name, "HTMLParser::evaluate");
+#else
+  // spans are compiled out
+  ASSERT_TRUE(events.empty());
+#endif
+}
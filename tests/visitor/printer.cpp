@@ -85,10 +85,10 @@ TEST_F(PrinterTest, NestedElements) {
 
 TEST_F(PrinterTest, CSSRule) {
   using namespace CSS;
-  std::vector<Declaration> decls;
-  decls.emplace_back(Declaration("font-size", ValuePtr(new UnitValue(15.4, px))));
-  decls.emplace_back(Declaration("text-decoration", ValuePtr(new TextValue("none"))));
-  decls.emplace_back(Declaration("color", ValuePtr(new ColorValue(155, 202, 187, 0.5))));
+  DeclarationSet decls;
+  decls.emplace_back(Declaration("font-size", Value::length(15.4, px)));
+  decls.emplace_back(Declaration("text-decoration", Value::keyword("none")));
+  decls.emplace_back(Declaration("color", Value::color(155, 202, 187, 0.5)));
   Rule rule({Selector("span", "myId", {"class1", "class2"}), Selector("a"),
              Selector("", "id"), Selector("", "", {"klass"})},
             std::move(decls));
@@ -107,17 +107,17 @@ span#myId.class1.class2, #id, .klass, a {
 
 TEST_F(PrinterTest, CSSRules) {
   using namespace CSS;
-  std::vector<Declaration> decls1;
-  decls1.emplace_back(Declaration("font-size", ValuePtr(new UnitValue(15.4, px))));
-  decls1.emplace_back(Declaration("text-decoration", ValuePtr(new TextValue("none"))));
-  decls1.emplace_back(Declaration("color", ValuePtr(new ColorValue(155, 202, 187, 0.5))));
+  DeclarationSet decls1;
+  decls1.emplace_back(Declaration("font-size", Value::length(15.4, px)));
+  decls1.emplace_back(Declaration("text-decoration", Value::keyword("none")));
+  decls1.emplace_back(Declaration("color", Value::color(155, 202, 187, 0.5)));
   Rule rule1({Selector("span", "myId", {"class1", "class2"}), Selector("a"),
               Selector("", "id"), Selector("", "", {"klass"})},
              std::move(decls1));
-  std::vector<Declaration> decls2;
-  decls2.emplace_back(Declaration("font-size", ValuePtr(new UnitValue(15.4, px))));
-  decls2.emplace_back(Declaration("text-decoration", ValuePtr(new TextValue("none"))));
-  decls2.emplace_back(Declaration("color", ValuePtr(new ColorValue(155, 202, 187, 0.5))));
+  DeclarationSet decls2;
+  decls2.emplace_back(Declaration("font-size", Value::length(15.4, px)));
+  decls2.emplace_back(Declaration("text-decoration", Value::keyword("none")));
+  decls2.emplace_back(Declaration("color", Value::color(155, 202, 187, 0.5)));
   Rule rule2({Selector("span", "myId", {"class1", "class2"}), Selector("a"),
               Selector("", "id"), Selector("", "", {"klass"})},
              std::move(decls2));